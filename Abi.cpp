@@ -0,0 +1,46 @@
+#include "Abi.h"
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+long long TargetAbi::sizeOf(const string &type) const
+{
+    if (type.empty())
+        return 0;
+    if (type.back() == '*' || type == "string" || type == "size_t" || type == "ptrdiff_t")
+        return pointer_size;
+    if (type == "char" || type == "bool")
+        return 1;
+    if (type == "short")
+        return 2;
+    if (type == "int" || type == "float")
+        return 4;
+    if (type == "long")
+        return long_size;
+    if (type == "double")
+        return 8;
+    return 0;
+}
+
+TargetAbi targetAbiNamed(const string &name)
+{
+    string upper = name;
+    transform(upper.begin(), upper.end(), upper.begin(), [](unsigned char c)
+              { return (char)toupper(c); });
+    TargetAbi abi;
+    abi.name = upper;
+    if (upper == "LP64")
+        return abi;
+    if (upper == "ILP32")
+    {
+        abi.long_size = 4;
+        abi.pointer_size = 4;
+        return abi;
+    }
+    if (upper == "LLP64")
+    {
+        abi.long_size = 4;
+        return abi;
+    }
+    throw invalid_argument("unknown ABI " + name + " (expected LP64, ILP32 or LLP64)");
+}
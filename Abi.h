@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+using namespace std;
+
+// Sizes of the C scalar types on the platform the C program was written for (--abi). Python has no
+// object sizes, so sizeof is evaluated with this model at transpile time, and --run uses it for
+// sizeof and the width of long.
+//   LP64  (Linux, macOS):  long and pointers are 64-bit
+//   ILP32 (32-bit targets): long and pointers are 32-bit
+//   LLP64 (Windows x64):   long is 32-bit, pointers are 64-bit
+struct TargetAbi
+{
+    string name = "LP64";
+    int long_size = 8;
+    int pointer_size = 8; // Also size_t and ptrdiff_t
+
+    // Size in bytes of a type name as the parser gives it ("int", "char*", "size_t", ...); 0 for
+    // void and unknown types.
+    long long sizeOf(const string &type) const;
+};
+
+// The ABI called 'name' (LP64, ILP32 or LLP64, case-insensitive); throws invalid_argument otherwise.
+TargetAbi targetAbiNamed(const string &name);
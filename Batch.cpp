@@ -0,0 +1,380 @@
+#include "Batch.h"
+#include "Frames.h"  // parseDiagnostic
+#include "Request.h" // runPipeline
+#include "Project.h" // ProjectManifest
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <deque>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+#include <iomanip>
+#include <map>
+#include <set>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    struct BatchInput
+    {
+        fs::path source;
+        fs::path output;
+        uintmax_t size = 0;
+    };
+
+    // Each worker owns a deque of tasks: it takes work from the back of its own deque and, once that
+    // is empty, steals from the front of the others. All tasks are queued before the workers start.
+    class WorkStealingPool
+    {
+    public:
+        explicit WorkStealingPool(size_t workers) : m_queues(workers) {}
+
+        void push(size_t worker, size_t task)
+        {
+            m_queues[worker].tasks.push_back(task);
+        }
+
+        void run(const function<void(size_t worker, size_t task)> &work)
+        {
+            vector<thread> threads;
+            for (size_t worker = 0; worker < m_queues.size(); ++worker)
+            {
+                threads.emplace_back([this, worker, &work]()
+                                     {
+                                         size_t task;
+                                         while (pop(worker, task))
+                                             work(worker, task);
+                                     });
+            }
+            for (auto &t : threads)
+                t.join();
+        }
+
+    private:
+        struct Queue
+        {
+            mutex lock;
+            deque<size_t> tasks;
+        };
+
+        bool pop(size_t worker, size_t &task)
+        {
+            {
+                Queue &own = m_queues[worker];
+                lock_guard<mutex> guard(own.lock);
+                if (!own.tasks.empty())
+                {
+                    task = own.tasks.back();
+                    own.tasks.pop_back();
+                    return true;
+                }
+            }
+            for (size_t i = 1; i < m_queues.size(); ++i)
+            {
+                Queue &victim = m_queues[(worker + i) % m_queues.size()];
+                lock_guard<mutex> guard(victim.lock);
+                if (!victim.tasks.empty())
+                {
+                    task = victim.tasks.front();
+                    victim.tasks.pop_front();
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        vector<Queue> m_queues;
+    };
+
+    // Buffers a worker reuses from file to file instead of allocating them anew.
+    struct WorkerState
+    {
+        string source;
+        ostringstream messages; // runPipeline's scratch stream
+    };
+
+    void collectInputs(const vector<string> &inputs, const string &output_dir, vector<BatchInput> &files)
+    {
+        for (const auto &input : inputs)
+        {
+            fs::path path(input);
+            if (fs::is_directory(path))
+            {
+                vector<fs::path> found;
+                for (const auto &entry : fs::recursive_directory_iterator(path))
+                {
+                    if (entry.is_regular_file() && entry.path().extension() == ".c")
+                        found.push_back(entry.path());
+                }
+                sort(found.begin(), found.end());
+                for (const auto &source : found)
+                {
+                    fs::path relative = fs::relative(source, path);
+                    fs::path output = output_dir.empty() ? source : fs::path(output_dir) / relative;
+                    files.push_back({source, output.replace_extension(".py"), fs::file_size(source)});
+                }
+            }
+            else if (fs::is_regular_file(path))
+            {
+                fs::path output = output_dir.empty() ? path : fs::path(output_dir) / path.filename();
+                files.push_back({path, output.replace_extension(".py"), fs::file_size(path)});
+            }
+            else
+                throw runtime_error("No such file or directory: " + input);
+        }
+
+        // A file named twice (a.c and a directory holding it) is transpiled once; two different files
+        // that map to the same .py (-o out a b, with a/x.c and b/x.c) would overwrite each other.
+        map<fs::path, fs::path> sources_by_output;
+        set<fs::path> sources;
+        vector<BatchInput> unique;
+        for (auto &file : files)
+        {
+            fs::path source = fs::weakly_canonical(file.source);
+            fs::path output = fs::absolute(file.output).lexically_normal();
+            if (!sources.insert(source).second)
+                continue;
+            auto known = sources_by_output.emplace(output, file.source);
+            if (!known.second)
+                throw runtime_error(known.first->second.string() + " and " + file.source.string() + " would both be written to " +
+                                    file.output.string());
+            unique.push_back(move(file));
+        }
+        files.swap(unique);
+    }
+
+    void transpileFile(const BatchInput &file, const BatchOptions &options, WorkerState &state, BatchFileResult &result)
+    {
+        result.input = file.source.string();
+        result.output = file.output.string();
+        bool measure = !options.stats.empty();
+        PhaseTimer timer(measure);
+        auto phaseDone = [&](const char *name)
+        {
+            if (measure)
+                result.stats.add(timer.lap(name));
+        };
+        result.stats.file = result.input;
+
+        bool project = options.project || !options.manifest.empty();
+        if (project)
+            result.stamp = statFile(file.source); // Before reading, see statFile
+        ifstream in(file.source, ios::binary);
+        if (!in)
+        {
+            result.failure = "cannot read " + result.input;
+            return;
+        }
+        state.source.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+        if (project)
+        {
+            result.stamp.hash = contentHash(state.source);
+            result.includes = resolveIncludes(state.source, fs::absolute(file.source).parent_path());
+        }
+        phaseDone("read");
+        result.stats.countSource(state.source);
+
+        EmitSections emit; // The Python only
+        PipelineResult pipeline;
+        string key;
+        if (options.cache)
+        {
+            key = options.cache->key(state.source, result.input, options.transpiler, emit);
+            result.cached = options.cache->load(key, pipeline);
+            phaseDone("cache");
+        }
+        if (!result.cached)
+        {
+            pipeline = runPipeline(state.source, options.transpiler, emit, nullptr, state.messages,
+                                   measure ? &result.stats : nullptr);
+            timer.lap(""); // runPipeline added its own phases
+            if (options.cache)
+            {
+                options.cache->store(key, pipeline);
+                phaseDone("cache");
+            }
+        }
+        result.stats.cached = result.cached;
+        if (options.lint && pipeline.completed)
+        {
+            for (const auto &warning : pipeline.lint)
+                pipeline.messages.push_back("Transpiler Warning (Line " + to_string(warning.line) + "): [" + warning.rule + "] " + warning.message);
+        }
+
+        for (const auto &line : pipeline.messages)
+        {
+            Diagnostic diagnostic = parseDiagnostic(line);
+            if (diagnostic.severity == "error")
+            {
+                if (result.errors++ == 0)
+                    result.failure = line;
+            }
+            else if (diagnostic.severity == "warning")
+                result.warnings++;
+            result.messages.push_back(line);
+        }
+        if (!pipeline.completed)
+            return;
+
+        error_code ec;
+        if (file.output.has_parent_path())
+            fs::create_directories(file.output.parent_path(), ec);
+        // Written next to the output and renamed over it, so that a reader (a watcher, an editor, the
+        // program being run) sees the old or the new Python, never a partial file.
+        fs::path temp = file.output;
+        temp += ".tmp";
+        bool written;
+        {
+            ofstream out(temp, ios::binary);
+            out << pipeline.python << "\n";
+            written = bool(out);
+        }
+        if (written)
+            fs::rename(temp, file.output, ec);
+        if (!written || ec)
+        {
+            fs::remove(temp, ec);
+            result.failure = "cannot write " + result.output;
+            return;
+        }
+        phaseDone("emit");
+        result.stats.countOutput(pipeline.python);
+        result.python_lines = (int)count(pipeline.python.begin(), pipeline.python.end(), '\n') + 1;
+        result.ok = result.errors == 0;
+    }
+}
+
+int runBatch(const vector<string> &inputs, const BatchOptions &options, ostream &out, ostream &err, BatchSummary *summary)
+{
+    vector<BatchInput> files;
+    collectInputs(inputs, options.output_dir, files);
+    if (files.empty())
+    {
+        err << "Batch: no .c files found" << endl;
+        return 1;
+    }
+
+    auto start = chrono::steady_clock::now(); // Checking the manifest counts too
+
+    // Project mode: drop the units the manifest says are up to date.
+    unique_ptr<ProjectManifest> loaded;
+    ProjectManifest *project = options.project;
+    string options_hash;
+    size_t up_to_date = 0;
+    if (!project && !options.manifest.empty())
+    {
+        string problem;
+        loaded = make_unique<ProjectManifest>(options.manifest, problem);
+        if (!problem.empty())
+            err << "Project Warning: " << problem << endl;
+        project = loaded.get();
+    }
+    if (project)
+    {
+        project->beginRun();
+        options_hash = ProjectManifest::optionsHash(optionsFingerprint(options.transpiler));
+        vector<BatchInput> stale;
+        for (auto &file : files)
+        {
+            if (project->upToDate(fs::absolute(file.source).lexically_normal(), fs::absolute(file.output).lexically_normal(), options_hash))
+                up_to_date++;
+            else
+                stale.push_back(move(file));
+        }
+        files.swap(stale);
+    }
+
+    size_t workers = options.jobs > 0 ? (size_t)options.jobs : max(1u, thread::hardware_concurrency());
+    workers = max<size_t>(1, min(workers, files.size()));
+
+    // Largest files first, dealt out round-robin: the big ones start early and stealing evens out the rest.
+    vector<size_t> order(files.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    stable_sort(order.begin(), order.end(), [&files](size_t a, size_t b)
+                { return files[a].size > files[b].size; });
+    WorkStealingPool pool(workers);
+    for (size_t i = 0; i < order.size(); ++i)
+        pool.push(i % workers, order[order.size() - 1 - i]); // Workers take from the back of their deque
+
+    vector<BatchFileResult> results(files.size());
+    vector<WorkerState> states(workers);
+    pool.run([&](size_t worker, size_t task)
+             {
+                 auto file_start = chrono::steady_clock::now();
+                 transpileFile(files[task], options, states[worker], results[task]);
+                 results[task].milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - file_start).count();
+             });
+    if (project)
+    {
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            if (results[i].stamp.exists)
+                project->record(fs::absolute(files[i].source).lexically_normal(), fs::absolute(files[i].output).lexically_normal(),
+                                options_hash, results[i].ok, results[i].stamp, results[i].includes);
+        }
+        project->endRun();
+        if (!options.manifest.empty() && !project->save())
+            err << "Project Warning: cannot write manifest " << options.manifest << endl;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    // Report in input order, whatever order the workers finished in.
+    ostream &stats_out = options.stats_out ? *options.stats_out : err;
+    TranspileStats stats_total;
+    stats_total.files = 0;
+    int failed = 0;
+    for (const auto &result : results)
+    {
+        for (const auto &message : result.messages)
+            err << result.input << ": " << message << "\n";
+        if (result.ok)
+        {
+            out << "ok    " << result.input << " -> " << result.output << " (" << result.python_lines << " lines, "
+                << fixed << setprecision(1) << result.milliseconds << " ms";
+            if (result.cached)
+                out << ", cached";
+            if (result.warnings > 0)
+                out << ", " << result.warnings << " warning" << (result.warnings == 1 ? "" : "s");
+            out << ")\n";
+        }
+        else
+        {
+            failed++;
+            out << "FAIL  " << result.input << ": " << result.failure << "\n";
+        }
+        if (!options.stats.empty())
+        {
+            stats_out << (options.stats == "json" ? result.stats.json() + "\n" : result.stats.text());
+            stats_total.merge(result.stats);
+        }
+    }
+    if (!options.stats.empty())
+    {
+        stats_out << (options.stats == "json" ? stats_total.json(true) + "\n" : stats_total.text(true));
+        stats_out.flush();
+    }
+    out << "Batch: " << files.size() << " file" << (files.size() == 1 ? "" : "s");
+    if (failed > 0 || project)
+    {
+        out << " (";
+        if (failed > 0)
+            out << failed << " failed" << (project ? ", " : "");
+        if (project)
+            out << up_to_date << " up to date";
+        out << ")";
+    }
+    out << " in " << fixed << setprecision(2) << seconds << " s, " << setprecision(1) << files.size() / max(seconds, 1e-9)
+        << " files/s, " << workers << " worker" << (workers == 1 ? "" : "s") << endl;
+    if (options.cache)
+        out << options.cache->statsLine() << endl;
+    err.flush();
+    if (summary)
+        *summary = {files.size(), (size_t)failed, up_to_date};
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "transpiler.h" // TranspilerOptions
+#include "Cache.h"      // ResultCache
+#include "Project.h"    // FileStamp, ProjectManifest
+#include "Stats.h"      // TranspileStats
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// --- Batch mode (transpiler -j N -o DIR inputs...) ---
+// Transpiles many C files in one process: the files are spread over a pool of worker threads,
+// each with its own Lexer/Parser/Transpiler per file and its own message buffer, so there is no
+// process start-up per file and the output of different files never mixes.
+
+struct BatchOptions
+{
+    TranspilerOptions transpiler;
+    int jobs = 0;      // Worker threads; 0 = one per core
+    string output_dir; // Where the .py files go (mirroring directory inputs); empty: next to each .c file
+    bool lint = false; // Report --lint warnings with each file's messages
+    ResultCache *cache = nullptr; // --cache-dir: reuse the results of unchanged files
+    string manifest;              // --project: only transpile units that changed since the last run (Project.h)
+    ProjectManifest *project = nullptr; // Or a manifest the caller keeps between runs (--watch); saved to 'manifest' if set
+    string stats;                 // --stats: "text" or "json" per-phase statistics of each file and the total ("": off)
+    ostream *stats_out = nullptr; // Where they go (nullptr: 'err')
+};
+
+struct BatchFileResult
+{
+    string input;
+    string output;
+    bool ok = false;             // Transpiled and written, without errors
+    bool cached = false;         // Taken from the result cache
+    string failure;              // Otherwise: the first error
+    int python_lines = 0;
+    int errors = 0;
+    int warnings = 0;
+    double milliseconds = 0;     // Wall time on its worker
+    vector<string> messages;     // What the single-file mode would have written to stderr
+    FileStamp stamp;             // Project mode: the source as it was read
+    vector<filesystem::path> includes; // Project mode: what its #include "..." lines name
+    TranspileStats stats;        // With --stats
+};
+
+// What a run did, for callers that run batches repeatedly (--watch).
+struct BatchSummary
+{
+    size_t transpiled = 0; // Units transpiled (in project mode: the ones that were not up to date)
+    size_t failed = 0;
+    size_t up_to_date = 0;
+};
+
+// Collects the .c files of 'inputs' (files, and directories searched recursively), transpiles them
+// on a work-stealing pool and writes the .py files. Prints a summary line per file and a total to
+// 'out', each file's messages (prefixed with its name) to 'err'. Returns the exit status: 0 if
+// every file succeeded, 1 otherwise. Throws runtime_error if an input does not exist, or if two
+// different files would be written to the same .py (nothing is transpiled then). In project
+// mode, units that are up to date are neither transpiled nor listed, only counted in the total.
+// With --stats, each file's statistics follow its messages, and the sum of all files comes last (as
+// JSON, one object per line: the files', then the total with "file": null). The peak RSS there is
+// that of the whole process, all workers together.
+int runBatch(const vector<string> &inputs, const BatchOptions &options, ostream &out, ostream &err, BatchSummary *summary = nullptr);
@@ -0,0 +1,505 @@
+#include "Cache.h"
+#include "Frames.h" // writeFrame
+#include <fstream>
+#include <sstream>
+#include <set>
+#include <random>
+#include <cstring>
+#include <cstdint>
+#include <cstdio> // snprintf
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <mach-o/dyld.h> // _NSGetExecutablePath
+#endif
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    const char *const ENTRY_FORMAT = "codemorph-result-1"; // Bump when the entry layout changes
+
+    // Marks a directory as a cache (the Cache Directory Tagging convention, which backup tools honour).
+    // Only a directory holding this file is ever scanned or evicted from.
+    const char *const TAG_NAME = "CACHEDIR.TAG";
+    const char *const TAG_CONTENTS = "Signature: 8a477f597d28d172789f06886806bc55\n"
+                                     "# This file is a CodeMorph result cache directory (transpiler --cache-dir).\n"
+                                     "# Everything in its <2 hex>/<32 hex> subdirectories may be deleted at any time.\n";
+
+    // The file of the running executable; empty if the platform does not say.
+    fs::path executablePath()
+    {
+#ifdef _WIN32
+        wchar_t buffer[32768];
+        DWORD length = GetModuleFileNameW(nullptr, buffer, sizeof(buffer) / sizeof(buffer[0]));
+        return length > 0 && length < sizeof(buffer) / sizeof(buffer[0]) ? fs::path(wstring(buffer, length)) : fs::path();
+#elif defined(__APPLE__)
+        char buffer[4096];
+        uint32_t size = sizeof(buffer);
+        return _NSGetExecutablePath(buffer, &size) == 0 ? fs::path(buffer) : fs::path();
+#else
+        error_code ec;
+        fs::path path = fs::read_symlink("/proc/self/exe", ec);
+        return ec ? fs::path() : path;
+#endif
+    }
+
+    uint64_t rotateLeft(uint64_t x, int bits)
+    {
+        return (x << bits) | (x >> (64 - bits));
+    }
+
+    uint64_t finalMix(uint64_t x)
+    {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return x;
+    }
+
+    // 128-bit hash over a sequence of byte strings, 8 bytes per step on two multiply-rotate lanes.
+    // Not cryptographic: it only has to tell different inputs apart, and fast, since a cache hit
+    // costs little more than hashing the source. Each string is length-prefixed, so ("ab", "c") and
+    // ("a", "bc") hash differently.
+    class ContentHash
+    {
+    public:
+        void add(const string &bytes)
+        {
+            const char *data = bytes.data();
+            size_t size = bytes.size();
+            uint64_t a = m_a ^ (size * 0x9e3779b97f4a7c15ULL);
+            uint64_t b = m_b + size;
+            size_t i = 0;
+            for (; i + 8 <= size; i += 8)
+            {
+                uint64_t word;
+                memcpy(&word, data + i, 8);
+                step(a, b, word);
+            }
+            if (i < size)
+            {
+                uint64_t word = 0;
+                memcpy(&word, data + i, size - i);
+                step(a, b, word);
+            }
+            m_a = finalMix(a);
+            m_b = finalMix(b ^ m_a);
+        }
+
+        string hex() const
+        {
+            char text[33];
+            snprintf(text, sizeof(text), "%016llx%016llx", (unsigned long long)m_a, (unsigned long long)m_b);
+            return text;
+        }
+
+    private:
+        static void step(uint64_t &a, uint64_t &b, uint64_t word)
+        {
+            a = rotateLeft((a ^ word) * 0x9e3779b97f4a7c15ULL, 29);
+            b = rotateLeft((b + word) * 0xc2b2ae3d27d4eb4fULL, 31) ^ a;
+        }
+
+        uint64_t m_a = 0x243f6a8885a308d3ULL;
+        uint64_t m_b = 0x13198a2e03707344ULL;
+    };
+
+    bool readFile(const fs::path &path, string &contents)
+    {
+        ifstream in(path, ios::binary);
+        if (!in)
+            return false;
+        contents.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+        return !in.bad();
+    }
+
+    // Splits frames (Frames.h) into (kind, payload) pairs; false if 'data' is not a whole number of frames.
+    bool readFrames(const string &data, vector<pair<string, string>> &frames)
+    {
+        size_t pos = 0;
+        while (pos < data.size())
+        {
+            size_t header_end = data.find('\n', pos);
+            if (header_end == string::npos)
+                return false;
+            size_t space = data.find(' ', pos);
+            if (space == string::npos || space > header_end)
+                return false;
+            size_t length;
+            try
+            {
+                length = stoul(data.substr(space + 1, header_end - space - 1));
+            }
+            catch (const std::exception &)
+            {
+                return false;
+            }
+            size_t start = header_end + 1;
+            if (start + length + 1 > data.size() || data[start + length] != '\n')
+                return false;
+            frames.emplace_back(data.substr(pos, space - pos), data.substr(start, length));
+            pos = start + length + 1;
+        }
+        return true;
+    }
+
+    string formatBytes(unsigned long long bytes)
+    {
+        char text[32];
+        if (bytes < 1024 * 1024)
+            snprintf(text, sizeof(text), "%.1f KB", bytes / 1024.0);
+        else
+            snprintf(text, sizeof(text), "%.1f MB", bytes / (1024.0 * 1024.0));
+        return text;
+    }
+
+    bool isHex(const string &text, size_t length)
+    {
+        return text.size() == length && all_of(text.begin(), text.end(), [](char c)
+                                               { return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'); });
+    }
+
+    // Calls 'visit' on every entry of the cache in 'directory': the regular files DIR/xx/<32 hex
+    // digits starting with xx>, and nothing else, whatever else lives in the directory.
+    void forEachEntry(const fs::path &directory, const function<void(const fs::directory_entry &)> &visit)
+    {
+        error_code ec;
+        for (const auto &bucket : fs::directory_iterator(directory, ec))
+        {
+            string prefix = bucket.path().filename().string();
+            if (!isHex(prefix, 2) || bucket.is_symlink(ec) || !bucket.is_directory(ec))
+                continue;
+            for (const auto &entry : fs::directory_iterator(bucket.path(), ec))
+            {
+                string name = entry.path().filename().string();
+                if (isHex(name, 32) && name.compare(0, 2, prefix) == 0 && !entry.is_symlink(ec) && entry.is_regular_file(ec))
+                    visit(entry);
+            }
+        }
+    }
+}
+
+string contentHash(const string &bytes)
+{
+    ContentHash hash;
+    hash.add(bytes);
+    return hash.hex();
+}
+
+string transpilerVersion()
+{
+    // The hash of the executable: rebuilding after a change to any source file gives a different binary,
+    // whichever translation units were recompiled. Hashed once per process. Where the executable cannot
+    // be read, the version is made up for this process, so entries are only reused within it.
+    static const string version = []
+    {
+        string bytes;
+        fs::path executable = executablePath();
+        if (!executable.empty())
+        {
+            ifstream in(executable, ios::binary);
+            ostringstream contents;
+            contents << in.rdbuf();
+            if (in)
+                bytes = contents.str();
+        }
+        if (bytes.empty())
+        {
+            random_device random;
+            return "CodeMorph process " + to_string(((unsigned long long)random() << 32) ^ random());
+        }
+        return "CodeMorph " + contentHash(bytes);
+    }();
+    return version;
+}
+
+string optionsFingerprint(const TranspilerOptions &options)
+{
+    ostringstream text;
+    text << "char_as_int=" << options.char_as_int << " inline_budget=" << options.inline_budget
+         << " inline_growth=" << options.inline_growth << " unroll_max_trips=" << options.unroll_max_trips
+         << " unroll_max_body=" << options.unroll_max_body << " parallel=" << options.parallel
+         << " parallel_min_work=" << options.parallel_min_work << " eval_budget=" << options.eval_budget
+         << " eval_max_elements=" << options.eval_max_elements << " profile_gen=" << jsonString(options.profile_gen_path)
+         << " profile_hot=" << options.profile_hot << " instrument=" << options.instrument
+         << " source_map=" << options.source_map << " lint=" << options.lint << " abi=" << options.abi.name
+         << " profile=" << options.profile.loaded;
+    if (options.profile.loaded)
+    {
+        for (const auto &count : options.profile.calls)
+            text << "\ncall " << count.first << " " << count.second;
+        for (const auto &count : options.profile.loop_entries)
+            text << "\nloop " << count.first << " " << count.second;
+        for (const auto &count : options.profile.loop_iterations)
+            text << "\niterations " << count.first << " " << count.second;
+        for (const auto &count : options.profile.branches)
+            text << "\nbranch " << count.first.first << " " << count.first.second << " " << count.second;
+    }
+    return text.str();
+}
+
+vector<fs::path> resolveIncludes(const string &source, const fs::path &directory)
+{
+    vector<fs::path> headers;
+    istringstream lines(source);
+    string line;
+    while (getline(lines, line))
+    {
+        size_t pos = line.find_first_not_of(" \t");
+        if (pos == string::npos || line[pos] != '#')
+            continue;
+        pos = line.find_first_not_of(" \t", pos + 1);
+        if (pos == string::npos || line.compare(pos, 7, "include") != 0)
+            continue;
+        pos = line.find_first_not_of(" \t", pos + 7);
+        if (pos == string::npos || line[pos] != '"')
+            continue;
+        size_t end = line.find('"', pos + 1);
+        if (end == string::npos || end == pos + 1)
+            continue;
+        headers.push_back((directory / line.substr(pos + 1, end - pos - 1)).lexically_normal());
+    }
+    return headers;
+}
+
+ResultCache::ResultCache(const string &directory, unsigned long long max_bytes) : m_directory(directory), m_max_bytes(max_bytes)
+{
+    error_code ec;
+    fs::create_directories(m_directory, ec);
+    if (!fs::is_directory(m_directory))
+        throw runtime_error("cannot create cache directory " + directory);
+    // A directory becomes a cache only while empty: pointing --cache-dir at a directory of other
+    // files (".", $HOME) must never lead to deleting them.
+    fs::path tag = m_directory / TAG_NAME;
+    if (!fs::exists(tag, ec))
+    {
+        if (!fs::is_empty(m_directory, ec) && !fs::exists(tag, ec)) // Not just another process tagging it
+            throw runtime_error(directory + " is not empty and not a cache directory (no " + TAG_NAME + ")");
+        ofstream out(tag, ios::binary);
+        out << TAG_CONTENTS;
+        if (!out)
+            throw runtime_error("cannot write " + tag.string());
+    }
+    forEachEntry(m_directory, [&](const fs::directory_entry &entry)
+                 {
+                     m_stats.entries++;
+                     m_stats.bytes += entry.file_size(ec);
+                 });
+    // Temporary files of different ResultCache instances (threads or processes) must not collide.
+    random_device random;
+    m_temp_counter = ((unsigned long long)random() << 32) ^ random();
+}
+
+string ResultCache::key(const string &source, const string &source_path, const TranspilerOptions &options,
+                        const EmitSections &emit) const
+{
+    ContentHash hash;
+    hash.add(ENTRY_FORMAT);
+    hash.add(transpilerVersion());
+    hash.add(optionsFingerprint(options));
+    hash.add(string() + (emit.tokens ? 't' : '-') + (emit.macros ? 'm' : '-') + (emit.ast ? 'a' : '-') + (emit.python ? 'p' : '-'));
+    hash.add(source);
+
+    // Headers, transitively, each once (include guards make cycles legal)
+    fs::path directory = source_path.empty() ? fs::path() : fs::path(source_path).parent_path();
+    vector<fs::path> pending = resolveIncludes(source, directory);
+    reverse(pending.begin(), pending.end());
+    set<fs::path> seen;
+    string contents;
+    while (!pending.empty())
+    {
+        fs::path header = pending.back();
+        pending.pop_back();
+        if (!seen.insert(header).second)
+            continue;
+        hash.add(header.string());
+        if (!readFile(header, contents))
+        {
+            hash.add("(missing)"); // Creating it later changes the key
+            continue;
+        }
+        hash.add(contents);
+        vector<fs::path> nested = resolveIncludes(contents, header.parent_path());
+        pending.insert(pending.end(), nested.rbegin(), nested.rend());
+    }
+    return hash.hex();
+}
+
+fs::path ResultCache::entryPath(const string &key) const
+{
+    return m_directory / key.substr(0, 2) / key;
+}
+
+bool ResultCache::load(const string &key, PipelineResult &result)
+{
+    fs::path path = entryPath(key);
+    string data;
+    vector<pair<string, string>> frames;
+    bool found = readFile(path, data);
+    bool valid = found && readFrames(data, frames) && frames.size() >= 2 && frames.front().first == "entry" &&
+                 frames.front().second == key && frames.back().first == "end";
+    if (valid)
+    {
+        result = PipelineResult();
+        for (size_t i = 1; i + 1 < frames.size(); ++i)
+        {
+            const string &kind = frames[i].first;
+            string &payload = frames[i].second;
+            if (kind == "completed")
+                result.completed = payload == "1";
+            else if (kind == "tokens")
+                result.tokens = move(payload);
+            else if (kind == "macros")
+                result.macros = move(payload);
+            else if (kind == "ast")
+                result.ast = move(payload);
+            else if (kind == "python")
+                result.python = move(payload);
+            else if (kind == "message")
+                result.messages.push_back(move(payload));
+            else if (kind == "lint")
+            {
+                // "<line> <cost> <rule>\n<message>"
+                LintWarning warning;
+                istringstream header(payload.substr(0, payload.find('\n')));
+                size_t newline = payload.find('\n');
+                if (newline == string::npos || !(header >> warning.line >> warning.cost >> warning.rule))
+                {
+                    valid = false;
+                    break;
+                }
+                warning.message = payload.substr(newline + 1);
+                result.lint.push_back(warning);
+            }
+        }
+    }
+
+    lock_guard<mutex> guard(m_lock);
+    if (!valid)
+    {
+        m_stats.misses++;
+        if (found) // Corrupt: make room for a good one
+        {
+            error_code ec;
+            if (fs::remove(path, ec))
+            {
+                m_stats.entries--;
+                m_stats.bytes -= min<unsigned long long>(m_stats.bytes, data.size());
+            }
+        }
+        return false;
+    }
+    m_stats.hits++;
+    error_code ec;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec); // Recently used
+    return true;
+}
+
+void ResultCache::store(const string &key, const PipelineResult &result)
+{
+    if (result.status != 0)
+        return;
+    ostringstream entry;
+    writeFrame(entry, "entry", key);
+    writeFrame(entry, "completed", result.completed ? "1" : "0");
+    writeFrame(entry, "tokens", result.tokens);
+    writeFrame(entry, "macros", result.macros);
+    writeFrame(entry, "ast", result.ast);
+    writeFrame(entry, "python", result.python);
+    for (const auto &message : result.messages)
+        writeFrame(entry, "message", message);
+    for (const auto &warning : result.lint)
+        writeFrame(entry, "lint", to_string(warning.line) + " " + to_string(warning.cost) + " " + warning.rule + "\n" + warning.message);
+    writeFrame(entry, "end", "");
+    string data = entry.str();
+
+    fs::path path = entryPath(key);
+    fs::path temp;
+    {
+        lock_guard<mutex> guard(m_lock);
+        temp = m_directory / ("tmp-" + to_string(m_temp_counter++));
+    }
+    error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+    {
+        ofstream out(temp, ios::binary);
+        out << data;
+        if (!out)
+        {
+            out.close();
+            fs::remove(temp, ec);
+            return; // The cache is best-effort: a full disk only costs the next run a miss
+        }
+    }
+    bool replaced = fs::exists(path, ec);
+    fs::rename(temp, path, ec);
+    if (ec)
+    {
+        fs::remove(temp, ec);
+        return;
+    }
+
+    lock_guard<mutex> guard(m_lock);
+    m_stats.stores++;
+    if (!replaced)
+    {
+        m_stats.entries++;
+        m_stats.bytes += data.size();
+    }
+    if (m_stats.bytes > m_max_bytes)
+        evict();
+}
+
+void ResultCache::evict()
+{
+    // Rescan, since other processes may share the directory, then delete the least recently used
+    // entries down to 90% of the limit, so that the next few stores do not scan again.
+    struct Entry
+    {
+        fs::path path;
+        unsigned long long size;
+        fs::file_time_type used;
+    };
+    vector<Entry> entries;
+    unsigned long long total = 0;
+    error_code ec;
+    forEachEntry(m_directory, [&](const fs::directory_entry &entry)
+                 {
+                     Entry found{entry.path(), entry.file_size(ec), entry.last_write_time(ec)};
+                     total += found.size;
+                     entries.push_back(found);
+                 });
+    sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b)
+         { return a.used < b.used; });
+    unsigned long long target = m_max_bytes / 10 * 9;
+    size_t removed = 0;
+    for (; removed < entries.size() && total > target; ++removed)
+    {
+        if (fs::remove(entries[removed].path, ec))
+            m_stats.evictions++;
+        total -= entries[removed].size;
+    }
+    m_stats.entries = (long long)(entries.size() - removed);
+    m_stats.bytes = total;
+}
+
+CacheStats ResultCache::stats()
+{
+    lock_guard<mutex> guard(m_lock);
+    return m_stats;
+}
+
+string ResultCache::statsLine()
+{
+    CacheStats s = stats();
+    return "Cache Info: " + to_string(s.hits) + " hit" + (s.hits == 1 ? "" : "s") + ", " + to_string(s.misses) + " miss" +
+           (s.misses == 1 ? "" : "es") + ", " + to_string(s.stores) + " store" + (s.stores == 1 ? "" : "s") + ", " +
+           to_string(s.evictions) + " eviction" + (s.evictions == 1 ? "" : "s") + "; " + to_string(s.entries) + " entr" +
+           (s.entries == 1 ? "y" : "ies") + ", " + formatBytes(s.bytes) + " of " + formatBytes(m_max_bytes);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Request.h" // PipelineResult
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+using namespace std;
+
+// --- On-disk result cache (--cache-dir=DIR) ---
+// Transpiling a file that was transpiled before, with the same options and the same transpiler, only
+// costs reading it and one lookup: lexing, parsing and code generation are skipped. Entries are
+// content-addressed, keyed by a 128-bit hash of
+//   - the source bytes,
+//   - the bytes of every header it #includes with quotes, transitively (see resolveIncludes),
+//   - the transpiler build (transpilerVersion()),
+//   - every option that can change the output (optionsFingerprint) and the sections asked for,
+// so an entry never goes stale: a changed input is simply a different key. One entry is one file,
+// DIR/<first 2 hex digits>/<32 hex digits>, holding the Python, the requested JSON sections, the
+// messages and the lint warnings in the frame syntax of Frames.h. Entries are written to a temporary
+// file and renamed into place, so concurrent transpilers (threads or processes) sharing DIR never see
+// a half-written entry. A hit refreshes the entry's modification time; when the entries outgrow the
+// size limit, the least recently used ones are deleted. Only files laid out as entries are counted or
+// deleted, and only in a directory the cache created: DIR must be new or empty the first time, and
+// then holds a CACHEDIR.TAG file; a non-empty directory without one is refused.
+
+// 128-bit hash of 'bytes' as 32 hex digits (not cryptographic, but fast).
+string contentHash(const string &bytes);
+
+// Identifies the transpiler build, by a hash of the executable file. Every build counts as a new
+// version: output from an older build is never reused.
+string transpilerVersion();
+
+// Everything in 'options' that can change the output, as text (the --profile-use counts included).
+string optionsFingerprint(const TranspilerOptions &options);
+
+// The headers named by the #include "..." lines of 'source', resolved against 'directory' (the
+// directory of the file containing the lines), in order of appearance. <...> includes name system
+// headers and are not followed. A header that does not exist is returned all the same.
+vector<filesystem::path> resolveIncludes(const string &source, const filesystem::path &directory);
+
+struct CacheStats
+{
+    long long hits = 0;
+    long long misses = 0;
+    long long stores = 0;
+    long long evictions = 0;
+    long long entries = 0;        // Currently in the cache directory (as far as this process knows)
+    unsigned long long bytes = 0; // Their total size
+};
+
+// Safe to use from several threads.
+class ResultCache
+{
+public:
+    // Creates 'directory' if needed. Throws runtime_error if it cannot be created, or if it already
+    // holds other files and no CACHEDIR.TAG.
+    ResultCache(const string &directory, unsigned long long max_bytes);
+
+    // Key of transpiling 'source' (read from 'source_path', "" for stdin: its quoted includes are then
+    // resolved against the current directory) with 'options' into 'emit'.
+    string key(const string &source, const string &source_path, const TranspilerOptions &options, const EmitSections &emit) const;
+
+    // The stored result for 'key', if any. An unreadable or corrupt entry counts as a miss (and is removed).
+    bool load(const string &key, PipelineResult &result);
+
+    // Stores a result with status 0 (lexical errors are reported afresh each time).
+    void store(const string &key, const PipelineResult &result);
+
+    CacheStats stats();
+
+    // "Cache Info: 12 hits, 3 misses, 3 stores, 0 evictions; 15 entries, 48.2 KB of 256.0 MB"
+    string statsLine();
+
+private:
+    filesystem::path entryPath(const string &key) const;
+    void evict(); // Called with m_lock held
+
+    filesystem::path m_directory;
+    unsigned long long m_max_bytes;
+    mutex m_lock;
+    CacheStats m_stats;
+    unsigned long long m_temp_counter = 0;
+};
@@ -0,0 +1,450 @@
+#include "Evaluator.h"
+#include <climits>
+#include <cmath>
+
+// --- Transpile-time evaluation of pure C code ---
+// Everything here follows C semantics (truncating integer division, 32-bit int, float rounding),
+// not those of the generated Python: the values replace what the compiled C program would compute.
+// Anything that is undefined or implementation-specific in C aborts the evaluation instead.
+
+Evaluator::Evaluator(long long step_budget) : m_step_budget(step_budget)
+{
+    m_scopes.emplace_back();
+}
+
+void Evaluator::defineConstant(const string &name, long long value)
+{
+    m_constants[name] = value;
+}
+
+void Evaluator::allowOuterScalar(const string &name, const string &type)
+{
+    m_outer_scalars[name] = type;
+}
+
+void Evaluator::step()
+{
+    if (++m_steps > m_step_budget)
+        throw EvaluationAborted("step budget exhausted");
+}
+
+static bool isArithmeticType(const string &type)
+{
+    return type == "int" || type == "long" || type == "short" || type == "char" || type == "bool" ||
+           type == "float" || type == "double";
+}
+
+EvalValue Evaluator::convert(const EvalValue &value, const string &type)
+{
+    EvalValue result;
+    result.known = true;
+    if (type == "float" || type == "double")
+    {
+        result.is_float = true;
+        double v = value.is_float ? value.f : (double)value.i;
+        result.f = type == "float" ? (double)(float)v : v;
+        return result;
+    }
+    long long v;
+    if (value.is_float)
+    {
+        if (type == "bool")
+            v = value.f != 0.0;
+        else if (!(value.f > (double)LLONG_MIN && value.f < (double)LLONG_MAX))
+            throw EvaluationAborted("float to integer conversion out of range");
+        else
+            v = (long long)value.f; // Truncates toward zero, like C
+    }
+    else
+    {
+        v = value.i;
+    }
+    if (type == "bool")
+        result.i = v != 0;
+    else if (type == "char")
+        result.i = (long long)(signed char)(unsigned char)v; // gcc/clang wrap out-of-range values
+    else if (type == "short")
+        result.i = (long long)(short)(unsigned short)v;
+    else if (type == "int")
+    {
+        if (v < INT_MIN || v > INT_MAX)
+            throw EvaluationAborted("value does not fit an int");
+        result.i = v;
+    }
+    else if (type == "long")
+    {
+        result.i = v;
+        result.is_long = true;
+    }
+    else
+        throw EvaluationAborted("unsupported type " + type);
+    return result;
+}
+
+static EvalValue integerValue(long long v)
+{
+    EvalValue value;
+    value.known = true;
+    value.i = v;
+    return value;
+}
+
+// Integer or floating literal text, e.g. "42", "0x1F", "10L", "2.5f", "1e3".
+static EvalValue literalValue(const string &text)
+{
+    EvalValue value;
+    value.known = true;
+    bool hex = text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X');
+    if (!hex && text.find_first_of(".eE") != string::npos)
+    {
+        value.is_float = true;
+        value.f = stod(text);
+        if (!text.empty() && (text.back() == 'f' || text.back() == 'F'))
+            value.f = (double)(float)value.f;
+        return value;
+    }
+    size_t consumed = 0;
+    try
+    {
+        value.i = stoll(text, &consumed, 0);
+    }
+    catch (const std::exception &)
+    {
+        throw EvaluationAborted("unsupported literal " + text);
+    }
+    if (consumed != text.size() && text.find_first_not_of("uUlL", consumed) != string::npos)
+        throw EvaluationAborted("unsupported literal " + text);
+    value.is_long = value.i > INT_MAX || text.find_first_of("lL") != string::npos;
+    return value;
+}
+
+EvalVariable *Evaluator::lookup(const string &name)
+{
+    for (auto scope = m_scopes.rbegin(); scope != m_scopes.rend(); ++scope)
+    {
+        auto it = scope->find(name);
+        if (it != scope->end())
+            return &it->second;
+    }
+    // First assignment of a scalar from the enclosing code: it now lives at the outermost scope.
+    auto outer = m_outer_scalars.find(name);
+    if (outer == m_outer_scalars.end())
+        return nullptr;
+    EvalVariable &variable = m_scopes.front()[name];
+    variable.type = outer->second;
+    variable.cells.assign(1, EvalValue());
+    m_order.push_back(name);
+    return &variable;
+}
+
+long long Evaluator::integerSize(const shared_ptr<ExpressionNode> &expr)
+{
+    EvalValue size = evaluate(expr);
+    if (size.is_float || size.i <= 0)
+        throw EvaluationAborted("array size is not a positive integer");
+    return size.i;
+}
+
+void Evaluator::declare(const shared_ptr<VariableDeclarationNode> &decl)
+{
+    EvalVariable variable;
+    variable.type = decl->getDeclaredType();
+    if (!isArithmeticType(variable.type))
+        throw EvaluationAborted("unsupported type " + variable.type);
+    long long count = 1;
+    if (auto arrayDecl = dynamic_pointer_cast<ArrayDeclarationNode>(decl))
+    {
+        variable.dims.push_back(integerSize(arrayDecl->getSizeExpression()));
+        for (const auto &inner : arrayDecl->getInnerSizeExpressions())
+            variable.dims.push_back(integerSize(inner));
+        for (long long dim : variable.dims)
+        {
+            count *= dim;
+            if (count > m_step_budget)
+                throw EvaluationAborted("array larger than the step budget");
+        }
+        m_steps += count; // Allocation counts against the budget too
+    }
+    variable.cells.assign(count, EvalValue());
+    if (decl->getInitializer())
+        variable.cells[0] = convert(evaluate(decl->getInitializer()), variable.type);
+
+    auto &scope = m_scopes.back();
+    if (scope.count(decl->getName()))
+        throw EvaluationAborted("redeclaration of " + decl->getName());
+    scope[decl->getName()] = variable;
+    if (m_scopes.size() == 1)
+        m_order.push_back(decl->getName());
+}
+
+void Evaluator::execute(const shared_ptr<StatementNode> &stmt)
+{
+    if (executeStatement(stmt) != Flow::Normal)
+        throw EvaluationAborted("break or continue outside a loop");
+}
+
+Evaluator::Flow Evaluator::executeStatement(const shared_ptr<StatementNode> &stmt)
+{
+    step();
+    if (!stmt)
+        return Flow::Normal;
+    if (auto decl = dynamic_pointer_cast<VariableDeclarationNode>(stmt))
+    {
+        declare(decl);
+        return Flow::Normal;
+    }
+    if (auto exprStmt = dynamic_pointer_cast<ExpressionStatementNode>(stmt))
+    {
+        if (exprStmt->getExpression())
+            evaluate(exprStmt->getExpression());
+        return Flow::Normal;
+    }
+    if (auto block = dynamic_pointer_cast<BlockNode>(stmt))
+    {
+        m_scopes.emplace_back();
+        Flow flow = Flow::Normal;
+        for (const auto &inner : block->getStatements())
+        {
+            flow = executeStatement(inner);
+            if (flow != Flow::Normal)
+                break;
+        }
+        m_scopes.pop_back();
+        return flow;
+    }
+    if (auto ifStmt = dynamic_pointer_cast<IfNode>(stmt))
+    {
+        if (isTrue(ifStmt->getCondition()))
+            return executeStatement(ifStmt->getThenBranch());
+        return ifStmt->getElseBranch() ? executeStatement(ifStmt->getElseBranch()) : Flow::Normal;
+    }
+    if (auto whileStmt = dynamic_pointer_cast<WhileNode>(stmt))
+    {
+        while (isTrue(whileStmt->getCondition()))
+        {
+            if (executeLoopBody(whileStmt->getBody()) == Flow::Break)
+                break;
+        }
+        return Flow::Normal;
+    }
+    if (auto forStmt = dynamic_pointer_cast<ForNode>(stmt))
+    {
+        m_scopes.emplace_back(); // A variable declared in the initializer is local to the loop
+        if (forStmt->getInitializer())
+            executeStatement(forStmt->getInitializer());
+        while (!forStmt->getCondition() || isTrue(forStmt->getCondition()))
+        {
+            if (executeLoopBody(forStmt->getBody()) == Flow::Break)
+                break;
+            if (forStmt->getIncrement())
+                evaluate(forStmt->getIncrement());
+        }
+        m_scopes.pop_back();
+        return Flow::Normal;
+    }
+    if (dynamic_pointer_cast<BreakNode>(stmt))
+        return Flow::Break;
+    if (dynamic_pointer_cast<ContinueNode>(stmt))
+        return Flow::Continue;
+    throw EvaluationAborted("unsupported statement " + stmt->type_name);
+}
+
+Evaluator::Flow Evaluator::executeLoopBody(const shared_ptr<StatementNode> &body)
+{
+    step(); // Also bounds empty loops like for (;;);
+    Flow flow = executeStatement(body);
+    return flow == Flow::Continue ? Flow::Normal : flow;
+}
+
+bool Evaluator::isTrue(const shared_ptr<ExpressionNode> &expr)
+{
+    EvalValue value = evaluate(expr);
+    return value.is_float ? value.f != 0.0 : value.i != 0;
+}
+
+EvalValue &Evaluator::cell(const shared_ptr<ExpressionNode> &lvalue, string &type)
+{
+    vector<shared_ptr<ExpressionNode>> indices;
+    shared_ptr<ExpressionNode> base = lvalue;
+    while (auto sub = dynamic_pointer_cast<ArraySubscriptNode>(base))
+    {
+        indices.insert(indices.begin(), sub->getIndexExpression());
+        base = sub->getArrayExpression();
+    }
+    auto ident = dynamic_pointer_cast<IdentifierNode>(base);
+    EvalVariable *variable = ident ? lookup(ident->getName()) : nullptr;
+    if (!variable)
+        throw EvaluationAborted("not a variable of the evaluated code");
+    if (indices.size() != variable->dims.size())
+        throw EvaluationAborted("partial subscript of " + ident->getName());
+    long long offset = 0;
+    for (size_t d = 0; d < indices.size(); ++d)
+    {
+        EvalValue index = evaluate(indices[d]);
+        if (index.is_float || index.i < 0 || index.i >= variable->dims[d])
+            throw EvaluationAborted("index out of bounds in " + ident->getName());
+        offset = offset * variable->dims[d] + index.i;
+    }
+    type = variable->type;
+    return variable->cells[offset];
+}
+
+EvalValue Evaluator::evaluate(const shared_ptr<ExpressionNode> &expr)
+{
+    step();
+    if (auto num = dynamic_pointer_cast<NumberNode>(expr))
+        return literalValue(num->getValue());
+    if (auto ch = dynamic_pointer_cast<CharLiteralNode>(expr))
+    {
+        if (ch->getValue().size() != 1)
+            throw EvaluationAborted("unsupported character literal");
+        return integerValue((long long)(signed char)ch->getValue()[0]);
+    }
+    if (auto boolean = dynamic_pointer_cast<BooleanNode>(expr))
+        return integerValue(boolean->getValue() ? 1 : 0);
+    if (auto ident = dynamic_pointer_cast<IdentifierNode>(expr))
+    {
+        auto constant = m_constants.find(ident->getName());
+        bool shadowed = false;
+        for (const auto &scope : m_scopes)
+            shadowed = shadowed || scope.count(ident->getName());
+        if (constant != m_constants.end() && !shadowed)
+            return integerValue(constant->second);
+    }
+    if (dynamic_pointer_cast<IdentifierNode>(expr) || dynamic_pointer_cast<ArraySubscriptNode>(expr))
+    {
+        string type;
+        EvalValue value = cell(expr, type);
+        if (!value.known)
+            throw EvaluationAborted("read of an uninitialized value");
+        return value;
+    }
+    if (auto assign = dynamic_pointer_cast<AssignmentNode>(expr))
+    {
+        EvalValue value = evaluate(assign->getRValue());
+        string type;
+        EvalValue &target = cell(assign->getLValue(), type);
+        target = convert(value, type);
+        return target;
+    }
+    if (auto binary = dynamic_pointer_cast<BinaryExpressionNode>(expr))
+        return evaluateBinary(binary);
+    if (auto unary = dynamic_pointer_cast<UnaryExpressionNode>(expr))
+        return evaluateUnary(unary);
+    if (auto cast = dynamic_pointer_cast<CastNode>(expr))
+    {
+        if (!isArithmeticType(cast->getTargetType()))
+            throw EvaluationAborted("unsupported cast to " + cast->getTargetType());
+        return convert(evaluate(cast->getOperand()), cast->getTargetType());
+    }
+    throw EvaluationAborted("unsupported expression " + (expr ? expr->type_name : string("(null)")));
+}
+
+EvalValue Evaluator::evaluateBinary(const shared_ptr<BinaryExpressionNode> &expr)
+{
+    const string &op = expr->getOperator();
+    if (op == "&&" || op == "||")
+    {
+        bool left = isTrue(expr->getLeft());
+        if (op == "&&" ? !left : left)
+            return integerValue(left ? 1 : 0);
+        return integerValue(isTrue(expr->getRight()) ? 1 : 0);
+    }
+    EvalValue left = evaluate(expr->getLeft());
+    EvalValue right = evaluate(expr->getRight());
+
+    // Usual arithmetic conversions: any floating operand makes it a double operation.
+    if (left.is_float || right.is_float)
+    {
+        double a = left.is_float ? left.f : (double)left.i;
+        double b = right.is_float ? right.f : (double)right.i;
+        EvalValue result;
+        result.known = true;
+        result.is_float = true;
+        if (op == "+")
+            result.f = a + b;
+        else if (op == "-")
+            result.f = a - b;
+        else if (op == "*")
+            result.f = a * b;
+        else if (op == "/")
+            result.f = a / b;
+        else if (op == "<" || op == ">" || op == "<=" || op == ">=" || op == "==" || op == "!=")
+            return integerValue(op == "<" ? a < b : op == ">" ? a > b : op == "<=" ? a <= b : op == ">=" ? a >= b : op == "==" ? a == b : a != b);
+        else
+            throw EvaluationAborted("unsupported floating operator " + op);
+        if (!isfinite(result.f))
+            throw EvaluationAborted("floating result is not finite");
+        return result;
+    }
+
+    long long a = left.i, b = right.i, r = 0;
+    bool overflow = false;
+    if (op == "+")
+        overflow = __builtin_add_overflow(a, b, &r);
+    else if (op == "-")
+        overflow = __builtin_sub_overflow(a, b, &r);
+    else if (op == "*")
+        overflow = __builtin_mul_overflow(a, b, &r);
+    else if (op == "/" || op == "%")
+    {
+        if (b == 0 || (a == LLONG_MIN && b == -1))
+            throw EvaluationAborted("division by zero");
+        r = op == "/" ? a / b : a % b; // Both truncate toward zero, like C99
+    }
+    else if (op == "<")
+        r = a < b;
+    else if (op == ">")
+        r = a > b;
+    else if (op == "<=")
+        r = a <= b;
+    else if (op == ">=")
+        r = a >= b;
+    else if (op == "==")
+        r = a == b;
+    else if (op == "!=")
+        r = a != b;
+    else
+        throw EvaluationAborted("unsupported operator " + op);
+    // Signed overflow is undefined in C: int arithmetic must stay within int, long within 64 bits.
+    bool is_long = (left.is_long || right.is_long) && !(op == "<" || op == ">" || op == "<=" || op == ">=" || op == "==" || op == "!=");
+    if (overflow || (!is_long && (r < INT_MIN || r > INT_MAX)))
+        throw EvaluationAborted("integer overflow");
+    EvalValue result = integerValue(r);
+    result.is_long = is_long;
+    return result;
+}
+
+EvalValue Evaluator::evaluateUnary(const shared_ptr<UnaryExpressionNode> &expr)
+{
+    const string &op = expr->getOperator();
+    if (op == "++" || op == "--")
+    {
+        string type;
+        EvalValue &target = cell(expr->getOperand(), type);
+        if (!target.known)
+            throw EvaluationAborted("read of an uninitialized value");
+        EvalValue old = target;
+        EvalValue updated = old;
+        if (old.is_float)
+            updated.f += op == "++" ? 1.0 : -1.0;
+        else
+            updated.i += op == "++" ? 1 : -1;
+        target = convert(updated, type);
+        return expr->isPostfix() ? old : target;
+    }
+    EvalValue operand = evaluate(expr->getOperand());
+    if (op == "!")
+        return integerValue(operand.is_float ? operand.f == 0.0 : operand.i == 0);
+    if (op == "-")
+    {
+        if (operand.is_float)
+            operand.f = -operand.f;
+        else if (operand.i == (operand.is_long ? LLONG_MIN : INT_MIN))
+            throw EvaluationAborted("integer overflow");
+        else
+            operand.i = -operand.i;
+        return operand;
+    }
+    throw EvaluationAborted("unsupported operator " + op); // & and * need pointers
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Parser.h" // AST node definitions
+#include <unordered_map>
+#include <stdexcept>
+using namespace std;
+
+// A C scalar value during transpile-time evaluation.
+struct EvalValue
+{
+    bool known = false;    // false: declared (or array element) but never assigned
+    bool is_float = false; // float/double value in 'f', otherwise an integer value in 'i'
+    bool is_long = false;  // Integer of type long: arithmetic on it is 64-bit instead of int
+    long long i = 0;
+    double f = 0.0;
+};
+
+// A variable of the evaluated code: a scalar is a single cell without dimensions.
+struct EvalVariable
+{
+    string type;               // Element type: "int", "char", "float", ...
+    vector<long long> dims;    // Array dimensions, outermost first (empty for scalars)
+    vector<EvalValue> cells;   // Row-major elements
+};
+
+// Thrown when code cannot be evaluated at transpile time: unsupported constructs, reads of values
+// only known at run time, undefined behavior (overflow, division by zero, out-of-bounds) or an
+// exhausted step budget. The transpiler then emits the code normally.
+class EvaluationAborted : public runtime_error
+{
+public:
+    using runtime_error::runtime_error;
+};
+
+// Interpreter for the side-effect free part of the C subset: declarations, assignments, arithmetic,
+// if/for/while with break/continue, on integer, floating and bool scalars and fixed-size arrays.
+// No calls, pointers or I/O. Used to precompute lookup tables that C code fills at startup.
+class Evaluator
+{
+public:
+    explicit Evaluator(long long step_budget);
+
+    // Names the evaluated code may read but not write (e.g. #define N 256).
+    void defineConstant(const string &name, long long value);
+    // A scalar declared before the evaluated statements: it may be assigned (its old value is unknown).
+    void allowOuterScalar(const string &name, const string &type);
+
+    // Executes one statement at the outermost scope. Throws EvaluationAborted.
+    void execute(const shared_ptr<StatementNode> &stmt);
+
+    // Variables of the outermost scope (declared there, or outer scalars assigned), in order of appearance.
+    const vector<string> &getVariableOrder() const { return m_order; }
+    const EvalVariable &getVariable(const string &name) const { return m_scopes.front().at(name); }
+    long long getStepsUsed() const { return m_steps; }
+
+    // Integer (value wrapped or checked for 'type'), or the float value rounded to 'type'.
+    static EvalValue convert(const EvalValue &value, const string &type);
+
+private:
+    enum class Flow
+    {
+        Normal,
+        Break,
+        Continue
+    };
+    Flow executeStatement(const shared_ptr<StatementNode> &stmt);
+    Flow executeLoopBody(const shared_ptr<StatementNode> &body);
+    void declare(const shared_ptr<VariableDeclarationNode> &decl);
+    EvalValue evaluate(const shared_ptr<ExpressionNode> &expr);
+    EvalValue evaluateBinary(const shared_ptr<BinaryExpressionNode> &expr);
+    EvalValue evaluateUnary(const shared_ptr<UnaryExpressionNode> &expr);
+    bool isTrue(const shared_ptr<ExpressionNode> &expr);
+    EvalValue &cell(const shared_ptr<ExpressionNode> &lvalue, string &type); // Storage an lvalue designates
+    EvalVariable *lookup(const string &name);
+    long long integerSize(const shared_ptr<ExpressionNode> &expr);
+    void step();
+
+    long long m_step_budget;
+    long long m_steps = 0;
+    vector<unordered_map<string, EvalVariable>> m_scopes; // Innermost last
+    unordered_map<string, long long> m_constants;
+    unordered_map<string, string> m_outer_scalars;
+    vector<string> m_order;
+};
@@ -0,0 +1,249 @@
+#include "Frames.h"
+#include <sstream>
+#include <regex>
+#include <cstdio>
+
+string jsonString(const string &text)
+{
+    string quoted = "\"";
+    for (unsigned char c : text)
+    {
+        if (c == '"' || c == '\\')
+            quoted += string("\\") + (char)c;
+        else if (c == '\n')
+            quoted += "\\n";
+        else if (c == '\t')
+            quoted += "\\t";
+        else if (c < 0x20)
+        {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            quoted += escaped;
+        }
+        else
+            quoted += (char)c;
+    }
+    return quoted + "\"";
+}
+
+EmitSections parseEmitSections(const string &list)
+{
+    EmitSections emit;
+    emit.python = false;
+    stringstream names(list);
+    string name;
+    while (getline(names, name, ','))
+    {
+        if (name == "tokens")
+            emit.tokens = true;
+        else if (name == "macros")
+            emit.macros = true;
+        else if (name == "ast")
+            emit.ast = true;
+        else if (name == "python")
+            emit.python = true;
+        else
+            throw invalid_argument(name);
+    }
+    return emit;
+}
+
+void writeFrame(ostream &out, const string &kind, const string &payload)
+{
+    out << kind << " " << payload.size() << "\n";
+    out.write(payload.data(), (streamsize)payload.size());
+    out << "\n";
+}
+
+string tokensJson(const vector<Token> &tokens)
+{
+    string json = "[";
+    for (size_t i = 0; i < tokens.size(); ++i)
+    {
+        const Token &token = tokens[i];
+        json += (i == 0 ? "" : ",\n ") + string("{\"value\": ") + jsonString(token.value) +
+                ", \"type\": " + jsonString(tokenTypeToString(token.type)) +
+                ", \"line\": " + to_string(token.line) + ", \"col\": " + to_string(token.col) + "}";
+    }
+    return json + "]";
+}
+
+string macrosJson(const vector<MacroDefinition> &macros)
+{
+    string json = "[";
+    for (size_t i = 0; i < macros.size(); ++i)
+    {
+        const MacroDefinition &macro = macros[i];
+        string parameters = "null";
+        if (macro.isFunctionLike)
+        {
+            parameters = "[";
+            for (size_t p = 0; p < macro.parameters.size(); ++p)
+                parameters += (p == 0 ? "" : ", ") + jsonString(macro.parameters[p]);
+            parameters += "]";
+        }
+        json += (i == 0 ? "" : ",\n ") + string("{\"name\": ") + jsonString(macro.name) +
+                ", \"parameters\": " + parameters + ", \"body\": " + jsonString(macro.body) +
+                ", \"line\": " + to_string(macro.line) + ", \"valid\": " + (macro.valid ? "true" : "false") + "}";
+    }
+    return json + "]";
+}
+
+// Node as JSON: its kind and line, the attributes of its type, the parts kept in named fields
+// (if/while/for parts, function bodies, array sizes) under their names, and getChildren().
+static void writeNode(ostringstream &out, const shared_ptr<ASTNode> &node)
+{
+    if (!node)
+    {
+        out << "null";
+        return;
+    }
+    out << "{\"node\": " << jsonString(node->type_name) << ", \"line\": " << node->line;
+    auto field = [&out](const char *name, const shared_ptr<ASTNode> &child)
+    {
+        out << ", \"" << name << "\": ";
+        writeNode(out, child);
+    };
+
+    if (auto p = dynamic_pointer_cast<IfNode>(node))
+    {
+        field("condition", p->getCondition());
+        field("then", p->getThenBranch());
+        field("else", p->getElseBranch());
+    }
+    else if (auto p = dynamic_pointer_cast<WhileNode>(node))
+    {
+        field("condition", p->getCondition());
+        field("body", p->getBody());
+    }
+    else if (auto p = dynamic_pointer_cast<ForNode>(node))
+    {
+        field("initializer", p->getInitializer());
+        field("condition", p->getCondition());
+        field("increment", p->getIncrement());
+        field("body", p->getBody());
+    }
+    else if (auto p = dynamic_pointer_cast<FunctionDeclarationNode>(node))
+    {
+        out << ", \"name\": " << jsonString(p->getName()) << ", \"type\": " << jsonString(p->getDeclaredType());
+        out << ", \"parameters\": [";
+        const auto &params = p->getParameters();
+        for (size_t i = 0; i < params.size(); ++i)
+        {
+            out << (i == 0 ? "" : ", ") << "{\"name\": " << jsonString(params[i].name)
+                << ", \"type\": " << jsonString(params[i].type) << ", \"dimensions\": " << params[i].dimensions << "}";
+        }
+        out << "]";
+        field("body", p->getBody());
+    }
+    else if (auto p = dynamic_pointer_cast<ArrayDeclarationNode>(node))
+    {
+        out << ", \"name\": " << jsonString(p->getName()) << ", \"type\": " << jsonString(p->getDeclaredType());
+        out << ", \"sizes\": [";
+        writeNode(out, p->getSizeExpression());
+        for (const auto &size : p->getInnerSizeExpressions())
+        {
+            out << ", ";
+            writeNode(out, size);
+        }
+        out << "]";
+    }
+    else if (auto p = dynamic_pointer_cast<DeclarationNode>(node))
+    {
+        out << ", \"name\": " << jsonString(p->getName()) << ", \"type\": " << jsonString(p->getDeclaredType());
+    }
+    else if (auto p = dynamic_pointer_cast<AssignmentStatementNode>(node))
+    {
+        field("assignment", p->getAssignment());
+    }
+    else if (auto p = dynamic_pointer_cast<BinaryExpressionNode>(node))
+    {
+        out << ", \"operator\": " << jsonString(p->getOperator());
+    }
+    else if (auto p = dynamic_pointer_cast<UnaryExpressionNode>(node))
+    {
+        out << ", \"operator\": " << jsonString(p->getOperator()) << ", \"postfix\": " << (p->isPostfix() ? "true" : "false");
+    }
+    else if (auto p = dynamic_pointer_cast<IdentifierNode>(node))
+    {
+        out << ", \"name\": " << jsonString(p->getName());
+    }
+    else if (auto p = dynamic_pointer_cast<FunctionCallNode>(node))
+    {
+        out << ", \"name\": " << jsonString(p->getFunctionName());
+    }
+    else if (auto p = dynamic_pointer_cast<StringLiteralNode>(node))
+    {
+        out << ", \"value\": " << jsonString(p->getValue());
+    }
+    else if (auto p = dynamic_pointer_cast<CharLiteralNode>(node))
+    {
+        out << ", \"value\": " << jsonString(p->getValue());
+    }
+    else if (auto p = dynamic_pointer_cast<NumberNode>(node))
+    {
+        out << ", \"value\": " << jsonString(p->getValue());
+    }
+    else if (auto p = dynamic_pointer_cast<BooleanNode>(node))
+    {
+        out << ", \"value\": " << (p->getValue() ? "true" : "false");
+    }
+    else if (auto p = dynamic_pointer_cast<SizeofNode>(node))
+    {
+        out << ", \"target_type\": " << jsonString(p->getTargetType());
+    }
+    else if (auto p = dynamic_pointer_cast<CastNode>(node))
+    {
+        out << ", \"target_type\": " << jsonString(p->getTargetType());
+    }
+
+    out << ", \"children\": [";
+    const auto &children = node->getChildren();
+    for (size_t i = 0; i < children.size(); ++i)
+    {
+        if (i > 0)
+            out << ", ";
+        writeNode(out, children[i]);
+    }
+    out << "]}";
+}
+
+string astJson(const shared_ptr<ASTNode> &node)
+{
+    ostringstream out;
+    writeNode(out, node);
+    return out.str();
+}
+
+Diagnostic parseDiagnostic(const string &message_line)
+{
+    // "<Source> <Severity> (Line N): message", e.g. "Transpiler Warning (Line 12): ..."
+    static const regex header(R"(^(?:(\S+) )?(Error|Warning|Info|error)(?: \(Line (\d+)\))?: (.*)$)");
+    smatch match;
+    Diagnostic diagnostic;
+    diagnostic.message = message_line;
+    if (regex_match(message_line, match, header))
+    {
+        diagnostic.source = match[1];
+        diagnostic.severity = match[2];
+        if (match[3].matched)
+            diagnostic.line = stoi(match[3]);
+        diagnostic.message = match[4];
+    }
+    else if (message_line.find("rror") != string::npos)
+        diagnostic.severity = "error";
+    else if (message_line.find("Warning") != string::npos)
+        diagnostic.severity = "warning";
+    else
+        diagnostic.severity = "info";
+    diagnostic.severity[0] = (char)tolower((unsigned char)diagnostic.severity[0]);
+    return diagnostic;
+}
+
+string diagnosticJson(const string &message_line)
+{
+    Diagnostic diagnostic = parseDiagnostic(message_line);
+    return "{\"severity\": " + jsonString(diagnostic.severity) + ", \"source\": " + jsonString(diagnostic.source) +
+           ", \"line\": " + (diagnostic.line > 0 ? to_string(diagnostic.line) : string("null")) +
+           ", \"message\": " + jsonString(diagnostic.message) + "}";
+}
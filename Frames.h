@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Parser.h" // AST node definitions
+#include "Lexer.h"  // Token, MacroDefinition
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// --- Framed output (--framed) ---
+// Instead of text sections separated by ---TOKENS--- style sentinel lines (which break when the C
+// code itself prints such a line), the output is a sequence of frames:
+//   <kind> <length>\n<payload of exactly length bytes>\n
+// so a reader can skip a section it does not need by its length, without scanning it. Kinds:
+//   protocol    {"version": 1}, always the first frame
+//   tokens      JSON array: [{"value": "int", "type": "Keyword", "line": 1, "col": 1}, ...]
+//   macros      JSON array: [{"name": "SQUARE", "parameters": ["x"], "body": "((x) * (x))", "line": 8, "valid": true}, ...]
+//                           ("parameters" is null for object-like macros)
+//   ast         JSON tree: {"node": "ProgramNode", "line": 0, ..., "children": [...]}
+//   python      the generated Python code, as is
+//   diagnostic  one JSON record per error/warning/info message:
+//               {"severity": "warning", "source": "Transpiler", "line": 12, "message": "...", "rule": "...", "cost": 2}
+//               ("line" is null when unknown; "rule" and "cost" only for --lint warnings)
+//   stats       with --stats, the per-phase statistics as one JSON object (Stats.h)
+//   end         {"status": <exit status>}, always the last frame
+// tokens/macros/ast/python follow --emit.
+
+// Output sections selected with --emit. The dumps are debugging aids and cost more than
+// transpiling on big inputs, so they are only produced on request.
+struct EmitSections
+{
+    bool tokens = false;
+    bool macros = false;
+    bool ast = false;
+    bool python = true;
+};
+
+// "tokens,macros,ast,python" (any subset, any order) -> sections. Throws invalid_argument.
+EmitSections parseEmitSections(const string &list);
+
+// Quoted and escaped JSON string.
+string jsonString(const string &text);
+
+void writeFrame(ostream &out, const string &kind, const string &payload);
+
+string tokensJson(const vector<Token> &tokens);
+string macrosJson(const vector<MacroDefinition> &macros);
+string astJson(const shared_ptr<ASTNode> &node);
+
+// One message line as written to cerr, e.g. "Parser Warning (Line 3): ..." -> severity "warning",
+// source "Parser", line 3. Lines without such a header (continuations like "Error occurred near
+// token: x") are kept whole as the message, with the severity their wording suggests.
+struct Diagnostic
+{
+    string severity; // "error", "warning" or "info"
+    string source;   // "Lexer", "Parser", "Transpiler", ...; empty if unknown
+    int line = 0;    // C line, 0 if unknown
+    string message;
+};
+Diagnostic parseDiagnostic(const string &message_line);
+
+// Diagnostic record of one message line: {"severity": "warning", "source": "Parser", "line": 3, ...}.
+string diagnosticJson(const string &message_line);
@@ -128,6 +128,9 @@ Token Lexer::lexStringLiteral()
             case 'f':
                 value += '\f';
                 break;
+            case '0':
+                value += '\0';
+                break;
             default:
                 // Unknown escape sequence, could be an error or pass char through
                 value += escaped_char; // Simple: pass through
@@ -196,6 +199,9 @@ Token Lexer::lexCharacterLiteral()
         case 'f':
             value += '\f';
             break;
+        case '0':
+            value += '\0'; // The NUL terminator character
+            break;
         // Add more as needed
         default:
             value += escaped_char;
@@ -378,7 +384,7 @@ void Lexer::processPreprocessorDirective()
         if (!isalpha(peek()) && peek() != '_')
         {
             // Error: macro name must be an identifier
-            cerr << "Lexer Error (Line " << directive_start_line << "): Invalid macro name after #define." << endl;
+            *m_diagnostics << "Lexer Error (Line " << directive_start_line << "): Invalid macro name after #define." << endl;
             currentMacro.valid = false;
             // Consume rest of the line to avoid cascading errors
             while (peek() != '\n' && peek() != '\0')
@@ -421,7 +427,7 @@ void Lexer::processPreprocessorDirective()
                         else
                         {
                             // Error: empty parameter or unexpected comma
-                            cerr << "Lexer Error (Line " << line << "): Unexpected comma or empty parameter in macro " << currentMacro.name << endl;
+                            *m_diagnostics << "Lexer Error (Line " << line << "): Unexpected comma or empty parameter in macro " << currentMacro.name << endl;
                             currentMacro.valid = false; // Mark as invalid
                         }
                         param_buffer.clear();
@@ -436,7 +442,7 @@ void Lexer::processPreprocessorDirective()
                     else if (peek() == '\n')
                     {
                         // Error: newline in parameter list without line continuation
-                        cerr << "Lexer Error (Line " << line << "): Unexpected newline in parameter list for macro " << currentMacro.name << endl;
+                        *m_diagnostics << "Lexer Error (Line " << line << "): Unexpected newline in parameter list for macro " << currentMacro.name << endl;
                         currentMacro.valid = false;
                         break; // Stop parsing params
                     }
@@ -452,7 +458,7 @@ void Lexer::processPreprocessorDirective()
             }
             else
             {
-                cerr << "Lexer Error (Line " << line << "): Missing ')' for function-like macro " << currentMacro.name << endl;
+                *m_diagnostics << "Lexer Error (Line " << line << "): Missing ')' for function-like macro " << currentMacro.name << endl;
                 currentMacro.valid = false;
             }
         }
@@ -488,7 +494,7 @@ void Lexer::processPreprocessorDirective()
 
         if (currentMacro.name.empty())
         {
-            cerr << "Lexer Error (Line " << directive_start_line << "): #define without a macro name." << endl;
+            *m_diagnostics << "Lexer Error (Line " << directive_start_line << "): #define without a macro name." << endl;
             currentMacro.valid = false;
         }
 
@@ -499,7 +505,7 @@ void Lexer::processPreprocessorDirective()
         else
         {
             // Optionally add to m_definedMacros with valid=false for tracking, or just skip
-            cerr << "Lexer Info: Macro definition for '" << currentMacro.name << "' on line " << directive_start_line << " was invalid and skipped." << endl;
+            *m_diagnostics << "Lexer Info: Macro definition for '" << currentMacro.name << "' on line " << directive_start_line << " was invalid and skipped." << endl;
         }
     }
     else
@@ -739,7 +745,15 @@ Token Lexer::nextToken()
             // We need to check if 'pos' is at the beginning of a line or only whitespace preceded it.
             // A more robust way: track column since last newline, or check if all chars from last newline to 'pos' are whitespace.
             // For now, let's assume if we see '#', and it's not inside a comment/string, it's a directive.
+            PhaseTimer timer(m_preprocess_stats != nullptr);
             processPreprocessorDirective(); // This will parse #define or skip others
+            if (m_preprocess_stats)
+            {
+                PhaseStats directive = timer.lap("preprocess");
+                m_preprocess_stats->wall_ms += directive.wall_ms;
+                m_preprocess_stats->cpu_ms += directive.cpu_ms;
+                m_preprocess_stats->peak_rss_kb = directive.peak_rss_kb;
+            }
             continue;                       // Restart loop to find next token or more skippable items
         }
         // MODIFICATION END
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <string>
+#include <iostream>
 #include <vector>
 #include <unordered_map>
+#include "Stats.h" // PhaseStats
 
 // ADD THIS:
 #include <algorithm> // For std::remove_if for trimming
@@ -68,6 +70,11 @@ public:
 
   // ADD THIS PUBLIC GETTER
   const vector<MacroDefinition> &getDefinedMacros() const;
+  // Where errors and infos about #define lines go (default cerr). Lets several lexers run on
+  // separate threads without interleaving their messages.
+  void setDiagnostics(ostream &out) { m_diagnostics = &out; }
+  // --stats: the time spent on preprocessor lines is added to 'stats' (nullptr: not measured).
+  void setPreprocessStats(PhaseStats *stats) { m_preprocess_stats = stats; }
 
 private:
   string source;
@@ -77,6 +84,8 @@ private:
 
   // ADD THIS MEMBER VARIABLE
   vector<MacroDefinition> m_definedMacros;
+  ostream *m_diagnostics = &cerr;
+  PhaseStats *m_preprocess_stats = nullptr;
 
   char peek();
   char peek_char_at(size_t offset);
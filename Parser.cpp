@@ -1,6 +1,7 @@
 #include "Parser.h"
 #include <stdexcept>
 #include <iostream> // For cerr
+#include <climits>  // For INT_MIN/INT_MAX (enumerator range)
 
 // This unescapeLiteralContent function assumes 's' is the PURE CONTENT
 // (i.e., already stripped of any outer quotes)
@@ -56,7 +57,22 @@ string Parser::unescapeLiteralContent(const string &s)
     return res;
 }
 
-Parser::Parser(const vector<Token> &tokens) : tokens(tokens), current(0) {}
+Parser::Parser(const vector<Token> &tokens) : tokens(tokens), current(0)
+{
+    for (const char *keyword : {"int", "float", "double", "char", "short", "long", "bool", "string", "void"})
+    {
+        typeNames[keyword] = keyword;
+    }
+}
+
+void Parser::defineMacros(const vector<MacroDefinition> &macros)
+{
+    for (const auto &macro : macros)
+    {
+        if (macro.valid && !macro.isFunctionLike)
+            macroBodies[macro.name] = macro.body;
+    }
+}
 
 shared_ptr<ProgramNode> Parser::parse()
 {
@@ -66,16 +82,16 @@ shared_ptr<ProgramNode> Parser::parse()
     }
     catch (const runtime_error &e)
     {
-        cerr << "Parse error: " << e.what() << endl;
+        *diagnostics << "Parse error: " << e.what() << endl;
         if (current < tokens.size() && tokens[current].type != TokenType::EndOfFile)
         {
-            cerr << "Error occurred near token: " << tokens[current].toString()
+            *diagnostics << "Error occurred near token: " << tokens[current].toString()
                  << " (type: " << tokenTypeToString(tokens[current].type)
                  << ", line: " << tokens[current].line << ")" << endl;
         }
         else if (!tokens.empty() && current > 0)
         {
-            cerr << "Error might be after token: " << tokens[current - 1].toString()
+            *diagnostics << "Error might be after token: " << tokens[current - 1].toString()
                  << " (type: " << tokenTypeToString(tokens[current - 1].type)
                  << ", line: " << tokens[current - 1].line << ")" << endl;
         }
@@ -88,6 +104,9 @@ shared_ptr<ProgramNode> Parser::parseProgram()
     auto programNode = make_shared<ProgramNode>();
     while (!isAtEnd())
     {
+        // A statement abandoned by a parse error may have left its scopes open
+        localScopes.clear();
+        hiddenEnumerators.clear();
         try
         {
             shared_ptr<StatementNode> stmt = parseStatement();
@@ -98,16 +117,16 @@ shared_ptr<ProgramNode> Parser::parseProgram()
         }
         catch (const runtime_error &e)
         {
-            cerr << "Error parsing statement: " << e.what() << endl;
+            *diagnostics << "Error parsing statement: " << e.what() << endl;
             if (current < tokens.size() && tokens[current].type != TokenType::EndOfFile)
             {
-                cerr << "Error occurred near token: " << tokens[current].toString()
+                *diagnostics << "Error occurred near token: " << tokens[current].toString()
                      << " (type: " << tokenTypeToString(tokens[current].type)
                      << ", line: " << tokens[current].line << ")" << endl;
             }
             else if (!tokens.empty() && current > 0)
             {
-                cerr << "Error might be after token: " << tokens[current - 1].toString()
+                *diagnostics << "Error might be after token: " << tokens[current - 1].toString()
                      << " (type: " << tokenTypeToString(tokens[current - 1].type)
                      << ", line: " << tokens[current - 1].line << ")" << endl;
             }
@@ -116,10 +135,23 @@ shared_ptr<ProgramNode> Parser::parseProgram()
                 break;
         }
     }
+    programNode->enumerators = enumConstants;
     return programNode;
 }
 
 shared_ptr<StatementNode> Parser::parseStatement()
+{
+    // Remember where the statement starts so later stages can report C line numbers.
+    int startLine = peek().line;
+    shared_ptr<StatementNode> stmt = parseStatementBody();
+    if (stmt && stmt->line == 0)
+    {
+        stmt->line = startLine;
+    }
+    return stmt;
+}
+
+shared_ptr<StatementNode> Parser::parseStatementBody()
 {
     if (match(TokenType::Keyword, "if"))
         return parseIf();
@@ -135,6 +167,8 @@ shared_ptr<StatementNode> Parser::parseStatement()
         return parseContinue();
     if (match(TokenType::Symbol, "{"))
         return parseBlock();
+    if (match(TokenType::Keyword, "typedef"))
+        return parseTypedef();
 
     if (check(TokenType::Identifier, "printf") && peek(1).type == TokenType::Symbol && peek(1).value == "(")
     {
@@ -145,9 +179,7 @@ shared_ptr<StatementNode> Parser::parseStatement()
         return parseScanfStatement();
     }
 
-    if (check(TokenType::Keyword, "int") || check(TokenType::Keyword, "float") ||
-        check(TokenType::Keyword, "char") || check(TokenType::Keyword, "bool") ||
-        check(TokenType::Keyword, "string") || check(TokenType::Keyword, "void"))
+    if (isTypeName())
     {
         return parseDeclaration();
     }
@@ -236,14 +268,37 @@ shared_ptr<ExpressionStatementNode> Parser::parseExpressionStatement()
 shared_ptr<BlockNode> Parser::parseBlock()
 {
     auto blockNode = make_shared<BlockNode>();
+    pushScope();
     while (!check(TokenType::Symbol, "}") && !isAtEnd())
     {
-        blockNode->addChild(parseStatement());
+        auto stmt = parseStatement();
+        if (stmt) // Type-only declarations (typedef, enum) leave nothing in the tree
+            blockNode->addChild(stmt);
     }
     consume(TokenType::Symbol, "}", "Expected '}' after block.");
+    popScope();
     return blockNode;
 }
 
+void Parser::popScope()
+{
+    for (const auto &name : localScopes.back())
+    {
+        if (--hiddenEnumerators[name] == 0)
+            hiddenEnumerators.erase(name);
+    }
+    localScopes.pop_back();
+}
+
+void Parser::declareLocal(const string &name)
+{
+    // Globals cannot share a name with an enumerator; only locals and parameters hide one.
+    if (localScopes.empty() || !enumConstants.count(name))
+        return;
+    localScopes.back().push_back(name);
+    hiddenEnumerators[name]++;
+}
+
 shared_ptr<IfNode> Parser::parseIf()
 {
     auto ifNode = make_shared<IfNode>();
@@ -273,11 +328,12 @@ shared_ptr<ForNode> Parser::parseFor()
     // 'for' keyword was matched
     auto forNode = make_shared<ForNode>();
     consume(TokenType::Symbol, "(", "Expected '(' after 'for'.");
+    pushScope(); // for (int i = ...): i is visible up to the end of the body
     // Initializer
     if (!check(TokenType::Symbol, ";"))
     {
-        if (check(TokenType::Keyword, "int") ||
-            check(TokenType::Keyword, "float"))
+        int initLine = peek().line;
+        if (isTypeName())
         {
             // Parse variable declaration but *without* consuming the type keyword yet,
             // as parseVariableDeclaration expects to do that if hints are empty.
@@ -288,6 +344,7 @@ shared_ptr<ForNode> Parser::parseFor()
         {
             forNode->setInitializer(parseExpressionStatement());
         }
+        forNode->getInitializer()->line = initLine;
     }
     else
     {
@@ -310,6 +367,7 @@ shared_ptr<ForNode> Parser::parseFor()
     consume(TokenType::Symbol, ")", "Expected ')' after for clauses.");
 
     forNode->setBody(parseStatement());
+    popScope();
     return forNode;
 }
 
@@ -351,7 +409,12 @@ shared_ptr<ContinueNode> Parser::parseContinue()
 // }
 shared_ptr<StatementNode> Parser::parseDeclaration()
 {
-    string typeStr = advance().value; // e.g., "int"
+    string typeStr = parseTypeName(); // e.g., "int" or "int*"
+    if (match(TokenType::Symbol, ";"))
+    {
+        // enum Color { RED, GREEN };  declares only the enumerators, which are folded at their uses.
+        return nullptr;
+    }
     string identifierStr = consume(TokenType::Identifier, "Expected identifier after type in declaration.").value;
 
     if (check(TokenType::Symbol, "["))
@@ -360,10 +423,14 @@ shared_ptr<StatementNode> Parser::parseDeclaration()
         auto sizeExpr = parseExpression(); // Parse the size (e.g., 10)
         consume(TokenType::Symbol, "]", "Expected ']' after array size in declaration.");
 
-        // TODO: Add logic for multi-dimensional arrays here if desired (loop for more '[size]')
-        // For now, single dimension
-
         auto arrayDeclNode = make_shared<ArrayDeclarationNode>(identifierStr, typeStr, sizeExpr);
+        // Multi-dimensional arrays: T a[N][M]...
+        while (match(TokenType::Symbol, "["))
+        {
+            arrayDeclNode->addInnerSizeExpression(parseExpression());
+            consume(TokenType::Symbol, "]", "Expected ']' after array size in declaration.");
+        }
+        declareLocal(identifierStr);
 
         // Optional: Handle C-style initializers e.g. int arr[3] = {1, 2, 3};
         // This is a more complex parsing step. For now, we assume no explicit initializer list here.
@@ -371,7 +438,7 @@ shared_ptr<StatementNode> Parser::parseDeclaration()
         if (match(TokenType::Operator, "="))
         {
             // For now, we'll just log and consume until semicolon if initializers aren't supported.
-            cerr << "Parser Warning (Line " << previous().line << "): Array initializer found for '"
+            *diagnostics << "Parser Warning (Line " << previous().line << "): Array initializer found for '"
                  << identifierStr << "' but full parsing for initializers is not yet implemented. Skipping initializer." << endl;
             while (!isAtEnd() && !check(TokenType::Symbol, ";"))
             {
@@ -407,13 +474,11 @@ shared_ptr<VariableDeclarationNode> Parser::parseVariableDeclaration(
 
     if (actualType.empty())
     {
-        if (!(check(TokenType::Keyword, "int") || check(TokenType::Keyword, "float") ||
-              check(TokenType::Keyword, "char") || check(TokenType::Keyword, "bool") ||
-              check(TokenType::Keyword, "string") || check(TokenType::Keyword, "void")))
+        if (!isTypeName())
         {
             throw runtime_error("Expected type keyword for variable declaration, got " + peek().toString());
         }
-        actualType = advance().value;
+        actualType = parseTypeName();
     }
     if (actualIdentifier.empty())
     {
@@ -421,6 +486,7 @@ shared_ptr<VariableDeclarationNode> Parser::parseVariableDeclaration(
     }
 
     auto varDeclNode = make_shared<VariableDeclarationNode>(actualIdentifier, actualType);
+    declareLocal(actualIdentifier); // In scope from its own initializer on, as in C
     if (match(TokenType::Operator, "="))
     {
         varDeclNode->addChild(parseExpression());
@@ -435,6 +501,7 @@ shared_ptr<FunctionDeclarationNode> Parser::parseFunctionDeclaration(
 {
     auto funcDeclNode = make_shared<FunctionDeclarationNode>(identifier, returnType);
     consume(TokenType::Symbol, "(", "Expected '(' after function name for parameters.");
+    pushScope(); // The parameters
 
     if (!check(TokenType::Symbol, ")"))
     {
@@ -444,13 +511,11 @@ shared_ptr<FunctionDeclarationNode> Parser::parseFunctionDeclaration(
             Parameter currentParam; // Create a new Parameter object
 
             // 1. Parse type
-            if (!(check(TokenType::Keyword, "int") || check(TokenType::Keyword, "float") ||
-                  check(TokenType::Keyword, "char") || check(TokenType::Keyword, "bool") ||
-                  check(TokenType::Keyword, "string") || check(TokenType::Keyword, "void")))
+            if (!isTypeName())
             {
                 throw runtime_error("Expected type keyword for function parameter, got " + peek().toString());
             }
-            currentParam.type = advance().value;
+            currentParam.type = parseTypeName();
 
             // 2. Parse name
             currentParam.name = consume(TokenType::Identifier, "Expected parameter name.").value;
@@ -460,10 +525,19 @@ shared_ptr<FunctionDeclarationNode> Parser::parseFunctionDeclaration(
             {
                 consume(TokenType::Symbol, "]", "Expected ']' after '[' in array parameter declaration.");
                 currentParam.isArray = true; // Mark it as an array!
+                currentParam.dimensions = 1;
+                // Further dimensions must have sizes in C (int g[][N]); Python lists do not need them.
+                while (match(TokenType::Symbol, "["))
+                {
+                    currentParam.innerSizes.push_back(parseExpression());
+                    consume(TokenType::Symbol, "]", "Expected ']' after array parameter dimension.");
+                    currentParam.dimensions++;
+                }
             }
 
             // 4. Add the completed parameter to the node
             funcDeclNode->addParameter(currentParam);
+            declareLocal(currentParam.name);
 
         } while (match(TokenType::Symbol, ","));
     }
@@ -477,6 +551,7 @@ shared_ptr<FunctionDeclarationNode> Parser::parseFunctionDeclaration(
     {
         consume(TokenType::Symbol, ";", "Expected '{' for function body or ';' for function prototype.");
     }
+    popScope();
     return funcDeclNode;
 }
 
@@ -497,9 +572,11 @@ shared_ptr<ExpressionNode> Parser::parseAssignmentExpression()
 
         // Check if left_expr is a valid L-value (can be assigned to)
         // For now, we'll accept IdentifierNode and ArraySubscriptNode
+        auto deref = dynamic_pointer_cast<UnaryExpressionNode>(left_expr);
         if (dynamic_pointer_cast<IdentifierNode>(left_expr) ||
-            dynamic_pointer_cast<ArraySubscriptNode>(left_expr)
-            /* TODO: Add other valid L-value types here, e.g., MemberAccessNode for obj.field, UnaryExpressionNode for *ptr */
+            dynamic_pointer_cast<ArraySubscriptNode>(left_expr) ||
+            (deref && deref->getOperator() == "*")
+            /* TODO: Add other valid L-value types here, e.g., MemberAccessNode for obj.field */
         )
         {
             // Create the new AssignmentNode that takes two ExpressionNode children
@@ -559,9 +636,18 @@ shared_ptr<ExpressionNode> Parser::parseFactor()
 
 shared_ptr<ExpressionNode> Parser::parseUnary()
 {
+    // Cast: '(' type-name ')' unary-expression
+    if (check(TokenType::Symbol, "(") && isTypeName(1))
+    {
+        advance(); // Consume '('
+        string castType = parseTypeName();
+        consume(TokenType::Symbol, ")", "Expected ')' after type name in cast.");
+        return make_shared<CastNode>(castType, parseUnary());
+    }
     if (check(TokenType::Operator, "!") ||
         check(TokenType::Operator, "-") ||
         check(TokenType::Operator, "&") ||
+        check(TokenType::Operator, "*") ||  // Pointer dereference
         check(TokenType::Operator, "++") || // <-- ADDED THIS
         check(TokenType::Operator, "--"))   // <-- ADDED THIS
     {                                       // Added '&' for address-of
@@ -614,7 +700,7 @@ shared_ptr<ExpressionNode> Parser::parseCall()
             // This is a postfix increment/decrement operator
             string op = previous().value; // Get the "++" or "--"
             // The operand is the expression we parsed *before* the operator
-            auto postfix_unary_node = make_shared<UnaryExpressionNode>(op);
+            auto postfix_unary_node = make_shared<UnaryExpressionNode>(op, true);
             postfix_unary_node->addChild(expr);
             // The whole thing (e.g., "i++") becomes the new expression
             expr = postfix_unary_node;
@@ -652,6 +738,19 @@ shared_ptr<ExpressionNode> Parser::parsePrimary()
         return make_shared<NumberNode>(advance().value);
     }
 
+    if (match(TokenType::Keyword, "sizeof"))
+    {
+        if (check(TokenType::Symbol, "(") && isTypeName(1))
+        {
+            advance(); // Consume '('
+            string sizedType = parseTypeName();
+            consume(TokenType::Symbol, ")", "Expected ')' after sizeof type.");
+            return make_shared<SizeofNode>(sizedType);
+        }
+        // sizeof expression: binds like a unary operator (sizeof a[0], sizeof *p, sizeof(x) + 1).
+        return make_shared<SizeofNode>(parseUnary());
+    }
+
     if (match(TokenType::StringLiteral))
     {
         // ASSUMPTION from error: lexer provides token.value as the content WITHOUT surrounding quotes.
@@ -676,6 +775,17 @@ shared_ptr<ExpressionNode> Parser::parsePrimary()
         return make_shared<CharLiteralNode>(unescaped_content);
     }
 
+    if (check(TokenType::Identifier) && enumConstants.count(peek().value) && !hiddenEnumerators.count(peek().value))
+    {
+        // Enumerators become integer literals, so the generated code has no lookups for them.
+        long long value = enumConstants.at(advance().value);
+        if (value >= 0)
+            return make_shared<NumberNode>(to_string(value));
+        auto negative = make_shared<UnaryExpressionNode>("-");
+        negative->addChild(make_shared<NumberNode>(to_string(-value)));
+        return negative;
+    }
+
     if (match(TokenType::Identifier))
     {
         // Check if this identifier might be "printf" or "scanf" being used as an expression (less common, but possible)
@@ -726,6 +836,227 @@ shared_ptr<ExpressionNode> Parser::parseBinaryExpression(
     return left;
 }
 
+// True if the token at 'offset' starts a type name: a type keyword, an enum specifier or a typedef
+// name. "string" is not a C keyword, so the lexer gives it as an identifier.
+bool Parser::isTypeName(int offset) const
+{
+    if (current + offset >= tokens.size())
+        return false;
+    Token t = peek(offset);
+    if (t.type == TokenType::Keyword && t.value == "enum")
+        return true;
+    return (t.type == TokenType::Keyword || t.type == TokenType::Identifier) && typeNames.count(t.value) > 0;
+}
+
+string Parser::parseTypeName()
+{
+    string typeStr;
+    if (match(TokenType::Keyword, "enum"))
+    {
+        typeStr = parseEnumSpecifier();
+    }
+    else
+    {
+        Token name = advance();
+        auto it = typeNames.find(name.value);
+        if (it == typeNames.end())
+            throw runtime_error("Unknown type name '" + name.value + "' (line " + to_string(name.line) + ")");
+        typeStr = it->second;
+    }
+    while (match(TokenType::Operator, "*"))
+    {
+        typeStr += "*";
+    }
+    return typeStr;
+}
+
+// After 'enum': an optional tag and an optional list of enumerators. Enumerators without a value
+// continue from the previous one. The type of an enum object is int.
+string Parser::parseEnumSpecifier()
+{
+    int line = previous().line;
+    bool tagged = match(TokenType::Identifier);
+    if (!match(TokenType::Symbol, "{"))
+    {
+        if (!tagged)
+            throw runtime_error("Expected enum tag or '{' after 'enum' (line " + to_string(line) + ")");
+        return "int";
+    }
+    long long next = 0;
+    while (!check(TokenType::Symbol, "}"))
+    {
+        Token name = consume(TokenType::Identifier, "Expected enumerator name.");
+        if (enumConstants.count(name.value) || typeNames.count(name.value))
+            throw runtime_error("Redeclaration of '" + name.value + "' as an enumerator (line " + to_string(name.line) + ")");
+        if (match(TokenType::Operator, "="))
+            next = evaluateConstant(parseLogicalOr());
+        if (next < INT_MIN || next > INT_MAX)
+            throw runtime_error("Value of enumerator '" + name.value + "' does not fit in an int (line " + to_string(name.line) + ")");
+        enumConstants[name.value] = next++;
+        if (!match(TokenType::Symbol, ","))
+            break;
+    }
+    consume(TokenType::Symbol, "}", "Expected '}' after enumerators.");
+    return "int";
+}
+
+// After 'typedef': typedef <type> Name;  Registers Name in the type name table; nothing is emitted.
+shared_ptr<StatementNode> Parser::parseTypedef()
+{
+    if (!isTypeName())
+        throw runtime_error("Only typedefs of int, float, char, bool, string, void, enums and pointers are supported, got " +
+                            peek().toString());
+    string typeStr = parseTypeName();
+    Token name = consume(TokenType::Identifier, "Expected a name in typedef.");
+    if (check(TokenType::Symbol, "[") || check(TokenType::Symbol, "("))
+        throw runtime_error("Array and function typedefs are not supported (line " + to_string(name.line) + ")");
+    consume(TokenType::Symbol, ";", "Expected ';' after typedef.");
+    auto existing = typeNames.find(name.value);
+    if (existing != typeNames.end() && existing->second != typeStr)
+        throw runtime_error("Conflicting typedef of '" + name.value + "' (line " + to_string(name.line) + ")");
+    if (enumConstants.count(name.value))
+        throw runtime_error("'" + name.value + "' is already an enumerator (line " + to_string(name.line) + ")");
+    typeNames[name.value] = typeStr;
+    return nullptr;
+}
+
+// Value of an integer constant expression (enumerator values): literals, enumerators (already
+// folded to literals), object-like macros, casts, sizeof and integer arithmetic.
+long long Parser::evaluateConstant(const shared_ptr<ExpressionNode> &expr)
+{
+    auto fail = [&]()
+    {
+        return runtime_error("Enumerator value is not an integer constant expression (line " + to_string(previous().line) + ")");
+    };
+    if (auto num = dynamic_pointer_cast<NumberNode>(expr))
+    {
+        const string &text = num->getValue();
+        size_t digits = text.find_last_not_of("uUlL") + 1;
+        bool hex = text.size() > 1 && (text[1] == 'x' || text[1] == 'X');
+        if (!hex && text.find_first_of(".eE") != string::npos)
+            throw fail();
+        try
+        {
+            return stoll(text.substr(0, digits), nullptr, 0);
+        }
+        catch (const std::exception &)
+        {
+            throw fail();
+        }
+    }
+    if (auto ch = dynamic_pointer_cast<CharLiteralNode>(expr))
+        return ch->getValue().empty() ? 0 : (signed char)ch->getValue()[0];
+    if (auto boolean = dynamic_pointer_cast<BooleanNode>(expr))
+        return boolean->getValue() ? 1 : 0;
+    if (auto cast = dynamic_pointer_cast<CastNode>(expr))
+        return evaluateConstant(cast->getOperand());
+    if (auto ident = dynamic_pointer_cast<IdentifierNode>(expr))
+    {
+        auto macro = macroBodies.find(ident->getName());
+        if (macro == macroBodies.end() || macroDepth >= 32)
+            throw fail();
+        // #define N 10: parse the body with the same symbol tables.
+        Lexer lexer(macro->second);
+        Parser body(lexer.tokenize());
+        body.typeNames = typeNames;
+        body.enumConstants = enumConstants;
+        body.macroBodies = macroBodies;
+        body.macroDepth = macroDepth + 1;
+        return body.evaluateConstant(body.parseExpression());
+    }
+    if (auto unary = dynamic_pointer_cast<UnaryExpressionNode>(expr))
+    {
+        long long value = evaluateConstant(unary->getOperand());
+        if (unary->getOperator() == "-")
+            return -value;
+        if (unary->getOperator() == "!")
+            return !value;
+        throw fail();
+    }
+    if (auto binary = dynamic_pointer_cast<BinaryExpressionNode>(expr))
+    {
+        long long a = evaluateConstant(binary->getLeft());
+        long long b = evaluateConstant(binary->getRight());
+        const string &op = binary->getOperator();
+        if (op == "+")
+            return a + b;
+        if (op == "-")
+            return a - b;
+        if (op == "*")
+            return a * b;
+        if ((op == "/" || op == "%") && b == 0)
+            throw runtime_error("Division by zero in enumerator value (line " + to_string(previous().line) + ")");
+        if (op == "/")
+            return a / b;
+        if (op == "%")
+            return a % b;
+        if (op == "<")
+            return a < b;
+        if (op == ">")
+            return a > b;
+        if (op == "<=")
+            return a <= b;
+        if (op == ">=")
+            return a >= b;
+        if (op == "==")
+            return a == b;
+        if (op == "!=")
+            return a != b;
+        if (op == "&&")
+            return a && b;
+        if (op == "||")
+            return a || b;
+    }
+    throw fail();
+}
+
+void forEachChild(const shared_ptr<ASTNode> &node, const function<void(const shared_ptr<ASTNode> &)> &visit)
+{
+    if (!node)
+        return;
+    for (const auto &child : node->getChildren())
+    {
+        visit(child);
+    }
+    auto visitIfSet = [&visit](const shared_ptr<ASTNode> &child)
+    {
+        if (child)
+            visit(child);
+    };
+    if (auto p = dynamic_pointer_cast<IfNode>(node))
+    {
+        visitIfSet(p->getCondition());
+        visitIfSet(p->getThenBranch());
+        visitIfSet(p->getElseBranch());
+    }
+    else if (auto p = dynamic_pointer_cast<WhileNode>(node))
+    {
+        visitIfSet(p->getCondition());
+        visitIfSet(p->getBody());
+    }
+    else if (auto p = dynamic_pointer_cast<ForNode>(node))
+    {
+        visitIfSet(p->getInitializer());
+        visitIfSet(p->getCondition());
+        visitIfSet(p->getIncrement());
+        visitIfSet(p->getBody());
+    }
+    else if (auto p = dynamic_pointer_cast<FunctionDeclarationNode>(node))
+    {
+        visitIfSet(p->getBody());
+    }
+    else if (auto p = dynamic_pointer_cast<AssignmentStatementNode>(node))
+    {
+        visitIfSet(p->getAssignment());
+    }
+    else if (auto p = dynamic_pointer_cast<ArrayDeclarationNode>(node))
+    {
+        visitIfSet(p->getSizeExpression());
+        for (const auto &size : p->getInnerSizeExpressions())
+            visitIfSet(size);
+    }
+}
+
 // Token handling utility methods
 Token Parser::advance()
 {
@@ -853,9 +1184,7 @@ void Parser::synchronize()
         case TokenType::Keyword:
             if (peek().value == "if" || peek().value == "while" || peek().value == "for" ||
                 peek().value == "return" || peek().value == "break" || peek().value == "continue" ||
-                peek().value == "print" || peek().value == "int" || peek().value == "float" ||
-                peek().value == "char" || peek().value == "bool" || peek().value == "string" ||
-                peek().value == "void")
+                peek().value == "print" || peek().value == "typedef" || isTypeName())
             {
                 return;
             }
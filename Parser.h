@@ -4,6 +4,7 @@
 #include <functional>
 #include <vector>
 #include <string>
+#include <unordered_map>
 #include "Lexer.h" // Assumed to provide Token, TokenType, and tokenTypeToString
 using namespace std;
 
@@ -30,6 +31,7 @@ public:
         }
     }
     string type_name; // For easy identification/debugging
+    int line = 0;     // C source line the node starts on (0 if unknown), used for reports
 
     const vector<shared_ptr<ASTNode>> &getChildren() const
     {
@@ -56,6 +58,9 @@ class ProgramNode : public ASTNode
 {
 public:
     ProgramNode() { type_name = "ProgramNode"; }
+    // The enumerators with their values. Their uses in the program are already folded; macro bodies,
+    // parsed later on their own, need the table to do the same.
+    unordered_map<string, long long> enumerators;
     vector<shared_ptr<StatementNode>> getStatements() const
     {
         vector<shared_ptr<StatementNode>> stmts;
@@ -276,6 +281,8 @@ struct Parameter
     string name;
     string type;
     bool isArray = false; // The crucial new piece of information!
+    int dimensions = 0;   // Number of [] suffixes: 1 for `int a[]`, 2 for `int g[][N]`
+    vector<shared_ptr<ExpressionNode>> innerSizes; // Sizes of the second and further dimensions (N of `int g[][N]`)
 };
 
 // REPLACE the old FunctionDeclarationNode with this one:
@@ -330,8 +337,9 @@ private:
 class UnaryExpressionNode : public ExpressionNode
 {
 public:
-    UnaryExpressionNode(const string &op) : op_val(op) { type_name = "UnaryExpressionNode"; }
+    UnaryExpressionNode(const string &op, bool isPostfix = false) : op_val(op), postfix(isPostfix) { type_name = "UnaryExpressionNode"; }
     const string &getOperator() const { return op_val; }
+    bool isPostfix() const { return postfix; } // true for x++ / x--, whose value is the old x
     shared_ptr<ExpressionNode> getOperand() const
     {
         if (!children.empty())
@@ -341,6 +349,7 @@ public:
 
 private:
     string op_val;
+    bool postfix;
 };
 
 class IdentifierNode : public ExpressionNode
@@ -482,15 +491,64 @@ public:
     {
         return size_expr;
     }
+    // Sizes of the second and further dimensions of `T a[N][M]...` (empty for 1-D arrays).
+    void addInnerSizeExpression(shared_ptr<ExpressionNode> sizeExpr) { inner_size_exprs.push_back(sizeExpr); }
+    const vector<shared_ptr<ExpressionNode>> &getInnerSizeExpressions() const { return inner_size_exprs; }
     // If you plan to support C-style initializers like int arr[3] = {1,2,3};
     // you'd add members and methods to store/access these initializer expressions.
     // For now, we'll skip direct initializers in the declaration for simplicity.
 
 private:
     shared_ptr<ExpressionNode> size_expr;
+    vector<shared_ptr<ExpressionNode>> inner_size_exprs;
     // vector<shared_ptr<ExpressionNode>> initializers; // For later
 };
 
+// sizeof(type-name) or sizeof expression. The type keeps its '*' suffixes, e.g. "int*". For the
+// expression form the type is empty and child 0 is the operand, which is never evaluated.
+class SizeofNode : public ExpressionNode
+{
+public:
+    SizeofNode(const string &typeName) : target_type(typeName) { type_name = "SizeofNode"; }
+    explicit SizeofNode(shared_ptr<ExpressionNode> operand)
+    {
+        type_name = "SizeofNode";
+        addChild(operand);
+    }
+    const string &getTargetType() const { return target_type; }
+    shared_ptr<ExpressionNode> getOperand() const
+    {
+        if (!children.empty())
+            return dynamic_pointer_cast<ExpressionNode>(children[0]);
+        return nullptr;
+    }
+
+private:
+    string target_type;
+};
+
+// (type) expression. Child 0: the operand.
+class CastNode : public ExpressionNode
+{
+public:
+    CastNode(const string &typeName, shared_ptr<ExpressionNode> operand) : target_type(typeName)
+    {
+        type_name = "CastNode";
+        if (operand)
+            addChild(operand);
+    }
+    const string &getTargetType() const { return target_type; }
+    shared_ptr<ExpressionNode> getOperand() const
+    {
+        if (!children.empty())
+            return dynamic_pointer_cast<ExpressionNode>(children[0]);
+        return nullptr;
+    }
+
+private:
+    string target_type;
+};
+
 class ArraySubscriptNode : public ExpressionNode
 {
 public:
@@ -524,6 +582,10 @@ public:
     }
 };
 
+// Calls 'visit' on every direct child of 'node', including the ones kept in named
+// fields (if/while/for parts, function bodies, array sizes) rather than in getChildren().
+void forEachChild(const shared_ptr<ASTNode> &node, const function<void(const shared_ptr<ASTNode> &)> &visit);
+
 // Parser class
 class Parser
 {
@@ -531,16 +593,46 @@ public:
     Parser(const vector<Token> &tokens);
     shared_ptr<ProgramNode> parse();
     shared_ptr<ExpressionNode> parseExpression();
+    // Object-like macros (#define N 10) that enum values may use: enum { SIZE = N * 2 }.
+    void defineMacros(const vector<MacroDefinition> &macros);
+    // Enumerators of the program a macro body belongs to (ProgramNode::enumerators), except the
+    // macro's parameters of the same name, which hide them.
+    void defineEnumerators(const unordered_map<string, long long> &enumerators, const vector<string> &parameters = {})
+    {
+        enumConstants = enumerators;
+        for (const auto &parameter : parameters)
+            enumConstants.erase(parameter);
+    }
+    // Where parse errors and warnings go (default cerr).
+    void setDiagnostics(ostream &out) { diagnostics = &out; }
 
 private:
     vector<Token> tokens;
     size_t current;
+    ostream *diagnostics = &cerr;
+
+    // Symbol table for type names: every name that can start a declaration, mapped to the type it
+    // denotes. Type keywords map to themselves, typedef names to their definition ("int*", ...).
+    unordered_map<string, string> typeNames;
+    // Enumerators with their values. Uses of an enumerator are parsed as the integer literal,
+    // except where a parameter or local variable of the same name hides it.
+    unordered_map<string, long long> enumConstants;
+    // Block scopes of the function being parsed (its parameters are the outermost), each with the
+    // enumerator names its declarations hide, and how many open scopes hide each name.
+    vector<vector<string>> localScopes;
+    unordered_map<string, int> hiddenEnumerators;
+    void pushScope() { localScopes.emplace_back(); }
+    void popScope();
+    void declareLocal(const string &name); // A parameter or local variable, from here to the end of its scope
+    unordered_map<string, string> macroBodies; // Object-like macros, for constant expressions
+    int macroDepth = 0;                        // Nesting of macro bodies being evaluated
 
     static string unescapeLiteralContent(const string &s);
 
     // Parsing methods for program structure
     shared_ptr<ProgramNode> parseProgram();
     shared_ptr<StatementNode> parseStatement();
+    shared_ptr<StatementNode> parseStatementBody();
     shared_ptr<ExpressionStatementNode> parseExpressionStatement();
     shared_ptr<BlockNode> parseBlock();
     shared_ptr<IfNode> parseIf();
@@ -568,6 +660,11 @@ private:
     shared_ptr<ExpressionNode> parseUnary();
     shared_ptr<ExpressionNode> parseCall();
     shared_ptr<ExpressionNode> parsePrimary();
+    bool isTypeName(int offset = 0) const; // Type keyword, 'enum' or typedef name at 'offset'
+    string parseTypeName();                // Type name plus any '*' suffixes, e.g. "int*"; typedefs resolved
+    string parseEnumSpecifier();           // enum [tag] [{ A = 1, B, ... }]; defines the enumerators
+    shared_ptr<StatementNode> parseTypedef();
+    long long evaluateConstant(const shared_ptr<ExpressionNode> &expr); // Integer constant expression
 
     shared_ptr<ExpressionNode> parseBinaryExpression(
         function<shared_ptr<ExpressionNode>()> parseSubExpr,
@@ -0,0 +1,66 @@
+#include "Profile.h"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+// Missing entries are zero: the instrumented program never got there.
+template <typename Key>
+static long long countOf(const map<Key, long long> &counts, const Key &key)
+{
+    auto it = counts.find(key);
+    return it == counts.end() ? 0 : it->second;
+}
+
+long long ProfileData::callCount(const string &function) const { return countOf(calls, function); }
+long long ProfileData::loopEntries(int line) const { return countOf(loop_entries, line); }
+long long ProfileData::loopIterations(int line) const { return countOf(loop_iterations, line); }
+long long ProfileData::branchCount(int line, int arm) const { return countOf(branches, make_pair(line, arm)); }
+
+ProfileData readProfile(const string &path)
+{
+    ifstream file(path);
+    if (!file)
+        throw runtime_error("Cannot open profile file: " + path);
+
+    ProfileData profile;
+    string line;
+    int line_number = 0;
+    while (getline(file, line))
+    {
+        line_number++;
+        if (line.empty() || line[0] == '#')
+            continue;
+        istringstream fields(line);
+        string kind;
+        fields >> kind;
+        bool ok = false;
+        if (kind == "call")
+        {
+            string function;
+            long long count;
+            ok = static_cast<bool>(fields >> function >> count);
+            if (ok)
+                profile.calls[function] += count;
+        }
+        else if (kind == "entry" || kind == "loop")
+        {
+            int source_line;
+            long long count;
+            ok = static_cast<bool>(fields >> source_line >> count);
+            if (ok)
+                (kind == "entry" ? profile.loop_entries : profile.loop_iterations)[source_line] += count;
+        }
+        else if (kind == "branch")
+        {
+            int source_line, arm;
+            long long count;
+            ok = static_cast<bool>(fields >> source_line >> arm >> count);
+            if (ok)
+                profile.branches[{source_line, arm}] += count;
+        }
+        if (!ok)
+            throw runtime_error("Malformed profile line " + to_string(line_number) + " in " + path + ": " + line);
+    }
+    profile.loaded = true;
+    return profile;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <map>
+using namespace std;
+
+// Execution counts recorded by a --profile-gen build of the generated Python, keyed by C source line.
+// The file is plain text, one count per line:
+//   call <function> <N>        function entered N times
+//   entry <line> <N>           loop starting on <line> reached N times
+//   loop <line> <N>            N iterations of that loop's body in total
+//   branch <line> <arm> <N>    arm <arm> (0 = if, 1 = first else-if, ..., last = else) of the
+//                              if-chain starting on <line> taken N times
+// Lines starting with '#' are comments.
+struct ProfileData
+{
+    map<string, long long> calls;
+    map<int, long long> loop_entries;
+    map<int, long long> loop_iterations;
+    map<pair<int, int>, long long> branches;
+    bool loaded = false;
+
+    long long callCount(const string &function) const;
+    long long loopEntries(int line) const;
+    long long loopIterations(int line) const;
+    long long branchCount(int line, int arm) const;
+};
+
+// Reads a profile file; throws runtime_error if it cannot be opened or a line is malformed.
+ProfileData readProfile(const string &path);
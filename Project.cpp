@@ -0,0 +1,316 @@
+#include "Project.h"
+#include "Cache.h" // contentHash, transpilerVersion, resolveIncludes
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include <random>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    const char *const MANIFEST_VERSION = "1";
+
+    bool readFile(const fs::path &path, string &contents)
+    {
+        ifstream in(path, ios::binary);
+        if (!in)
+            return false;
+        contents.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+        return !in.bad();
+    }
+}
+
+FileStamp statFile(const fs::path &path)
+{
+    FileStamp stamp;
+    error_code ec;
+    stamp.size = fs::file_size(path, ec);
+    if (ec)
+        return stamp;
+    auto time = fs::last_write_time(path, ec);
+    if (ec)
+        return stamp;
+    stamp.exists = true;
+    stamp.mtime = (long long)time.time_since_epoch().count();
+    return stamp;
+}
+
+ProjectManifest::ProjectManifest(const string &path, string &problem) : m_path(path)
+{
+    if (path.empty())
+        return;
+    ifstream file(path);
+    if (!file)
+        return; // First run
+    vector<string> numbered; // Paths by file number
+    string line;
+    int line_number = 0;
+    while (getline(file, line))
+    {
+        line_number++;
+        if (line.empty() || line[0] == '#')
+            continue;
+        istringstream fields(line);
+        string kind;
+        fields >> kind;
+        bool valid = true;
+        if (kind == "version")
+        {
+            string version;
+            fields >> version;
+            if (version != MANIFEST_VERSION)
+            {
+                problem = "manifest " + path + " has version " + version + ", rebuilding everything";
+                break;
+            }
+        }
+        else if (kind == "file")
+        {
+            FileStamp stamp;
+            string hash, file_path;
+            valid = bool(fields >> stamp.size >> stamp.mtime >> hash) && fields.get() == ' ' && getline(fields, file_path);
+            stamp.exists = hash != "-";
+            stamp.hash = stamp.exists ? hash : "";
+            if (valid)
+            {
+                m_nodes[file_path].stamp = stamp;
+                numbered.push_back(file_path);
+            }
+        }
+        else if (kind == "include")
+        {
+            size_t from, to;
+            valid = bool(fields >> from >> to) && from < numbered.size() && to < numbered.size();
+            if (valid)
+                m_nodes[numbered[from]].includes.push_back(numbered[to]);
+        }
+        else if (kind == "unit")
+        {
+            size_t source;
+            Unit unit;
+            int ok;
+            valid = bool(fields >> source >> unit.options_hash >> ok) && source < numbered.size() && fields.get() == ' ' &&
+                    getline(fields, unit.output);
+            unit.ok = ok == 1;
+            if (valid)
+                m_units[numbered[source]] = unit;
+        }
+        else
+            valid = false;
+        if (!valid)
+        {
+            problem = "malformed manifest " + path + " (line " + to_string(line_number) + "), rebuilding everything";
+            break;
+        }
+    }
+    if (!problem.empty())
+    {
+        m_nodes.clear();
+        m_units.clear();
+    }
+}
+
+void ProjectManifest::beginRun()
+{
+    for (auto &node : m_nodes)
+        node.second.state = 0;
+    m_changed.clear();
+    m_recorded.clear();
+}
+
+vector<string> ProjectManifest::files() const
+{
+    vector<string> paths;
+    for (const auto &node : m_nodes)
+        paths.push_back(node.first);
+    return paths;
+}
+
+string ProjectManifest::optionsHash(const string &options_fingerprint)
+{
+    return contentHash(transpilerVersion() + "\n" + options_fingerprint);
+}
+
+bool ProjectManifest::ownChanged(const string &path)
+{
+    Node &node = m_nodes[path];
+    if (node.state != 0)
+        return node.state == 2;
+    FileStamp now = statFile(path);
+    bool changed;
+    if (now.exists != node.stamp.exists)
+        changed = true;
+    else if (!now.exists || (now.size == node.stamp.size && now.mtime == node.stamp.mtime))
+        changed = false;
+    else
+    {
+        // Touched, or really edited: the bytes decide. Either way the new time is remembered, so the
+        // next run is back to stat() only.
+        string contents;
+        now.hash = readFile(path, contents) ? contentHash(contents) : "";
+        changed = now.hash != node.stamp.hash;
+        if (!changed)
+            node.stamp = now;
+    }
+    node.state = changed ? 2 : 1;
+    if (changed)
+        m_changed.insert(path);
+    return changed;
+}
+
+bool ProjectManifest::upToDate(const fs::path &source, const fs::path &output, const string &options_hash)
+{
+    auto unit = m_units.find(source.string());
+    if (unit == m_units.end() || !unit->second.ok || unit->second.options_hash != options_hash ||
+        unit->second.output != output.string())
+        return false;
+    error_code ec;
+    if (!fs::exists(output, ec))
+        return false;
+
+    // Everything the unit reaches through its includes, each file checked once per run
+    vector<string> pending{source.string()};
+    set<string> visited;
+    while (!pending.empty())
+    {
+        string path = pending.back();
+        pending.pop_back();
+        if (!visited.insert(path).second)
+            continue;
+        if (ownChanged(path))
+            return false;
+        const auto &includes = m_nodes[path].includes;
+        pending.insert(pending.end(), includes.begin(), includes.end());
+    }
+    return true;
+}
+
+void ProjectManifest::scan(const string &path, set<string> &visited)
+{
+    if (!visited.insert(path).second)
+        return;
+    Node &node = m_nodes[path];
+    if (node.state != 3 && (node.state == 2 || ownChanged(path)))
+    {
+        // New or edited: its includes may be different now
+        node.stamp = statFile(path);
+        node.includes.clear();
+        string contents;
+        if (node.stamp.exists && readFile(path, contents))
+        {
+            node.stamp.hash = contentHash(contents);
+            for (const auto &header : resolveIncludes(contents, fs::path(path).parent_path()))
+                node.includes.push_back(header.string());
+        }
+        else
+            node.stamp.exists = false;
+        node.state = 3;
+    }
+    vector<string> includes = m_nodes[path].includes; // m_nodes may grow below
+    for (const auto &header : includes)
+        scan(header, visited);
+}
+
+void ProjectManifest::record(const fs::path &source, const fs::path &output, const string &options_hash, bool ok,
+                             const FileStamp &stamp, const vector<fs::path> &includes)
+{
+    Node &node = m_nodes[source.string()];
+    node.stamp = stamp;
+    node.includes.clear();
+    for (const auto &header : includes)
+        node.includes.push_back(header.string());
+    node.state = 3;
+    m_units[source.string()] = {options_hash, output.string(), ok};
+    m_recorded.insert(source.string());
+
+    set<string> visited{source.string()};
+    vector<string> headers = node.includes;
+    for (const auto &header : headers)
+        scan(header, visited);
+}
+
+void ProjectManifest::endRun()
+{
+    // A unit not transpiled in this run (not among the inputs) that reaches a file that changed must
+    // be rebuilt next time, although that file's stamp is now current.
+    for (auto &unit : m_units)
+    {
+        if (m_recorded.count(unit.first) || !unit.second.ok)
+            continue;
+        vector<string> pending{unit.first};
+        set<string> visited;
+        while (!pending.empty() && unit.second.ok)
+        {
+            string path = pending.back();
+            pending.pop_back();
+            if (!visited.insert(path).second)
+                continue;
+            if (m_changed.count(path))
+                unit.second.ok = false;
+            const auto &includes = m_nodes[path].includes;
+            pending.insert(pending.end(), includes.begin(), includes.end());
+        }
+    }
+}
+
+bool ProjectManifest::save()
+{
+    // Only the files some unit still reaches
+    unordered_map<string, size_t> numbers;
+    vector<string> order;
+    for (const auto &unit : m_units)
+    {
+        vector<string> pending{unit.first};
+        while (!pending.empty())
+        {
+            string path = pending.back();
+            pending.pop_back();
+            if (!numbers.emplace(path, order.size()).second)
+                continue;
+            order.push_back(path);
+            const auto &includes = m_nodes[path].includes;
+            pending.insert(pending.end(), includes.begin(), includes.end());
+        }
+    }
+
+    ostringstream out;
+    out << "# CodeMorph project manifest (transpiler --project): files with <size> <mtime> <hash> <path>,\n";
+    out << "# #include edges between file numbers, and the units built with <options hash> <ok> <output>\n";
+    out << "version " << MANIFEST_VERSION << "\n";
+    for (const auto &path : order)
+    {
+        const FileStamp &stamp = m_nodes[path].stamp;
+        out << "file " << stamp.size << " " << stamp.mtime << " " << (stamp.exists ? stamp.hash : "-") << " " << path << "\n";
+    }
+    for (const auto &path : order)
+    {
+        for (const auto &header : m_nodes[path].includes)
+            out << "include " << numbers[path] << " " << numbers[header] << "\n";
+    }
+    for (const auto &unit : m_units)
+        out << "unit " << numbers[unit.first] << " " << unit.second.options_hash << " " << (unit.second.ok ? 1 : 0) << " "
+            << unit.second.output << "\n";
+
+    random_device random;
+    string temp = m_path + ".tmp-" + to_string(random());
+    {
+        ofstream file(temp, ios::binary);
+        file << out.str();
+        if (!file)
+        {
+            file.close();
+            error_code ec;
+            fs::remove(temp, ec);
+            return false;
+        }
+    }
+    error_code ec;
+    fs::rename(temp, m_path, ec);
+    if (ec)
+    {
+        fs::remove(temp, ec);
+        return false;
+    }
+    return true;
+}
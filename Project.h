@@ -0,0 +1,90 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+using namespace std;
+
+// --- Project mode (batch mode with --project=MANIFEST) ---
+// Incremental builds of multi-file projects: the manifest remembers, from one run to the next, every
+// file involved (sources and the headers they #include with quotes, transitively) with a stamp, the
+// include edges between them, and for each translation unit the options it was transpiled with and
+// where its Python went. A unit is transpiled again only if its source, one of the headers it
+// reaches, the options, the transpiler build or the output path changed, or its output is gone; all
+// other units cost a few stat() calls. On disk the manifest is text:
+//   file <size> <mtime> <content hash, - if missing> <path>    numbered from 0 in order of appearance
+//   include <file number> <file number>                       "the first #includes the second"
+//   unit <file number> <options hash> <ok 0|1> <output path>
+// Paths are absolute. Lines starting with '#' are comments.
+
+// Size and modification time decide quickly that a file is unchanged; if they differ, the content
+// hash decides (so touching a file, or checking it out again, does not rebuild anything).
+struct FileStamp
+{
+    bool exists = false;
+    unsigned long long size = 0;
+    long long mtime = 0; // file_time_type ticks
+    string hash;         // contentHash of the bytes
+};
+
+// Existence, size and time of 'path' now, without the hash. Callers that go on to read the file take
+// this first, so that a write racing the read leaves a stamp that makes the next run look again.
+FileStamp statFile(const filesystem::path &path);
+
+class ProjectManifest
+{
+public:
+    // Loads 'path' if it exists ("" for a manifest kept in memory only). An unreadable or malformed
+    // manifest is treated as empty (everything is rebuilt), with a message in 'problem'.
+    ProjectManifest(const string &path, string &problem);
+
+    // Forgets what was checked in the previous run, for a manifest used by more than one (--watch).
+    void beginRun();
+
+    // Every file the manifest knows (sources and headers, absolute), missing headers included.
+    vector<string> files() const;
+
+    // The options hash a unit records: contentHash of the transpiler build and its options fingerprint.
+    static string optionsHash(const string &options_fingerprint);
+
+    // True if 'source' was transpiled to 'output' successfully with 'options_hash', and neither it nor
+    // anything it includes changed since. Not thread-safe.
+    bool upToDate(const filesystem::path &source, const filesystem::path &output, const string &options_hash);
+
+    // Records a unit transpiled in this run: 'stamp' is that of the source as it was read, 'includes'
+    // what resolveIncludes found in it. Rescans the headers it reaches. Not thread-safe.
+    void record(const filesystem::path &source, const filesystem::path &output, const string &options_hash, bool ok,
+                const FileStamp &stamp, const vector<filesystem::path> &includes);
+
+    // After the record() calls of a run: invalidates the units that were not transpiled in it but
+    // reach a file that changed.
+    void endRun();
+
+    // Writes the manifest (to a temporary file renamed into place). False if it could not be written.
+    bool save();
+
+private:
+    struct Node
+    {
+        FileStamp stamp;
+        vector<string> includes;
+        int state = 0; // This run: 0 not looked at, 1 unchanged, 2 changed, 3 rescanned (stamp and includes current)
+    };
+    struct Unit
+    {
+        string options_hash;
+        string output;
+        bool ok = false;
+    };
+
+    bool ownChanged(const string &path); // The file itself, not what it includes
+    void scan(const string &path, set<string> &visited);
+
+    string m_path;
+    map<string, Node> m_nodes; // By absolute path
+    map<string, Unit> m_units; // By source path
+    set<string> m_changed;     // Files found changed (or new) in this run
+    set<string> m_recorded;    // Units transpiled in this run
+};
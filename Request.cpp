@@ -0,0 +1,172 @@
+#include "Request.h"
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+
+PipelineResult runPipeline(const string &source, const TranspilerOptions &options, const EmitSections &emit,
+                           MacroTranslationCache *macro_cache, ostringstream &messages, TranspileStats *stats)
+{
+    PipelineResult result;
+    messages.str("");
+    messages.clear();
+    PhaseTimer timer(stats != nullptr);
+    auto phaseDone = [&](const char *name)
+    {
+        if (stats)
+            stats->add(timer.lap(name));
+    };
+    try
+    {
+        Lexer lexer(source);
+        lexer.setDiagnostics(messages);
+        PhaseStats preprocess{"preprocess"};
+        if (stats)
+            lexer.setPreprocessStats(&preprocess);
+        vector<Token> tokens = lexer.tokenize();
+        const auto &macros = lexer.getDefinedMacros();
+        if (stats)
+        {
+            PhaseStats lex = timer.lap("lex"); // The #define lines are in 'preprocess'
+            lex.wall_ms -= preprocess.wall_ms;
+            lex.cpu_ms -= preprocess.cpu_ms;
+            stats->add(lex);
+            stats->add(preprocess);
+            stats->tokens = (long long)tokens.size();
+            stats->macros = (long long)macros.size();
+        }
+        if (emit.tokens)
+            result.tokens = tokensJson(tokens);
+        if (emit.macros)
+            result.macros = macrosJson(macros);
+        if (emit.tokens || emit.macros)
+            phaseDone("emit");
+
+        Parser parser(tokens);
+        parser.setDiagnostics(messages);
+        parser.defineMacros(macros);
+        phaseDone("preprocess");
+        shared_ptr<ProgramNode> program = parser.parse();
+        phaseDone("parse");
+        if (stats)
+        {
+            stats->countAst(program);
+            timer.lap(""); // Counting is not parsing
+        }
+        if (emit.ast)
+        {
+            result.ast = astJson(program);
+            phaseDone("emit");
+        }
+
+        if (emit.python || options.lint)
+        {
+            Transpiler transpiler(options);
+            transpiler.setDiagnostics(messages);
+            transpiler.setMacroCache(macro_cache);
+            transpiler.setStats(stats);
+            try
+            {
+                result.python = transpiler.transpile(program, macros);
+                result.completed = true;
+                if (stats)
+                    stats->countOutput(result.python);
+            }
+            catch (const std::exception &e)
+            {
+                messages << "Transpilation Error: " << e.what() << endl;
+            }
+            transpiler.writeInfoMessages(messages);
+            result.lint = transpiler.getLintWarnings();
+            stable_sort(result.lint.begin(), result.lint.end(), [](const LintWarning &a, const LintWarning &b)
+                        { return a.line < b.line; });
+        }
+    }
+    catch (const std::exception &e)
+    {
+        messages << "Lexical Error: " << e.what() << endl;
+        result.status = 1;
+    }
+
+    istringstream lines(messages.str());
+    string message;
+    while (getline(lines, message))
+    {
+        if (!message.empty())
+            result.messages.push_back(message);
+    }
+    return result;
+}
+
+string lintJson(const LintWarning &warning)
+{
+    return "{\"severity\": \"warning\", \"source\": \"Lint\", \"line\": " + to_string(warning.line) +
+           ", \"message\": " + jsonString(warning.message) + ", \"rule\": " + jsonString(warning.rule) +
+           ", \"cost\": " + to_string(warning.cost) + "}";
+}
+
+string TranspileResult::diagnosticsJson() const
+{
+    string json = "[";
+    for (size_t i = 0; i < diagnostics.size(); ++i)
+        json += (i == 0 ? "" : ",\n ") + diagnostics[i];
+    return json + "]";
+}
+
+string TranspileResult::frames() const
+{
+    ostringstream out;
+    writeFrame(out, "protocol", "{\"version\": 1}");
+    if (emit.tokens && !tokens.empty())
+        writeFrame(out, "tokens", tokens);
+    if (emit.macros && !macros.empty())
+        writeFrame(out, "macros", macros);
+    if (emit.ast && !ast.empty())
+        writeFrame(out, "ast", ast);
+    if (emit.python && status == 0)
+        writeFrame(out, "python", python);
+    for (const auto &record : diagnostics)
+        writeFrame(out, "diagnostic", record);
+    return out.str();
+}
+
+TranspileResult transpileRequest(const string &source, const string &options_text, const TranspilerOptions &defaults,
+                                 MacroTranslationCache *macro_cache)
+{
+    TranspileResult result;
+    TranspilerOptions options = defaults;
+    try
+    {
+        istringstream lines(options_text);
+        string option;
+        while (getline(lines, option))
+        {
+            if (option.empty())
+                continue;
+            if (option == "--lint" || option == "--lint=text" || option == "--lint=json")
+                options.lint = true;
+            else if (option.rfind("--emit=", 0) == 0)
+                result.emit = parseEmitSections(option.substr(7));
+            else if (!parseTranspilerOption(option, options))
+                throw invalid_argument(option);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        result.diagnostics.push_back(diagnosticJson(string("Request Error: unknown or malformed option: ") + e.what()));
+        result.status = 1;
+        return result;
+    }
+
+    ostringstream messages;
+    PipelineResult pipeline = runPipeline(source, options, result.emit, macro_cache, messages);
+    result.status = pipeline.status;
+    result.tokens = move(pipeline.tokens);
+    result.macros = move(pipeline.macros);
+    result.ast = move(pipeline.ast);
+    result.python = move(pipeline.python);
+    for (const auto &message : pipeline.messages)
+        result.diagnostics.push_back(diagnosticJson(message));
+    for (const auto &warning : pipeline.lint)
+        result.diagnostics.push_back(lintJson(warning));
+    return result;
+}
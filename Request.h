@@ -0,0 +1,57 @@
+#pragma once
+
+#include "transpiler.h" // TranspilerOptions, MacroTranslationCache
+#include "Frames.h"     // EmitSections
+#include <string>
+#include <sstream>
+#include <vector>
+using namespace std;
+
+// --- One transpilation as a service call ---
+// Shared by the daemon (--serve, Server.h) and the in-process library (libcodemorph, codemorph.h):
+// source and options in, the requested sections and the diagnostics out, nothing on stdout/stderr.
+
+// The pipeline behind every mode that transpiles a buffer without printing (the daemon, the library,
+// batch mode and the result cache): lexer, parser and, when Python or lint warnings are wanted, the
+// transpiler, with the messages the single-file mode would write to stderr collected as lines.
+struct PipelineResult
+{
+    int status = 0;         // 1 if lexing failed (the message says why); nothing else is filled in then
+    bool completed = false; // The transpiler ran without throwing (false too when it was not needed)
+    string tokens;          // JSON sections (Frames.h), only those requested
+    string macros;
+    string ast;
+    string python;
+    vector<string> messages;     // stderr lines, in order (Info messages included)
+    vector<LintWarning> lint;    // With options.lint, sorted by C line
+};
+
+// 'messages' is scratch space for the diagnostics stream; callers transpiling many buffers pass the
+// same one each time to reuse its allocation. With 'stats' (--stats), the lex, preprocess, parse and
+// pass phases are added to it, the JSON sections as emit, and the token, macro, AST node and output
+// counts are filled in; reading the source and writing the results are the caller's to add.
+PipelineResult runPipeline(const string &source, const TranspilerOptions &options, const EmitSections &emit,
+                           MacroTranslationCache *macro_cache, ostringstream &messages, TranspileStats *stats = nullptr);
+
+// Diagnostic record of a lint warning: {"severity": "warning", "source": "Lint", ..., "rule": ..., "cost": N}.
+string lintJson(const LintWarning &warning);
+
+struct TranspileResult
+{
+    int status = 0; // 0, or 1 if the options were malformed or lexing failed
+    EmitSections emit; // Which of the sections below were requested (the others are empty)
+    string tokens;     // JSON, see Frames.h
+    string macros;     // JSON
+    string ast;        // JSON
+    string python;
+    vector<string> diagnostics; // JSON records (Frames.h), in order
+
+    string diagnosticsJson() const; // The records as one JSON array
+    string frames() const;          // --framed output without the end frame
+};
+
+// Transpiles 'source'. 'options_text' holds transpiler options, one per line (--char-as-int,
+// --inline-budget=N, --abi=..., --lint, --emit=SECTIONS), applied on top of 'defaults'. The
+// macro cache, if given, must only be shared between calls with the same defaults and options.
+TranspileResult transpileRequest(const string &source, const string &options_text, const TranspilerOptions &defaults,
+                                 MacroTranslationCache *macro_cache);
@@ -0,0 +1,307 @@
+#include "Server.h"
+#include "Request.h"
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <list>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <unordered_map>
+#include <stdexcept>
+#include <cstring>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <csignal>
+#include <cerrno>
+#endif
+
+namespace
+{
+    // State shared by all connections.
+    class ServerState
+    {
+    public:
+        explicit ServerState(const TranspilerOptions &defaults) : m_defaults(defaults) {}
+
+        const TranspilerOptions &defaults() const { return m_defaults; }
+
+        MacroTranslationCache &macroCache(const string &options_text)
+        {
+            lock_guard<mutex> guard(m_lock);
+            auto &cache = m_macro_caches[options_text];
+            if (!cache)
+                cache = make_unique<MacroTranslationCache>();
+            return *cache;
+        }
+
+        // Answer frames (without the end frame) and status of an earlier identical request.
+        bool findResponse(const string &key, string &frames, int &status)
+        {
+            lock_guard<mutex> guard(m_lock);
+            m_requests++;
+            auto it = m_responses.find(key);
+            if (it == m_responses.end())
+                return false;
+            m_lru.splice(m_lru.begin(), m_lru, it->second);
+            frames = it->second->frames;
+            status = it->second->status;
+            m_response_hits++;
+            return true;
+        }
+
+        void storeResponse(const string &key, const string &frames, int status)
+        {
+            lock_guard<mutex> guard(m_lock);
+            if (m_responses.count(key))
+                return;
+            m_lru.push_front({key, frames, status});
+            m_responses[key] = m_lru.begin();
+            if (m_lru.size() > RESPONSE_CACHE_SIZE)
+            {
+                m_responses.erase(m_lru.back().key);
+                m_lru.pop_back();
+            }
+        }
+
+        string statsJson()
+        {
+            lock_guard<mutex> guard(m_lock);
+            long long macro_hits = 0;
+            for (auto &cache : m_macro_caches)
+                macro_hits += cache.second->hits();
+            return "{\"requests\": " + to_string(m_requests) + ", \"response_cache_hits\": " + to_string(m_response_hits) +
+                   ", \"macro_cache_hits\": " + to_string(macro_hits) + "}";
+        }
+
+    private:
+        static const size_t RESPONSE_CACHE_SIZE = 128;
+        struct Response
+        {
+            string key;
+            string frames;
+            int status;
+        };
+
+        TranspilerOptions m_defaults;
+        mutex m_lock;
+        unordered_map<string, unique_ptr<MacroTranslationCache>> m_macro_caches; // By options text
+        list<Response> m_lru; // Most recently used first
+        unordered_map<string, list<Response>::iterator> m_responses;
+        long long m_requests = 0;
+        long long m_response_hits = 0;
+    };
+
+#ifndef _WIN32
+    // Reads frames from a connected socket.
+    class FrameReader
+    {
+    public:
+        explicit FrameReader(int fd) : m_fd(fd) {}
+
+        // False at end of stream or on a malformed frame.
+        bool read(string &kind, string &payload)
+        {
+            size_t header_end;
+            while ((header_end = m_buffer.find('\n', m_start)) == string::npos)
+            {
+                if (!fill())
+                    return false;
+            }
+            string header = m_buffer.substr(m_start, header_end - m_start);
+            size_t space = header.find(' ');
+            if (space == string::npos)
+                return false;
+            kind = header.substr(0, space);
+            size_t length;
+            try
+            {
+                length = stoul(header.substr(space + 1));
+            }
+            catch (const std::exception &)
+            {
+                return false;
+            }
+            size_t payload_start = header_end + 1;
+            while (m_buffer.size() < payload_start + length + 1)
+            {
+                if (!fill())
+                    return false;
+            }
+            payload = m_buffer.substr(payload_start, length);
+            m_start = payload_start + length + 1;
+            if (m_start > 65536) // Drop consumed bytes now and then
+            {
+                m_buffer.erase(0, m_start);
+                m_start = 0;
+            }
+            return true;
+        }
+
+    private:
+        bool fill()
+        {
+            char chunk[65536];
+            ssize_t received;
+            do
+                received = recv(m_fd, chunk, sizeof(chunk), 0);
+            while (received < 0 && errno == EINTR);
+            if (received <= 0)
+                return false;
+            m_buffer.append(chunk, (size_t)received);
+            return true;
+        }
+
+        int m_fd;
+        string m_buffer;
+        size_t m_start = 0;
+    };
+
+    bool sendAll(int fd, const string &data)
+    {
+        size_t sent = 0;
+        while (sent < data.size())
+        {
+            ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            sent += (size_t)n;
+        }
+        return true;
+    }
+
+    void serveConnection(int fd, ServerState &state)
+    {
+        FrameReader reader(fd);
+        string kind, payload;
+        string options_text, emit_text;
+        while (reader.read(kind, payload))
+        {
+            if (kind == "options")
+                options_text = payload;
+            else if (kind == "emit")
+                emit_text = payload;
+            else if (kind == "source" || kind == "stats")
+            {
+                auto start = chrono::steady_clock::now();
+                string frames;
+                int status = 0;
+                bool cached = false;
+                if (kind == "stats")
+                {
+                    ostringstream out;
+                    writeFrame(out, "stats", state.statsJson());
+                    frames = out.str();
+                }
+                else
+                {
+                    string key = options_text + '\0' + emit_text + '\0' + payload;
+                    cached = state.findResponse(key, frames, status);
+                    if (!cached)
+                    {
+                        string request_options = options_text;
+                        if (!emit_text.empty())
+                            request_options += "\n--emit=" + emit_text;
+                        TranspileResult result = transpileRequest(payload, request_options, state.defaults(), &state.macroCache(options_text));
+                        frames = result.frames();
+                        status = result.status;
+                        state.storeResponse(key, frames, status);
+                    }
+                }
+                long long microseconds = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+                ostringstream end;
+                writeFrame(end, "end", "{\"status\": " + to_string(status) + ", \"cached\": " + (cached ? "true" : "false") +
+                                           ", \"microseconds\": " + to_string(microseconds) + "}");
+                if (!sendAll(fd, frames + end.str()))
+                    break;
+                // The next request starts from scratch
+                options_text.clear();
+                emit_text.clear();
+            }
+            else
+            {
+                ostringstream out;
+                writeFrame(out, "diagnostic", diagnosticJson("Server Error: unknown request frame '" + kind + "'"));
+                writeFrame(out, "end", "{\"status\": 1, \"cached\": false, \"microseconds\": 0}");
+                if (!sendAll(fd, out.str()))
+                    break;
+            }
+        }
+        close(fd);
+    }
+#endif
+}
+
+int runServer(const string &socket_path, const TranspilerOptions &defaults, ostream &log)
+{
+#ifdef _WIN32
+    log << "--serve is only available on systems with Unix domain sockets" << endl;
+    return 1;
+#else
+    sockaddr_un address{};
+    if (socket_path.size() >= sizeof(address.sun_path))
+    {
+        log << "Server Error: socket path too long: " << socket_path << endl;
+        return 1;
+    }
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+    {
+        log << "Server Error: socket: " << strerror(errno) << endl;
+        return 1;
+    }
+    // A socket file left behind by an earlier server is replaced; anything else at that path is kept.
+    struct stat existing;
+    if (lstat(socket_path.c_str(), &existing) == 0)
+    {
+        if (!S_ISSOCK(existing.st_mode))
+        {
+            log << "Server Error: " << socket_path << " exists and is not a socket" << endl;
+            close(listener);
+            return 1;
+        }
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool answered = probe >= 0 && connect(probe, (sockaddr *)&address, sizeof(address)) == 0;
+        if (probe >= 0)
+            close(probe);
+        if (answered)
+        {
+            log << "Server Error: another server is listening on " << socket_path << endl;
+            close(listener);
+            return 1;
+        }
+        unlink(socket_path.c_str());
+    }
+    if (bind(listener, (sockaddr *)&address, sizeof(address)) < 0 || listen(listener, 64) < 0)
+    {
+        log << "Server Error: cannot listen on " << socket_path << ": " << strerror(errno) << endl;
+        close(listener);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    log << "Server: listening on " << socket_path << endl;
+
+    ServerState state(defaults);
+    while (true)
+    {
+        int client = accept(listener, nullptr, nullptr);
+        if (client < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            log << "Server Error: accept: " << strerror(errno) << endl;
+            close(listener);
+            return 1;
+        }
+        thread(serveConnection, client, ref(state)).detach();
+    }
+#endif
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "transpiler.h" // TranspilerOptions
+#include <iostream>
+#include <string>
+using namespace std;
+
+// --- Daemon mode (--serve=SOCKET) ---
+// Listens on a Unix domain socket and transpiles for any number of clients, each connection carrying
+// any number of requests, so a front end like gui.py pays neither process start-up nor cold caches
+// per click. Requests and responses use the frame syntax of --framed (Frames.h):
+//   <kind> <length>\n<payload of exactly length bytes>\n
+// A request is a few frames, the last of which triggers the answer:
+//   options  transpiler options, one per line (--char-as-int, --inline-budget=N, --abi=..., --lint, ...);
+//            applied on top of the options the server was started with. Optional.
+//   emit     sections to answer with, as for --emit: "tokens,macros,ast,python". Optional (python).
+//   source   the C code. Ends the request; the answer is what --framed prints (protocol, sections,
+//            diagnostics), closed by an end frame {"status": N, "cached": true|false, "microseconds": N}.
+//   stats    ends a request too; answered with a stats frame
+//            {"requests": N, "response_cache_hits": N, "macro_cache_hits": N} and an end frame.
+// Warm state kept between requests:
+//   - the answers to the last 128 distinct requests (same source, options and sections: no work at all);
+//   - per set of options, the Python translations of the 4096 macro bodies used most recently.
+// A socket file at SOCKET is only replaced if no server answers on it; any other file is left alone.
+
+// Serves until the process is killed. Returns 1 (after a message on 'log') if the socket cannot be set up.
+int runServer(const string &socket_path, const TranspilerOptions &defaults, ostream &log);
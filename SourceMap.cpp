@@ -0,0 +1,225 @@
+#include "SourceMap.h"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <map>
+#include <algorithm>
+#include <cstdio>
+
+int SourceMap::cLine(int python_line) const
+{
+    if (python_line < 1 || python_line > (int)c_lines.size())
+        return 0;
+    return c_lines[python_line - 1];
+}
+
+string SourceMap::serialize() const
+{
+    ostringstream out;
+    out << "# C-to-Python source map: <first Python line> <lines> <C line>\n";
+    out << "c " << c_file << "\n";
+    out << "py " << python_file << "\n";
+    for (size_t first = 0; first < c_lines.size();)
+    {
+        size_t last = first;
+        while (last + 1 < c_lines.size() && c_lines[last + 1] == c_lines[first])
+            last++;
+        if (c_lines[first] != 0)
+            out << first + 1 << " " << last - first + 1 << " " << c_lines[first] << "\n";
+        first = last + 1;
+    }
+    return out.str();
+}
+
+SourceMap readSourceMap(const string &path)
+{
+    ifstream file(path);
+    if (!file)
+        throw runtime_error("Cannot open source map: " + path);
+    SourceMap map;
+    string line;
+    int line_number = 0;
+    while (getline(file, line))
+    {
+        line_number++;
+        if (line.empty() || line[0] == '#')
+            continue;
+        if (line.rfind("c ", 0) == 0)
+        {
+            map.c_file = line.substr(2);
+            continue;
+        }
+        if (line.rfind("py ", 0) == 0)
+        {
+            map.python_file = line.substr(3);
+            continue;
+        }
+        istringstream fields(line);
+        int first, count, c_line;
+        if (!(fields >> first >> count >> c_line) || first < 1 || count < 1)
+            throw runtime_error("Malformed source map line " + to_string(line_number) + " in " + path + ": " + line);
+        if ((int)map.c_lines.size() < first + count - 1)
+            map.c_lines.resize(first + count - 1, 0);
+        fill(map.c_lines.begin() + (first - 1), map.c_lines.begin() + (first - 1 + count), c_line);
+    }
+    return map;
+}
+
+static string baseName(const string &path)
+{
+    size_t slash = path.find_last_of("/\\");
+    return slash == string::npos ? path : path.substr(slash + 1);
+}
+
+// "file.py:12" -> C location "input.c:7"; "" if the file is not the mapped Python file or the line is unmapped.
+static string cLocation(const SourceMap &map, const string &file, const string &line_text)
+{
+    if (baseName(file) != baseName(map.python_file))
+        return "";
+    int c_line = 0;
+    try
+    {
+        c_line = map.cLine(stoi(line_text));
+    }
+    catch (const std::exception &)
+    {
+        return "";
+    }
+    return c_line > 0 ? map.c_file + ":" + to_string(c_line) : "";
+}
+
+// pstats rows: ncalls tottime percall cumtime percall filename:lineno(function)
+static string translatePstats(const SourceMap &map, const vector<string> &lines, size_t header)
+{
+    struct Row
+    {
+        long long calls = 0, primitive_calls = 0;
+        double tottime = 0, cumtime = 0;
+    };
+    vector<string> order;
+    std::map<string, Row> rows;
+    string out;
+    for (size_t k = 0; k <= header; ++k)
+        out += lines[k] + "\n";
+    for (size_t k = header + 1; k < lines.size(); ++k)
+    {
+        istringstream fields(lines[k]);
+        string ncalls, tottime, percall, cumtime, percall2, location;
+        if (!(fields >> ncalls >> tottime >> percall >> cumtime >> percall2) || !getline(fields, location))
+        {
+            if (!lines[k].empty())
+                out += lines[k] + "\n"; // Not a row: keep as is
+            continue;
+        }
+        location.erase(0, location.find_first_not_of(' '));
+        // file:line(function) of the mapped Python file -> C file:line(function)
+        size_t paren = location.rfind('(');
+        size_t colon = paren == string::npos ? string::npos : location.rfind(':', paren);
+        if (colon != string::npos && location[0] != '{')
+        {
+            string c_location = cLocation(map, location.substr(0, colon), location.substr(colon + 1, paren - colon - 1));
+            if (!c_location.empty())
+                location = c_location + location.substr(paren);
+        }
+        Row row;
+        size_t slash = ncalls.find('/'); // "total/primitive" for recursive functions
+        try
+        {
+            row.calls = stoll(ncalls.substr(0, slash));
+            row.primitive_calls = slash == string::npos ? row.calls : stoll(ncalls.substr(slash + 1));
+            row.tottime = stod(tottime);
+            row.cumtime = stod(cumtime);
+        }
+        catch (const std::exception &)
+        {
+            out += lines[k] + "\n";
+            continue;
+        }
+        if (!rows.count(location))
+            order.push_back(location);
+        Row &total = rows[location];
+        total.calls += row.calls;
+        total.primitive_calls += row.primitive_calls;
+        total.tottime += row.tottime;
+        total.cumtime += row.cumtime;
+    }
+
+    stable_sort(order.begin(), order.end(), [&rows](const string &a, const string &b)
+                { return rows[a].tottime > rows[b].tottime; });
+    for (const auto &location : order)
+    {
+        const Row &row = rows[location];
+        string ncalls = to_string(row.calls);
+        if (row.primitive_calls != row.calls)
+            ncalls += "/" + to_string(row.primitive_calls);
+        char buffer[128];
+        snprintf(buffer, sizeof(buffer), "%9s %8.3f %8.3f %8.3f %8.3f ", ncalls.c_str(), row.tottime,
+                 row.calls ? row.tottime / row.calls : 0.0, row.cumtime,
+                 row.primitive_calls ? row.cumtime / row.primitive_calls : 0.0);
+        out += buffer + location + "\n";
+    }
+    return out;
+}
+
+// py-spy collapsed stacks: "frame;frame;... count", each frame "function (file.py:line)".
+static string translateCollapsed(const SourceMap &map, const vector<string> &lines)
+{
+    vector<string> order;
+    std::map<string, long long> counts;
+    for (const auto &line : lines)
+    {
+        size_t space = line.find_last_of(' ');
+        if (line.empty() || space == string::npos)
+            continue;
+        long long count;
+        try
+        {
+            count = stoll(line.substr(space + 1));
+        }
+        catch (const std::exception &)
+        {
+            continue;
+        }
+        string stack;
+        istringstream frames(line.substr(0, space));
+        string frame;
+        while (getline(frames, frame, ';'))
+        {
+            size_t open = frame.rfind(" (");
+            size_t colon = frame.rfind(':');
+            if (open != string::npos && colon != string::npos && colon > open && frame.back() == ')')
+            {
+                string c_location = cLocation(map, frame.substr(open + 2, colon - open - 2),
+                                              frame.substr(colon + 1, frame.size() - colon - 2));
+                if (!c_location.empty())
+                    frame = frame.substr(0, open) + " (" + c_location + ")";
+            }
+            stack += (stack.empty() ? "" : ";") + frame;
+        }
+        if (!counts.count(stack))
+            order.push_back(stack);
+        counts[stack] += count;
+    }
+    string out;
+    for (const auto &stack : order)
+        out += stack + " " + to_string(counts[stack]) + "\n";
+    return out;
+}
+
+string translateProfileReport(const SourceMap &map, istream &report)
+{
+    vector<string> lines;
+    string line;
+    while (getline(report, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        lines.push_back(line);
+    }
+    for (size_t k = 0; k < lines.size(); ++k)
+    {
+        if (lines[k].find("ncalls") != string::npos && lines[k].find("filename:lineno(function)") != string::npos)
+            return translatePstats(map, lines, k);
+    }
+    return translateCollapsed(map, lines);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <istream>
+using namespace std;
+
+// Which C line each line of the generated Python comes from (--source-map).
+// On disk the map is run-length encoded text:
+//   c <C file name>
+//   py <Python file name>
+//   <first Python line> <number of lines> <C line>     one line per run, runs of C line 0 omitted
+// Lines starting with '#' are comments.
+struct SourceMap
+{
+    string c_file;
+    string python_file;
+    vector<int> c_lines; // c_lines[n - 1]: C line of Python line n (0: generated helper code)
+
+    int cLine(int python_line) const;
+    string serialize() const;
+};
+
+// Reads a map written by serialize(); throws runtime_error if it cannot be opened or is malformed.
+SourceMap readSourceMap(const string &path);
+
+// Rewrites a profiler report about the generated Python so that it points at the C source:
+// cProfile/pstats text output (print_stats) or py-spy collapsed stacks (--format raw).
+// Entries that map to the same C location are merged and their costs added up.
+string translateProfileReport(const SourceMap &map, istream &report);
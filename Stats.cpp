@@ -0,0 +1,262 @@
+#include "Stats.h"
+#include "Parser.h" // ASTNode, forEachChild
+#include "Frames.h" // jsonString
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+    // Order of the phases in a report: pipeline order, the passes in the order they ran.
+    int phaseRank(const string &name)
+    {
+        if (name == "read")
+            return 0;
+        if (name == "cache")
+            return 1;
+        if (name == "lex")
+            return 2;
+        if (name == "preprocess")
+            return 3;
+        if (name == "parse")
+            return 4;
+        if (name.rfind("pass:", 0) == 0)
+            return 5;
+        return 6; // emit
+    }
+
+    string number(double value, int decimals = 3)
+    {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+        return buffer;
+    }
+
+    double perSecond(long long count, double milliseconds)
+    {
+        return milliseconds > 0 ? count * 1000.0 / milliseconds : 0;
+    }
+
+    double wallMilliseconds()
+    {
+        return chrono::duration<double, milli>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+double threadCpuMilliseconds()
+{
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user))
+        return 0;
+    auto ticks = [](const FILETIME &time) { return ((unsigned long long)time.dwHighDateTime << 32) | time.dwLowDateTime; };
+    return (ticks(kernel) + ticks(user)) / 10000.0; // 100 ns units
+#else
+    timespec now;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) != 0)
+        return 0;
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+#endif
+}
+
+long long peakRssKilobytes()
+{
+#ifdef _WIN32
+    return 0; // Would need psapi (GetProcessMemoryInfo)
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024; // Bytes there
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+PhaseTimer::PhaseTimer(bool enabled) : m_enabled(enabled)
+{
+    if (!enabled)
+        return;
+    m_wall_start = wallMilliseconds();
+    m_cpu_start = threadCpuMilliseconds();
+}
+
+PhaseStats PhaseTimer::lap(const string &name)
+{
+    PhaseStats phase;
+    phase.name = name;
+    if (!m_enabled)
+        return phase;
+    double wall = wallMilliseconds();
+    double cpu = threadCpuMilliseconds();
+    phase.wall_ms = wall - m_wall_start;
+    phase.cpu_ms = cpu - m_cpu_start;
+    phase.peak_rss_kb = peakRssKilobytes();
+    m_wall_start = wall;
+    m_cpu_start = cpu;
+    return phase;
+}
+
+PhaseStats *TranspileStats::find(const string &name)
+{
+    for (auto &phase : phases)
+    {
+        if (phase.name == name)
+            return &phase;
+    }
+    return nullptr;
+}
+
+void TranspileStats::add(const PhaseStats &phase)
+{
+    if (PhaseStats *known = find(phase.name))
+    {
+        known->wall_ms += phase.wall_ms;
+        known->cpu_ms += phase.cpu_ms;
+        known->peak_rss_kb = max(known->peak_rss_kb, phase.peak_rss_kb);
+        return;
+    }
+    int rank = phaseRank(phase.name);
+    auto position = find_if(phases.begin(), phases.end(), [rank](const PhaseStats &other)
+                            { return phaseRank(other.name) > rank; });
+    phases.insert(position, phase);
+}
+
+void TranspileStats::countSource(const string &source)
+{
+    source_bytes = (long long)source.size();
+    source_lines = (long long)count(source.begin(), source.end(), '\n') + (!source.empty() && source.back() != '\n');
+}
+
+void TranspileStats::countAst(const shared_ptr<ASTNode> &program)
+{
+    function<void(const shared_ptr<ASTNode> &)> visit = [&](const shared_ptr<ASTNode> &node)
+    {
+        if (!node)
+            return;
+        ast_nodes++;
+        ast_nodes_by_kind[node->type_name.empty() ? "ASTNode" : node->type_name]++;
+        forEachChild(node, visit);
+    };
+    visit(program);
+}
+
+void TranspileStats::countOutput(const string &python)
+{
+    // As written: the Python and a final newline
+    output_bytes = (long long)python.size() + 1;
+    output_lines = (long long)count(python.begin(), python.end(), '\n') + 1;
+}
+
+void TranspileStats::merge(const TranspileStats &other)
+{
+    files += other.files;
+    cached += other.cached;
+    source_bytes += other.source_bytes;
+    source_lines += other.source_lines;
+    tokens += other.tokens;
+    macros += other.macros;
+    ast_nodes += other.ast_nodes;
+    for (const auto &kind : other.ast_nodes_by_kind)
+        ast_nodes_by_kind[kind.first] += kind.second;
+    output_bytes += other.output_bytes;
+    output_lines += other.output_lines;
+    for (const auto &phase : other.phases)
+        add(phase);
+}
+
+string TranspileStats::json(bool total) const
+{
+    double wall = 0, cpu = 0;
+    long long peak = 0;
+    string phases_json;
+    for (const auto &phase : phases)
+    {
+        wall += phase.wall_ms;
+        cpu += phase.cpu_ms;
+        peak = max(peak, phase.peak_rss_kb);
+        phases_json += string(phases_json.empty() ? "" : ", ") + "{\"name\": " + jsonString(phase.name) +
+                       ", \"wall_ms\": " + number(phase.wall_ms) + ", \"cpu_ms\": " + number(phase.cpu_ms) +
+                       ", \"peak_rss_kb\": " + to_string(phase.peak_rss_kb) + "}";
+    }
+    string kinds_json;
+    for (const auto &kind : ast_nodes_by_kind)
+        kinds_json += string(kinds_json.empty() ? "" : ", ") + jsonString(kind.first) + ": " + to_string(kind.second);
+    auto phaseWall = [this](const string &name)
+    {
+        for (const auto &phase : phases)
+        {
+            if (phase.name == name)
+                return phase.wall_ms;
+        }
+        return 0.0;
+    };
+
+    return "{\"file\": " + (total ? string("null") : jsonString(file)) + ", \"files\": " + to_string(files) +
+           ", \"cached\": " + to_string(cached) +
+           ", \"source_bytes\": " + to_string(source_bytes) + ", \"source_lines\": " + to_string(source_lines) +
+           ", \"tokens\": " + to_string(tokens) + ", \"macros\": " + to_string(macros) +
+           ", \"ast_nodes\": " + to_string(ast_nodes) + ", \"ast_nodes_by_kind\": {" + kinds_json + "}" +
+           ", \"output_bytes\": " + to_string(output_bytes) + ", \"output_lines\": " + to_string(output_lines) +
+           ", \"phases\": [" + phases_json + "]" +
+           ", \"total\": {\"wall_ms\": " + number(wall) + ", \"cpu_ms\": " + number(cpu) + ", \"peak_rss_kb\": " + to_string(peak) + "}" +
+           ", \"throughput\": {\"source_bytes_per_s\": " + number(perSecond(source_bytes, wall), 0) +
+           ", \"tokens_per_s\": " + number(perSecond(tokens, phaseWall("lex")), 0) +
+           ", \"ast_nodes_per_s\": " + number(perSecond(ast_nodes, phaseWall("parse")), 0) +
+           ", \"output_bytes_per_s\": " + number(perSecond(output_bytes, wall), 0) + "}}";
+}
+
+string TranspileStats::text(bool total) const
+{
+    string out = "Stats: ";
+    out += total ? to_string(files) + " file" + (files == 1 ? "" : "s") : (file.empty() ? "<stdin>" : file);
+    if (cached > 0)
+        out += total ? " (" + to_string(cached) + " from the cache)" : " (from the cache)";
+    out += ": " + to_string(source_bytes) + " bytes, " + to_string(source_lines) + " lines, " + to_string(tokens) +
+           " tokens, " + to_string(macros) + " macros, " + to_string(ast_nodes) + " AST nodes -> " +
+           to_string(output_bytes) + " bytes of Python (" + to_string(output_lines) + " lines)\n";
+
+    char row[128];
+    snprintf(row, sizeof(row), "  %-18s %12s %12s %14s\n", "phase", "wall ms", "cpu ms", "peak RSS KB");
+    out += row;
+    double wall = 0, cpu = 0, lex = 0, parse = 0;
+    long long peak = 0;
+    for (const auto &phase : phases)
+    {
+        snprintf(row, sizeof(row), "  %-18s %12.3f %12.3f %14lld\n", phase.name.c_str(), phase.wall_ms, phase.cpu_ms, phase.peak_rss_kb);
+        out += row;
+        wall += phase.wall_ms;
+        cpu += phase.cpu_ms;
+        peak = max(peak, phase.peak_rss_kb);
+        if (phase.name == "lex")
+            lex = phase.wall_ms;
+        else if (phase.name == "parse")
+            parse = phase.wall_ms;
+    }
+    snprintf(row, sizeof(row), "  %-18s %12.3f %12.3f %14lld\n", "total", wall, cpu, peak);
+    out += row;
+    out += "  throughput: " + number(perSecond(source_bytes, wall) / 1e6, 2) + " MB/s of source, " +
+           number(perSecond(tokens, lex), 0) + " tokens/s (lex), " + number(perSecond(ast_nodes, parse), 0) +
+           " AST nodes/s (parse)\n";
+
+    if (!ast_nodes_by_kind.empty())
+    {
+        vector<pair<string, long long>> kinds(ast_nodes_by_kind.begin(), ast_nodes_by_kind.end());
+        stable_sort(kinds.begin(), kinds.end(), [](const pair<string, long long> &a, const pair<string, long long> &b)
+                    { return a.second > b.second; });
+        out += "  AST nodes:";
+        for (size_t i = 0; i < kinds.size(); ++i)
+            out += (i == 0 ? " " : ", ") + kinds[i].first + " " + to_string(kinds[i].second);
+        out += "\n";
+    }
+    return out;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+class ASTNode;
+
+// --- Per-phase statistics (--stats[=json]) ---
+// Where the time of one transpilation goes, phase by phase, and how much it processed:
+//   read            reading the C source
+//   lex             tokenizing (without the #define lines)
+//   preprocess      the #define lines, and handing the macros to the parser
+//   parse           building the AST
+//   pass:<name>     the transpiler's passes: macros (translating macro bodies), inline-plan,
+//                   global-tables, purity, lint-prep, codegen (the statements), helpers (runtime
+//                   helpers and assembling the module), source-map (with --source-map)
+//   cache           a --cache-dir lookup (on a hit, the phases from lex to the passes are skipped)
+//   emit            JSON dumps, and writing the Python
+// Each phase has its wall time, the CPU time of the thread that ran it, and the peak RSS of the
+// process when it ended (a high-water mark, so it only grows; 0 where the platform does not say).
+// Reported on stderr (or --stats-file) as text, or as one JSON object per line, and in framed mode
+// as a "stats" frame, e.g.
+//   {"file": "a.c", "files": 1, "source_bytes": 1210, ..., "phases": [{"name": "read", "wall_ms": 0.012,
+//    "cpu_ms": 0.011, "peak_rss_kb": 3456}, ...], "total": {...}, "throughput": {...}}
+
+struct PhaseStats
+{
+    string name;
+    double wall_ms = 0;
+    double cpu_ms = 0;
+    long long peak_rss_kb = 0;
+};
+
+// CPU time used by the calling thread, in milliseconds.
+double threadCpuMilliseconds();
+
+// Peak resident set size of the process so far, in KB; 0 if unknown.
+long long peakRssKilobytes();
+
+// Measures consecutive phases: each lap() returns the time since the previous one (or construction).
+// A disabled timer never reads a clock.
+class PhaseTimer
+{
+public:
+    explicit PhaseTimer(bool enabled = true);
+    PhaseStats lap(const string &name);
+
+private:
+    bool m_enabled;
+    double m_wall_start = 0;
+    double m_cpu_start = 0;
+};
+
+struct TranspileStats
+{
+    string file;   // "" for stdin; the batch total has no file at all
+    long long files = 1;
+    long long cached = 0;  // Files answered from the result cache (their lex to pass phases did not run)
+    long long source_bytes = 0;
+    long long source_lines = 0;
+    long long tokens = 0;
+    long long macros = 0;
+    long long ast_nodes = 0;
+    map<string, long long> ast_nodes_by_kind;
+    long long output_bytes = 0;
+    long long output_lines = 0;
+    vector<PhaseStats> phases; // In the order of the list above
+
+    // Adds a measurement to the phase of that name (phases measured in pieces add up).
+    void add(const PhaseStats &phase);
+    PhaseStats *find(const string &name);
+    void countSource(const string &source);
+    void countAst(const shared_ptr<ASTNode> &program);
+    void countOutput(const string &python);
+    // Adds the counts and times of another file's statistics (batch totals).
+    void merge(const TranspileStats &other);
+
+    string json(bool total = false) const; // One line, no newline
+    string text(bool total = false) const; // Several lines, each ending in a newline
+};
@@ -0,0 +1,1731 @@
+#include "VM.h"
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+
+// --- Bytecode compiler ---
+// Every value is one Cell: integers (of any C integer type, and pointers) sign-extended in 'i',
+// float and double in 'f'. Memory is an array of cells, one per C object or array element, so
+// pointer arithmetic counts elements and sizeof (from the TargetAbi) only matters for malloc sizes.
+// Expressions are typed at compile time and the opcodes carry the C conversions (wrapping to int or
+// char, rounding to float), so the machine itself never looks at types.
+
+static const int MAX_MACRO_DEPTH = 64;
+static const long long MAX_STACK_CELLS = 1LL << 26; // 512 MB of frames
+static const size_t MAX_CALL_DEPTH = 100000;
+static const long long MAX_BLOCK_CELLS = 1LL << 28;
+
+static bool isPointer(const string &scalar)
+{
+    return !scalar.empty() && scalar.back() == '*';
+}
+
+static bool isFloating(const string &scalar)
+{
+    return scalar == "float" || scalar == "double";
+}
+
+static string pointee(const string &pointer)
+{
+    return pointer.substr(0, pointer.size() - 1);
+}
+
+// Width of an integer type in bits (1 for bool); pointers are 64-bit.
+static int integerBits(const string &scalar)
+{
+    if (scalar == "bool")
+        return 1;
+    if (scalar == "char")
+        return 8;
+    if (scalar == "short")
+        return 16;
+    if (scalar == "int")
+        return 32;
+    return 64;
+}
+
+static long long wrapInteger(long long value, long long bits)
+{
+    if (bits == 1)
+        return value != 0;
+    if (bits == 8)
+        return (long long)(int8_t)(uint8_t)value;
+    if (bits == 16)
+        return (long long)(int16_t)(uint16_t)value;
+    if (bits == 32)
+        return (long long)(int32_t)(uint32_t)value;
+    return value;
+}
+
+BytecodeCompiler::BytecodeCompiler(const vector<MacroDefinition> &macros, const TargetAbi &abi) : m_abi(abi), m_macros(macros)
+{
+}
+
+BytecodeProgram BytecodeCompiler::compile(shared_ptr<ProgramNode> program)
+{
+    m_object_macros.clear();
+    m_function_macros.clear();
+    for (const auto &macro : m_macros)
+    {
+        if (!macro.valid)
+            continue;
+        shared_ptr<ExpressionNode> body;
+        try
+        {
+            Lexer lexer(macro.body);
+            vector<Token> tokens = lexer.tokenize();
+            Parser parser(tokens);
+            parser.defineEnumerators(program->enumerators, macro.parameters); // #define NEXT (B + 1) with B an enumerator
+            body = parser.parseExpression();
+        }
+        catch (const std::exception &)
+        {
+            continue; // Not an expression: a program using the macro fails to compile
+        }
+        if (macro.isFunctionLike)
+            m_function_macros[macro.name] = {macro.parameters, body};
+        else
+            m_object_macros[macro.name] = body;
+    }
+    return compileProgram(program);
+}
+
+size_t BytecodeCompiler::emit(OpCode op, long long a, long long b, double d)
+{
+    Instruction instruction;
+    instruction.op = op;
+    instruction.a = a;
+    instruction.b = b;
+    instruction.d = d;
+    instruction.line = m_line;
+    m_program.code.push_back(instruction);
+    return m_program.code.size() - 1;
+}
+
+string BytecodeCompiler::scalarType(const string &declared) const
+{
+    if (declared == "string")
+        return "char*";
+    size_t stars = declared.find('*');
+    string base = declared.substr(0, stars);
+    if (base != "int" && base != "char" && base != "bool" && base != "short" && base != "long" &&
+        base != "float" && base != "double" && base != "void")
+        throw VMError("unsupported type " + declared, m_line);
+    if (base == "long" && m_abi.long_size == 4)
+        return "int" + (stars == string::npos ? "" : declared.substr(stars)); // ILP32/LLP64: long is int
+    return declared;
+}
+
+long long BytecodeCompiler::sizeOf(const CType &type) const
+{
+    long long size = m_abi.sizeOf(type.scalar);
+    for (size_t d = 0; d < type.dims.size(); ++d)
+    {
+        if (type.dims[d] == 0)
+            return m_abi.pointer_size; // Array parameter
+        size *= type.dims[d];
+    }
+    return size;
+}
+
+// Type of an expression without evaluating it (sizeof expr): compiled, then the code is dropped.
+BytecodeCompiler::CType BytecodeCompiler::staticType(const shared_ptr<ExpressionNode> &expr)
+{
+    size_t code_size = m_program.code.size();
+    size_t formats = m_program.formats.size();
+    CType type = compileValue(expr);
+    m_program.code.resize(code_size);
+    m_program.formats.resize(formats);
+    return type;
+}
+
+long long BytecodeCompiler::sizeofValue(const shared_ptr<SizeofNode> &node)
+{
+    if (variableLengthArray(node))
+        throw VMError("sizeof a variable length array is not a constant", m_line);
+    CType type{scalarType(node->getTargetType().empty() ? "void" : node->getTargetType()), {}};
+    if (auto str = dynamic_pointer_cast<StringLiteralNode>(node->getOperand()))
+        type = CType{"char", {(long long)str->getValue().size() + 1}}; // The array, not the decayed pointer
+    else if (node->getOperand())
+        type = staticType(node->getOperand());
+    long long size = sizeOf(type);
+    if (size <= 0)
+        throw VMError("sizeof applied to an incomplete type", m_line);
+    return size;
+}
+
+// The variable length array a sizeof applies to, if it is one (sizeof v, not sizeof v[0]).
+const BytecodeCompiler::Symbol *BytecodeCompiler::variableLengthArray(const shared_ptr<SizeofNode> &node) const
+{
+    auto ident = dynamic_pointer_cast<IdentifierNode>(node->getOperand());
+    // A parameter of a macro being expanded stands for its argument, named in the caller's context
+    for (size_t depth = m_macro_arguments.size(); ident && depth > 0; --depth)
+    {
+        auto argument = m_macro_arguments[depth - 1].find(ident->getName());
+        if (argument == m_macro_arguments[depth - 1].end())
+            break;
+        ident = dynamic_pointer_cast<IdentifierNode>(argument->second);
+    }
+    const Symbol *symbol = ident ? lookup(ident->getName()) : nullptr;
+    return symbol && symbol->length_slot >= 0 ? symbol : nullptr;
+}
+
+const BytecodeCompiler::Symbol *BytecodeCompiler::lookup(const string &name) const
+{
+    for (auto scope = m_scopes.rbegin(); scope != m_scopes.rend(); ++scope)
+    {
+        auto it = scope->find(name);
+        if (it != scope->end())
+            return &it->second;
+    }
+    return nullptr;
+}
+
+long long BytecodeCompiler::stringAddress(const string &text)
+{
+    auto it = m_strings.find(text);
+    if (it != m_strings.end())
+        return it->second;
+    long long address = (long long)m_program.static_data.size();
+    for (char c : text)
+    {
+        Cell cell;
+        cell.i = (signed char)c;
+        m_program.static_data.push_back(cell);
+    }
+    Cell terminator;
+    terminator.i = 0;
+    m_program.static_data.push_back(terminator);
+    m_strings[text] = address;
+    return address;
+}
+
+// Array sizes: integer literals and macros, sizeof and arithmetic on them.
+long long BytecodeCompiler::constantInteger(const shared_ptr<ExpressionNode> &expr)
+{
+    if (auto num = dynamic_pointer_cast<NumberNode>(expr))
+    {
+        const string &text = num->getValue();
+        size_t consumed = 0;
+        long long value = 0;
+        try
+        {
+            value = stoll(text, &consumed, 0);
+        }
+        catch (const std::exception &)
+        {
+            consumed = 0;
+        }
+        if (consumed == 0 || text.find_first_not_of("uUlL", consumed) != string::npos)
+            throw VMError("not an integer constant: " + text, m_line);
+        return value;
+    }
+    if (auto ch = dynamic_pointer_cast<CharLiteralNode>(expr))
+        return ch->getValue().empty() ? 0 : (signed char)ch->getValue()[0];
+    if (auto sizeNode = dynamic_pointer_cast<SizeofNode>(expr))
+        return sizeofValue(sizeNode);
+    if (auto cast = dynamic_pointer_cast<CastNode>(expr))
+        return constantInteger(cast->getOperand());
+    if (auto ident = dynamic_pointer_cast<IdentifierNode>(expr))
+    {
+        auto macro = m_object_macros.find(ident->getName());
+        if (macro != m_object_macros.end() && m_macro_depth < MAX_MACRO_DEPTH)
+        {
+            m_macro_depth++;
+            long long value = constantInteger(macro->second);
+            m_macro_depth--;
+            return value;
+        }
+    }
+    if (auto unary = dynamic_pointer_cast<UnaryExpressionNode>(expr))
+    {
+        if (unary->getOperator() == "-")
+            return -constantInteger(unary->getOperand());
+    }
+    if (auto binary = dynamic_pointer_cast<BinaryExpressionNode>(expr))
+    {
+        long long a = constantInteger(binary->getLeft());
+        long long b = constantInteger(binary->getRight());
+        const string &op = binary->getOperator();
+        if (op == "+")
+            return a + b;
+        if (op == "-")
+            return a - b;
+        if (op == "*")
+            return a * b;
+        if ((op == "/" || op == "%") && b != 0)
+            return op == "/" ? a / b : a % b;
+    }
+    throw VMError("not a constant expression", m_line);
+}
+
+BytecodeProgram BytecodeCompiler::compileProgram(shared_ptr<ProgramNode> program)
+{
+    m_program = BytecodeProgram();
+    m_program.static_data.resize(1); // Address 0 is NULL
+    m_program.static_data[0].i = 0;
+    m_scopes.assign(1, {});
+    m_functions.clear();
+    m_global_initializers.clear();
+
+    // Signatures first: calls may come before the definition.
+    for (const auto &stmt : program->getStatements())
+    {
+        auto funcDecl = dynamic_pointer_cast<FunctionDeclarationNode>(stmt);
+        if (!funcDecl)
+            continue;
+        m_line = funcDecl->line;
+        auto existing = m_functions.find(funcDecl->getName());
+        FunctionInfo info;
+        info.index = existing != m_functions.end() ? existing->second.index : (int)m_program.functions.size();
+        info.decl = funcDecl;
+        info.return_type = scalarType(funcDecl->getDeclaredType());
+        for (const auto &param : funcDecl->getParameters())
+        {
+            CType type;
+            type.scalar = scalarType(param.type);
+            if (param.isArray)
+            {
+                type.dims.push_back(0);
+                for (const auto &size : param.innerSizes)
+                    type.dims.push_back(constantInteger(size));
+            }
+            info.parameter_types.push_back(type);
+        }
+        if (existing == m_functions.end())
+        {
+            CompiledFunction compiled;
+            compiled.name = funcDecl->getName();
+            compiled.parameters = (int)info.parameter_types.size();
+            m_program.functions.push_back(compiled);
+        }
+        if (existing == m_functions.end() || funcDecl->getBody())
+            m_functions[funcDecl->getName()] = info;
+    }
+
+    for (const auto &stmt : program->getStatements())
+    {
+        m_line = stmt ? stmt->line : 0;
+        if (auto funcDecl = dynamic_pointer_cast<FunctionDeclarationNode>(stmt))
+        {
+            if (funcDecl->getBody())
+                compileFunction(m_functions[funcDecl->getName()]);
+        }
+        else if (auto decl = dynamic_pointer_cast<VariableDeclarationNode>(stmt))
+        {
+            compileDeclaration(decl, true);
+        }
+        else if (stmt)
+        {
+            throw VMError("unsupported statement at file scope: " + stmt->type_name, m_line);
+        }
+    }
+
+    // Entry point: global initializers, then main().
+    m_program.entry = m_program.code.size();
+    for (const auto &decl : m_global_initializers)
+    {
+        m_line = decl->line;
+        const Symbol &symbol = m_scopes[0].at(decl->getName());
+        convert(compileValue(decl->getInitializer()), symbol.type.scalar);
+        emit(OpCode::StoreGlobal, symbol.address);
+        emit(OpCode::Pop);
+    }
+    auto mainFunction = m_functions.find("main");
+    if (mainFunction == m_functions.end() || !mainFunction->second.decl->getBody())
+        throw VMError("the program has no main() function");
+    for (size_t i = 0; i < mainFunction->second.parameter_types.size(); ++i)
+        emit(OpCode::PushInt, 0); // argc/argv: no arguments
+    emit(OpCode::Call, mainFunction->second.index, (long long)mainFunction->second.parameter_types.size());
+    emit(OpCode::Halt);
+    return m_program;
+}
+
+void BytecodeCompiler::compileFunction(const FunctionInfo &function)
+{
+    m_scopes.emplace_back();
+    m_frame_size = 0;
+    m_return_type = function.return_type;
+    m_program.functions[function.index].entry = m_program.code.size();
+    const auto &params = function.decl->getParameters();
+    for (size_t i = 0; i < params.size(); ++i)
+    {
+        Symbol symbol;
+        symbol.type = function.parameter_types[i];
+        symbol.address = m_frame_size++;
+        symbol.indirect = !symbol.type.dims.empty();
+        m_scopes.back()[params[i].name] = symbol;
+    }
+    compileStatement(function.decl->getBody());
+    emit(OpCode::PushInt, 0); // Falling off the end returns 0 (main) or nothing
+    emit(OpCode::Return);
+    m_program.functions[function.index].frame_size = m_frame_size;
+    m_scopes.pop_back();
+}
+
+void BytecodeCompiler::compileDeclaration(const shared_ptr<VariableDeclarationNode> &decl, bool global)
+{
+    Symbol symbol;
+    symbol.global = global;
+    symbol.type.scalar = scalarType(decl->getDeclaredType());
+    if (symbol.type.scalar == "void")
+        throw VMError("variable '" + decl->getName() + "' declared void", m_line);
+
+    shared_ptr<ExpressionNode> variable_length;
+    long long cells = 1;
+    if (auto arrayDecl = dynamic_pointer_cast<ArrayDeclarationNode>(decl))
+    {
+        try
+        {
+            symbol.type.dims.push_back(constantInteger(arrayDecl->getSizeExpression()));
+        }
+        catch (const VMError &)
+        {
+            if (global)
+                throw VMError("size of global array '" + decl->getName() + "' is not a constant", m_line);
+            variable_length = arrayDecl->getSizeExpression();
+            symbol.type.dims.push_back(0);
+        }
+        for (const auto &inner : arrayDecl->getInnerSizeExpressions())
+            symbol.type.dims.push_back(constantInteger(inner));
+        for (size_t d = 0; d < symbol.type.dims.size(); ++d)
+        {
+            if (symbol.type.dims[d] <= 0 && !(d == 0 && variable_length))
+                throw VMError("array '" + decl->getName() + "' has a non-positive size", m_line);
+            cells *= max(1LL, symbol.type.dims[d]);
+            if (cells > MAX_BLOCK_CELLS)
+                throw VMError("array '" + decl->getName() + "' is too large", m_line);
+        }
+    }
+
+    if (m_scopes.back().count(decl->getName()))
+        throw VMError("redeclaration of '" + decl->getName() + "'", m_line);
+    if (global)
+    {
+        symbol.address = (long long)m_program.static_data.size();
+        Cell zero;
+        zero.i = 0;
+        m_program.static_data.resize(m_program.static_data.size() + cells, zero);
+    }
+    else if (variable_length)
+    {
+        // T a[n][M]...: the slot holds the address of a block allocated each time the declaration runs.
+        symbol.address = m_frame_size++;
+        symbol.length_slot = m_frame_size++;
+        symbol.indirect = true;
+        emit(OpCode::LoadLocal, symbol.address);
+        convert(compileValue(variable_length), "long");
+        emit(OpCode::StoreLocal, symbol.length_slot); // For sizeof
+        if (cells > 1)
+        {
+            emit(OpCode::PushInt, cells);
+            emit(OpCode::MulInt, 64);
+        }
+        emit(OpCode::AllocArray);
+        emit(OpCode::StoreLocal, symbol.address);
+        emit(OpCode::Pop);
+    }
+    else
+    {
+        symbol.address = m_frame_size;
+        m_frame_size += (int)cells;
+    }
+    m_scopes.back()[decl->getName()] = symbol;
+
+    if (!decl->getInitializer() || !symbol.type.dims.empty())
+        return;
+    if (global)
+    {
+        m_global_initializers.push_back(decl);
+        return;
+    }
+    m_allocation_element = isPointer(symbol.type.scalar) ? max(1LL, sizeOf({pointee(symbol.type.scalar), {}})) : 1;
+    convert(compileValue(decl->getInitializer()), symbol.type.scalar);
+    m_allocation_element = 1;
+    emit(OpCode::StoreLocal, symbol.address);
+    emit(OpCode::Pop);
+}
+
+void BytecodeCompiler::compileCondition(const shared_ptr<ExpressionNode> &expr)
+{
+    CType type = compileValue(expr);
+    if (type.dims.empty() && isFloating(type.scalar))
+        emit(OpCode::BoolFloat);
+}
+
+void BytecodeCompiler::compileLoopBody(const shared_ptr<StatementNode> &body, LoopLabels &labels)
+{
+    m_loops.push_back(&labels);
+    compileStatement(body);
+    m_loops.pop_back();
+}
+
+void BytecodeCompiler::compileStatement(const shared_ptr<StatementNode> &stmt)
+{
+    if (!stmt)
+        return;
+    if (stmt->line > 0)
+        m_line = stmt->line;
+
+    if (auto decl = dynamic_pointer_cast<VariableDeclarationNode>(stmt))
+    {
+        compileDeclaration(decl, false);
+    }
+    else if (auto exprStmt = dynamic_pointer_cast<ExpressionStatementNode>(stmt))
+    {
+        if (exprStmt->getExpression())
+        {
+            compileValue(exprStmt->getExpression());
+            emit(OpCode::Pop);
+        }
+    }
+    else if (auto assignStmt = dynamic_pointer_cast<AssignmentStatementNode>(stmt))
+    {
+        compileAssignment(assignStmt->getAssignment());
+        emit(OpCode::Pop);
+    }
+    else if (auto block = dynamic_pointer_cast<BlockNode>(stmt))
+    {
+        m_scopes.emplace_back();
+        for (const auto &inner : block->getStatements())
+            compileStatement(inner);
+        m_scopes.pop_back();
+    }
+    else if (auto ifStmt = dynamic_pointer_cast<IfNode>(stmt))
+    {
+        compileCondition(ifStmt->getCondition());
+        size_t to_else = emit(OpCode::JumpIfFalse);
+        compileStatement(ifStmt->getThenBranch());
+        if (ifStmt->getElseBranch())
+        {
+            size_t to_end = emit(OpCode::Jump);
+            patch(to_else, m_program.code.size());
+            compileStatement(ifStmt->getElseBranch());
+            patch(to_end, m_program.code.size());
+        }
+        else
+        {
+            patch(to_else, m_program.code.size());
+        }
+    }
+    else if (auto whileStmt = dynamic_pointer_cast<WhileNode>(stmt))
+    {
+        size_t start = m_program.code.size();
+        compileCondition(whileStmt->getCondition());
+        size_t to_end = emit(OpCode::JumpIfFalse);
+        LoopLabels labels;
+        compileLoopBody(whileStmt->getBody(), labels);
+        emit(OpCode::Jump, (long long)start);
+        patch(to_end, m_program.code.size());
+        for (size_t at : labels.breaks)
+            patch(at, m_program.code.size());
+        for (size_t at : labels.continues)
+            patch(at, start);
+    }
+    else if (auto forStmt = dynamic_pointer_cast<ForNode>(stmt))
+    {
+        m_scopes.emplace_back(); // A variable declared in the initializer is local to the loop
+        compileStatement(forStmt->getInitializer());
+        m_line = stmt->line;
+        size_t start = m_program.code.size();
+        size_t to_end = SIZE_MAX;
+        if (forStmt->getCondition())
+        {
+            compileCondition(forStmt->getCondition());
+            to_end = emit(OpCode::JumpIfFalse);
+        }
+        LoopLabels labels;
+        compileLoopBody(forStmt->getBody(), labels);
+        size_t increment = m_program.code.size();
+        m_line = stmt->line;
+        if (forStmt->getIncrement())
+        {
+            compileValue(forStmt->getIncrement());
+            emit(OpCode::Pop);
+        }
+        emit(OpCode::Jump, (long long)start);
+        if (to_end != SIZE_MAX)
+            patch(to_end, m_program.code.size());
+        for (size_t at : labels.breaks)
+            patch(at, m_program.code.size());
+        for (size_t at : labels.continues)
+            patch(at, increment);
+        m_scopes.pop_back();
+    }
+    else if (auto returnStmt = dynamic_pointer_cast<ReturnNode>(stmt))
+    {
+        if (returnStmt->getReturnValue() && m_return_type != "void")
+        {
+            convert(compileValue(returnStmt->getReturnValue()), m_return_type);
+        }
+        else
+        {
+            if (returnStmt->getReturnValue())
+            {
+                compileValue(returnStmt->getReturnValue());
+                emit(OpCode::Pop);
+            }
+            emit(OpCode::PushInt, 0);
+        }
+        emit(OpCode::Return);
+    }
+    else if (dynamic_pointer_cast<BreakNode>(stmt) || dynamic_pointer_cast<ContinueNode>(stmt))
+    {
+        bool is_break = dynamic_pointer_cast<BreakNode>(stmt) != nullptr;
+        if (m_loops.empty())
+            throw VMError(string(is_break ? "break" : "continue") + " outside a loop", m_line);
+        (is_break ? m_loops.back()->breaks : m_loops.back()->continues).push_back(emit(OpCode::Jump));
+    }
+    else if (auto printfStmt = dynamic_pointer_cast<PrintfNode>(stmt))
+    {
+        compilePrintf(printfStmt);
+    }
+    else if (auto scanfStmt = dynamic_pointer_cast<ScanfNode>(stmt))
+    {
+        compileScanf(scanfStmt);
+    }
+    else
+    {
+        throw VMError("unsupported statement " + stmt->type_name, m_line);
+    }
+}
+
+// Splits a printf/scanf format into pieces of literal text and one conversion each.
+static vector<FormatPiece> parseFormat(const string &format, bool for_scanf, int line)
+{
+    const string conversions = for_scanf ? "diufeEgGscx" : "diouxXcsfFeEgGp";
+    vector<FormatPiece> pieces;
+    FormatPiece piece;
+    for (size_t i = 0; i < format.size(); ++i)
+    {
+        if (format[i] != '%')
+        {
+            piece.text += format[i];
+            continue;
+        }
+        if (i + 1 < format.size() && format[i + 1] == '%')
+        {
+            piece.text += '%';
+            ++i;
+            continue;
+        }
+        size_t j = i + 1;
+        if (for_scanf && j < format.size() && format[j] == '*')
+        {
+            piece.suppressed = true;
+            ++j;
+        }
+        size_t spec_start = j;
+        while (j < format.size() && (string("-+ #0").find(format[j]) != string::npos || isdigit((unsigned char)format[j]) ||
+                                     (!for_scanf && format[j] == '.')))
+            ++j;
+        piece.spec = format.substr(spec_start, j - spec_start);
+        while (j < format.size() && (format[j] == 'l' || format[j] == 'h' || format[j] == 'L' || format[j] == 'z'))
+            piece.long_arg = piece.long_arg || format[j++] != 'h';
+        if (j >= format.size() || conversions.find(format[j]) == string::npos)
+            throw VMError("unsupported conversion in format \"" + format + "\"", line);
+        piece.conversion = format[j];
+        pieces.push_back(piece);
+        piece = FormatPiece();
+        i = j;
+    }
+    if (!piece.text.empty())
+        pieces.push_back(piece);
+    return pieces;
+}
+
+void BytecodeCompiler::compilePrintf(const shared_ptr<PrintfNode> &stmt)
+{
+    auto format = dynamic_pointer_cast<StringLiteralNode>(stmt->getFormatStringExpression());
+    if (!format)
+        throw VMError("printf format must be a string literal", m_line);
+    vector<FormatPiece> pieces = parseFormat(format->getValue(), false, m_line);
+    auto args = stmt->getArguments();
+    size_t next = 0;
+    for (const auto &piece : pieces)
+    {
+        if (!piece.conversion)
+            continue;
+        if (next >= args.size())
+            throw VMError("printf format \"" + format->getValue() + "\" needs more arguments", m_line);
+        CType type = compileValue(args[next++]);
+        if (piece.conversion == 's' || piece.conversion == 'p')
+        {
+            if (type.dims.empty() && !isPointer(type.scalar))
+                throw VMError(string("printf %") + piece.conversion + " needs a pointer argument", m_line);
+        }
+        else if (string("fFeEgG").find(piece.conversion) != string::npos)
+            convert(type, "double");
+        else
+            convert(type, "long");
+    }
+    if (next != args.size())
+        throw VMError("printf format \"" + format->getValue() + "\" has fewer conversions than arguments", m_line);
+    m_program.formats.push_back(pieces);
+    emit(OpCode::Printf, (long long)m_program.formats.size() - 1, (long long)args.size());
+}
+
+void BytecodeCompiler::compileScanf(const shared_ptr<ScanfNode> &stmt)
+{
+    auto format = dynamic_pointer_cast<StringLiteralNode>(stmt->getFormatStringExpression());
+    if (!format)
+        throw VMError("scanf format must be a string literal", m_line);
+    vector<FormatPiece> pieces = parseFormat(format->getValue(), true, m_line);
+    auto args = stmt->getArguments();
+    size_t next = 0;
+    for (auto &piece : pieces)
+    {
+        if (!piece.conversion || piece.suppressed)
+            continue;
+        if (next >= args.size())
+            throw VMError("scanf format \"" + format->getValue() + "\" needs more arguments", m_line);
+        CType type = compileValue(args[next++]);
+        if (!type.dims.empty())
+            piece.target_type = type.scalar;
+        else if (isPointer(type.scalar))
+            piece.target_type = pointee(type.scalar);
+        else
+            throw VMError("scanf arguments must be addresses (&x or an array)", m_line);
+        if (piece.target_type == "void" || isPointer(piece.target_type))
+            throw VMError("scanf cannot store into a " + piece.target_type, m_line);
+    }
+    if (next != args.size())
+        throw VMError("scanf format \"" + format->getValue() + "\" has fewer conversions than arguments", m_line);
+    m_program.formats.push_back(pieces);
+    emit(OpCode::Scanf, (long long)m_program.formats.size() - 1, (long long)args.size());
+}
+
+// Emits the C conversion of a value of type 'from' to type 'to' (assignment, argument, return, cast).
+void BytecodeCompiler::convert(const CType &from, const string &to)
+{
+    if (!from.dims.empty())
+    {
+        if (!isPointer(to) && to != "long")
+            throw VMError("array used where a " + to + " is expected", m_line);
+        return; // Arrays decay to the address of their first element
+    }
+    if (to == "void" || from.scalar == to)
+        return;
+    if (from.scalar == "void")
+        throw VMError("void value used as a " + to, m_line);
+    bool from_float = isFloating(from.scalar);
+    if (isPointer(to))
+    {
+        if (from_float)
+            throw VMError("floating value used as a pointer", m_line);
+        return;
+    }
+    if (isFloating(to))
+    {
+        if (!from_float)
+            emit(OpCode::IntToFloat, to == "float" ? 32 : 64);
+        else if (to == "float")
+            emit(OpCode::RoundFloat);
+        return;
+    }
+    int bits = integerBits(to);
+    if (from_float)
+        emit(bits == 1 ? OpCode::BoolFloat : OpCode::FloatToInt, bits);
+    else if (bits == 1)
+        emit(OpCode::BoolInt);
+    else if (bits < (isPointer(from.scalar) ? 64 : integerBits(from.scalar)))
+        emit(OpCode::WrapInt, bits);
+}
+
+BytecodeCompiler::CType BytecodeCompiler::compileIdentifier(const shared_ptr<IdentifierNode> &ident, bool address)
+{
+    const string &name = ident->getName();
+
+    // A parameter of the function-like macro being expanded: the argument, in the caller's context.
+    if (!m_macro_arguments.empty() && m_macro_arguments.back().count(name))
+    {
+        auto bindings = m_macro_arguments.back();
+        m_macro_arguments.pop_back();
+        CType type = address ? compileAddress(bindings[name]) : compileValue(bindings[name]);
+        m_macro_arguments.push_back(bindings);
+        return type;
+    }
+    auto macro = m_object_macros.find(name);
+    if (macro != m_object_macros.end())
+    {
+        if (++m_macro_depth > MAX_MACRO_DEPTH)
+            throw VMError("macro " + name + " expands recursively", m_line);
+        CType type = address ? compileAddress(macro->second) : compileValue(macro->second);
+        m_macro_depth--;
+        return type;
+    }
+
+    const Symbol *symbol = lookup(name);
+    if (!symbol)
+    {
+        if (name == "NULL" && !address)
+        {
+            emit(OpCode::PushInt, 0);
+            return {"void*", {}};
+        }
+        throw VMError("undeclared identifier '" + name + "'", m_line);
+    }
+    if (!symbol->type.dims.empty())
+    {
+        // An array's value is its address.
+        if (symbol->indirect)
+            emit(OpCode::LoadLocal, symbol->address);
+        else
+            emit(symbol->global ? OpCode::PushInt : OpCode::AddrLocal, symbol->address);
+        return symbol->type;
+    }
+    if (address)
+        emit(symbol->global ? OpCode::PushInt : OpCode::AddrLocal, symbol->address);
+    else
+        emit(symbol->global ? OpCode::LoadGlobal : OpCode::LoadLocal, symbol->address);
+    return symbol->type;
+}
+
+BytecodeCompiler::CType BytecodeCompiler::compileAddress(const shared_ptr<ExpressionNode> &expr)
+{
+    if (auto ident = dynamic_pointer_cast<IdentifierNode>(expr))
+        return compileIdentifier(ident, true);
+
+    shared_ptr<ExpressionNode> base_expr;
+    shared_ptr<ExpressionNode> index_expr;
+    if (auto sub = dynamic_pointer_cast<ArraySubscriptNode>(expr))
+    {
+        base_expr = sub->getArrayExpression();
+        index_expr = sub->getIndexExpression();
+    }
+    else if (auto unary = dynamic_pointer_cast<UnaryExpressionNode>(expr))
+    {
+        if (unary->getOperator() == "*")
+            base_expr = unary->getOperand();
+    }
+    if (!base_expr)
+        throw VMError("expression is not assignable", m_line);
+
+    // a[i] and *p: the address of an element of the array or pointer value.
+    CType base = compileValue(base_expr);
+    if (base.dims.empty() && !isPointer(base.scalar))
+        throw VMError("subscripted or dereferenced value is not an array or pointer", m_line);
+    long long stride = 1;
+    for (size_t d = 1; d < base.dims.size(); ++d)
+        stride *= base.dims[d];
+    if (index_expr)
+    {
+        CType index = compileValue(index_expr);
+        if (!index.dims.empty() || isFloating(index.scalar) || isPointer(index.scalar))
+            throw VMError("array index is not an integer", m_line);
+        emit(OpCode::Index, stride);
+    }
+    CType element;
+    if (!base.dims.empty())
+    {
+        element.scalar = base.scalar;
+        element.dims.assign(base.dims.begin() + 1, base.dims.end());
+    }
+    else
+    {
+        element.scalar = pointee(base.scalar);
+        if (element.scalar == "void")
+            throw VMError("dereference of a void pointer", m_line);
+    }
+    return element;
+}
+
+BytecodeCompiler::CType BytecodeCompiler::compileValue(const shared_ptr<ExpressionNode> &expr)
+{
+    if (!expr)
+        throw VMError("missing expression", m_line);
+    if (auto num = dynamic_pointer_cast<NumberNode>(expr))
+    {
+        const string &text = num->getValue();
+        bool hex = text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X');
+        if (!hex && text.find_first_of(".eE") != string::npos)
+        {
+            bool is_float = text.back() == 'f' || text.back() == 'F';
+            double value = stod(text);
+            emit(OpCode::PushFloat, 0, 0, is_float ? (double)(float)value : value);
+            return {is_float ? "float" : "double", {}};
+        }
+        long long value = constantInteger(expr);
+        emit(OpCode::PushInt, value);
+        return {value > INT_MAX || text.find_first_of("lL") != string::npos ? "long" : "int", {}};
+    }
+    if (auto ch = dynamic_pointer_cast<CharLiteralNode>(expr))
+    {
+        emit(OpCode::PushInt, ch->getValue().empty() ? 0 : (signed char)ch->getValue()[0]);
+        return {"int", {}};
+    }
+    if (auto boolean = dynamic_pointer_cast<BooleanNode>(expr))
+    {
+        emit(OpCode::PushInt, boolean->getValue() ? 1 : 0);
+        return {"int", {}};
+    }
+    if (auto str = dynamic_pointer_cast<StringLiteralNode>(expr))
+    {
+        emit(OpCode::PushInt, stringAddress(str->getValue()));
+        return {"char*", {}};
+    }
+    if (auto ident = dynamic_pointer_cast<IdentifierNode>(expr))
+        return compileIdentifier(ident, false);
+    if (auto assign = dynamic_pointer_cast<AssignmentNode>(expr))
+        return compileAssignment(assign);
+    if (auto binary = dynamic_pointer_cast<BinaryExpressionNode>(expr))
+        return compileBinary(binary);
+    if (auto call = dynamic_pointer_cast<FunctionCallNode>(expr))
+        return compileCall(call);
+    if (auto cast = dynamic_pointer_cast<CastNode>(expr))
+    {
+        string target = scalarType(cast->getTargetType());
+        convert(compileValue(cast->getOperand()), target);
+        return {target, {}};
+    }
+    if (auto sizeNode = dynamic_pointer_cast<SizeofNode>(expr))
+    {
+        if (const Symbol *array = variableLengthArray(sizeNode))
+        {
+            // Its length when the declaration ran, times the size of one row
+            CType row = array->type;
+            row.dims.erase(row.dims.begin());
+            emit(OpCode::LoadLocal, array->length_slot);
+            emit(OpCode::PushInt, sizeOf(row));
+            emit(OpCode::MulInt, 64);
+        }
+        else
+        {
+            emit(OpCode::PushInt, sizeofValue(sizeNode));
+        }
+        return {scalarType("long"), {}}; // size_t
+    }
+    auto unary = dynamic_pointer_cast<UnaryExpressionNode>(expr);
+    if (unary && unary->getOperator() != "*")
+        return compileUnary(unary);
+    if (unary || dynamic_pointer_cast<ArraySubscriptNode>(expr))
+    {
+        CType type = compileAddress(expr);
+        if (type.dims.empty())
+            emit(OpCode::Load);
+        return type;
+    }
+    throw VMError("unsupported expression " + expr->type_name, m_line);
+}
+
+BytecodeCompiler::CType BytecodeCompiler::compileAssignment(const shared_ptr<AssignmentNode> &assign)
+{
+    // Plain variables are stored directly; everything else through its address.
+    auto ident = dynamic_pointer_cast<IdentifierNode>(assign->getLValue());
+    bool plain = ident && (m_macro_arguments.empty() || !m_macro_arguments.back().count(ident->getName())) &&
+                 !m_object_macros.count(ident->getName());
+    const Symbol *symbol = plain ? lookup(ident->getName()) : nullptr;
+    CType target;
+    if (symbol && symbol->type.dims.empty())
+        target = symbol->type;
+    else
+        target = compileAddress(assign->getLValue());
+    if (!target.dims.empty())
+        throw VMError("assignment to an array", m_line);
+
+    m_allocation_element = isPointer(target.scalar) ? max(1LL, sizeOf({pointee(target.scalar), {}})) : 1;
+    convert(compileValue(assign->getRValue()), target.scalar);
+    m_allocation_element = 1;
+    if (symbol && symbol->type.dims.empty())
+        emit(symbol->global ? OpCode::StoreGlobal : OpCode::StoreLocal, symbol->address);
+    else
+        emit(OpCode::Store);
+    return target;
+}
+
+// Usual arithmetic conversions: double, float, long, otherwise int (char, short and bool promote).
+static string arithmeticType(const string &a, const string &b)
+{
+    if (a == "double" || b == "double")
+        return "double";
+    if (a == "float" || b == "float")
+        return "float";
+    if (a == "long" || b == "long")
+        return "long";
+    return "int";
+}
+
+BytecodeCompiler::CType BytecodeCompiler::compileBinary(const shared_ptr<BinaryExpressionNode> &expr)
+{
+    const string &op = expr->getOperator();
+    if (op == "&&" || op == "||")
+    {
+        compileCondition(expr->getLeft());
+        emit(OpCode::BoolInt);
+        emit(OpCode::Dup);
+        size_t to_end = emit(op == "&&" ? OpCode::JumpIfFalse : OpCode::JumpIfTrue);
+        emit(OpCode::Pop);
+        compileCondition(expr->getRight());
+        emit(OpCode::BoolInt);
+        patch(to_end, m_program.code.size());
+        return {"int", {}};
+    }
+
+    CType left = compileValue(expr->getLeft());
+    CType right = compileValue(expr->getRight());
+    bool left_pointer = !left.dims.empty() || isPointer(left.scalar);
+    bool right_pointer = !right.dims.empty() || isPointer(right.scalar);
+    auto stride = [](const CType &type)
+    {
+        long long elements = 1;
+        for (size_t d = 1; d < type.dims.size(); ++d)
+            elements *= type.dims[d];
+        return elements;
+    };
+    auto decay = [](const CType &type)
+    {
+        if (type.dims.empty())
+            return type;
+        if (type.dims.size() == 1)
+            return CType{type.scalar + "*", {}};
+        CType rows = type;
+        rows.dims[0] = 0;
+        return rows;
+    };
+
+    bool comparison = op == "<" || op == "<=" || op == ">" || op == ">=" || op == "==" || op == "!=";
+    if (comparison)
+    {
+        bool floating = (!left_pointer && isFloating(left.scalar)) || (!right_pointer && isFloating(right.scalar));
+        if (floating && !isFloating(left.scalar))
+            emit(OpCode::IntToFloatNext, 64);
+        if (floating && !isFloating(right.scalar))
+            emit(OpCode::IntToFloat, 64);
+        static const unordered_map<string, pair<OpCode, OpCode>> opcodes = {
+            {"<", {OpCode::LessInt, OpCode::LessFloat}},
+            {"<=", {OpCode::LessEqualInt, OpCode::LessEqualFloat}},
+            {">", {OpCode::GreaterInt, OpCode::GreaterFloat}},
+            {">=", {OpCode::GreaterEqualInt, OpCode::GreaterEqualFloat}},
+            {"==", {OpCode::EqualInt, OpCode::EqualFloat}},
+            {"!=", {OpCode::NotEqualInt, OpCode::NotEqualFloat}}};
+        const auto &pair = opcodes.at(op);
+        emit(floating ? pair.second : pair.first);
+        return {"int", {}};
+    }
+
+    if (left_pointer || right_pointer)
+    {
+        // Pointer arithmetic counts elements (one cell each).
+        if (op == "-" && left_pointer && right_pointer)
+        {
+            emit(OpCode::SubInt, 64);
+            if (stride(left) > 1)
+            {
+                emit(OpCode::PushInt, stride(left));
+                emit(OpCode::DivInt, 64);
+            }
+            return {"long", {}};
+        }
+        if ((op == "+" || op == "-") && left_pointer && !right_pointer && !isFloating(right.scalar))
+        {
+            if (op == "-")
+                emit(OpCode::NegInt, 64);
+            emit(OpCode::Index, stride(left));
+            return decay(left);
+        }
+        if (op == "+" && right_pointer && !left_pointer && !isFloating(left.scalar))
+        {
+            emit(OpCode::Swap);
+            emit(OpCode::Index, stride(right));
+            return decay(right);
+        }
+        throw VMError("invalid pointer arithmetic with '" + op + "'", m_line);
+    }
+
+    string result = arithmeticType(left.scalar, right.scalar);
+    if (isFloating(result))
+    {
+        long long precision = result == "float" ? 32 : 64;
+        if (!isFloating(left.scalar))
+            emit(OpCode::IntToFloatNext, precision);
+        if (!isFloating(right.scalar))
+            emit(OpCode::IntToFloat, precision);
+        static const unordered_map<string, OpCode> opcodes = {
+            {"+", OpCode::AddFloat}, {"-", OpCode::SubFloat}, {"*", OpCode::MulFloat}, {"/", OpCode::DivFloat}};
+        auto it = opcodes.find(op);
+        if (it == opcodes.end())
+            throw VMError("operator '" + op + "' needs integer operands", m_line);
+        emit(it->second, precision);
+        return {result, {}};
+    }
+    static const unordered_map<string, OpCode> opcodes = {
+        {"+", OpCode::AddInt}, {"-", OpCode::SubInt}, {"*", OpCode::MulInt}, {"/", OpCode::DivInt}, {"%", OpCode::ModInt}};
+    auto it = opcodes.find(op);
+    if (it == opcodes.end())
+        throw VMError("unsupported operator '" + op + "'", m_line);
+    emit(it->second, result == "long" ? 64 : 32);
+    return {result, {}};
+}
+
+BytecodeCompiler::CType BytecodeCompiler::compileUnary(const shared_ptr<UnaryExpressionNode> &expr)
+{
+    const string &op = expr->getOperator();
+    if (op == "&")
+    {
+        CType object = compileAddress(expr->getOperand());
+        return {object.scalar + "*", {}};
+    }
+    if (op == "++" || op == "--")
+    {
+        CType object = compileAddress(expr->getOperand());
+        if (!object.dims.empty())
+            throw VMError("cannot " + string(op == "++" ? "increment" : "decrement") + " an array", m_line);
+        int delta = op == "++" ? 1 : -1;
+        if (isFloating(object.scalar))
+            emit(expr->isPostfix() ? OpCode::IncFloatPost : OpCode::IncFloat, 0, object.scalar == "float" ? 32 : 64, delta);
+        else
+            emit(expr->isPostfix() ? OpCode::IncIntPost : OpCode::IncInt, delta, isPointer(object.scalar) ? 64 : integerBits(object.scalar));
+        return object;
+    }
+    CType operand = compileValue(expr->getOperand());
+    if (!operand.dims.empty() || isPointer(operand.scalar))
+    {
+        if (op != "!")
+            throw VMError("invalid operand of unary '" + op + "'", m_line);
+        emit(OpCode::NotInt);
+        return {"int", {}};
+    }
+    bool floating = isFloating(operand.scalar);
+    if (op == "!")
+    {
+        emit(floating ? OpCode::NotFloat : OpCode::NotInt);
+        return {"int", {}};
+    }
+    if (op == "-")
+    {
+        string result = floating ? operand.scalar : (operand.scalar == "long" ? "long" : "int");
+        emit(floating ? OpCode::NegFloat : OpCode::NegInt, result == "long" || floating ? 64 : 32);
+        return {result, {}};
+    }
+    throw VMError("unsupported unary operator '" + op + "'", m_line);
+}
+
+BytecodeCompiler::CType BytecodeCompiler::compileCall(const shared_ptr<FunctionCallNode> &call)
+{
+    const string &name = call->getFunctionName();
+    auto args = call->getArguments();
+    auto expectArguments = [&](size_t count)
+    {
+        if (args.size() != count)
+            throw VMError(name + "() takes " + to_string(count) + " argument(s), got " + to_string(args.size()), m_line);
+    };
+
+    auto macro = m_function_macros.find(name);
+    if (macro != m_function_macros.end())
+    {
+        expectArguments(macro->second.first.size());
+        if (++m_macro_depth > MAX_MACRO_DEPTH)
+            throw VMError("macro " + name + " expands recursively", m_line);
+        unordered_map<string, shared_ptr<ExpressionNode>> bindings;
+        for (size_t i = 0; i < args.size(); ++i)
+            bindings[macro->second.first[i]] = args[i];
+        m_macro_arguments.push_back(bindings);
+        CType type = compileValue(macro->second.second);
+        m_macro_arguments.pop_back();
+        m_macro_depth--;
+        return type;
+    }
+
+    auto function = m_functions.find(name);
+    if (function != m_functions.end())
+    {
+        if (!function->second.decl->getBody())
+            throw VMError("function '" + name + "' is declared but never defined", m_line);
+        expectArguments(function->second.parameter_types.size());
+        for (size_t i = 0; i < args.size(); ++i)
+        {
+            const CType &param = function->second.parameter_types[i];
+            CType arg = compileValue(args[i]);
+            if (!param.dims.empty())
+            {
+                if (arg.dims.empty() && !isPointer(arg.scalar))
+                    throw VMError("argument " + to_string(i + 1) + " of " + name + "() must be an array", m_line);
+            }
+            else
+            {
+                convert(arg, param.scalar);
+            }
+        }
+        emit(OpCode::Call, function->second.index, (long long)args.size());
+        return {function->second.return_type, {}};
+    }
+
+    // The few library functions the translated programs use.
+    if (name == "malloc")
+    {
+        expectArguments(1);
+        convert(compileValue(args[0]), "long");
+        emit(OpCode::Malloc, m_allocation_element);
+        return {"void*", {}};
+    }
+    if (name == "calloc")
+    {
+        expectArguments(2);
+        convert(compileValue(args[0]), "long");
+        convert(compileValue(args[1]), "long");
+        emit(OpCode::Calloc, m_allocation_element);
+        return {"void*", {}};
+    }
+    if (name == "free")
+    {
+        expectArguments(1);
+        convert(compileValue(args[0]), "void*");
+        emit(OpCode::Free);
+        return {"void", {}};
+    }
+    if (name == "abs" || name == "putchar")
+    {
+        expectArguments(1);
+        convert(compileValue(args[0]), "int");
+        emit(name == "abs" ? OpCode::AbsInt : OpCode::Putchar);
+        return {"int", {}};
+    }
+    if (name == "fabs" || name == "sqrt")
+    {
+        expectArguments(1);
+        convert(compileValue(args[0]), "double");
+        emit(name == "fabs" ? OpCode::AbsFloat : OpCode::Sqrt);
+        return {"double", {}};
+    }
+    if (name == "pow")
+    {
+        expectArguments(2);
+        convert(compileValue(args[0]), "double");
+        convert(compileValue(args[1]), "double");
+        emit(OpCode::Pow);
+        return {"double", {}};
+    }
+    throw VMError("call to undeclared function '" + name + "'", m_line);
+}
+
+// --- Virtual machine ---
+
+VirtualMachine::VirtualMachine(const BytecodeProgram &program, istream &in, ostream &out, long long step_limit)
+    : m_program(program), m_in(in), m_out(out), m_step_limit(step_limit)
+{
+}
+
+Cell &VirtualMachine::at(long long address, int line)
+{
+    long long block = address >> 32;
+    if (block == 0)
+    {
+        if (address <= 0 || address >= m_stack_top)
+            throw VMError(address == 0 ? "NULL pointer dereference" : "invalid memory access (out of bounds or dangling pointer)", line);
+        return m_memory[address];
+    }
+    size_t index = (size_t)(block - 1);
+    long long offset = address & 0xffffffffLL;
+    if (block < 0 || index >= m_heap.size() || !m_heap_live[index] || offset >= (long long)m_heap[index].size())
+        throw VMError("invalid heap access (out of bounds or freed memory)", line);
+    return m_heap[index][offset];
+}
+
+long long VirtualMachine::allocate(long long cells, int line)
+{
+    if (cells < 0 || cells > MAX_BLOCK_CELLS)
+        throw VMError("allocation of " + to_string(cells) + " elements is too large", line);
+    Cell zero;
+    zero.i = 0;
+    m_heap.emplace_back(max(cells, 1LL), zero);
+    m_heap_live.push_back(true);
+    return (long long)m_heap.size() << 32;
+}
+
+void VirtualMachine::release(long long address, int line)
+{
+    if (address == 0)
+        return;
+    size_t index = (size_t)((address >> 32) - 1);
+    if ((address >> 32) <= 0 || index >= m_heap.size() || (address & 0xffffffffLL) != 0 || !m_heap_live[index])
+        throw VMError("free() of a pointer that malloc did not return (or that was already freed)", line);
+    m_heap_live[index] = false;
+    vector<Cell>().swap(m_heap[index]);
+}
+
+string VirtualMachine::readString(long long address, int line)
+{
+    string text;
+    for (;; ++address)
+    {
+        long long c = at(address, line).i;
+        if (c == 0)
+            return text;
+        text += (char)c;
+    }
+}
+
+template <typename T>
+static string formatValue(const string &spec, T value)
+{
+    int length = snprintf(nullptr, 0, spec.c_str(), value);
+    string text(length > 0 ? length : 0, '\0');
+    if (length > 0)
+        snprintf(&text[0], length + 1, spec.c_str(), value);
+    return text;
+}
+
+void VirtualMachine::printFormatted(const vector<FormatPiece> &format, const Cell *args, int line)
+{
+    string output;
+    size_t next = 0;
+    for (const auto &piece : format)
+    {
+        output += piece.text;
+        if (!piece.conversion)
+            continue;
+        Cell value = args[next++];
+        string spec = "%" + piece.spec;
+        switch (piece.conversion)
+        {
+        case 'd':
+        case 'i':
+            output += formatValue(spec + "lld", value.i);
+            break;
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            output += formatValue(spec + "ll" + piece.conversion,
+                                  piece.long_arg ? (unsigned long long)value.i : (unsigned long long)(uint32_t)value.i);
+            break;
+        case 'c':
+            output += formatValue(spec + "c", (int)(unsigned char)value.i);
+            break;
+        case 's':
+            output += formatValue(spec + "s", readString(value.i, line).c_str());
+            break;
+        case 'p':
+            output += formatValue("0x%llx", (unsigned long long)value.i);
+            break;
+        default:
+            output += formatValue(spec + piece.conversion, value.f);
+            break;
+        }
+    }
+    m_out << output;
+}
+
+// Stores a scanned number into an object of type 'type' (C conversion rules).
+static Cell scannedValue(const string &type, long long integer, double floating, bool is_float)
+{
+    Cell cell;
+    if (isFloating(type))
+    {
+        double value = is_float ? floating : (double)integer;
+        cell.f = type == "float" ? (double)(float)value : value;
+    }
+    else
+    {
+        cell.i = wrapInteger(is_float ? (long long)floating : integer, integerBits(type));
+    }
+    return cell;
+}
+
+void VirtualMachine::scanFormatted(const vector<FormatPiece> &format, const Cell *args, int line)
+{
+    m_out.flush(); // Prompts appear before the program waits for input, like a terminal
+    auto skipSpace = [this]()
+    {
+        while (m_in.peek() != EOF && isspace(m_in.peek()))
+            m_in.get();
+    };
+    size_t next = 0;
+    for (const auto &piece : format)
+    {
+        for (char c : piece.text)
+        {
+            if (isspace((unsigned char)c))
+                skipSpace();
+            else if (m_in.peek() == (unsigned char)c)
+                m_in.get();
+            else
+                return; // Input does not match the format: stop, like scanf
+        }
+        if (!piece.conversion)
+            continue;
+        long long address = piece.suppressed ? 0 : args[next++].i;
+        size_t width = piece.spec.empty() ? 0 : (size_t)stoul(piece.spec);
+        auto take = [&](const string &allowed, string &text)
+        {
+            while (m_in.peek() != EOF && allowed.find((char)m_in.peek()) != string::npos && (width == 0 || text.size() < width))
+                text += (char)m_in.get();
+        };
+        string text;
+        if (piece.conversion == 'c')
+        {
+            int c = m_in.get();
+            if (c == EOF)
+                return;
+            if (!piece.suppressed)
+                at(address, line) = scannedValue(piece.target_type, (signed char)c, 0.0, false);
+            continue;
+        }
+        skipSpace();
+        if (piece.conversion == 's')
+        {
+            while (m_in.peek() != EOF && !isspace(m_in.peek()) && (width == 0 || text.size() < width))
+                text += (char)m_in.get();
+            if (text.empty())
+                return;
+            if (!piece.suppressed)
+            {
+                for (size_t k = 0; k <= text.size(); ++k)
+                    at(address + (long long)k, line).i = k < text.size() ? (signed char)text[k] : 0;
+            }
+            continue;
+        }
+        bool is_float = string("feEgG").find(piece.conversion) != string::npos;
+        take("+-", text);
+        if (piece.conversion == 'x')
+            take("0123456789abcdefABCDEFxX", text);
+        else
+            take(is_float ? "0123456789.eE+-" : "0123456789", text);
+        char *end = nullptr;
+        long long integer = 0;
+        double floating = 0.0;
+        if (is_float)
+            floating = strtod(text.c_str(), &end);
+        else
+            integer = strtoll(text.c_str(), &end, piece.conversion == 'x' ? 16 : 10);
+        if (text.empty() || end == text.c_str())
+            return;
+        if (!piece.suppressed)
+            at(address, line) = scannedValue(piece.target_type, integer, floating, is_float);
+    }
+}
+
+int VirtualMachine::run()
+{
+    m_memory = m_program.static_data;
+    m_stack_top = (long long)m_memory.size();
+    m_memory.resize(max<size_t>(m_memory.size() * 2, 1 << 16));
+    m_heap.clear();
+    m_heap_live.clear();
+    m_stack.clear();
+    m_frames.assign(1, Frame{SIZE_MAX, m_stack_top, {}});
+    m_steps = 0;
+
+    const vector<Instruction> &code = m_program.code;
+    size_t pc = m_program.entry;
+    long long fp = m_stack_top;
+    auto pop = [this]()
+    {
+        Cell value = m_stack.back();
+        m_stack.pop_back();
+        return value;
+    };
+    auto push = [this](Cell value)
+    { m_stack.push_back(value); };
+    auto pushInt = [this](long long value)
+    {
+        Cell cell;
+        cell.i = value;
+        m_stack.push_back(cell);
+    };
+    auto pushFloat = [this](double value)
+    {
+        Cell cell;
+        cell.f = value;
+        m_stack.push_back(cell);
+    };
+    // Wrapping integer arithmetic without undefined behavior in the interpreter itself.
+    auto wrapped = [](unsigned long long value, long long bits)
+    { return wrapInteger((long long)value, bits); };
+
+    while (true)
+    {
+        if (m_step_limit > 0 && ++m_steps > m_step_limit)
+            throw VMError("stopped after " + to_string(m_step_limit) + " instructions (endless loop?); raise the limit with --run-steps",
+                          code[pc].line);
+        const Instruction &ins = code[pc++];
+        switch (ins.op)
+        {
+        case OpCode::PushInt:
+            pushInt(ins.a);
+            break;
+        case OpCode::PushFloat:
+            pushFloat(ins.d);
+            break;
+        case OpCode::Pop:
+            m_stack.pop_back();
+            break;
+        case OpCode::Dup:
+            push(m_stack.back());
+            break;
+        case OpCode::Swap:
+            swap(m_stack[m_stack.size() - 1], m_stack[m_stack.size() - 2]);
+            break;
+        case OpCode::LoadLocal:
+            push(m_memory[fp + ins.a]);
+            break;
+        case OpCode::StoreLocal:
+            m_memory[fp + ins.a] = m_stack.back();
+            break;
+        case OpCode::LoadGlobal:
+            push(m_memory[ins.a]);
+            break;
+        case OpCode::StoreGlobal:
+            m_memory[ins.a] = m_stack.back();
+            break;
+        case OpCode::AddrLocal:
+            pushInt(fp + ins.a);
+            break;
+        case OpCode::Load:
+        {
+            long long address = pop().i;
+            push(at(address, ins.line));
+            break;
+        }
+        case OpCode::Store:
+        {
+            Cell value = pop();
+            long long address = pop().i;
+            at(address, ins.line) = value;
+            push(value);
+            break;
+        }
+        case OpCode::Index:
+        {
+            long long index = pop().i;
+            m_stack.back().i += index * ins.a;
+            break;
+        }
+        case OpCode::AddInt:
+        case OpCode::SubInt:
+        case OpCode::MulInt:
+        case OpCode::DivInt:
+        case OpCode::ModInt:
+        {
+            long long b = pop().i;
+            long long a = m_stack.back().i;
+            long long r;
+            if (ins.op == OpCode::AddInt)
+                r = wrapped((unsigned long long)a + (unsigned long long)b, ins.a);
+            else if (ins.op == OpCode::SubInt)
+                r = wrapped((unsigned long long)a - (unsigned long long)b, ins.a);
+            else if (ins.op == OpCode::MulInt)
+                r = wrapped((unsigned long long)a * (unsigned long long)b, ins.a);
+            else if (b == 0)
+                throw VMError(ins.op == OpCode::DivInt ? "division by zero" : "modulo by zero", ins.line);
+            else if (a == LLONG_MIN && b == -1)
+                r = ins.op == OpCode::DivInt ? LLONG_MIN : 0;
+            else
+                r = wrapped((unsigned long long)(ins.op == OpCode::DivInt ? a / b : a % b), ins.a);
+            m_stack.back().i = r;
+            break;
+        }
+        case OpCode::NegInt:
+            m_stack.back().i = wrapped(0ULL - (unsigned long long)m_stack.back().i, ins.a);
+            break;
+        case OpCode::AddFloat:
+        case OpCode::SubFloat:
+        case OpCode::MulFloat:
+        case OpCode::DivFloat:
+        {
+            double b = pop().f;
+            double a = m_stack.back().f;
+            double r = ins.op == OpCode::AddFloat ? a + b : ins.op == OpCode::SubFloat ? a - b : ins.op == OpCode::MulFloat ? a * b : a / b;
+            m_stack.back().f = ins.a == 32 ? (double)(float)r : r;
+            break;
+        }
+        case OpCode::NegFloat:
+            m_stack.back().f = -m_stack.back().f;
+            break;
+        case OpCode::LessInt:
+        case OpCode::LessEqualInt:
+        case OpCode::GreaterInt:
+        case OpCode::GreaterEqualInt:
+        case OpCode::EqualInt:
+        case OpCode::NotEqualInt:
+        {
+            long long b = pop().i;
+            long long a = m_stack.back().i;
+            bool r = ins.op == OpCode::LessInt ? a < b : ins.op == OpCode::LessEqualInt ? a <= b : ins.op == OpCode::GreaterInt ? a > b
+                                                                                            : ins.op == OpCode::GreaterEqualInt ? a >= b
+                                                                                            : ins.op == OpCode::EqualInt      ? a == b
+                                                                                                                              : a != b;
+            m_stack.back().i = r;
+            break;
+        }
+        case OpCode::LessFloat:
+        case OpCode::LessEqualFloat:
+        case OpCode::GreaterFloat:
+        case OpCode::GreaterEqualFloat:
+        case OpCode::EqualFloat:
+        case OpCode::NotEqualFloat:
+        {
+            double b = pop().f;
+            double a = m_stack.back().f;
+            bool r = ins.op == OpCode::LessFloat ? a < b : ins.op == OpCode::LessEqualFloat ? a <= b : ins.op == OpCode::GreaterFloat ? a > b
+                                                                                                : ins.op == OpCode::GreaterEqualFloat ? a >= b
+                                                                                                : ins.op == OpCode::EqualFloat      ? a == b
+                                                                                                                                    : a != b;
+            m_stack.back().i = r;
+            break;
+        }
+        case OpCode::NotInt:
+            m_stack.back().i = m_stack.back().i == 0;
+            break;
+        case OpCode::NotFloat:
+            m_stack.back().i = m_stack.back().f == 0.0;
+            break;
+        case OpCode::BoolInt:
+            m_stack.back().i = m_stack.back().i != 0;
+            break;
+        case OpCode::BoolFloat:
+            m_stack.back().i = m_stack.back().f != 0.0;
+            break;
+        case OpCode::IntToFloat:
+        case OpCode::IntToFloatNext:
+        {
+            Cell &cell = ins.op == OpCode::IntToFloat ? m_stack.back() : m_stack[m_stack.size() - 2];
+            double value = (double)cell.i;
+            cell.f = ins.a == 32 ? (double)(float)cell.i : value;
+            break;
+        }
+        case OpCode::FloatToInt:
+        {
+            double value = m_stack.back().f;
+            if (!(value > -9.3e18 && value < 9.3e18))
+                throw VMError("floating value out of range for an integer conversion", ins.line);
+            m_stack.back().i = wrapInteger((long long)value, ins.a);
+            break;
+        }
+        case OpCode::WrapInt:
+            m_stack.back().i = wrapInteger(m_stack.back().i, ins.a);
+            break;
+        case OpCode::RoundFloat:
+            m_stack.back().f = (double)(float)m_stack.back().f;
+            break;
+        case OpCode::IncInt:
+        case OpCode::IncIntPost:
+        {
+            Cell &cell = at(pop().i, ins.line);
+            long long old = cell.i;
+            cell.i = wrapped((unsigned long long)old + (unsigned long long)ins.a, ins.b);
+            pushInt(ins.op == OpCode::IncIntPost ? old : cell.i);
+            break;
+        }
+        case OpCode::IncFloat:
+        case OpCode::IncFloatPost:
+        {
+            Cell &cell = at(pop().i, ins.line);
+            double old = cell.f;
+            cell.f = ins.b == 32 ? (double)(float)(old + ins.d) : old + ins.d;
+            pushFloat(ins.op == OpCode::IncFloatPost ? old : cell.f);
+            break;
+        }
+        case OpCode::Jump:
+            pc = (size_t)ins.a;
+            break;
+        case OpCode::JumpIfFalse:
+            if (pop().i == 0)
+                pc = (size_t)ins.a;
+            break;
+        case OpCode::JumpIfTrue:
+            if (pop().i != 0)
+                pc = (size_t)ins.a;
+            break;
+        case OpCode::Call:
+        {
+            const CompiledFunction &function = m_program.functions[ins.a];
+            long long new_fp = m_stack_top;
+            long long new_top = new_fp + function.frame_size;
+            if (new_top > MAX_STACK_CELLS || m_frames.size() > MAX_CALL_DEPTH)
+                throw VMError("stack overflow (recursion too deep) calling " + function.name + "()", ins.line);
+            if (new_top > (long long)m_memory.size())
+                m_memory.resize(max<size_t>((size_t)new_top, m_memory.size() * 2));
+            Cell zero;
+            zero.i = 0;
+            fill(m_memory.begin() + new_fp, m_memory.begin() + new_top, zero);
+            for (long long k = 0; k < ins.b; ++k)
+                m_memory[new_fp + k] = m_stack[m_stack.size() - ins.b + k];
+            m_stack.resize(m_stack.size() - ins.b);
+            m_frames.push_back(Frame{pc, new_fp, {}});
+            m_stack_top = new_top;
+            fp = new_fp;
+            pc = function.entry;
+            break;
+        }
+        case OpCode::Return:
+        {
+            Frame &frame = m_frames.back();
+            for (long long array : frame.arrays)
+                release(array, ins.line);
+            pc = frame.return_pc;
+            m_stack_top = frame.fp;
+            m_frames.pop_back();
+            fp = m_frames.back().fp;
+            break;
+        }
+        case OpCode::Printf:
+            printFormatted(m_program.formats[ins.a], m_stack.data() + m_stack.size() - ins.b, ins.line);
+            m_stack.resize(m_stack.size() - ins.b);
+            break;
+        case OpCode::Scanf:
+            scanFormatted(m_program.formats[ins.a], m_stack.data() + m_stack.size() - ins.b, ins.line);
+            m_stack.resize(m_stack.size() - ins.b);
+            break;
+        case OpCode::Malloc:
+        {
+            long long bytes = m_stack.back().i;
+            m_stack.back().i = allocate((bytes + ins.a - 1) / ins.a, ins.line);
+            break;
+        }
+        case OpCode::Calloc:
+        {
+            long long size = pop().i;
+            long long count = m_stack.back().i;
+            if (size != 0 && count > MAX_BLOCK_CELLS * 8 / size)
+                throw VMError("calloc() of too many elements", ins.line);
+            m_stack.back().i = allocate((count * size + ins.a - 1) / ins.a, ins.line);
+            break;
+        }
+        case OpCode::Free:
+            release(m_stack.back().i, ins.line);
+            m_stack.back().i = 0;
+            break;
+        case OpCode::AllocArray:
+        {
+            long long cells = pop().i;
+            long long old = m_stack.back().i;
+            auto &arrays = m_frames.back().arrays;
+            auto owned = find(arrays.begin(), arrays.end(), old);
+            if (owned != arrays.end())
+            {
+                release(old, ins.line);
+                arrays.erase(owned);
+            }
+            if (cells <= 0)
+                throw VMError("variable length array of non-positive size", ins.line);
+            m_stack.back().i = allocate(cells, ins.line);
+            arrays.push_back(m_stack.back().i);
+            break;
+        }
+        case OpCode::AbsInt:
+            m_stack.back().i = wrapInteger(m_stack.back().i < 0 ? 0 - (unsigned long long)m_stack.back().i : m_stack.back().i, 32);
+            break;
+        case OpCode::AbsFloat:
+            m_stack.back().f = fabs(m_stack.back().f);
+            break;
+        case OpCode::Sqrt:
+            m_stack.back().f = sqrt(m_stack.back().f);
+            break;
+        case OpCode::Pow:
+        {
+            double exponent = pop().f;
+            m_stack.back().f = pow(m_stack.back().f, exponent);
+            break;
+        }
+        case OpCode::Putchar:
+            m_out.put((char)m_stack.back().i);
+            break;
+        case OpCode::Halt:
+            m_out.flush();
+            return (int)m_stack.back().i;
+        }
+    }
+}
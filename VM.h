@@ -0,0 +1,256 @@
+#pragma once
+
+#include "Parser.h" // AST node definitions
+#include "Lexer.h"  // MacroDefinition
+#include "Abi.h"    // sizeof and the width of long
+#include <iostream>
+#include <unordered_map>
+#include <stdexcept>
+using namespace std;
+
+// --- Bytecode VM (--run) ---
+// The C program is compiled from the AST to code for a small stack machine and executed in
+// process, with C semantics (32-bit int arithmetic, truncating division, float rounding, char
+// arithmetic on integers). Used to preview what a program prints without going through Python,
+// and as the reference side when comparing the generated Python's output.
+
+// A compile error (construct --run does not support) or a run-time fault of the program.
+class VMError : public runtime_error
+{
+public:
+    VMError(const string &message, int line = 0) : runtime_error(message), m_line(line) {}
+    int getLine() const { return m_line; } // C line, 0 if unknown
+
+private:
+    int m_line;
+};
+
+enum class OpCode
+{
+    PushInt,   // a: value
+    PushFloat, // d: value
+    Pop,
+    Dup,
+    Swap,
+    LoadLocal,   // a: frame slot
+    StoreLocal,  // a: frame slot (the value stays on the stack)
+    LoadGlobal,  // a: address
+    StoreGlobal, // a: address (the value stays on the stack)
+    AddrLocal,   // a: frame slot; pushes its address
+    Load,        // address -> value
+    Store,       // address value -> value
+    Index,       // address index -> address + index * a
+    AddInt,      // Integer arithmetic, result wrapped to a bits (32 or 64)
+    SubInt,
+    MulInt,
+    DivInt,
+    ModInt,
+    NegInt,
+    AddFloat, // Floating arithmetic; a = 32 rounds the result to float
+    SubFloat,
+    MulFloat,
+    DivFloat,
+    NegFloat,
+    LessInt, // Comparisons push 0 or 1
+    LessEqualInt,
+    GreaterInt,
+    GreaterEqualInt,
+    EqualInt,
+    NotEqualInt,
+    LessFloat,
+    LessEqualFloat,
+    GreaterFloat,
+    GreaterEqualFloat,
+    EqualFloat,
+    NotEqualFloat,
+    NotInt,
+    NotFloat,
+    BoolInt,   // != 0
+    BoolFloat, // != 0.0
+    IntToFloat,     // a = 32 rounds to float
+    IntToFloatNext, // Same, on the value below the top
+    FloatToInt,     // Truncates, then wraps to a bits
+    WrapInt,        // a: 8, 16 or 32 (sign-extending)
+    RoundFloat,     // double -> float precision
+    IncInt,         // address -> new value; a: delta, b: bits (1 = bool)
+    IncIntPost,     // address -> old value
+    IncFloat,       // d: delta, b = 32 rounds to float
+    IncFloatPost,
+    Jump,        // a: target
+    JumpIfFalse, // a: target; pops the condition
+    JumpIfTrue,
+    Call,     // a: function index, b: argument count
+    Return,   // Pops the return value
+    Printf,   // a: format index, b: argument count
+    Scanf,    // a: format index, b: argument count
+    Malloc,   // bytes -> address; a: element size in bytes (a cell holds one element)
+    Calloc,   // count size -> address; a: element size
+    Free,     // address -> 0
+    AllocArray, // old-address cells -> address (variable length arrays; the old block is released)
+    AbsInt,
+    AbsFloat,
+    Sqrt,
+    Pow,
+    Putchar,
+    Halt
+};
+
+struct Instruction
+{
+    OpCode op;
+    long long a = 0;
+    long long b = 0;
+    double d = 0.0;
+    int line = 0; // C line, for run-time errors
+};
+
+// One piece of a printf/scanf format: literal text followed by at most one conversion.
+struct FormatPiece
+{
+    string text;          // Literal text before the conversion
+    char conversion = 0;  // 'd', 'f', 's', ...; 0 for trailing text only
+    string spec;          // Flags, width and precision between '%' and the conversion, e.g. "-8.3"
+    bool long_arg = false; // l/ll length modifier
+    bool suppressed = false; // scanf %*d: read and discard
+    string target_type;    // scanf: C type of the object the value is stored into
+};
+
+struct CompiledFunction
+{
+    string name;
+    int parameters = 0;
+    int frame_size = 0; // Cells: parameters, locals and fixed-size local arrays
+    size_t entry = 0;
+};
+
+union Cell
+{
+    long long i;
+    double f;
+};
+
+struct BytecodeProgram
+{
+    vector<Instruction> code;
+    vector<CompiledFunction> functions;
+    vector<vector<FormatPiece>> formats;
+    vector<Cell> static_data; // Globals and string literals; address 0 is NULL
+    size_t entry = 0;         // Global initializers, then main()
+};
+
+// Compiles a parsed program to bytecode. Throws VMError for constructs it does not support.
+class BytecodeCompiler
+{
+public:
+    BytecodeCompiler(const vector<MacroDefinition> &macros, const TargetAbi &abi);
+    BytecodeProgram compile(shared_ptr<ProgramNode> program);
+
+private:
+    BytecodeProgram compileProgram(shared_ptr<ProgramNode> program); // After the macro bodies are parsed
+    // Type of an object or value: an array of 'scalar' when dims is not empty (dims[0] is 0 for
+    // array parameters, whose length is unknown), otherwise a scalar ("int", "char*", ...).
+    struct CType
+    {
+        string scalar;
+        vector<long long> dims;
+    };
+    struct Symbol
+    {
+        CType type;
+        bool global = false;
+        long long address = 0;  // Global address or frame slot
+        bool indirect = false;  // The slot holds the array's address (array parameters, variable length arrays)
+        long long length_slot = -1; // Variable length array: frame slot holding its length (dims[0] is 0)
+    };
+    struct FunctionInfo
+    {
+        shared_ptr<FunctionDeclarationNode> decl;
+        int index = 0;
+        string return_type;
+        vector<CType> parameter_types;
+    };
+    struct LoopLabels
+    {
+        vector<size_t> breaks;
+        vector<size_t> continues;
+    };
+
+    void compileFunction(const FunctionInfo &function);
+    void compileStatement(const shared_ptr<StatementNode> &stmt);
+    void compileDeclaration(const shared_ptr<VariableDeclarationNode> &decl, bool global);
+    void compileLoopBody(const shared_ptr<StatementNode> &body, LoopLabels &labels);
+    void compileCondition(const shared_ptr<ExpressionNode> &expr); // Pushes an integer that is nonzero when expr holds
+    void compilePrintf(const shared_ptr<PrintfNode> &stmt);
+    void compileScanf(const shared_ptr<ScanfNode> &stmt);
+    CType compileValue(const shared_ptr<ExpressionNode> &expr);
+    CType compileAddress(const shared_ptr<ExpressionNode> &expr); // Pushes the address of an lvalue, returns its type
+    CType compileBinary(const shared_ptr<BinaryExpressionNode> &expr);
+    CType compileUnary(const shared_ptr<UnaryExpressionNode> &expr);
+    CType compileCall(const shared_ptr<FunctionCallNode> &call);
+    CType compileIdentifier(const shared_ptr<IdentifierNode> &ident, bool address);
+    CType compileAssignment(const shared_ptr<AssignmentNode> &assign);
+    void convert(const CType &from, const string &to);
+    long long constantInteger(const shared_ptr<ExpressionNode> &expr);
+    long long stringAddress(const string &text);
+    const Symbol *lookup(const string &name) const;
+    string scalarType(const string &declared) const; // Declared type name -> scalar type ("string" is char*)
+    long long sizeOf(const CType &type) const;        // sizeof under m_abi
+    CType staticType(const shared_ptr<ExpressionNode> &expr);
+    long long sizeofValue(const shared_ptr<SizeofNode> &node);
+    const Symbol *variableLengthArray(const shared_ptr<SizeofNode> &node) const; // sizeof of one: taken at run time
+    size_t emit(OpCode op, long long a = 0, long long b = 0, double d = 0.0);
+    void patch(size_t at, size_t target) { m_program.code[at].a = (long long)target; }
+
+    TargetAbi m_abi;
+    vector<MacroDefinition> m_macros; // Parsed by compile(), with the program's enumerators
+    BytecodeProgram m_program;
+    unordered_map<string, FunctionInfo> m_functions;
+    unordered_map<string, shared_ptr<ExpressionNode>> m_object_macros;
+    unordered_map<string, pair<vector<string>, shared_ptr<ExpressionNode>>> m_function_macros;
+    vector<unordered_map<string, shared_ptr<ExpressionNode>>> m_macro_arguments; // Innermost expansion last
+    int m_macro_depth = 0;
+    vector<unordered_map<string, Symbol>> m_scopes; // [0]: globals
+    vector<LoopLabels *> m_loops;
+    vector<shared_ptr<VariableDeclarationNode>> m_global_initializers;
+    unordered_map<string, long long> m_strings; // Interned string literals
+    string m_return_type;  // Of the function being compiled
+    int m_frame_size = 0;
+    int m_line = 0; // C line of the statement being compiled
+    long long m_allocation_element = 1; // Element size of the pointer a malloc result is stored into
+};
+
+// Executes a compiled program: printf output goes to 'out', scanf reads 'in'.
+class VirtualMachine
+{
+public:
+    VirtualMachine(const BytecodeProgram &program, istream &in, ostream &out, long long step_limit);
+    int run(); // Runs main(); returns its exit status. Throws VMError on run-time faults.
+    long long getStepsUsed() const { return m_steps; }
+
+private:
+    Cell &at(long long address, int line);
+    void printFormatted(const vector<FormatPiece> &format, const Cell *args, int line);
+    void scanFormatted(const vector<FormatPiece> &format, const Cell *args, int line);
+    string readString(long long address, int line);
+    long long allocate(long long cells, int line);
+    void release(long long address, int line);
+
+    struct Frame
+    {
+        size_t return_pc;
+        long long fp;
+        vector<long long> arrays; // Variable length arrays to release on return
+    };
+
+    const BytecodeProgram &m_program;
+    istream &m_in;
+    ostream &m_out;
+    long long m_step_limit;
+    long long m_steps = 0;
+    vector<Cell> m_memory; // Static data, then the frames of active calls
+    long long m_stack_top = 0;
+    vector<vector<Cell>> m_heap; // malloc blocks; address = (block + 1) << 32 | offset
+    vector<bool> m_heap_live;
+    vector<Cell> m_stack; // Operand stack
+    vector<Frame> m_frames;
+};
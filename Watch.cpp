@@ -0,0 +1,206 @@
+#include "Watch.h"
+#include "Project.h" // ProjectManifest
+#include <filesystem>
+#include <chrono>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <cstring>
+#include <cerrno>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace
+{
+#ifdef __linux__
+    // inotify on a set of directories. Directories rather than files: editors often save by writing
+    // a new file and renaming it over the old one, which a watch on the old file would not see.
+    class DirectoryWatcher
+    {
+    public:
+        DirectoryWatcher() : m_fd(inotify_init1(IN_CLOEXEC)) {}
+        ~DirectoryWatcher()
+        {
+            if (m_fd >= 0)
+                close(m_fd);
+        }
+
+        bool ok() const { return m_fd >= 0; }
+        size_t size() const { return m_directories.size(); }
+
+        // Watches 'directory', and with 'recursive' every directory below it, now and later.
+        void watch(const fs::path &directory, bool recursive)
+        {
+            error_code ec;
+            if (!fs::is_directory(directory, ec))
+                return;
+            auto known = m_recursive.find(directory);
+            if (known != m_recursive.end() && (known->second || !recursive))
+                return;
+            int wd = inotify_add_watch(m_fd, directory.c_str(),
+                                       IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_ONLYDIR);
+            if (wd < 0)
+                return;
+            m_directories[wd] = directory;
+            m_recursive[directory] = recursive;
+            if (recursive)
+            {
+                for (const auto &entry : fs::directory_iterator(directory, ec))
+                {
+                    if (entry.is_directory(ec))
+                        watch(entry.path(), true);
+                }
+            }
+        }
+
+        enum Result
+        {
+            TIMEOUT,
+            IRRELEVANT, // Only events about other files: the Python being written, temporary files, ...
+            RELEVANT    // A C source or header changed, or a directory appeared
+        };
+
+        // Waits up to 'timeout_ms' (-1: for ever) for events.
+        Result wait(int timeout_ms)
+        {
+            pollfd request{m_fd, POLLIN, 0};
+            int ready = poll(&request, 1, timeout_ms);
+            if (ready <= 0)
+                return TIMEOUT;
+            alignas(inotify_event) char buffer[65536];
+            ssize_t size = read(m_fd, buffer, sizeof(buffer));
+            bool relevant = false;
+            for (ssize_t pos = 0; pos < size;)
+            {
+                const inotify_event *event = (const inotify_event *)(buffer + pos);
+                pos += sizeof(inotify_event) + event->len;
+                if (event->mask & IN_Q_OVERFLOW)
+                {
+                    relevant = true; // Events were lost: check everything
+                    continue;
+                }
+                auto directory = m_directories.find(event->wd);
+                if (directory == m_directories.end())
+                    continue;
+                if (event->mask & IN_IGNORED) // The directory is gone
+                {
+                    m_recursive.erase(directory->second);
+                    m_directories.erase(directory);
+                    continue;
+                }
+                if (event->len == 0)
+                    continue;
+                fs::path path = directory->second / event->name;
+                if (event->mask & IN_ISDIR)
+                {
+                    if ((event->mask & (IN_CREATE | IN_MOVED_TO)) && m_recursive[directory->second])
+                    {
+                        watch(path, true);
+                        relevant = true; // It may have brought sources along
+                    }
+                    continue;
+                }
+                string extension = path.extension().string();
+                if (extension == ".c" || extension == ".h")
+                    relevant = true;
+            }
+            return relevant ? RELEVANT : IRRELEVANT;
+        }
+
+    private:
+        int m_fd;
+        map<int, fs::path> m_directories;  // By watch descriptor
+        map<fs::path, bool> m_recursive;   // Watched directories: whether their subdirectories are too
+    };
+#endif
+}
+
+int runWatch(const vector<string> &inputs, const WatchOptions &options, ostream &out, ostream &err)
+{
+#ifndef __linux__
+    err << "--watch is only available on Linux (inotify)" << endl;
+    return 1;
+#else
+    DirectoryWatcher watcher;
+    if (!watcher.ok())
+    {
+        err << "Watch Error: inotify: " << strerror(errno) << endl;
+        return 1;
+    }
+    string problem;
+    ProjectManifest project(options.batch.manifest, problem);
+    if (!problem.empty())
+        err << "Project Warning: " << problem << endl;
+    BatchOptions batch = options.batch;
+    batch.project = &project;
+
+    // Sources: the input directories with everything below them, and the directories of input files.
+    // Headers: the directories of every file the manifest knows, refreshed after each build, since
+    // sources may start including headers from elsewhere.
+    auto addWatches = [&]()
+    {
+        for (const auto &input : inputs)
+        {
+            error_code ec;
+            if (fs::is_directory(input, ec))
+                watcher.watch(fs::absolute(input), true);
+            else
+                watcher.watch(fs::absolute(input).parent_path(), false);
+        }
+        for (const auto &file : project.files())
+            watcher.watch(fs::path(file).parent_path(), false);
+    };
+
+    try
+    {
+        runBatch(inputs, batch, out, err);
+    }
+    catch (const std::exception &e)
+    {
+        err << "Batch Error: " << e.what() << endl;
+        return 1;
+    }
+    addWatches();
+    out << "Watch: watching " << watcher.size() << " director" << (watcher.size() == 1 ? "y" : "ies")
+        << " for changes (Ctrl+C to stop)" << endl;
+
+    while (true)
+    {
+        if (watcher.wait(-1) != DirectoryWatcher::RELEVANT)
+            continue;
+        // Still writing: wait until no relevant event came for the debounce interval
+        auto edit = chrono::steady_clock::now();
+        auto last_event = edit;
+        while (true)
+        {
+            auto quiet = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - last_event).count();
+            if (quiet >= options.debounce_ms)
+                break;
+            if (watcher.wait((int)(options.debounce_ms - quiet)) == DirectoryWatcher::RELEVANT)
+                last_event = chrono::steady_clock::now();
+        }
+
+        BatchSummary summary;
+        try
+        {
+            runBatch(inputs, batch, out, err, &summary);
+        }
+        catch (const std::exception &e)
+        {
+            err << "Batch Error: " << e.what() << endl; // An input was deleted, say; keep watching
+        }
+        double milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - edit).count();
+        addWatches();
+        out << "Watch: " << summary.transpiled << " file" << (summary.transpiled == 1 ? "" : "s") << " rebuilt";
+        if (summary.failed > 0)
+            out << " (" << summary.failed << " failed)";
+        out << " " << fixed << setprecision(1) << milliseconds << " ms after the edit (debounce " << options.debounce_ms
+            << " ms)" << endl;
+    }
+#endif
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "Batch.h" // BatchOptions
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// --- Watch mode (--watch, Linux) ---
+// Batch mode that does not exit: after a first build of 'inputs' it waits for changes (inotify on the
+// input directories, recursively, and on the directories of every header the sources include) and
+// rebuilds. A burst of writes (an editor saving several files, or writing one in several steps) makes
+// one rebuild, once no event came for the debounce interval. Rebuilds are incremental, as in project
+// mode (Project.h): the manifest is kept in memory between rebuilds (and saved to --project, if
+// given), so only the units whose source or headers changed are transpiled. The .py files are
+// replaced atomically. After each rebuild a line gives the time from the first write of the burst to
+// the last output written, e.g.
+//   Watch: 1 file rebuilt 112.4 ms after the edit (debounce 100 ms)
+
+struct WatchOptions
+{
+    BatchOptions batch;
+    int debounce_ms = 100; // Quiet time after the last event before rebuilding
+};
+
+// Runs until the process is killed. Returns 1 (after a message on 'err') if watching is not possible.
+int runWatch(const vector<string> &inputs, const WatchOptions &options, ostream &out, ostream &err);
@@ -0,0 +1,283 @@
+import os
+import sys
+import json
+import time
+import shutil
+import threading
+import argparse
+import tempfile
+import subprocess
+
+# Benchmark of the generated Python against the same program built with gcc.
+# For every C program of the corpus: build it with gcc, transpile it, run both on the same fixed
+# stdin and compare what they print (stdout and exit status, byte for byte). Reported per program:
+# runtime ratio (Python time / C time, best of --repeat runs), peak RSS of the Python run and size
+# of the generated Python. The report goes to bench_output.txt; the exit status is 1 when a program
+# got worse than in the stored baseline (bench_baseline.json), which --update-baseline rewrites.
+#
+#   python bench.py                       # the corpus below
+#   python bench.py more.c tests/         # plus more programs (stdin: more.in next to more.c, if any)
+#   python bench.py --update-baseline     # accept the current numbers
+
+# Programs that are always benchmarked, with the stdin they get. Each one prints the same as its gcc
+# build, so that a mismatch in the report is a regression rather than a known difference.
+CORPUS = [
+    ("input_code.c", "7\n"),
+    ("bench/sieve.c", "100000\n"),       # nested loops over a large array
+    ("bench/sort.c", "2000\n"),          # calls in the inner loop, array parameter writes
+    ("bench/fib.c", "25\n"),             # recursion
+    ("bench/matrix.c", ""),              # 2-D global arrays
+    ("bench/collatz.c", "30000\n"),      # while loops, output without newlines
+    ("bench/minmax.c", "6\n4\n-2\n17\n9\n0\n3\n"),  # scalars passed by address
+    ("bench/pointers.c", "3000\n"),     # pointers into a buffer passed to functions, fill/copy loops
+    ("bench/tables.c", "2000\n"),       # global lookup tables filled by an init function and at the top of main
+]
+
+BASELINE_FILE = "bench_baseline.json"
+REPORT_FILE = "bench_output.txt"
+
+# The generated code defines main() but does not call it; the runner does, and exits with its result.
+# The prompts the generated scanf code passes to input() are not part of what the C program prints,
+# so the runner's input() reads a line without writing one.
+PYTHON_RUNNER = (
+    "import builtins, runpy, sys\n"
+    "def _input(prompt=''):\n"
+    "    line = sys.stdin.readline()\n"
+    "    if not line:\n"
+    "        raise EOFError\n"
+    "    return line.rstrip('\\n')\n"
+    "builtins.input = _input\n"
+    "g = runpy.run_path(sys.argv[1], run_name='bench')\n"
+    "r = g['main']() if 'main' in g else 0\n"
+    "sys.stdout.flush()\n"
+    "sys.exit(r if isinstance(r, int) else 0)\n"
+)
+
+
+def default_transpiler():
+    if sys.platform == 'win32':
+        return 'transpiler.exe'
+    return os.path.join('.', 'transpiler')
+
+
+def collect_programs(paths):
+    programs = [(path, stdin) for path, stdin in CORPUS]
+    for path in paths:
+        files = []
+        if os.path.isdir(path):
+            for root, _, names in os.walk(path):
+                files += [os.path.join(root, name) for name in sorted(names) if name.endswith('.c')]
+        else:
+            files.append(path)
+        for file in files:
+            input_file = os.path.splitext(file)[0] + '.in'
+            stdin = ""
+            if os.path.exists(input_file):
+                with open(input_file, encoding='utf-8') as f:
+                    stdin = f.read()
+            programs.append((file, stdin))
+    return programs
+
+
+def run_measured(command, stdin, timeout):
+    """Runs command with stdin; returns (stdout bytes, exit status, wall seconds, peak RSS in KB or None)."""
+    with tempfile.TemporaryFile() as input_file:
+        input_file.write(stdin.encode('utf-8'))
+        input_file.seek(0)
+        start = time.perf_counter()
+        process = subprocess.Popen(command, stdin=input_file, stdout=subprocess.PIPE, stderr=subprocess.DEVNULL)
+        if not hasattr(os, 'wait4'):
+            stdout, _ = process.communicate(timeout=timeout)
+            return stdout, process.returncode, time.perf_counter() - start, None
+        # Reap the child ourselves: wait4 also gives its resource usage (ru_maxrss is in KB on Linux).
+        timer = threading.Timer(timeout, process.kill)
+        timer.start()
+        stdout = process.stdout.read()
+        _, status, usage = os.wait4(process.pid, 0)
+        timer.cancel()
+        elapsed = time.perf_counter() - start
+        process.returncode = os.waitstatus_to_exitcode(status)
+        process.stdout.close()
+        return stdout, process.returncode, elapsed, usage.ru_maxrss
+
+
+def best_of(command, stdin, repeat, timeout):
+    """Runs command 'repeat' times; the output and status of the first run, the fastest time, the highest RSS."""
+    output, status, best, peak = None, None, None, None
+    for _ in range(repeat):
+        stdout, code, elapsed, rss = run_measured(command, stdin, timeout)
+        if output is None:
+            output, status = stdout, code
+        best = elapsed if best is None else min(best, elapsed)
+        if rss is not None:
+            peak = rss if peak is None else max(peak, rss)
+    return output, status, best, peak
+
+
+def first_difference(a, b):
+    for i in range(min(len(a), len(b))):
+        if a[i] != b[i]:
+            return i
+    return min(len(a), len(b))
+
+
+def read_frames(data):
+    """--framed transpiler output ("<kind> <length>\\n<payload>\\n"...) -> {kind: payload of its last frame}."""
+    frames = {}
+    pos = 0
+    while pos < len(data):
+        header_end = data.index(b"\n", pos)
+        kind, length = data[pos:header_end].decode('ascii').split(" ")
+        start = header_end + 1
+        frames[kind] = data[start:start + int(length)]
+        pos = start + int(length) + 1
+    return frames
+
+
+def bench_program(path, stdin, args, work_dir):
+    result = {"program": path}
+    name = os.path.splitext(os.path.basename(path))[0]
+    executable = os.path.join(work_dir, name + ('.exe' if sys.platform == 'win32' else ''))
+    python_file = os.path.join(work_dir, name + '.py')
+
+    build = subprocess.run([args.cc, '-O2', '-w', '-o', executable, path, '-lm'], capture_output=True, text=True)
+    if build.returncode != 0:
+        result["error"] = "gcc failed: " + build.stderr.strip().splitlines()[0] if build.stderr.strip() else "gcc failed"
+        return result
+
+    with open(path, 'rb') as f:
+        source = f.read()
+    transpile = subprocess.run([args.transpiler, '--framed'], input=source, capture_output=True)
+    frames = read_frames(transpile.stdout)
+    if transpile.returncode != 0 or "python" not in frames:
+        errors = [json.loads(payload)["message"] for kind, payload in frames.items() if kind == "diagnostic"]
+        result["error"] = "transpiler failed: " + (errors[0] if errors else "no Python code")
+        return result
+    python_code = frames["python"].decode('utf-8')
+    with open(python_file, 'w', encoding='utf-8') as f:
+        f.write(python_code)
+    result["python_bytes"] = len(python_code.encode('utf-8'))
+
+    c_output, c_status, c_time, _ = best_of([executable], stdin, args.repeat, args.timeout)
+    py_output, py_status, py_time, py_rss = best_of(
+        [sys.executable, '-c', PYTHON_RUNNER, python_file], stdin, args.repeat, args.timeout)
+
+    result["output_match"] = c_output == py_output and c_status == py_status
+    if not result["output_match"]:
+        if c_output != py_output:
+            at = first_difference(c_output, py_output)
+            result["mismatch"] = "stdout differs at byte %d (C %d bytes, Python %d bytes)" % (at, len(c_output), len(py_output))
+        else:
+            result["mismatch"] = "exit status %d vs %d" % (c_status, py_status)
+    result["c_seconds"] = c_time
+    result["python_seconds"] = py_time
+    result["runtime_ratio"] = py_time / c_time if c_time > 0 else None
+    result["python_peak_rss_kb"] = py_rss
+    return result
+
+
+def regressions(result, baseline, args):
+    """What got worse than the baseline entry of the same program."""
+    found = []
+    if "error" in result:
+        if "error" not in baseline:
+            found.append(result["error"])
+        return found
+    if baseline.get("output_match") and not result["output_match"]:
+        found.append("output no longer matches C: " + result["mismatch"])
+
+    def grew(key, tolerance, label):
+        old, new = baseline.get(key), result.get(key)
+        if old and new is not None and new > old * (1 + tolerance):
+            found.append("%s %s -> %s (+%.0f%%)" % (label, format_number(old), format_number(new), (new / old - 1) * 100))
+
+    grew("runtime_ratio", args.tolerance, "runtime ratio")
+    grew("python_peak_rss_kb", args.tolerance, "peak RSS KB")
+    grew("python_bytes", args.size_tolerance, "Python bytes")
+    return found
+
+
+def format_number(value):
+    if value is None:
+        return "-"
+    if isinstance(value, float):
+        return "%.2f" % value
+    return str(value)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmark the generated Python against gcc-built C.")
+    parser.add_argument('programs', nargs='*', help="more C files or directories (searched recursively)")
+    parser.add_argument('--transpiler', default=default_transpiler())
+    parser.add_argument('--cc', default='gcc')
+    parser.add_argument('--repeat', type=int, default=5, help="runs per program; the fastest counts (default 5)")
+    parser.add_argument('--timeout', type=float, default=60)
+    parser.add_argument('--tolerance', type=float, default=0.5,
+                        help="allowed growth of runtime ratio and RSS before it counts as a regression (default 0.5 = 50%%)")
+    parser.add_argument('--size-tolerance', type=float, default=0.1,
+                        help="allowed growth of the generated code (default 0.1 = 10%%)")
+    parser.add_argument('--baseline', default=BASELINE_FILE)
+    parser.add_argument('--output', default=REPORT_FILE)
+    parser.add_argument('--update-baseline', action='store_true', help="store the current results as the baseline")
+    args = parser.parse_args()
+
+    if shutil.which(args.cc) is None:
+        print("Bench Error: C compiler '%s' not found" % args.cc, file=sys.stderr)
+        return 2
+    if shutil.which(args.transpiler) is None and not os.path.exists(args.transpiler):
+        print("Bench Error: transpiler '%s' not found (build it first, see README)" % args.transpiler, file=sys.stderr)
+        return 2
+
+    baseline = {}
+    if os.path.exists(args.baseline):
+        with open(args.baseline, encoding='utf-8') as f:
+            baseline = json.load(f).get("programs", {})
+
+    results = []
+    with tempfile.TemporaryDirectory() as work_dir:
+        for path, stdin in collect_programs(args.programs):
+            results.append(bench_program(path, stdin, args, work_dir))
+
+    lines = ["%-28s %-8s %10s %10s %8s %12s %10s" % ("program", "output", "C s", "Python s", "ratio", "py RSS KB", "py bytes")]
+    failed = False
+    for result in results:
+        if "error" in result:
+            lines.append("%-28s ERROR    %s" % (result["program"], result["error"]))
+        else:
+            lines.append("%-28s %-8s %10.4f %10.4f %8s %12s %10d" % (
+                result["program"], "match" if result["output_match"] else "MISMATCH",
+                result["c_seconds"], result["python_seconds"], format_number(result["runtime_ratio"]),
+                format_number(result["python_peak_rss_kb"]), result["python_bytes"]))
+            if not result["output_match"]:
+                lines.append("    " + result["mismatch"])
+        if result["program"] not in baseline:
+            lines.append("    (not in baseline)")
+            continue
+        for regression in regressions(result, baseline[result["program"]], args):
+            lines.append("    REGRESSION: " + regression)
+            failed = True
+
+    if args.update_baseline:
+        stored = {}
+        for result in results:
+            stored[result["program"]] = {key: round(result[key], 2) if isinstance(result[key], float) else result[key]
+                                         for key in
+                                         ("error", "output_match", "runtime_ratio", "python_peak_rss_kb", "python_bytes")
+                                         if key in result}
+        with open(args.baseline, 'w', encoding='utf-8') as f:
+            json.dump({"programs": stored}, f, indent=2, sort_keys=True)
+            f.write("\n")
+        lines.append("baseline written to " + args.baseline)
+        failed = False
+    elif failed:
+        lines.append("FAILED: regressions against " + args.baseline)
+
+    report = "\n".join(lines) + "\n"
+    with open(args.output, 'w', encoding='utf-8') as f:
+        f.write(report)
+    sys.stdout.write(report)
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,31 @@
+#include <stdio.h>
+
+// Longest Collatz chain below a bound; prints progress without newlines, then ends the line
+int steps(long n) {
+    int count = 0;
+    while (n != 1) {
+        if (n % 2 == 0)
+            n = n / 2;
+        else
+            n = 3 * n + 1;
+        count++;
+    }
+    return count;
+}
+
+int main() {
+    int bound;
+    scanf("%d", &bound);
+    int best = 1;
+    int best_steps = 0;
+    for (int i = 1; i < bound; i++) {
+        int s = steps(i);
+        if (s > best_steps) {
+            best_steps = s;
+            best = i;
+            printf("%d ", i);
+        }
+    }
+    printf("\nlongest chain below %d starts at %d (%d steps)\n", bound, best, best_steps);
+    return 0;
+}
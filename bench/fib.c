@@ -0,0 +1,17 @@
+#include <stdio.h>
+
+// Naive recursion: call overhead dominates
+int fib(int n) {
+    if (n < 2)
+        return n;
+    return fib(n - 1) + fib(n - 2);
+}
+
+int main() {
+    int n;
+    scanf("%d", &n);
+    for (int i = 0; i <= n; i = i + 5) {
+        printf("fib(%d) = %d\n", i, fib(i));
+    }
+    return 0;
+}
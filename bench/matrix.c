@@ -0,0 +1,36 @@
+#include <stdio.h>
+
+#define N 60
+
+int a[N][N];
+int b[N][N];
+int c[N][N];
+
+// Integer matrix product, then the trace and a row sum of the result
+int main() {
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < N; j++) {
+            a[i][j] = (i + j) % 7;
+            b[i][j] = (i * j) % 5;
+        }
+    }
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < N; j++) {
+            int sum = 0;
+            for (int k = 0; k < N; k++) {
+                sum = sum + a[i][k] * b[k][j];
+            }
+            c[i][j] = sum;
+        }
+    }
+    int trace = 0;
+    for (int i = 0; i < N; i++) {
+        trace = trace + c[i][i];
+    }
+    int row = 0;
+    for (int j = 0; j < N; j++) {
+        row = row + c[N - 1][j];
+    }
+    printf("trace %d, last row sum %d\n", trace, row);
+    return 0;
+}
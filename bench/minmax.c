@@ -0,0 +1,27 @@
+#include <stdio.h>
+
+// Reads numbers and reports their range through pointer out-parameters
+void bounds(int *values, int n, int *low, int *high) {
+    *low = values[0];
+    *high = values[0];
+    for (int i = 1; i < n; i++) {
+        if (values[i] < *low)
+            *low = values[i];
+        if (values[i] > *high)
+            *high = values[i];
+    }
+}
+
+int main() {
+    int n;
+    scanf("%d", &n);
+    int values[100];
+    for (int i = 0; i < n; i++) {
+        scanf("%d", &values[i]);
+    }
+    int low;
+    int high;
+    bounds(values, n, &low, &high);
+    printf("%d values from %d to %d\n", n, low, high);
+    return 0;
+}
@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+// Sorting blocks of a buffer through pointers into its middle
+void fill(int *p, int n, int v) {
+    for (int i = 0; i < n; i++)
+        p[i] = v;
+}
+
+void isort(int a[], int n) {
+    for (int i = 1; i < n; i++) {
+        int j = i;
+        while (j > 0 && a[j - 1] > a[j]) {
+            int t = a[j];
+            a[j] = a[j - 1];
+            a[j - 1] = t;
+            j = j - 1;
+        }
+    }
+}
+
+int total(int *p, int n) {
+    int s = 0;
+    for (int i = 0; i < n; i++)
+        s = s + p[i];
+    return s;
+}
+
+int main() {
+    int n;
+    scanf("%d", &n);
+    int *buf = malloc(n * sizeof(int));
+    int seed = 4321;
+    for (int i = 0; i < n; i++) {
+        seed = (seed * 1103 + 12345) % 65536;
+        buf[i] = seed % 1000;
+    }
+    // Each block of 100 sorted in place, then its first ten overwritten
+    int *block = buf;
+    int blocks = 0;
+    while (block + 100 <= buf + n) {
+        isort(block, 100);
+        fill(block, 10, blocks);
+        block = block + 100;
+        blocks = blocks + 1;
+    }
+    isort(&buf[0], 50);
+    int *p = buf;
+    p++;
+    int copy[20];
+    for (int i = 0; i < 20; i++)
+        copy[i] = p[i];
+    for (int i = 0; i < 5; i++)
+        p[i] = 7;
+    int checksum = 0;
+    for (int i = 0; i < n; i++) {
+        checksum = (checksum * 31 + buf[i]) % 1000003;
+    }
+    printf("%d blocks, block sums %d %d, copy %d %d, checksum %d\n", blocks, total(buf, 100), total(buf + 100, 100),
+           copy[0], copy[19], checksum);
+    free(buf);
+    return 0;
+}
@@ -0,0 +1,24 @@
+#include <stdio.h>
+
+// Sieve of Eratosthenes: counts the primes below a limit read from stdin
+int main() {
+    int limit;
+    scanf("%d", &limit);
+    int composite[200000];
+    for (int i = 0; i < limit; i++) {
+        composite[i] = 0;
+    }
+    int count = 0;
+    int last = 0;
+    for (int i = 2; i < limit; i++) {
+        if (composite[i] == 0) {
+            count = count + 1;
+            last = i;
+            for (int j = i * 2; j < limit; j = j + i) {
+                composite[j] = 1;
+            }
+        }
+    }
+    printf("%d primes below %d, the largest is %d\n", count, limit, last);
+    return 0;
+}
@@ -0,0 +1,32 @@
+#include <stdio.h>
+
+// Insertion sort of pseudo-random numbers
+void swap(int v[], int i, int j) {
+    int t = v[i];
+    v[i] = v[j];
+    v[j] = t;
+}
+
+int main() {
+    int n;
+    scanf("%d", &n);
+    int values[5000];
+    int seed = 12345;
+    for (int i = 0; i < n; i++) {
+        seed = (seed * 1103 + 12345) % 65536;
+        values[i] = seed % 1000;
+    }
+    for (int i = 1; i < n; i++) {
+        int j = i;
+        while (j > 0 && values[j - 1] > values[j]) {
+            swap(values, j - 1, j);
+            j = j - 1;
+        }
+    }
+    int checksum = 0;
+    for (int i = 0; i < n; i++) {
+        checksum = (checksum * 31 + values[i]) % 1000003;
+    }
+    printf("smallest %d, largest %d, checksum %d\n", values[0], values[n - 1], checksum);
+    return 0;
+}
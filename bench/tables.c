@@ -0,0 +1,37 @@
+#include <stdio.h>
+
+// Lookup tables filled once at startup: by an init function and by a loop at the top of main
+int squares[256];
+int bits[256];
+int fact[13];
+
+void init_tables() {
+    for (int i = 0; i < 256; i++) {
+        squares[i] = i * i;
+        int v = i;
+        int count = 0;
+        while (v > 0) {
+            count = count + v % 2;
+            v = v / 2;
+        }
+        bits[i] = count;
+    }
+}
+
+int main() {
+    int rounds;
+    init_tables();
+    fact[0] = 1;
+    for (int i = 1; i < 13; i++) {
+        fact[i] = fact[i - 1] * i;
+    }
+    scanf("%d", &rounds);
+    long total = 0;
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < 256; i++) {
+            total = total + squares[i] % 97 + bits[i] + fact[(i + r) % 13] % 89;
+        }
+    }
+    printf("total %ld after %d rounds\n", total, rounds);
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include "codemorph.h"
+#include "Request.h"
+#include <mutex>
+#include <memory>
+#include <new>
+#include <cstring>
+#include <unordered_map>
+
+struct cm_context
+{
+    TranspilerOptions defaults;
+    mutex lock;
+    unordered_map<string, unique_ptr<MacroTranslationCache>> macro_caches; // By options text, --emit lines removed
+
+    MacroTranslationCache *macroCache(const string &options_text)
+    {
+        lock_guard<mutex> guard(lock);
+        auto &cache = macro_caches[options_text];
+        if (!cache)
+            cache = make_unique<MacroTranslationCache>();
+        return cache.get();
+    }
+};
+
+struct cm_result
+{
+    TranspileResult result;
+    // Built on first request, so that callers who only want the Python never pay for them.
+    mutable string diagnostics;
+    mutable string frames;
+    mutable bool has_diagnostics = false;
+    mutable bool has_frames = false;
+};
+
+namespace
+{
+    cm_view view(const string &text)
+    {
+        return {text.data(), text.size()};
+    }
+
+    // The options that decide how macros translate: everything but the --emit lines.
+    string translationOptions(const string &options_text)
+    {
+        string kept;
+        size_t start = 0;
+        while (start < options_text.size())
+        {
+            size_t end = options_text.find('\n', start);
+            if (end == string::npos)
+                end = options_text.size();
+            string option = options_text.substr(start, end - start);
+            if (option.rfind("--emit=", 0) != 0)
+                kept += option + "\n";
+            start = end + 1;
+        }
+        return kept;
+    }
+}
+
+int cm_abi_version(void)
+{
+    return CM_ABI_VERSION;
+}
+
+cm_context *cm_context_create(void)
+{
+    return new (nothrow) cm_context();
+}
+
+void cm_context_destroy(cm_context *context)
+{
+    delete context;
+}
+
+cm_result *cm_transpile(cm_context *context, const char *source, size_t size, const char *options)
+{
+    if (!context)
+        return nullptr;
+    // No exception may cross the C boundary: running out of memory is the only one left here.
+    try
+    {
+        string options_text = options ? options : "";
+        unique_ptr<cm_result> result(new cm_result());
+        result->result = transpileRequest(string(source ? source : "", source ? size : 0), options_text, context->defaults,
+                                          context->macroCache(translationOptions(options_text)));
+        return result.release();
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+int cm_result_status(const cm_result *result)
+{
+    return result ? result->result.status : 1;
+}
+
+cm_view cm_result_section(const cm_result *result, const char *kind)
+{
+    static const string empty;
+    if (!result || !kind)
+        return view(empty);
+    const TranspileResult &r = result->result;
+    if (strcmp(kind, "python") == 0)
+        return view(r.python);
+    if (strcmp(kind, "tokens") == 0)
+        return view(r.tokens);
+    if (strcmp(kind, "macros") == 0)
+        return view(r.macros);
+    if (strcmp(kind, "ast") == 0)
+        return view(r.ast);
+    try
+    {
+        if (strcmp(kind, "diagnostics") == 0)
+        {
+            if (!result->has_diagnostics)
+            {
+                result->diagnostics = r.diagnosticsJson();
+                result->has_diagnostics = true;
+            }
+            return view(result->diagnostics);
+        }
+        if (strcmp(kind, "frames") == 0)
+        {
+            if (!result->has_frames)
+            {
+                result->frames = r.frames();
+                result->has_frames = true;
+            }
+            return view(result->frames);
+        }
+    }
+    catch (...)
+    {
+    }
+    return view(empty);
+}
+
+void cm_result_release(cm_result *result)
+{
+    delete result;
+}
@@ -0,0 +1,78 @@
+#ifndef CODEMORPH_H
+#define CODEMORPH_H
+
+/*
+ * --- libcodemorph: the transpiler as an in-process library ---
+ * A plain C interface, so any language with a C FFI (Python's ctypes, see codemorph.py) can
+ * transpile without starting a process per request. Build it with
+ *   g++ -std=c++17 -O2 -shared -fPIC Lexer.cpp Parser.cpp transpiler.cpp Evaluator.cpp Profile.cpp
+ *       SourceMap.cpp Abi.cpp Frames.cpp Request.cpp Stats.cpp codemorph.cpp -pthread -o libcodemorph.so
+ *
+ *   cm_context *context = cm_context_create();
+ *   cm_result *result = cm_transpile(context, source, source_size, "--char-as-int\n--emit=ast,python");
+ *   cm_view python = cm_result_section(result, "python");
+ *   ... use python.data[0 .. python.size) ...
+ *   cm_result_release(result);
+ *   cm_context_destroy(context);
+ *
+ * Nothing is printed: diagnostics come back as the "diagnostics" section. A context keeps warm
+ * state between calls (the Python translation of macro bodies, per set of options) and may be
+ * used from several threads at once; a result belongs to the thread that asked for it.
+ */
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#define CM_API __declspec(dllexport)
+#else
+#define CM_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /* Bumped whenever a declaration below changes incompatibly. */
+#define CM_ABI_VERSION 1
+
+    typedef struct cm_context cm_context;
+    typedef struct cm_result cm_result;
+
+    /* Bytes owned by a result: not NUL-terminated, valid until the result is released. */
+    typedef struct cm_view
+    {
+        const char *data;
+        size_t size;
+    } cm_view;
+
+    CM_API int cm_abi_version(void);
+
+    /* NULL only if out of memory. */
+    CM_API cm_context *cm_context_create(void);
+    CM_API void cm_context_destroy(cm_context *context);
+
+    /*
+     * Transpiles 'size' bytes of C source. 'options' holds command-line options, one per line
+     * (--char-as-int, --inline-budget=N, --abi=..., --lint, --emit=tokens,macros,ast,python), or is
+     * NULL. NULL only if out of memory or 'context' is NULL.
+     */
+    CM_API cm_result *cm_transpile(cm_context *context, const char *source, size_t size, const char *options);
+
+    /* 0, or 1 if the options were malformed or lexing failed (see the diagnostics section). */
+    CM_API int cm_result_status(const cm_result *result);
+
+    /*
+     * A section of the result: "python", "tokens", "macros", "ast" (JSON, see Frames.h),
+     * "diagnostics" (a JSON array of diagnostic records) or "frames" (what --framed prints, without
+     * the end frame). Sections that were not requested, and unknown kinds, are empty views.
+     */
+    CM_API cm_view cm_result_section(const cm_result *result, const char *kind);
+
+    CM_API void cm_result_release(cm_result *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,153 @@
+"""ctypes binding for libcodemorph (codemorph.h): the transpiler in-process, without a subprocess per call.
+
+    import codemorph
+    context = codemorph.Context()
+    with context.transpile(source, options=["--char-as-int"], sections="ast,python") as result:
+        if result.status == 0:
+            print(result.text("python"))
+
+The shared library is looked up next to this module first, then by the system's usual rules; set
+CODEMORPH_LIBRARY to load a specific file. Importing raises OSError if it cannot be found.
+"""
+import ctypes
+import json
+import os
+import sys
+
+ABI_VERSION = 1
+
+
+class _View(ctypes.Structure):
+    _fields_ = [("data", ctypes.c_void_p), ("size", ctypes.c_size_t)]
+
+
+def _library_names():
+    if sys.platform == "win32":
+        return ["codemorph.dll", "libcodemorph.dll"]
+    if sys.platform == "darwin":
+        return ["libcodemorph.dylib"]
+    return ["libcodemorph.so"]
+
+
+def _load():
+    explicit = os.environ.get("CODEMORPH_LIBRARY")
+    candidates = [explicit] if explicit else []
+    here = os.path.dirname(os.path.abspath(__file__))
+    candidates += [os.path.join(here, name) for name in _library_names()] + _library_names()
+    errors = []
+    for candidate in candidates:
+        try:
+            return ctypes.CDLL(candidate)
+        except OSError as e:
+            errors.append(str(e))
+    raise OSError("libcodemorph not found: " + "; ".join(errors))
+
+
+_lib = _load()
+_lib.cm_abi_version.restype = ctypes.c_int
+_lib.cm_abi_version.argtypes = []
+_lib.cm_context_create.restype = ctypes.c_void_p
+_lib.cm_context_create.argtypes = []
+_lib.cm_context_destroy.restype = None
+_lib.cm_context_destroy.argtypes = [ctypes.c_void_p]
+_lib.cm_transpile.restype = ctypes.c_void_p
+_lib.cm_transpile.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_size_t, ctypes.c_char_p]
+_lib.cm_result_status.restype = ctypes.c_int
+_lib.cm_result_status.argtypes = [ctypes.c_void_p]
+_lib.cm_result_section.restype = _View
+_lib.cm_result_section.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+_lib.cm_result_release.restype = None
+_lib.cm_result_release.argtypes = [ctypes.c_void_p]
+
+if _lib.cm_abi_version() != ABI_VERSION:
+    raise OSError(f"libcodemorph ABI version {_lib.cm_abi_version()}, this binding needs {ABI_VERSION}")
+
+
+class Result:
+    """One transpilation. Its sections point into memory owned by the library: release() the result
+    (or use it as a context manager) when done, after which views taken from it must not be used.
+    Without an explicit release, views keep the result alive: ctx.transpile(src).view("python") is safe."""
+
+    def __init__(self, handle):
+        self._handle = handle
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.release()
+
+    def __del__(self):
+        self.release()
+
+    def release(self):
+        if self._handle:
+            _lib.cm_result_release(self._handle)
+            self._handle = None
+
+    def _check(self):
+        if not self._handle:
+            raise ValueError("result already released")
+
+    @property
+    def status(self):
+        self._check()
+        return _lib.cm_result_status(self._handle)
+
+    def view(self, kind):
+        """A section as a read-only memoryview of the library's buffer, without copying: "python",
+        "tokens", "macros", "ast", "diagnostics" or "frames". Empty if not requested."""
+        self._check()
+        section = _lib.cm_result_section(self._handle, kind.encode("ascii"))
+        if not section.size:
+            return memoryview(b"")
+        buffer = (ctypes.c_char * section.size).from_address(section.data)
+        buffer._result = self  # The view keeps the result (and so the buffer) alive until it is gone too
+        return memoryview(buffer).cast("B").toreadonly()
+
+    def bytes(self, kind):
+        return self.view(kind).tobytes()
+
+    def text(self, kind):
+        return self.bytes(kind).decode("utf-8", "replace")
+
+    def diagnostics(self):
+        """The diagnostic records (see Frames.h) as dictionaries."""
+        return json.loads(self.text("diagnostics"))
+
+
+class Context:
+    """Warm state (translated macro bodies) shared by the transpilations made through it. Usable
+    from several threads; ctypes releases the GIL for the duration of each call."""
+
+    def __init__(self):
+        self._handle = _lib.cm_context_create()
+        if not self._handle:
+            raise MemoryError("cm_context_create failed")
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __del__(self):
+        self.close()
+
+    def close(self):
+        if getattr(self, "_handle", None):
+            _lib.cm_context_destroy(self._handle)
+            self._handle = None
+
+    def transpile(self, source, options=(), sections="python"):
+        """Transpiles C source (str or bytes). 'options' are command-line options such as
+        "--char-as-int" or "--inline-budget=8"; 'sections' is as for --emit."""
+        if not self._handle:
+            raise ValueError("context already closed")
+        if isinstance(source, str):
+            source = source.encode("utf-8")
+        lines = list(options) + ["--emit=" + sections]
+        handle = _lib.cm_transpile(self._handle, source, len(source), "\n".join(lines).encode("utf-8"))
+        if not handle:
+            raise MemoryError("cm_transpile failed")
+        return Result(handle)
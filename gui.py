@@ -1,5 +1,13 @@
+import os
 import sys
+import json
+import socket
 import subprocess
+import tempfile
+try:
+    import codemorph  # ctypes binding for libcodemorph: the transpiler in-process
+except OSError:
+    codemorph = None
 from PyQt5.QtWidgets import (
     QApplication, QWidget, QLabel, QVBoxLayout, QHBoxLayout,
     QPushButton, QPlainTextEdit, QFileDialog, QTabWidget, QMessageBox,
@@ -9,6 +17,116 @@ from PyQt5.QtGui import QFont
 from PyQt5.QtCore import Qt
 
 
+
+def read_frames(data):
+    """Splits the transpiler's --framed output into (kind, payload bytes) pairs. A frame is
+    "<kind> <length>\\n" followed by exactly length bytes and a newline."""
+    frames = []
+    pos = 0
+    while pos < len(data):
+        header_end = data.index(b"\n", pos)
+        kind, length = data[pos:header_end].decode('ascii').split(" ")
+        start = header_end + 1
+        if start + int(length) + 1 > len(data):
+            raise ValueError("truncated frame")
+        frames.append((kind, data[start:start + int(length)]))
+        pos = start + int(length) + 1
+    return frames
+
+
+_codemorph_context = None
+
+
+def transpile_in_process(source, sections):
+    """Frames (as --framed would print them) from libcodemorph, or None if the library is not
+    available. The context, and with it the translated macros, lives as long as the GUI."""
+    global _codemorph_context
+    if codemorph is None:
+        return None
+    if _codemorph_context is None:
+        _codemorph_context = codemorph.Context()
+    with _codemorph_context.transpile(source, sections=sections) as result:
+        end = json.dumps({"status": result.status}).encode('ascii')
+        return read_frames(result.bytes("frames")) + [("end", end)]
+
+
+def transpile_via_server(source, sections):
+    """Frames answering a request to the 'transpiler --serve' at $CODEMORPH_SOCKET, or None if no
+    server is configured or reachable."""
+    path = os.environ.get("CODEMORPH_SOCKET")
+    if not path or not hasattr(socket, "AF_UNIX"):
+        return None
+    try:
+        with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as connection:
+            connection.settimeout(30)
+            connection.connect(path)
+            request = b""
+            for kind, payload in (("emit", sections.encode('utf-8')), ("source", source.encode('utf-8'))):
+                request += f"{kind} {len(payload)}\n".encode('ascii') + payload + b"\n"
+            connection.sendall(request)
+            data = b""
+            while True:
+                chunk = connection.recv(65536)
+                if not chunk:
+                    return None
+                data += chunk
+                try:
+                    frames = read_frames(data)
+                except ValueError:
+                    continue  # The answer is not complete yet
+                if frames and frames[-1][0] == "end":
+                    return frames
+    except OSError:
+        return None
+
+
+def format_tokens(tokens):
+    return "".join(f" {t['value']} ---->({t['type']}) line: {t['line']}, col: {t['col']}\n" for t in tokens)
+
+
+def format_macros(macros):
+    if not macros:
+        return "(No macros defined or parsed)\n"
+    text = ""
+    for m in macros:
+        if not m["valid"]:
+            text += f"Invalid Macro (skipped): {m['name']} (defined on line {m['line']})\n"
+            continue
+        parameters = "" if m["parameters"] is None else "(" + ", ".join(m["parameters"]) + ")"
+        text += f"Macro: {m['name']}{parameters} -> \"{m['body']}\" (Line: {m['line']})\n"
+    return text
+
+
+def format_ast(node, indent=0, label=None):
+    """Indented tree of the JSON AST: the node kind with its attributes, then its parts."""
+    pad = "  " * indent
+    prefix = pad + (label + ": " if label else "")
+    if node is None:
+        return prefix + "(empty)\n"
+    attributes = [f"{key}={value!r}" for key, value in node.items()
+                  if key not in ("node", "line", "children") and not isinstance(value, (dict, list)) and value is not None]
+    if node.get("parameters") is not None:
+        attributes.append("(" + ", ".join(f"{p['type']} {p['name']}" + "[]" * p["dimensions"] for p in node["parameters"]) + ")")
+    text = prefix + f"({node['node']}) " + " ".join(attributes) + (f"  [line {node['line']}]" if node["line"] else "") + "\n"
+    for key, value in node.items():
+        if key in ("condition", "then", "else", "initializer", "increment", "body", "assignment"):
+            if key != "else" or value is not None:
+                text += format_ast(value, indent + 1, key)
+        elif key == "sizes":
+            for size in value:
+                text += format_ast(size, indent + 1, "size")
+    for child in node["children"]:
+        text += format_ast(child, indent + 1)
+    return text
+
+
+def format_diagnostic(record):
+    where = f" (Line {record['line']})" if record["line"] is not None else ""
+    rule = f" [{record['rule']}]" if "rule" in record else ""
+    source = record["source"] + " " if record["source"] else ""
+    return f"{source}{record['severity'].capitalize()}{where}:{rule} {record['message']}"
+
+
 class Transpiler(QWidget):
     def __init__(self):
         super().__init__()
@@ -55,6 +173,13 @@ class Transpiler(QWidget):
         self.transpile_btn.setToolTip("Transpile the C code to Python")
         self.transpile_btn.clicked.connect(self.transpile_code)
 
+        self.run_btn = QPushButton(" Run")
+        self.run_btn.setIcon(self.style().standardIcon(QStyle.SP_MediaSeekForward))
+        self.run_btn.setFixedHeight(40)
+        self.run_btn.setCursor(Qt.PointingHandCursor)
+        self.run_btn.setToolTip("Run the C code directly (built-in interpreter) and show what it prints")
+        self.run_btn.clicked.connect(self.run_code)
+
         self.reset_btn = QPushButton(" Reset")
         self.reset_btn.setIcon(self.style().standardIcon(QStyle.SP_DialogResetButton))
         self.reset_btn.setFixedHeight(40)
@@ -65,6 +190,7 @@ class Transpiler(QWidget):
         # Add left side buttons to the layout
         action_buttons_layout.addWidget(self.open_file_btn)
         action_buttons_layout.addWidget(self.transpile_btn)
+        action_buttons_layout.addWidget(self.run_btn)
         action_buttons_layout.addWidget(self.reset_btn)
 
         # Add a spacer to push the save button to the right side
@@ -91,6 +217,12 @@ class Transpiler(QWidget):
         self.input_box.setPlaceholderText("Enter C code here or click 'Open File'...")
         left_panel.addWidget(self.input_box)
 
+        self.program_input_box = QPlainTextEdit()
+        self.program_input_box.setFont(QFont("Fira Code", 12))
+        self.program_input_box.setFixedHeight(90)
+        self.program_input_box.setPlaceholderText("Input for scanf when using 'Run' (optional)...")
+        left_panel.addWidget(self.program_input_box)
+
         main_split.addLayout(left_panel, 3)
 
         # Right side: Tabs with output
@@ -134,9 +266,15 @@ class Transpiler(QWidget):
         self.ast_box.setReadOnly(True)
         self.ast_box.setPlaceholderText("Abstract Syntax Tree (AST) representation will appear here.")
 
+        self.run_output_box = QPlainTextEdit()
+        self.run_output_box.setFont(QFont("Fira Code", 12))
+        self.run_output_box.setReadOnly(True)
+        self.run_output_box.setPlaceholderText("Output of the C program will appear here after 'Run'.")
+
         self.tabs.addTab(self.output_box, ".PY code")
         self.tabs.addTab(self.tokens_box, "Tokens")
         self.tabs.addTab(self.ast_box, "AST")
+        self.tabs.addTab(self.run_output_box, "Program Output")
 
         right_panel.addWidget(self.tabs)
         main_split.addLayout(right_panel, 4)
@@ -194,6 +332,7 @@ class Transpiler(QWidget):
                 self.output_box.clear()
                 self.tokens_box.clear()
                 self.ast_box.clear()
+                self.run_output_box.clear()
                 self.tabs.setCurrentIndex(0)
             except Exception as e:
                 QMessageBox.critical(self, "Error", f"Could not read file: {str(e)}")
@@ -209,13 +348,91 @@ class Transpiler(QWidget):
         self.ast_box.clear()
         self.tabs.setCurrentIndex(0)
 
+        try:
+            # libcodemorph transpiles in this process; failing that, a running 'transpiler --serve' (socket
+            # path in CODEMORPH_SOCKET) answers without process start-up; otherwise the transpiler is
+            # started for this click.
+            frames = transpile_in_process(input_text, "tokens,macros,ast,python")
+            if frames is None:
+                frames = transpile_via_server(input_text, "tokens,macros,ast,python")
+            status, stderr = 0, b""
+            if frames is None:
+                creation_flags = 0
+                if sys.platform == 'win32':
+                    creation_flags = subprocess.CREATE_NO_WINDOW
+
+                # --framed: every section is length-prefixed, so the C code cannot confuse the parsing by
+                # printing a section marker, and diagnostics come as records.
+                process = subprocess.Popen(
+                    ['transpiler.exe', '--framed', '--emit=tokens,macros,ast,python'],
+                    stdin=subprocess.PIPE,
+                    stdout=subprocess.PIPE,
+                    stderr=subprocess.PIPE,
+                    creationflags=creation_flags
+                )
+                stdout, stderr = process.communicate(input=input_text.encode('utf-8'))
+                frames = read_frames(stdout)
+                status = process.returncode
+            else:
+                status = json.loads(frames[-1][1])["status"]
+
+            messages = [format_diagnostic(json.loads(payload)) for kind, payload in frames if kind == "diagnostic"]
+            errors = [payload for kind, payload in frames if kind == "diagnostic" and json.loads(payload)["severity"] == "error"]
+            sections = {kind: payload for kind, payload in frames if kind in ("tokens", "macros", "ast", "python")}
+
+            if status != 0 or "python" not in sections:
+                error_message = "Transpiler Error:\n"
+                if messages: error_message += "\n".join(messages)
+                elif stderr: error_message += stderr.decode('utf-8', 'replace').strip()
+                else: error_message += "Unknown error during transpilation."
+                QMessageBox.critical(self, "Transpilation Error", error_message)
+                return
+
+            tokens = format_tokens(json.loads(sections["tokens"])) if "tokens" in sections else ""
+            if "macros" in sections:
+                tokens += "\n---DEFINED MACROS---\n" + format_macros(json.loads(sections["macros"]))
+            ast_content = format_ast(json.loads(sections["ast"])) if "ast" in sections else ""
+            python_code = sections["python"].decode('utf-8')
+
+            self.tokens_box.setPlainText(tokens.strip())
+            self.ast_box.setPlainText(ast_content.strip())
+            self.output_box.setPlainText(python_code.strip())
+
+            if messages:
+                title = "Transpilation completed with errors" if errors else "Transpiler Messages"
+                QMessageBox.information(self, title, "Transpilation completed with messages:\n\n" + "\n".join(messages))
+
+        except FileNotFoundError:
+            QMessageBox.critical(self, "Error", "'transpiler.exe' not found. Ensure it is in PATH or same directory as the script.")
+        except Exception as e:
+            QMessageBox.critical(self, "Error", f"An unexpected error occurred: {str(e)}")
+
+    def run_code(self):
+        input_text = self.input_box.toPlainText()
+        if not input_text.strip():
+            QMessageBox.warning(self, "Warning", "Input C code is empty. Please enter or open C code.")
+            return
+
+        self.run_output_box.clear()
+        self.tabs.setCurrentWidget(self.run_output_box)
+
+        # The C code goes to the transpiler's stdin, so the program's own input is passed as a file.
+        input_file = None
         try:
             creation_flags = 0
             if sys.platform == 'win32':
                 creation_flags = subprocess.CREATE_NO_WINDOW
 
+            command = ['transpiler.exe', '--run']
+            program_input = self.program_input_box.toPlainText()
+            if program_input:
+                input_file = tempfile.NamedTemporaryFile('w', suffix='.txt', delete=False, encoding='utf-8')
+                input_file.write(program_input if program_input.endswith("\n") else program_input + "\n")
+                input_file.close()
+                command.append('--run-input=' + input_file.name)
+
             process = subprocess.Popen(
-                ['transpiler.exe'],
+                command,
                 stdin=subprocess.PIPE,
                 stdout=subprocess.PIPE,
                 stderr=subprocess.PIPE,
@@ -225,45 +442,28 @@ class Transpiler(QWidget):
             )
             stdout, stderr = process.communicate(input=input_text)
 
-            if process.returncode != 0 or (stderr and "---PYTHON_CODE---" not in stdout):
-                error_message = "Transpiler Error:\n"
-                if stderr: error_message += stderr.strip()
-                elif stdout and "---PYTHON_CODE---" not in stdout: error_message += stdout.strip()
-                else: error_message += "Unknown error during transpilation."
-                QMessageBox.critical(self, "Transpilation Error", error_message)
-                return
-
-            tokens, ast_content, python_code = "", "", ""
-            section = None
-            for line in stdout.splitlines():
-                if line.strip() == "---TOKENS---": section = "tokens"; continue
-                elif line.strip() == "---AST---": section = "ast"; continue
-                elif line.strip() == "---PYTHON_CODE---": section = "python"; continue
-
-                if section == "tokens": tokens += line + "\n"
-                elif section == "ast": ast_content += line + "\n"
-                elif section == "python": python_code += line + "\n"
-
-            if not python_code.strip() and not tokens.strip() and not ast_content.strip() and not stderr:
-                 QMessageBox.warning(self, "Transpilation Note", "Transpiler produced no distinct output sections.")
-
-            self.tokens_box.setPlainText(tokens.strip())
-            self.ast_box.setPlainText(ast_content.strip())
-            self.output_box.setPlainText(python_code.strip())
-            
-            if stderr.strip() and "---PYTHON_CODE---" in stdout: # Check if python code exists despite stderr
-                QMessageBox.information(self, "Transpiler Messages", f"Transpilation completed with messages:\n\n{stderr.strip()}")
+            # Parse errors and run errors (with their C line) follow what the program printed so far.
+            output = stdout
+            if stderr.strip():
+                output += ("\n" if output and not output.endswith("\n") else "") + stderr.strip() + "\n"
+            output += f"\n[exit status {process.returncode}]"
+            self.run_output_box.setPlainText(output)
 
         except FileNotFoundError:
             QMessageBox.critical(self, "Error", "'transpiler.exe' not found. Ensure it is in PATH or same directory as the script.")
         except Exception as e:
             QMessageBox.critical(self, "Error", f"An unexpected error occurred: {str(e)}")
+        finally:
+            if input_file is not None:
+                os.remove(input_file.name)
 
     def reset_fields(self):
         self.input_box.clear()
+        self.program_input_box.clear()
         self.output_box.clear()
         self.tokens_box.clear()
         self.ast_box.clear()
+        self.run_output_box.clear()
         self.tabs.setCurrentIndex(0)
 
     def save_output(self):
@@ -1,9 +1,25 @@
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <cstdio>       // For snprintf
 #include <vector>       // For std::vector
 #include <string>       // For std::string
 #include <memory>       // For std::shared_ptr
+#include <algorithm>    // For std::max
 #include "transpiler.h" // Contains Lexer, Parser, AST nodes, and Transpiler
+#include "SourceMap.h"
+#include "VM.h"
+#include "Frames.h"
+#include "Batch.h"
+#include "Server.h"
+#include "Request.h"
+#include "Cache.h"
+#include "Watch.h"
+#include "Stats.h"
+#ifdef _WIN32
+#include <io.h>  // _setmode: frames are counted in bytes, so no \n -> \r\n translation
+#include <fcntl.h>
+#endif
 // Ensure Lexer.h, Parser.h and their .cpp are correctly set up
 // and "transpiler.h" correctly includes them or provides their definitions.
 
@@ -207,7 +223,13 @@ void printAST(const shared_ptr<ASTNode> &node, int indent)
         {
             cout << "NO_SIZE_EXPR"; // Should ideally not happen if parser validates
         }
-        cout << "]" << endl;
+        cout << "]";
+        for (const auto &size : p->getInnerSizeExpressions())
+        {
+            auto sizeNum = dynamic_pointer_cast<NumberNode>(size);
+            cout << "[" << (sizeNum ? sizeNum->getValue() : "expr") << "]";
+        }
+        cout << endl;
         // If VariableDeclarationNode (base) has an initializer member that ArrayDeclarationNode uses:
         if (p->getInitializer())
         { // Check if this method exists and is used
@@ -253,7 +275,8 @@ void printAST(const shared_ptr<ASTNode> &node, int indent)
             // If it's an array, print the brackets!
             if (params[i].isArray)
             {
-                cout << "[]";
+                for (int d = 0; d < max(1, params[i].dimensions); ++d)
+                    cout << "[]";
             }
             // Add comma if not the last parameter
             if (i < params.size() - 1)
@@ -307,11 +330,35 @@ void printAST(const shared_ptr<ASTNode> &node, int indent)
     else if (auto p = dynamic_pointer_cast<UnaryExpressionNode>(node))
     {
         printIndent(indent);
-        cout << "(" << p->type_name << "): Operator '" << p->getOperator() << "'" << endl;
+        cout << "(" << p->type_name << "): Operator '" << p->getOperator() << "'"
+             << (p->isPostfix() ? " (postfix)" : "") << endl;
+        printIndent(indent + 1);
+        cout << "Operand:" << endl;
+        printAST(p->getOperand(), indent + 2);
+    }
+    else if (auto p = dynamic_pointer_cast<CastNode>(node))
+    {
+        printIndent(indent);
+        cout << "(" << p->type_name << "): (" << p->getTargetType() << ")" << endl;
         printIndent(indent + 1);
         cout << "Operand:" << endl;
         printAST(p->getOperand(), indent + 2);
     }
+    else if (auto p = dynamic_pointer_cast<SizeofNode>(node))
+    {
+        printIndent(indent);
+        if (p->getOperand())
+        {
+            cout << "(" << p->type_name << "): sizeof expression" << endl;
+            printIndent(indent + 1);
+            cout << "Operand:" << endl;
+            printAST(p->getOperand(), indent + 2);
+        }
+        else
+        {
+            cout << "(" << p->type_name << "): sizeof(" << p->getTargetType() << ")" << endl;
+        }
+    }
     else if (auto p = dynamic_pointer_cast<IdentifierNode>(node))
     {
         printIndent(indent);
@@ -403,6 +450,7 @@ void printAST(const shared_ptr<ASTNode> &node, int indent)
                 (dynamic_pointer_cast<AssignmentNode>(node) != nullptr) || // Updated if structure changed
                 (dynamic_pointer_cast<BinaryExpressionNode>(node) != nullptr) ||
                 (dynamic_pointer_cast<UnaryExpressionNode>(node) != nullptr) ||
+                (dynamic_pointer_cast<CastNode>(node) != nullptr) ||
                 (dynamic_pointer_cast<FunctionCallNode>(node) != nullptr);
 
             if (!genericChildren.empty() && !children_explicitly_handled)
@@ -417,8 +465,314 @@ void printAST(const shared_ptr<ASTNode> &node, int indent)
         }
     }
 
-    int main()
+    int main(int argc, char *argv[])
     {
+        // === Step 0: Command-line options ===
+        TranspilerOptions options;
+        string profile_use_path;
+        string source_map_path, map_profile_path;
+        string source_name = "input.c", python_name = "Converted.py";
+        string lint_format; // "", "text" or "json"
+        bool run = false;
+        string run_input_path;
+        long long run_steps = 100000000;
+        EmitSections emit; // Only the Python code unless --emit says otherwise
+        bool framed = false;
+        vector<string> batch_inputs; // Batch mode: C files and directories given as arguments
+        int batch_jobs = 0;
+        string batch_output_dir;
+        bool batch_flags = false; // -j or -o given
+        string serve_path;
+        string cache_dir;
+        unsigned long long cache_megabytes = 256;
+        bool cache_stats = false;
+        string project_manifest;
+        bool watch = false;
+        int watch_debounce_ms = 100;
+        string stats_format; // "", "text" or "json"
+        string stats_path;
+        for (int i = 1; i < argc; ++i)
+        {
+            string arg = argv[i];
+            try
+            {
+                if (parseTranspilerOption(arg, options))
+                    continue;
+                if (arg.rfind("--profile-use=", 0) == 0 && arg.size() > 14)
+                    profile_use_path = arg.substr(14);
+                else if (arg.rfind("--source-map=", 0) == 0 && arg.size() > 13)
+                    source_map_path = arg.substr(13);
+                else if (arg.rfind("--source-name=", 0) == 0 && arg.size() > 14)
+                    source_name = arg.substr(14);
+                else if (arg.rfind("--python-name=", 0) == 0 && arg.size() > 14)
+                    python_name = arg.substr(14);
+                else if (arg.rfind("--map-profile=", 0) == 0 && arg.size() > 14)
+                    map_profile_path = arg.substr(14);
+                else if (arg == "--lint" || arg == "--lint=text" || arg == "--lint=json")
+                    lint_format = arg == "--lint=json" ? "json" : "text";
+                else if (arg == "--run")
+                    run = true;
+                else if (arg.rfind("--run-input=", 0) == 0 && arg.size() > 12)
+                    run_input_path = arg.substr(12);
+                else if (arg.rfind("--run-steps=", 0) == 0)
+                    run_steps = stoll(arg.substr(12));
+                else if (arg.rfind("--emit=", 0) == 0)
+                    emit = parseEmitSections(arg.substr(7));
+                else if (arg == "--framed")
+                    framed = true;
+                else if (arg.rfind("--serve=", 0) == 0 && arg.size() > 8)
+                    serve_path = arg.substr(8);
+                else if (arg.rfind("--cache-dir=", 0) == 0 && arg.size() > 12)
+                    cache_dir = arg.substr(12);
+                else if (arg.rfind("--cache-size=", 0) == 0)
+                    cache_megabytes = stoull(arg.substr(13));
+                else if (arg == "--cache-stats")
+                    cache_stats = true;
+                else if (arg.rfind("--project=", 0) == 0 && arg.size() > 10)
+                    project_manifest = arg.substr(10);
+                else if (arg == "--watch")
+                    watch = true;
+                else if (arg.rfind("--watch-debounce=", 0) == 0)
+                    watch_debounce_ms = stoi(arg.substr(17));
+                else if (arg == "--stats" || arg == "--stats=text" || arg == "--stats=json")
+                    stats_format = arg == "--stats=json" ? "json" : "text";
+                else if (arg.rfind("--stats-file=", 0) == 0 && arg.size() > 13)
+                    stats_path = arg.substr(13);
+                else if (arg == "-j" || arg == "-o")
+                {
+                    if (i + 1 >= argc)
+                        throw invalid_argument(arg);
+                    if (arg == "-j")
+                        batch_jobs = stoi(argv[++i]);
+                    else
+                        batch_output_dir = argv[++i];
+                    batch_flags = true;
+                }
+                else if (arg.rfind("-j", 0) == 0 && arg.size() > 2 && arg[2] != '-')
+                {
+                    batch_jobs = stoi(arg.substr(2));
+                    batch_flags = true;
+                }
+                else if (!arg.empty() && arg[0] != '-')
+                    batch_inputs.push_back(arg);
+                else
+                    throw invalid_argument(arg);
+            }
+            catch (const std::exception &)
+            {
+                cerr << "Unknown or malformed option: " << arg << endl;
+                cerr << "Usage: transpiler [--char-as-int] [--inline-budget=N] [--inline-growth=PERCENT]\n"
+                     << "                  [--unroll-trips=N] [--unroll-body=NODES] [--parallel] [--parallel-min-work=N]\n"
+                     << "                  [--eval-budget=STEPS] [--eval-max-elements=N]\n"
+                     << "                  [--profile-gen=FILE | --profile-use=FILE] [--profile-hot=N]\n"
+                     << "                  [--instrument] [--source-map=FILE] [--source-name=C_NAME] [--python-name=PY_NAME]\n"
+                     << "                  [--lint[=text|json]] [--abi=LP64|ILP32|LLP64] [--emit=tokens,macros,ast,python]\n"
+                     << "                  [--framed] [--cache-dir=DIR [--cache-size=MB] [--cache-stats]]\n"
+                     << "                  [--stats[=text|json]] [--stats-file=FILE]\n"
+                     << "                  < input.c\n"
+                     << "       transpiler [-j N] [-o OUTDIR] [--project=MANIFEST] [transpiler options] inputs.c|dirs...\n"
+                     << "       transpiler --watch [--watch-debounce=MS] [-j N] [-o OUTDIR] [--project=MANIFEST] inputs.c|dirs...\n"
+                     << "       transpiler --serve=SOCKET [transpiler options]\n"
+                     << "       transpiler --run [--run-input=FILE] [--run-steps=N] [--abi=...] < input.c\n"
+                     << "       transpiler --map-profile=MAP < profile-report.txt" << endl;
+                return 1;
+            }
+        }
+        if (!profile_use_path.empty())
+        {
+            if (!options.profile_gen_path.empty())
+            {
+                cerr << "--profile-gen and --profile-use cannot be combined" << endl;
+                return 1;
+            }
+            try
+            {
+                options.profile = readProfile(profile_use_path);
+            }
+            catch (const std::exception &e)
+            {
+                cerr << e.what() << endl;
+                return 1;
+            }
+        }
+
+        // Per-phase statistics (see Stats.h): on stderr, in --stats-file, or as a frame in framed mode
+        if (!stats_format.empty() && (run || !serve_path.empty() || !map_profile_path.empty()))
+        {
+            cerr << "--stats cannot be combined with --run, --serve or --map-profile" << endl;
+            return 1;
+        }
+        if (!stats_path.empty() && stats_format.empty())
+            stats_format = "text";
+        ofstream stats_file;
+        if (!stats_path.empty())
+        {
+            stats_file.open(stats_path, ios::app);
+            if (!stats_file)
+            {
+                cerr << "Stats Error: cannot write " << stats_path << endl;
+                return 1;
+            }
+        }
+        ostream &stats_out = stats_path.empty() ? cerr : stats_file;
+
+        // Result cache, for the single-file and batch modes (see Cache.h)
+        unique_ptr<ResultCache> cache;
+        if (!cache_dir.empty())
+        {
+            try
+            {
+                cache = make_unique<ResultCache>(cache_dir, cache_megabytes * 1024 * 1024);
+            }
+            catch (const std::exception &e)
+            {
+                cerr << "Cache Error: " << e.what() << endl;
+                return 1;
+            }
+        }
+
+        // Daemon mode: requests come over a Unix socket; the options given here are their defaults.
+        if (!serve_path.empty())
+        {
+            if (run || framed || !batch_inputs.empty() || !map_profile_path.empty() || !source_map_path.empty())
+            {
+                cerr << "--serve cannot be combined with --run, --framed, batch inputs, --map-profile or --source-map" << endl;
+                return 1;
+            }
+            return runServer(serve_path, options, cerr);
+        }
+
+        // Batch mode: the files named on the command line instead of stdin, on a pool of threads.
+        if ((batch_flags || !project_manifest.empty() || watch) && batch_inputs.empty())
+        {
+            cerr << "-j, -o, --project and --watch need input files or directories" << endl;
+            return 1;
+        }
+        if (!batch_inputs.empty())
+        {
+            if (run || framed || !map_profile_path.empty() || !source_map_path.empty() || lint_format == "json")
+            {
+                cerr << "Batch mode cannot be combined with --run, --framed, --map-profile, --source-map or --lint=json" << endl;
+                return 1;
+            }
+            BatchOptions batch;
+            batch.transpiler = options;
+            batch.transpiler.lint = !lint_format.empty();
+            batch.jobs = batch_jobs;
+            batch.output_dir = batch_output_dir;
+            batch.lint = batch.transpiler.lint;
+            batch.cache = cache.get();
+            batch.manifest = project_manifest;
+            batch.stats = stats_format;
+            batch.stats_out = stats_path.empty() ? nullptr : &stats_out;
+            if (watch)
+            {
+                WatchOptions watching;
+                watching.batch = batch;
+                watching.debounce_ms = watch_debounce_ms;
+                return runWatch(batch_inputs, watching, cout, cerr);
+            }
+            try
+            {
+                return runBatch(batch_inputs, batch, cout, cerr);
+            }
+            catch (const std::exception &e)
+            {
+                cerr << "Batch Error: " << e.what() << endl;
+                return 1;
+            }
+        }
+
+        // Report translation mode: stdin is a cProfile/py-spy report of the generated Python, not C code.
+        if (!map_profile_path.empty())
+        {
+            try
+            {
+                cout << translateProfileReport(readSourceMap(map_profile_path), cin);
+            }
+            catch (const std::exception &e)
+            {
+                cerr << e.what() << endl;
+                return 1;
+            }
+            return 0;
+        }
+        options.source_map = !source_map_path.empty();
+        options.lint = !lint_format.empty();
+
+        // Framed mode: every section, and every message that would go to stderr, becomes a frame on
+        // stdout (see Frames.h). Lint warnings are diagnostic records there, whatever --lint format.
+        if (framed && run)
+        {
+            cerr << "--framed cannot be combined with --run" << endl;
+            return 1;
+        }
+        ostringstream diagnostics;
+        streambuf *stderr_buffer = cerr.rdbuf();
+        vector<string> lint_records;
+        if (framed)
+        {
+#ifdef _WIN32
+            _setmode(_fileno(stdout), _O_BINARY);
+#endif
+            if (!lint_format.empty())
+                lint_format = "text";
+            cerr.rdbuf(diagnostics.rdbuf());
+            writeFrame(cout, "protocol", "{\"version\": 1}");
+        }
+        // Exit with 'status': after the --stats report; in framed mode after the diagnostics and the end frame.
+        bool measure = !stats_format.empty();
+        TranspileStats stats;
+        stats.file = source_name;
+        auto finish = [&](int status)
+        {
+            if (measure && !framed)
+                stats_out << (stats_format == "json" ? stats.json() + "\n" : stats.text()) << flush;
+            if (!framed)
+                return status;
+            cerr.rdbuf(stderr_buffer);
+            istringstream messages(diagnostics.str());
+            string message;
+            while (getline(messages, message))
+            {
+                if (!message.empty())
+                    writeFrame(cout, "diagnostic", diagnosticJson(message));
+            }
+            for (const auto &record : lint_records)
+                writeFrame(cout, "diagnostic", record);
+            if (measure)
+                writeFrame(cout, "stats", stats.json());
+            writeFrame(cout, "end", "{\"status\": " + to_string(status) + "}");
+            cout.flush();
+            return status;
+        };
+
+        // --lint=text warnings: on stderr, or as diagnostic records after the messages in framed mode.
+        auto reportLint = [&](const vector<LintWarning> &warnings)
+        {
+            if (lint_format != "text")
+                return;
+            for (const auto &warning : warnings)
+            {
+                if (framed)
+                {
+                    lint_records.push_back(lintJson(warning));
+                    continue;
+                }
+                cerr << "Transpiler Warning (Line " << warning.line << "): [" << warning.rule << "] " << warning.message;
+                if (warning.cost > 0)
+                    cerr << " (~" << warning.cost << " bytecode units per iteration)";
+                cerr << endl;
+            }
+        };
+
+        PhaseTimer timer(measure);
+        auto phaseDone = [&](const char *name)
+        {
+            if (measure)
+                stats.add(timer.lap(name));
+        };
+
         // === Step 1: Read code from stdin ===
         string line, source_code;
         char ch;
@@ -438,11 +792,61 @@ void printAST(const shared_ptr<ASTNode> &node, int indent)
         else if (cin.bad() || (cin.fail() && !cin.eof()))
         {
             cerr << "Failed to read source code from stdin due to stream error." << endl;
-            return 1;
+            return finish(1);
+        }
+        phaseDone("read");
+        stats.countSource(source_code);
+
+        // With --cache-dir, an unchanged program (same source, headers, options and sections) is answered
+        // from the cache without lexing, parsing or transpiling. The text dumps, --run, --source-map and
+        // --lint=json have outputs of their own and always take the full path below.
+        bool text_dumps = !framed && (emit.tokens || emit.macros || emit.ast);
+        if (cache && !text_dumps && !run && !options.source_map && lint_format != "json")
+        {
+            string key = cache->key(source_code, "", options, emit);
+            PipelineResult result;
+            bool hit = cache->load(key, result);
+            phaseDone("cache");
+            if (!hit)
+            {
+                ostringstream scratch;
+                result = runPipeline(source_code, options, emit, nullptr, scratch, measure ? &stats : nullptr);
+                timer.lap(""); // runPipeline added its own phases
+                cache->store(key, result);
+                phaseDone("cache");
+            }
+            stats.cached = hit;
+            for (const auto &message : result.messages)
+                cerr << message << endl;
+            if (result.status == 0)
+            {
+                if (framed && emit.tokens)
+                    writeFrame(cout, "tokens", result.tokens);
+                if (framed && emit.macros)
+                    writeFrame(cout, "macros", result.macros);
+                if (framed && emit.ast)
+                    writeFrame(cout, "ast", result.ast);
+                reportLint(result.lint);
+            }
+            if (cache_stats)
+                cerr << cache->statsLine() << endl;
+            phaseDone("emit");
+            if (result.status != 0 || !emit.python)
+                return finish(result.status);
+            if (framed)
+                writeFrame(cout, "python", result.python);
+            else
+                cout << result.python << endl; // The text dumps, which would need the section marker, skip the cache
+            phaseDone("emit");
+            stats.countOutput(result.python);
+            return finish(0);
         }
 
         // === Step 2: Lexical Analysis ===
         Lexer lexer(source_code);
+        PhaseStats preprocess{"preprocess"};
+        if (measure)
+            lexer.setPreprocessStats(&preprocess);
         vector<Token> tokens;
         try
         {
@@ -451,64 +855,137 @@ void printAST(const shared_ptr<ASTNode> &node, int indent)
         catch (const std::exception &e)
         {
             cerr << "Lexical Error: " << e.what() << endl;
-            return 1;
+            return finish(1);
         }
         // ADD THIS: Get defined macros
         const auto &definedMacros = lexer.getDefinedMacros();
-
-        cout << "---TOKENS---" << endl;
-        for (const auto &token : tokens)
+        if (measure)
         {
-            cout << " " << token.value << " ---->("
-                 << tokenTypeToString(token.type) << ") line: "
-                 << token.line << ", col: " << token.col << endl;
+            PhaseStats lex = timer.lap("lex"); // The #define lines are in 'preprocess'
+            lex.wall_ms -= preprocess.wall_ms;
+            lex.cpu_ms -= preprocess.cpu_ms;
+            stats.add(lex);
+            stats.add(preprocess);
+            stats.tokens = (long long)tokens.size();
+            stats.macros = (long long)definedMacros.size();
         }
 
-        cout << "---TOKENS---" << endl;
-        for (const auto &token : tokens)
-        {
-            // It's good practice to check tokenTypeToString can handle all TokenType enum values
-            cout << " " << token.value << " ---->("
-                 << tokenTypeToString(token.type) << ") line: "
-                 << token.line << ", col: " << token.col << endl;
-        }
+        // --lint=json and --run: the lint report or the program's output is the only output, so the
+        // usual sections go nowhere.
+        streambuf *stdout_buffer = cout.rdbuf();
+        if (lint_format == "json" || run)
+            cout.rdbuf(nullptr);
 
-        cout << "\n---DEFINED MACROS---" << endl;
-        if (definedMacros.empty())
+        // Debug dumps, only when requested with --emit (in --lint=json and --run mode they would go nowhere).
+        bool dumps = lint_format != "json" && !run;
+        if (dumps && emit.tokens && framed)
+            writeFrame(cout, "tokens", tokensJson(tokens));
+        else if (dumps && emit.tokens)
         {
-            cout << "(No macros defined or parsed)" << endl;
+            cout << "---TOKENS---" << endl;
+            for (const auto &token : tokens)
+            {
+                cout << " " << token.value << " ---->("
+                     << tokenTypeToString(token.type) << ") line: "
+                     << token.line << ", col: " << token.col << endl;
+            }
         }
-        for (const auto &macro : definedMacros)
+
+        if (dumps && emit.macros && framed)
+            writeFrame(cout, "macros", macrosJson(definedMacros));
+        else if (dumps && emit.macros)
         {
-            if (!macro.valid)
+            cout << "\n---DEFINED MACROS---" << endl;
+            if (definedMacros.empty())
             {
-                cout << "Invalid Macro (skipped): " << macro.name << " (defined on line " << macro.line << ")" << endl;
-                continue;
+                cout << "(No macros defined or parsed)" << endl;
             }
-            cout << "Macro: " << macro.name;
-            if (macro.isFunctionLike)
+            for (const auto &macro : definedMacros)
             {
-                cout << "(";
-                for (size_t i = 0; i < macro.parameters.size(); ++i)
+                if (!macro.valid)
+                {
+                    cout << "Invalid Macro (skipped): " << macro.name << " (defined on line " << macro.line << ")" << endl;
+                    continue;
+                }
+                cout << "Macro: " << macro.name;
+                if (macro.isFunctionLike)
                 {
-                    cout << macro.parameters[i] << (i < macro.parameters.size() - 1 ? ", " : "");
+                    cout << "(";
+                    for (size_t i = 0; i < macro.parameters.size(); ++i)
+                    {
+                        cout << macro.parameters[i] << (i < macro.parameters.size() - 1 ? ", " : "");
+                    }
+                    cout << ")";
                 }
-                cout << ")";
+                cout << " -> \"" << macro.body << "\" (Line: " << macro.line << ")" << endl;
             }
-            cout << " -> \"" << macro.body << "\" (Line: " << macro.line << ")" << endl;
         }
+        phaseDone("emit");
         // === Step 3: Parse tokens into AST ===
         Parser parser(tokens);
+        parser.defineMacros(definedMacros); // Macros usable in enumerator values
+        phaseDone("preprocess");
         shared_ptr<ProgramNode> ast_root = parser.parse(); // parser.parse() should not return nullptr based on its impl
+        phaseDone("parse");
+        if (measure)
+        {
+            stats.countAst(ast_root);
+            timer.lap(""); // Counting is not parsing
+        }
 
-        cout << "---AST---" << endl;
-        // ast_root itself will be non-null.
-        // We print it regardless; if parsing failed internally, ProgramNode might be empty
-        // and parser would have printed errors to cerr.
-        printAST(ast_root);
+        if (dumps && emit.ast && framed)
+            writeFrame(cout, "ast", astJson(ast_root));
+        else if (dumps && emit.ast)
+        {
+            cout << "---AST---" << endl;
+            // ast_root itself will be non-null.
+            // We print it regardless; if parsing failed internally, ProgramNode might be empty
+            // and parser would have printed errors to cerr.
+            printAST(ast_root);
+        }
+        phaseDone("emit");
+
+        // Run mode: execute the C program on the bytecode VM instead of transpiling it. Its stdin is
+        // --run-input (our own stdin carried the source), its stdout is ours.
+        if (run)
+        {
+            cout.rdbuf(stdout_buffer);
+            cout.clear();
+            ifstream run_input;
+            istringstream no_input;
+            if (!run_input_path.empty())
+            {
+                run_input.open(run_input_path);
+                if (!run_input)
+                {
+                    cerr << "Run Error: cannot read " << run_input_path << endl;
+                    return 1;
+                }
+            }
+            try
+            {
+                BytecodeCompiler compiler(definedMacros, options.abi);
+                BytecodeProgram program = compiler.compile(ast_root);
+                VirtualMachine vm(program, run_input_path.empty() ? (istream &)no_input : (istream &)run_input, cout, run_steps);
+                return vm.run();
+            }
+            catch (const VMError &e)
+            {
+                cout.flush();
+                cerr << "Run Error";
+                if (e.getLine() > 0)
+                    cerr << " (Line " << e.getLine() << ")";
+                cerr << ": " << e.what() << endl;
+                return 1;
+            }
+        }
 
         // === Step 4: Transpile to Python ===
-        Transpiler transpiler;
+        // Nothing to do when only dumps were asked for (lint and the source map need the transpiler's pass).
+        if (!emit.python && !options.lint && !options.source_map)
+            return finish(0);
+        Transpiler transpiler(options);
+        transpiler.setStats(measure ? &stats : nullptr);
         string python_code;
         try
         {
@@ -519,8 +996,54 @@ void printAST(const shared_ptr<ASTNode> &node, int indent)
         {
             cerr << "Transpilation Error: " << e.what() << endl;
         }
+        timer.lap(""); // The transpiler added its passes
 
-        cout << "\n---PYTHON_CODE---" << endl;
-        cout << python_code << endl;
-        return 0;
+        transpiler.writeInfoMessages(cerr);
+
+        // Performance lint, sorted by C line
+        vector<LintWarning> warnings = transpiler.getLintWarnings();
+        stable_sort(warnings.begin(), warnings.end(), [](const LintWarning &a, const LintWarning &b)
+                    { return a.line < b.line; });
+        reportLint(warnings);
+        if (lint_format == "json")
+        {
+            cout.rdbuf(stdout_buffer);
+            cout.clear();
+            cout << "{\n  \"warnings\": [";
+            for (size_t i = 0; i < warnings.size(); ++i)
+            {
+                const auto &warning = warnings[i];
+                cout << (i == 0 ? "\n" : ",\n") << "    {\"line\": " << warning.line << ", \"rule\": " << jsonString(warning.rule)
+                     << ", \"cost\": " << warning.cost << ", \"message\": " << jsonString(warning.message) << "}";
+            }
+            cout << (warnings.empty() ? "]\n}" : "\n  ]\n}") << endl;
+        }
+
+        if (options.source_map)
+        {
+            SourceMap map;
+            map.c_file = source_name;
+            map.python_file = python_name;
+            map.c_lines = transpiler.getSourceLines();
+            ofstream map_file(source_map_path);
+            map_file << map.serialize();
+            if (!map_file)
+                cerr << "Transpiler Warning: could not write source map " << source_map_path << endl;
+        }
+        phaseDone("emit");
+
+        if (lint_format == "json" || !emit.python)
+            return finish(0);
+        if (framed)
+            writeFrame(cout, "python", python_code);
+        else
+        {
+            // The marker separates the code from the dumps above it; alone, the output is plain Python.
+            if (emit.tokens || emit.macros || emit.ast)
+                cout << endl << "---PYTHON_CODE---" << endl;
+            cout << python_code << endl;
+        }
+        phaseDone("emit");
+        stats.countOutput(python_code);
+        return finish(0);
     }
\ No newline at end of file
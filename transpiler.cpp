@@ -5,12 +5,194 @@
 #include <stdexcept>
 #include <algorithm> // For std::all_of
 #include <cctype>    // For ::isspace
+#include <set>
+#include <cstdio>  // snprintf
+#include <cstdlib> // strtod
+#include <climits> // INT_MAX
 
 // ADD THESE INCLUDES FOR THE TEMPORARY LEXER/PARSER IN transpileMacroBody
 #include "Lexer.h"  // We already have MacroDefinition from transpiler.h, but good to be explicit for Lexer class
 #include "Parser.h" // For Parser class
 // Constructor
-Transpiler::Transpiler() {}
+Transpiler::Transpiler(const TranspilerOptions &options) : m_options(options) {}
+
+// Pointer helpers (see the pointer lowering section below)
+static shared_ptr<ExpressionNode> stripCasts(shared_ptr<ExpressionNode> expr)
+{
+    while (auto cast = dynamic_pointer_cast<CastNode>(expr))
+    {
+        expr = cast->getOperand();
+    }
+    return expr;
+}
+
+static bool isAllocationCall(shared_ptr<ExpressionNode> expr)
+{
+    auto call = dynamic_pointer_cast<FunctionCallNode>(stripCasts(expr));
+    return call && (call->getFunctionName() == "malloc" || call->getFunctionName() == "calloc");
+}
+
+static bool isPointerType(const string &type)
+{
+    return !type.empty() && type.back() == '*';
+}
+
+static bool isZeroLiteral(shared_ptr<ExpressionNode> expr)
+{
+    auto num = dynamic_pointer_cast<NumberNode>(expr);
+    return num && num->getValue() == "0";
+}
+
+static bool parseIntegerLiteral(const string &text, long long &value)
+{
+    size_t digits_from = (!text.empty() && text[0] == '-') ? 1 : 0;
+    if (text.size() <= digits_from || text.size() > 18 ||
+        !all_of(text.begin() + digits_from, text.end(), [](unsigned char c)
+                { return isdigit(c); }))
+        return false;
+    value = stoll(text);
+    return true;
+}
+
+// "o + k" without the noise of a zero offset.
+static string addOffset(const string &offset, const string &op, const string &amount)
+{
+    if (offset == "0")
+        return op == "+" ? amount : "(-" + amount + ")";
+    return "(" + offset + " " + op + " " + amount + ")";
+}
+
+// One printf conversion, %[flags][width][.precision][length]conversion, and the
+// equivalent Python format spec ("" when plain str() formatting already matches C).
+struct FormatSpec
+{
+    size_t length = 0; // Characters consumed, including the '%'
+    char conversion = 0;
+    string python_spec;
+};
+
+static bool parseFormatSpec(const string &fmt, size_t pos, FormatSpec &spec)
+{
+    size_t i = pos + 1;
+    bool left = false, plus = false, space = false, zero = false, alt = false;
+    for (; i < fmt.size() && string("-+ 0#").find(fmt[i]) != string::npos; ++i)
+    {
+        left |= fmt[i] == '-';
+        plus |= fmt[i] == '+';
+        space |= fmt[i] == ' ';
+        zero |= fmt[i] == '0';
+        alt |= fmt[i] == '#';
+    }
+    string width, precision;
+    while (i < fmt.size() && isdigit((unsigned char)fmt[i]))
+        width += fmt[i++];
+    if (i < fmt.size() && fmt[i] == '.')
+    {
+        precision = ".";
+        for (++i; i < fmt.size() && isdigit((unsigned char)fmt[i]); ++i)
+            precision += fmt[i];
+        if (precision == ".")
+            precision = ".0";
+    }
+    while (i < fmt.size() && string("hlLqjzt").find(fmt[i]) != string::npos)
+        ++i;
+    if (i >= fmt.size() || string("diucsfFeEgGxXop").find(fmt[i]) == string::npos)
+        return false;
+
+    spec.conversion = fmt[i];
+    spec.length = i + 1 - pos;
+    bool is_text = spec.conversion == 'c' || spec.conversion == 's';
+    string type;
+    if (string("fFeEgGxXo").find(spec.conversion) != string::npos)
+        type = string(1, spec.conversion);
+    else if (!is_text && spec.conversion != 'p' && (plus || space || zero || !width.empty() || !precision.empty()))
+        type = "d";
+    if (type == "d" && !precision.empty())
+    {
+        // %.3d pads with zeros to the precision; Python has no such spec, so use it as a zero-padded width.
+        width = width.empty() ? precision.substr(1) : width;
+        zero = true;
+        precision.clear();
+    }
+
+    string align = left ? "<" : (is_text && !width.empty() ? ">" : "");
+    string sign = plus ? "+" : (space ? " " : "");
+    spec.python_spec = align + (is_text ? "" : sign) + (alt && !is_text ? "#" : "") +
+                       (zero && !left && !is_text ? "0" : "") + width + precision + type;
+    return true;
+}
+
+// Definitions of the runtime helpers the generated code may call, by name.
+static const vector<pair<string, string>> &runtimeHelperDefinitions()
+{
+    static const vector<pair<string, string>> helpers = {
+        // Rewrites and helpers call builtins through this alias: the C program may define functions of those names.
+        {"_b", "import builtins as _b\n"},
+        {"_unsupported", "def _unsupported(what):\n"
+                         "    raise NotImplementedError(what + \" could not be transpiled\")\n"},
+        {"_cstr", "def _cstr(buf, start=0):\n"
+                  "    end = buf.find(0, start)\n"
+                  "    return buf[start:end if end >= 0 else len(buf)].decode(\"latin-1\")\n"},
+        {"_cstr_set", "def _cstr_set(buf, text, start=0):\n"
+                      "    data = text.encode(\"latin-1\") + b\"\\0\"\n"
+                      "    buf[start:start + len(data)] = data\n"},
+        {"_prof", "import atexit\n"
+                  "from collections import Counter\n"
+                  "_prof = Counter()\n"
+                  "\n"
+                  "@atexit.register\n"
+                  "def _prof_write():\n"
+                  "    with open(_PROFILE_PATH, \"w\") as out:\n"
+                  "        out.write(\"# transpiler profile\\n\")\n"
+                  "        for key, count in sorted(_prof.items()):\n"
+                  "            out.write(\" \".join(map(str, key)) + \" \" + str(count) + \"\\n\")\n"},
+        {"_inst", "import atexit\n"
+                  "import sys\n"
+                  "from time import perf_counter_ns as _inst_clock\n"
+                  "_inst_stats = {}  # (C line, construct) -> [count, total ns, ns in nested constructs]\n"
+                  "_inst_stack = []\n"
+                  "\n"
+                  "def _inst_enter():\n"
+                  "    _inst_stack.append(0)\n"
+                  "    return _inst_clock()\n"
+                  "\n"
+                  "def _inst_exit(key, start):\n"
+                  "    elapsed = _inst_clock() - start\n"
+                  "    nested = _inst_stack.pop()\n"
+                  "    if _inst_stack:\n"
+                  "        _inst_stack[-1] += elapsed\n"
+                  "    stats = _inst_stats.get(key)\n"
+                  "    if stats is None:\n"
+                  "        stats = _inst_stats[key] = [0, 0, 0]\n"
+                  "    stats[0] += 1\n"
+                  "    stats[1] += elapsed\n"
+                  "    stats[2] += nested\n"
+                  "\n"
+                  "@atexit.register\n"
+                  "def _inst_report():\n"
+                  "    rows = sorted(_inst_stats.items(), key=lambda item: item[1][1] - item[1][2], reverse=True)\n"
+                  "    print(\"%12s %12s %10s  %s\" % (\"self ms\", \"total ms\", \"count\", \"C construct\"), file=sys.stderr)\n"
+                  "    for (line, what), (count, total, nested) in rows:\n"
+                  "        print(\"%12.3f %12.3f %10d  line %d: %s\" % ((total - nested) / 1e6, total / 1e6, count, line, what), file=sys.stderr)\n"},
+        {"_pmap", "import os\n"
+                  "from concurrent.futures import ProcessPoolExecutor\n"
+                  "_pool = None\n"
+                  "_pool_workers = os.cpu_count() or 1\n"
+                  "\n"
+                  "def _pchunk(kernel, lo, hi, args):\n"
+                  "    return [kernel(i, *args) for i in _b.range(lo, hi)]\n"
+                  "\n"
+                  "def _pmap(kernel, lo, hi, *args):\n"
+                  "    global _pool\n"
+                  "    if _pool is None:\n"
+                  "        _pool = ProcessPoolExecutor(_pool_workers)\n"
+                  "    chunk = _b.max(1, -(-(hi - lo) // (_pool_workers * 4)))  # About 4 chunks per worker\n"
+                  "    futures = [_pool.submit(_pchunk, kernel, i, _b.min(i + chunk, hi), args) for i in _b.range(lo, hi, chunk)]\n"
+                  "    return [value for future in futures for value in future.result()]\n"},
+    };
+    return helpers;
+}
+
 
 // Utility: Indent given code by the number of 4-space groups specified by 'level_delta'.
 // If 'code_block' is empty or only whitespace, and 'add_pass_if_empty' is true,
@@ -96,12 +278,100 @@ string Transpiler::indent(const string &code_block, int level_delta, bool add_pa
     return result;
 }
 
-// IMPLEMENT THE NEW HELPER FUNCTION
+bool parseTranspilerOption(const string &arg, TranspilerOptions &options)
+{
+    if (arg == "--char-as-int")
+        options.char_as_int = true;
+    else if (arg.rfind("--inline-budget=", 0) == 0)
+        options.inline_budget = stoi(arg.substr(16));
+    else if (arg.rfind("--inline-growth=", 0) == 0)
+        options.inline_growth = stoi(arg.substr(16));
+    else if (arg.rfind("--unroll-trips=", 0) == 0)
+        options.unroll_max_trips = stoi(arg.substr(15));
+    else if (arg.rfind("--unroll-body=", 0) == 0)
+        options.unroll_max_body = stoi(arg.substr(14));
+    else if (arg == "--parallel")
+        options.parallel = true;
+    else if (arg.rfind("--parallel-min-work=", 0) == 0)
+        options.parallel_min_work = stoi(arg.substr(20));
+    else if (arg.rfind("--eval-budget=", 0) == 0)
+        options.eval_budget = stoll(arg.substr(14));
+    else if (arg.rfind("--eval-max-elements=", 0) == 0)
+        options.eval_max_elements = stoll(arg.substr(20));
+    else if (arg.rfind("--profile-gen=", 0) == 0 && arg.size() > 14)
+        options.profile_gen_path = arg.substr(14);
+    else if (arg.rfind("--profile-hot=", 0) == 0)
+        options.profile_hot = stoll(arg.substr(14));
+    else if (arg == "--instrument")
+        options.instrument = true;
+    else if (arg.rfind("--abi=", 0) == 0)
+        options.abi = targetAbiNamed(arg.substr(6));
+    else
+        return false;
+    return true;
+}
+
+void Transpiler::writeInfoMessages(ostream &out) const
+{
+    // Which loops were replaced by builtin/slice idioms
+    for (const auto &rewrite : m_loop_rewrites)
+    {
+        out << "Transpiler Info (Line " << rewrite.line << "): " << rewrite.loop_kind
+            << "-loop rewritten as " << rewrite.idiom << endl;
+    }
+    for (const auto &note : m_profile_notes)
+    {
+        out << "Transpiler Info (Line " << note.first << "): " << note.second << endl;
+    }
+    for (const auto &inlined : m_inlined_calls)
+    {
+        out << "Transpiler Info: " << inlined.second << " call(s) to '" << inlined.first << "' inlined" << endl;
+    }
+}
+
+// With a macro cache, a body translated before (under the same options) is not lexed and parsed
+// again; the messages of its first translation are repeated.
 string Transpiler::transpileMacroBodyToPythonExpression(const string &c_macro_body_source, const vector<string> &macro_params)
 {
+    if (!m_macro_cache)
+        return translateMacroBody(c_macro_body_source, macro_params);
+    string key = c_macro_body_source;
+    for (const auto &param : macro_params)
+        key += '\0' + param;
+    key += '\1' + m_enumerator_key; // The same body folds differently under other enumerators
+    string python, messages;
+    if (m_macro_cache->find(key, python, messages))
+    {
+        *m_diagnostics << messages;
+        if (python.find("_unsupported(") != string::npos)
+            m_runtime_helpers.insert("_unsupported");
+        return python;
+    }
+    ostringstream captured;
+    ostream *diagnostics = m_diagnostics;
+    m_diagnostics = &captured;
+    python = translateMacroBody(c_macro_body_source, macro_params);
+    m_diagnostics = diagnostics;
+    *m_diagnostics << captured.str();
+    m_macro_cache->store(key, python, captured.str());
+    return python;
+}
+
+string Transpiler::translateMacroBody(const string &c_macro_body_source, const vector<string> &macro_params)
+{
+    string python;
+    auto bodyExpr = parseMacroBody(c_macro_body_source, macro_params, python);
+    return bodyExpr ? transpileExpression(bodyExpr) : python;
+}
+
+// The expression of a macro body; nullptr (with the Python to use instead in 'python', "None")
+// if the body is empty or cannot be parsed.
+shared_ptr<ExpressionNode> Transpiler::parseMacroBody(const string &c_macro_body_source, const vector<string> &macro_params, string &python)
+{
+    python = "None"; // Also what a body that fails to translate becomes, after its error message
     if (c_macro_body_source.empty())
     {
-        return "None"; // Or handle as error, or empty string if appropriate
+        return nullptr;
     }
 
     // Create a temporary lexer and parser for the macro body.
@@ -110,6 +380,7 @@ string Transpiler::transpileMacroBodyToPythonExpression(const string &c_macro_bo
     // For simplicity now, our current Lexer will try to process them if they exist.
     // A more robust solution might involve a Lexer constructor flag to disable preprocessor handling.
     Lexer tempLexer(c_macro_body_source);
+    tempLexer.setDiagnostics(*m_diagnostics);
     vector<Token> bodyTokens;
     try
     {
@@ -123,18 +394,20 @@ string Transpiler::transpileMacroBodyToPythonExpression(const string &c_macro_bo
     }
     catch (const std::exception &e)
     {
-        cerr << "Transpiler Error: Could not tokenize macro body '" << c_macro_body_source << "': " << e.what() << endl;
-        return "#ERROR_TOKENIZING_MACRO_BODY";
+        *m_diagnostics << "Transpiler Error: Could not tokenize macro body '" << c_macro_body_source << "': " << e.what() << endl;
+        return nullptr;
     }
 
     // Filter out any macros defined *within* this macro body's tokenization.
     // This is a simple guard; complex nested preproc would need more.
     if (!tempLexer.getDefinedMacros().empty())
     {
-        cerr << "Transpiler Warning: Nested #define found and ignored within macro body: " << c_macro_body_source << endl;
+        *m_diagnostics << "Transpiler Warning: Nested #define found and ignored within macro body: " << c_macro_body_source << endl;
     }
 
     Parser tempParser(bodyTokens);
+    tempParser.setDiagnostics(*m_diagnostics);
+    tempParser.defineEnumerators(m_enumerators, macro_params); // Folded as in the program: enums are not Python globals
     shared_ptr<ExpressionNode> bodyExpr;
     try
     {
@@ -143,19 +416,19 @@ string Transpiler::transpileMacroBodyToPythonExpression(const string &c_macro_bo
                         { return std::isspace(c); }))
         {
             // If body was just whitespace, it's effectively empty.
-            return "None"; // Or "" if that's more suitable for an empty expression in Python.
+            return nullptr;
         }
         if (bodyTokens.empty() && !c_macro_body_source.empty())
         {
             // If body tokens are empty but C source was not (just whitespace), it's an issue.
             // If C source was also empty, 'return "None"' above handled it.
             // This case could mean the lexer consumed everything as skippable.
-            cerr << "Transpiler Error: Macro body '" << c_macro_body_source << "' resulted in no tokens for parsing as expression." << endl;
-            return "#ERROR_EMPTY_TOKENS_FOR_MACRO_BODY";
+            *m_diagnostics << "Transpiler Error: Macro body '" << c_macro_body_source << "' resulted in no tokens for parsing as expression." << endl;
+            return nullptr;
         }
         if (bodyTokens.empty() && c_macro_body_source.empty())
         {
-            return "None"; // Macro body was literally empty
+            return nullptr; // Macro body was literally empty
         }
 
         bodyExpr = tempParser.parseExpression(); // This should parse up to where it thinks the expression ends.
@@ -170,22 +443,60 @@ string Transpiler::transpileMacroBodyToPythonExpression(const string &c_macro_bo
         if (bodyTokens.empty() && error_what.find("Expected primary expression") != string::npos && error_what.find("EndOfFile") != string::npos)
         {
             // Macro body was effectively empty (e.g. just comments)
-            return "None"; // Or an empty string, depending on how Python should treat empty macro bodies
+            return nullptr;
         }
-        cerr << "Transpiler Error: Could not parse macro body '" << c_macro_body_source << "' as expression: " << e.what() << endl;
-        return "#ERROR_PARSING_MACRO_BODY";
+        *m_diagnostics << "Transpiler Error: Could not parse macro body '" << c_macro_body_source << "' as expression: " << e.what() << endl;
+        return nullptr;
     }
 
     if (!bodyExpr)
     {
-        cerr << "Transpiler Error: Parsing macro body '" << c_macro_body_source << "' yielded null expression." << endl;
-        return "#ERROR_NULL_EXPR_MACRO_BODY";
+        *m_diagnostics << "Transpiler Error: Parsing macro body '" << c_macro_body_source << "' yielded null expression." << endl;
+        return nullptr;
     }
 
     // The transpiled expression might use macro parameters.
     // For this simple version, C macro expansion is textual. Python functions will handle parameters.
     // No direct text substitution in this transpiler stage for macro parameters.
-    return transpileExpression(bodyExpr);
+    return bodyExpr;
+}
+
+// A use of a macro from m_macro_expansions (an identifier, or a call with one argument per
+// parameter): the body, transpiled here so that its sizeof sees the declarations in scope.
+bool Transpiler::transpileMacroExpansion(const string &name, bool called, const vector<shared_ptr<ExpressionNode>> &args,
+                                         string &out_code)
+{
+    auto it = m_macro_expansions.find(name);
+    if (it == m_macro_expansions.end() || it->second.function_like != called || it->second.parameters.size() != args.size() ||
+        m_expanding_macros.count(name))
+        return false; // As in C, a macro is not expanded again inside its own expansion
+    const MacroExpansion &expansion = it->second;
+    unordered_map<string, shared_ptr<ExpressionNode>> arguments;
+    for (size_t i = 0; i < args.size(); ++i)
+        arguments[expansion.parameters[i]] = args[i];
+    m_macro_arguments.push_back(arguments);
+    m_expanding_macros.insert(name);
+    out_code = "(" + transpileExpression(expansion.body) + ")";
+    m_expanding_macros.erase(name);
+    m_macro_arguments.pop_back();
+    return true;
+}
+
+// Calls 'use' with the argument that 'name' stands for if it is a parameter of the innermost macro
+// expansion. The argument belongs to the macro's use site, so that expansion is set aside meanwhile.
+bool Transpiler::withMacroArgument(const string &name, const function<void(const shared_ptr<ExpressionNode> &)> &use) const
+{
+    if (m_macro_arguments.empty())
+        return false;
+    auto it = m_macro_arguments.back().find(name);
+    if (it == m_macro_arguments.back().end())
+        return false;
+    shared_ptr<ExpressionNode> argument = it->second;
+    auto arguments = move(m_macro_arguments.back());
+    m_macro_arguments.pop_back();
+    use(argument);
+    m_macro_arguments.push_back(move(arguments));
+    return true;
 }
 
 // MODIFY Transpiler::transpile
@@ -195,19 +506,117 @@ string Transpiler::transpile(shared_ptr<ProgramNode> program, const vector<Macro
     { // Should not happen if parser always returns a ProgramNode
         return "# Error: Program AST is null\n";
     }
-    return transpileProgram(program, macros); // Pass macros along
+    string code = transpileProgram(program, macros); // Pass macros along
+    if (!m_options.source_map)
+        return code;
+    PhaseTimer timer(m_stats != nullptr);
+    code = stripSourceTags(code);
+    if (m_stats)
+        m_stats->add(timer.lap("pass:source-map"));
+    return code;
+}
+
+// --- Source map ---
+// With source_map on, transpileStatement puts a tag "\x01<C line>\x02" after the indentation of
+// the first line of each statement's code. Here the tags are removed and each Python line gets
+// the C line of its innermost (last) tag. Untagged lines continue the statement above them,
+// except at indentation 0, where they are generated code (helpers, macros, the main() guard).
+static const char SOURCE_TAG_START = '\x01';
+static const char SOURCE_TAG_END = '\x02';
+
+string Transpiler::stripSourceTags(const string &tagged_code)
+{
+    m_source_lines.clear();
+    string code;
+    istringstream lines(tagged_code);
+    string line;
+    int current = 0;
+    while (getline(lines, line))
+    {
+        int tagged = 0;
+        size_t start;
+        while ((start = line.find(SOURCE_TAG_START)) != string::npos)
+        {
+            size_t end = line.find(SOURCE_TAG_END, start);
+            tagged = stoi(line.substr(start + 1, end - start - 1));
+            line.erase(start, end - start + 1);
+        }
+        if (tagged)
+            current = tagged;
+        else if (line.empty() || !isspace((unsigned char)line[0]))
+            current = 0;
+        m_source_lines.push_back(tagged ? tagged : current);
+        code += line + "\n";
+    }
+    if (!tagged_code.empty() && tagged_code.back() != '\n')
+        code.pop_back();
+    return code;
 }
 
 string Transpiler::transpileProgram(shared_ptr<ProgramNode> program, const vector<MacroDefinition> &macros)
 {
     string py_code;
+    PhaseTimer timer(m_stats != nullptr);
+    auto passDone = [&](const char *name)
+    {
+        if (m_stats)
+            m_stats->add(timer.lap(string("pass:") + name));
+    };
 
     // --- 1. Transpile Macro Definitions ---
+    m_enumerators = program->enumerators;
+    map<string, long long> sorted_enumerators(m_enumerators.begin(), m_enumerators.end());
+    m_enumerator_key.clear();
+    for (const auto &enumerator : sorted_enumerators)
+        m_enumerator_key += enumerator.first + "=" + to_string(enumerator.second) + ";";
     string transpiled_macros_code;
+    m_integer_macros.clear();
+    m_macro_functions.clear();
+    m_macro_expansions.clear();
     for (const auto &macroDef : macros)
     {
         if (!macroDef.valid)
             continue; // Skip invalid macros
+        if (macroDef.isFunctionLike)
+            m_macro_functions.insert(macroDef.name);
+
+        // A sizeof that depends on the arguments or on later declarations (#define COUNT(a)
+        // (sizeof(a) / sizeof(a[0]))) has no value here: such a macro is expanded where it is used.
+        if (macroDef.body.find("sizeof") != string::npos)
+        {
+            ostringstream ignored; // A body that does not parse is reported when it is translated below
+            ostream *diagnostics = m_diagnostics;
+            m_diagnostics = &ignored;
+            string python;
+            auto bodyExpr = parseMacroBody(macroDef.body, macroDef.parameters, python);
+            m_diagnostics = diagnostics;
+            bool foldable = true;
+            function<void(const shared_ptr<ASTNode> &)> visit = [&](const shared_ptr<ASTNode> &node)
+            {
+                long long size;
+                auto sizeofNode = dynamic_pointer_cast<SizeofNode>(node);
+                if (sizeofNode && !sizeofValue(sizeofNode, size))
+                    foldable = false;
+                forEachChild(node, visit);
+            };
+            visit(bodyExpr);
+            if (bodyExpr && !foldable)
+            {
+                m_macro_expansions[macroDef.name] = {macroDef.isFunctionLike, macroDef.parameters, bodyExpr};
+                transpiled_macros_code += "# " + macroDef.name + (macroDef.isFunctionLike ? "()" : "") +
+                                          " is expanded where it is used (sizeof)\n";
+                continue;
+            }
+        }
+
+        // #define N 4: loop bounds using N count as constants (see transpileUnrolledLoop)
+        string body = macroDef.body;
+        body.erase(remove_if(body.begin(), body.end(), [](unsigned char c)
+                             { return isspace(c); }),
+                   body.end());
+        long long ignored;
+        if (!macroDef.isFunctionLike && parseIntegerLiteral(body, ignored))
+            m_integer_macros[macroDef.name] = body;
 
         if (macroDef.isFunctionLike)
         {
@@ -237,17 +646,94 @@ string Transpiler::transpileProgram(shared_ptr<ProgramNode> program, const vecto
     }
 
     py_code += transpiled_macros_code;
+    passDone("macros");
 
     // --- 2. Transpile Program Statements ---
+    planPointerArguments(program);
+    planInlining(program);
+    passDone("inline-plan");
+    m_global_names.clear();
+    for (const auto &stmt : program->getStatements())
+    {
+        auto decl = dynamic_pointer_cast<DeclarationNode>(stmt);
+        if (decl && !dynamic_pointer_cast<FunctionDeclarationNode>(stmt))
+            m_global_names.insert(decl->getName());
+    }
+    planGlobalTables(program);
+    passDone("global-tables");
+    summarizePurity(program);
+    passDone("purity");
+    prepareLint(program);
+    passDone("lint-prep");
+    m_parallel_kernels.clear();
+    bool has_main = false;
     string program_statements_code;
     for (const auto &stmt : program->getStatements())
     {
+        auto decl = dynamic_pointer_cast<VariableDeclarationNode>(stmt);
+        auto precomputed = decl ? m_precomputed_globals.find(decl->getName()) : m_precomputed_globals.end();
+        if (precomputed != m_precomputed_globals.end())
+        {
+            program_statements_code += transpileEvaluatedVariable(precomputed->first, precomputed->second, 0);
+            continue;
+        }
         // Top-level statements are at indent level 0.
         program_statements_code += transpileStatement(stmt, 0);
+        auto funcDecl = dynamic_pointer_cast<FunctionDeclarationNode>(stmt);
+        has_main = has_main || (funcDecl && funcDecl->getName() == "main" && funcDecl->getBody());
     }
     py_code += program_statements_code;
+    passDone("codegen");
+
+    // Pool workers re-import the module when processes are spawned instead of forked,
+    // so with parallel loops the entry point must only run in the parent.
+    if (!m_parallel_kernels.empty() && has_main)
+    {
+        py_code += "\nif __name__ == \"__main__\":\n" + indent("main()\n", 1);
+    }
+
+    // --- 3. Runtime helpers and parallel loop kernels used by the statements above go first ---
+    string profile_path_code;
+    if (isProfiling())
+    {
+        string path;
+        for (char c : m_options.profile_gen_path)
+            path += (c == '\\' || c == '"') ? string("\\") + c : string(1, c);
+        profile_path_code = "_PROFILE_PATH = \"" + path + "\"\n\n";
+    }
+    string module = transpileRuntimeHelpers() + profile_path_code + m_parallel_kernels + py_code;
+    passDone("helpers");
+    return module;
+}
+
+string Transpiler::transpileRuntimeHelpers() const
+{
+    string helpers_code;
+    for (const auto &helper : runtimeHelperDefinitions())
+    {
+        if (m_runtime_helpers.count(helper.first))
+            helpers_code += helper.second + "\n";
+    }
+    return helpers_code;
+}
 
-    return py_code;
+// A char* argument of printf/scanf in char-as-int mode: returns the bytearray (or bytes literal)
+// expression and sets offset to the index the C string starts at.
+string Transpiler::transpileCharBufferArgument(shared_ptr<ExpressionNode> expr, string &offset)
+{
+    string buffer;
+    offset = "0";
+    if (isPointerExpression(expr) && pointerParts(expr, buffer, offset))
+        return buffer;
+    offset = "0";
+    auto unary = dynamic_pointer_cast<UnaryExpressionNode>(expr);
+    auto sub = unary && unary->getOperator() == "&" ? dynamic_pointer_cast<ArraySubscriptNode>(unary->getOperand()) : nullptr;
+    if (sub && !isPointerExpression(sub->getArrayExpression())) // &s[k]
+    {
+        offset = transpileExpression(sub->getIndexExpression());
+        return transpileExpression(sub->getArrayExpression());
+    }
+    return transpileExpression(expr);
 }
 
 string Transpiler::transpilePrintfStatement(shared_ptr<PrintfNode> stmt)
@@ -256,27 +742,43 @@ string Transpiler::transpilePrintfStatement(shared_ptr<PrintfNode> stmt)
     if (!formatStringNode)
         return "# Error: printf format string is not a string literal\n";
     string formatStr = formatStringNode->getValue();
-    vector<string> pyArgs;
-    for (const auto &argExpr : stmt->getArguments())
-        pyArgs.push_back(transpileExpression(argExpr));
+    auto args = stmt->getArguments();
     size_t argIdx = 0;
     string f_string_content = "";
     for (size_t i = 0; i < formatStr.length(); ++i)
     {
         if (formatStr[i] == '%')
         { /* ... printf to f-string logic ... */
+            FormatSpec spec;
             if (i + 1 < formatStr.length() && formatStr[i + 1] == '%')
             {
                 f_string_content += '%';
                 i++;
             }
-            else if (i + 1 < formatStr.length())
+            else if (parseFormatSpec(formatStr, i, spec))
             {
-                if (argIdx < pyArgs.size())
+                if (argIdx < args.size())
                 {
-                    f_string_content += "{" + pyArgs[argIdx] + "}";
+                    // In char-as-int mode chars and strings only become str here, at the output boundary.
+                    string value;
+                    if (m_options.char_as_int && spec.conversion == 'c')
+                    {
+                        value = "chr(" + transpileExpression(args[argIdx]) + ")";
+                    }
+                    else if (m_options.char_as_int && spec.conversion == 's')
+                    {
+                        string offset;
+                        string buffer = transpileCharBufferArgument(args[argIdx], offset);
+                        value = "_cstr(" + buffer + (offset == "0" ? "" : ", " + offset) + ")";
+                        m_runtime_helpers.insert("_cstr");
+                    }
+                    else
+                    {
+                        value = transpileExpression(args[argIdx]);
+                    }
+                    f_string_content += "{" + value + (spec.python_spec.empty() ? "" : ":" + spec.python_spec) + "}";
                     argIdx++;
-                    i++;
+                    i += spec.length - 1;
                 }
                 else
                 {
@@ -304,7 +806,16 @@ string Transpiler::transpilePrintfStatement(shared_ptr<PrintfNode> stmt)
                 f_string_content += formatStr[i];
         }
     }
-    return "print(f\"" + f_string_content + "\")\n";
+    // print() ends the line itself: a format that ends with \n leaves it to print(), any other
+    // (a prompt, part of a line) must not get one.
+    size_t backslashes = 0;
+    while (f_string_content.size() >= backslashes + 2 &&
+           f_string_content[f_string_content.size() - 2 - backslashes] == '\\')
+        backslashes++;
+    bool ends_line = f_string_content.size() >= 2 && f_string_content.back() == 'n' && backslashes % 2 == 1;
+    if (ends_line)
+        return "print(f\"" + f_string_content.substr(0, f_string_content.size() - 2) + "\")\n";
+    return "print(f\"" + f_string_content + "\", end=\"\")\n";
 }
 string Transpiler::transpileScanfStatement(shared_ptr<ScanfNode> stmt)
 {
@@ -328,10 +839,18 @@ string Transpiler::transpileScanfStatement(shared_ptr<ScanfNode> stmt)
                 continue;
             }
         }
+        // A char array or char pointer already is the address scanf("%s") needs.
+        auto ident = dynamic_pointer_cast<IdentifierNode>(argExpr);
+        string type = ident && m_declared_types.count(ident->getName()) ? m_declared_types[ident->getName()] : "";
+        if (isPointerType(type) || (type.size() > 2 && type.substr(type.size() - 2) == "[]"))
+        {
+            py_target_vars_str.push_back(ident->getName());
+            continue;
+        }
         // Fallback: if not a recognized &expression.
         // This could be an error for complex expressions not meant as simple scanf targets.
         // For robustness, we can try to transpile it, but it might lead to invalid Python.
-        cerr << "Transpiler Warning: Scanf argument '" << transpileExpression(argExpr)
+        *m_diagnostics << "Transpiler Warning: Scanf argument '" << transpileExpression(argExpr)
              << "' is not a simple address-of expression. Transpiling as is for target." << endl;
         py_target_vars_str.push_back(transpileExpression(argExpr)); // Attempt to transpile it
     }
@@ -414,8 +933,18 @@ string Transpiler::transpileScanfStatement(shared_ptr<ScanfNode> stmt)
             result_code += current_target_var_str + " = int(" + rhs + ")\n";
         else if (spec_token == "%f")
             result_code += current_target_var_str + " = float(" + rhs + ")\n";
+        else if (spec_token == "%s" && m_options.char_as_int)
+        {
+            // Copy the word into the char array, NUL terminated, like C does
+            string offset;
+            string buffer = transpileCharBufferArgument(stmt->getArguments()[var_idx], offset);
+            result_code += "_cstr_set(" + buffer + ", " + rhs + (offset == "0" ? "" : ", " + offset) + ")\n";
+            m_runtime_helpers.insert("_cstr_set");
+        }
         else if (spec_token == "%s")
             result_code += current_target_var_str + " = " + rhs + "\n";
+        else if (spec_token == "%c" && m_options.char_as_int)
+            result_code += current_target_var_str + " = ord((" + rhs + ")[:1] or \"\\0\")\n";
         else if (spec_token == "%c")
             result_code += current_target_var_str + " = (" + rhs + ")[0] if " + rhs + " else ''\n";
         else
@@ -446,13 +975,38 @@ string Transpiler::transpileReturnStatement(shared_ptr<ReturnNode> stmt)
 string Transpiler::transpileVariableDeclaration(shared_ptr<VariableDeclarationNode> decl)
 { /* ... same ... */
     string name = decl->getName();
+    m_declared_types[name] = decl->getDeclaredType();
+    m_array_dims.erase(name);
+    if (decl->getInitializer() && m_pointers.count(name))
+    {
+        string assignment = transpilePointerAssignment(name, decl->getInitializer());
+        return assignment.empty() ? "" : assignment + "\n";
+    }
+    if (m_boxed.count(name))
+        return name + " = [" + (decl->getInitializer() ? transpileExpression(decl->getInitializer()) : "0") + "]\n";
     if (decl->getInitializer())
         return name + " = " + transpileExpression(decl->getInitializer()) + "\n";
     return "";
 }
 string Transpiler::transpileExpressionStatement(shared_ptr<ExpressionStatementNode> stmt)
 { /* ... same ... */
-    return transpileExpression(stmt->getExpression()) + "\n";
+    // free(p): Python reclaims the list once nothing refers to it, so only drop our reference.
+    auto call = dynamic_pointer_cast<FunctionCallNode>(stmt->getExpression());
+    if (call && call->getFunctionName() == "free")
+    {
+        auto args = call->getArguments();
+        auto target = args.size() == 1 ? dynamic_pointer_cast<IdentifierNode>(stripCasts(args[0])) : nullptr;
+        auto it = target ? m_pointers.find(target->getName()) : m_pointers.end();
+        if (it == m_pointers.end())
+            return "";
+        if (it->second.kind == PointerInfo::Kind::Buffer)
+            return target->getName() + " = None\n";
+        if (it->second.buffer == target->getName() + "__buf")
+            return it->second.buffer + " = None\n";
+        return "";
+    }
+    string expr_code = transpileExpression(stmt->getExpression());
+    return expr_code.empty() ? "" : expr_code + "\n";
 }
 string Transpiler::transpileBreakStatement(shared_ptr<BreakNode> stmt) { return "break\n"; }
 string Transpiler::transpileContinueStatement(shared_ptr<ContinueNode> stmt) { return "continue\n"; }
@@ -466,11 +1020,8 @@ string Transpiler::transpileBlock(shared_ptr<BlockNode> block, int content_inden
     string collected_code_for_block_content;
     if (block)
     {
-        for (const auto &stmt_in_block : block->getStatements())
-        {
-            // Each statement inside this block will be rendered at `content_indent_level`
-            collected_code_for_block_content += transpileStatement(stmt_in_block, content_indent_level);
-        }
+        // Each statement inside this block will be rendered at `content_indent_level`
+        collected_code_for_block_content = transpileStatementList(block->getStatements(), content_indent_level);
     }
     // If collected_code_for_block_content is empty (e.g. from empty BlockNode or all children were empty decls)
     // The `indent` utility should handle adding "pass" correctly IF it was called from If/While etc
@@ -522,48 +1073,465 @@ string Transpiler::transpileBlock(shared_ptr<BlockNode> block, int content_inden
 // PASTE THIS NEW CODE IN ITS PLACE
 string Transpiler::transpileIfStatement(shared_ptr<IfNode> stmt, int base_indent_level)
 {
-    // 1. Transpile the initial 'if' part
-    string condition = transpileExpression(stmt->getCondition());
-    string code = indent("if " + condition + ":\n", base_indent_level);
-    code += transpileStatement(stmt->getThenBranch(), base_indent_level + 1);
+    // 1. Collect the chain: the conditions of 'if' and each 'else if' with their branches,
+    //    then the final 'else' (if there is one).
+    vector<shared_ptr<ExpressionNode>> conditions;
+    vector<shared_ptr<StatementNode>> branches;
+    shared_ptr<StatementNode> else_branch;
+    shared_ptr<StatementNode> current_branch = stmt;
+    while (current_branch)
+    {
+        if (auto if_node = dynamic_pointer_cast<IfNode>(current_branch))
+        {
+            conditions.push_back(if_node->getCondition());
+            branches.push_back(if_node->getThenBranch());
+            current_branch = if_node->getElseBranch();
+        }
+        else
+        {
+            else_branch = current_branch;
+            current_branch = nullptr;
+        }
+    }
+
+    // 2. With a profile, the most frequently taken arms are tested first (where that is safe).
+    vector<size_t> order = profiledArmOrder(stmt->line, conditions);
+    const ProfileData &profile = m_options.profile;
+    long long chain_count = 0; // Times the chain ran; only known when every outcome is counted (there is an else)
+    for (size_t arm = 0; arm <= conditions.size(); ++arm)
+        chain_count += profile.branchCount(stmt->line, (int)arm);
+    bool chain_ran = else_branch ? true : chain_count > 0;
+
+    // An arm's body: counted with --profile-gen; cold with --profile-use if the chain ran but the arm never did.
+    auto transpileArm = [&](size_t arm, shared_ptr<StatementNode> branch)
+    {
+        string arm_code;
+        if (isProfiling())
+            arm_code += profileCounter("\"branch\", " + to_string(stmt->line) + ", " + to_string(arm), base_indent_level + 1);
+        bool outer_cold = m_cold;
+        m_cold = m_cold || (profile.loaded && chain_ran && profile.branchCount(stmt->line, (int)arm) == 0);
+        arm_code += transpileStatement(branch, base_indent_level + 1);
+        m_cold = outer_cold;
+        return arm_code;
+    };
+
+    // 3. Emit 'if', one 'elif' per further condition, and the final 'else'.
+    string code;
+    for (size_t position = 0; position < order.size(); ++position)
+    {
+        size_t arm = order[position];
+        string condition = transpileExpression(conditions[arm]);
+        code += indent((position == 0 ? "if " : "elif ") + condition + ":\n", base_indent_level);
+        code += transpileArm(arm, branches[arm]);
+    }
+    if (else_branch)
+    {
+        code += indent("else:\n", base_indent_level);
+        code += transpileArm(conditions.size(), else_branch);
+    }
+    return code;
+}
+
+// --- Loop idiom recognizer ---
+// Counted loops that only reduce, search, fill or copy an array are replaced by the matching
+// Python builtin or slice operation, which runs at C speed instead of one bytecode loop per element.
+
+// Returns the statements of a loop/branch body (a lone statement counts as a one-element list).
+static vector<shared_ptr<StatementNode>> bodyStatements(shared_ptr<StatementNode> body)
+{
+    if (auto block = dynamic_pointer_cast<BlockNode>(body))
+    {
+        return block->getStatements();
+    }
+    if (body)
+    {
+        return {body};
+    }
+    return {};
+}
+
+static bool isIdentifierNamed(shared_ptr<ExpressionNode> expr, const string &name)
+{
+    auto ident = dynamic_pointer_cast<IdentifierNode>(expr);
+    return ident && ident->getName() == name;
+}
+
+// Matches `A[var]` where A is a plain identifier; stores A in array_name.
+static bool isSubscriptByVar(shared_ptr<ExpressionNode> expr, const string &var, string &array_name)
+{
+    auto sub = dynamic_pointer_cast<ArraySubscriptNode>(expr);
+    if (!sub || !isIdentifierNamed(sub->getIndexExpression(), var))
+        return false;
+    auto arr = dynamic_pointer_cast<IdentifierNode>(sub->getArrayExpression());
+    if (!arr)
+        return false;
+    array_name = arr->getName();
+    return true;
+}
+
+// Matches `var++`, `++var`, `var = var + 1` and `var = 1 + var` as an expression statement.
+static bool isUnitIncrementOf(shared_ptr<StatementNode> stmt, const string &var)
+{
+    auto exprStmt = dynamic_pointer_cast<ExpressionStatementNode>(stmt);
+    if (!exprStmt)
+        return false;
+    auto expr = exprStmt->getExpression();
+    if (auto unary = dynamic_pointer_cast<UnaryExpressionNode>(expr))
+    {
+        return unary->getOperator() == "++" && isIdentifierNamed(unary->getOperand(), var);
+    }
+    if (auto assign = dynamic_pointer_cast<AssignmentNode>(expr))
+    {
+        auto sum = dynamic_pointer_cast<BinaryExpressionNode>(assign->getRValue());
+        if (!isIdentifierNamed(assign->getLValue(), var) || !sum || sum->getOperator() != "+")
+            return false;
+        auto one = [](shared_ptr<ExpressionNode> e)
+        {
+            auto num = dynamic_pointer_cast<NumberNode>(e);
+            return num && num->getValue() == "1";
+        };
+        return (isIdentifierNamed(sum->getLeft(), var) && one(sum->getRight())) ||
+               (one(sum->getLeft()) && isIdentifierNamed(sum->getRight(), var));
+    }
+    return false;
+}
+
+// Collects every identifier that appears inside an expression.
+static void collectIdentifiers(shared_ptr<ASTNode> node, set<string> &names)
+{
+    if (!node)
+        return;
+    if (auto ident = dynamic_pointer_cast<IdentifierNode>(node))
+    {
+        names.insert(ident->getName());
+    }
+    for (const auto &child : node->getChildren())
+    {
+        collectIdentifiers(child, names);
+    }
+}
+
+// True when evaluating the expression cannot change program state (no calls, assignments, ++ or --).
+static bool isSideEffectFree(shared_ptr<ASTNode> node)
+{
+    if (!node)
+        return true;
+    if (dynamic_pointer_cast<AssignmentNode>(node) || dynamic_pointer_cast<FunctionCallNode>(node))
+        return false;
+    if (auto unary = dynamic_pointer_cast<UnaryExpressionNode>(node))
+    {
+        if (unary->getOperator() == "++" || unary->getOperator() == "--")
+            return false;
+    }
+    for (const auto &child : node->getChildren())
+    {
+        if (!isSideEffectFree(child))
+            return false;
+    }
+    return true;
+}
 
-    // 2. Start processing the chain of 'else' branches
-    shared_ptr<StatementNode> current_else_branch = stmt->getElseBranch();
+static bool containsSubscript(shared_ptr<ASTNode> node)
+{
+    if (!node)
+        return false;
+    if (dynamic_pointer_cast<ArraySubscriptNode>(node))
+        return true;
+    for (const auto &child : node->getChildren())
+    {
+        if (containsSubscript(child))
+            return true;
+    }
+    return false;
+}
 
-    // Loop through the chain of 'else if's
-    while (current_else_branch)
+// True if a break/continue in 'stmt' would act on the enclosing loop (nested loops own theirs).
+static bool containsLoopControl(shared_ptr<StatementNode> stmt)
+{
+    if (!stmt)
+        return false;
+    if (dynamic_pointer_cast<BreakNode>(stmt) || dynamic_pointer_cast<ContinueNode>(stmt))
+        return true;
+    if (auto block = dynamic_pointer_cast<BlockNode>(stmt))
     {
-        // Try to cast the current else branch to an IfNode.
-        // If successful, it's an 'else if' construct.
-        if (auto else_if_node = dynamic_pointer_cast<IfNode>(current_else_branch))
+        for (const auto &inner : block->getStatements())
         {
-            // It's an 'else if', so generate an 'elif'.
-            string elif_condition = transpileExpression(else_if_node->getCondition());
-            code += indent("elif " + elif_condition + ":\n", base_indent_level);
-            code += transpileStatement(else_if_node->getThenBranch(), base_indent_level + 1);
+            if (containsLoopControl(inner))
+                return true;
+        }
+    }
+    if (auto ifStmt = dynamic_pointer_cast<IfNode>(stmt))
+    {
+        return containsLoopControl(ifStmt->getThenBranch()) || containsLoopControl(ifStmt->getElseBranch());
+    }
+    return false;
+}
 
-            // Move to the next link in the chain for the next loop iteration.
-            current_else_branch = else_if_node->getElseBranch();
+string Transpiler::elementTypeOf(const string &array_name) const
+{
+    auto it = m_declared_types.find(array_name);
+    if (it == m_declared_types.end() || it->second.size() < 2 || it->second.substr(it->second.size() - 2) != "[]")
+        return "";
+    return it->second.substr(0, it->second.size() - 2);
+}
+
+// Tries to replace a counted loop with a builtin/slice equivalent. On success the rewritten
+// code (indented to 'indent_level') is stored in out_code and the rewrite is recorded in the report.
+bool Transpiler::transpileLoopIdiom(const CountedLoop &loop, int line, const string &loop_kind, int indent_level, string &out_code)
+{
+    const string &var = loop.var;
+    auto stmt = loop.body_stmt;
+    if (!stmt || !loop.hi || isProfiling() || m_boxed.count(var))
+        return false; // An instrumented build keeps every loop, so its iterations can be counted
+
+    // The rewritten code evaluates the bounds once, so they must not have side effects
+    // and must not depend on the induction variable.
+    if (!isSideEffectFree(loop.hi) || !isSideEffectFree(loop.lo))
+        return false;
+    set<string> bound_names;
+    collectIdentifiers(loop.hi, bound_names);
+    collectIdentifiers(loop.lo, bound_names);
+    if (bound_names.count(var))
+        return false;
+
+    string lo_py = loop.lo ? transpileExpression(loop.lo) : var;
+    string hi_py = transpileExpression(loop.hi);
+    if (loop.inclusive)
+        hi_py = "(" + hi_py + " + 1)";
+    string slice = "[" + lo_py + ":" + hi_py + "]";
+    // The elements lo..hi of A. A lowered pointer is sliced in the list it walks, from its offset on
+    // (p[i] is p__buf[p + i]).
+    auto sliceOf = [&](const string &name)
+    {
+        auto it = m_pointers.find(name);
+        if (it == m_pointers.end() || (it->second.kind != PointerInfo::Kind::Walker && it->second.kind != PointerInfo::Kind::Pair))
+            return name + slice;
+        return it->second.buffer + "[" + (lo_py == "0" ? name : addOffset(name, "+", lo_py)) + ":" + addOffset(name, "+", hi_py) + "]";
+    };
+    // After a C loop without break the counter is hi, or lo if the loop never ran.
+    string var_epilogue = loop.var_live_after ? var + " = _b.max(" + lo_py + ", " + hi_py + ")\n" : "";
+
+    string code;
+    string idiom;
+    set<string> written; // Names the loop body assigns; the bounds must not depend on them
+
+    if (auto exprStmt = dynamic_pointer_cast<ExpressionStatementNode>(stmt))
+    {
+        auto assign = dynamic_pointer_cast<AssignmentNode>(exprStmt->getExpression());
+        if (!assign)
+            return false;
+        auto lval = assign->getLValue();
+        auto rval = assign->getRValue();
+        string array_name;
+
+        if (auto acc = dynamic_pointer_cast<IdentifierNode>(lval))
+        {
+            // Sum reduction: s = s + A[i] (or s = A[i] + s)
+            string acc_name = acc->getName();
+            auto add = dynamic_pointer_cast<BinaryExpressionNode>(rval);
+            if (!add || add->getOperator() != "+")
+                return false;
+            bool matched = (isIdentifierNamed(add->getLeft(), acc_name) && isSubscriptByVar(add->getRight(), var, array_name)) ||
+                           (isSubscriptByVar(add->getLeft(), var, array_name) && isIdentifierNamed(add->getRight(), acc_name));
+            if (!matched || acc_name == var || acc_name == array_name || array_name == var)
+                return false;
+            // sum() only reproduces C's element-by-element result exactly for integers.
+            auto acc_type = m_declared_types.find(acc_name);
+            if (acc_type == m_declared_types.end() || acc_type->second != "int" || elementTypeOf(array_name) != "int")
+                return false;
+            written.insert(acc_name);
+            code = acc_name + " = _b.sum(" + sliceOf(array_name) + ", " + acc_name + ")\n" + var_epilogue;
+            idiom = "sum() reduction over " + array_name;
+        }
+        else if (isSubscriptByVar(lval, var, array_name))
+        {
+            if (array_name == var)
+                return false;
+            string src_name;
+            if (isSubscriptByVar(rval, var, src_name))
+            {
+                // Copy: D[i] = S[i]. Slice assignment copies S first, so aliasing D and S is harmless.
+                string dst_elem = elementTypeOf(array_name);
+                string src_elem = elementTypeOf(src_name);
+                if (src_name == var || (!dst_elem.empty() && !src_elem.empty() && dst_elem != src_elem))
+                    return false;
+                code = sliceOf(array_name) + " = " + sliceOf(src_name) + "\n" + var_epilogue;
+                idiom = "slice copy from " + src_name + " to " + array_name;
+            }
+            else
+            {
+                // Fill: A[i] = v with v loop-invariant. Rejecting subscripts in v rules out
+                // reading A (or an alias of it) while it is being filled.
+                set<string> value_names;
+                collectIdentifiers(rval, value_names);
+                if (!isSideEffectFree(rval) || containsSubscript(rval) || value_names.count(var) || value_names.count(array_name))
+                    return false;
+                code = sliceOf(array_name) + " = [" + transpileExpression(rval) + "] * (" + hi_py + " - " + lo_py + ")\n" + var_epilogue;
+                idiom = "slice fill of " + array_name;
+            }
+            written.insert(array_name);
         }
         else
         {
-            // It's a final 'else' block (not another 'if').
-            code += indent("else:\n", base_indent_level);
-            code += transpileStatement(current_else_branch, base_indent_level + 1);
+            return false;
+        }
+    }
+    else if (auto ifStmt = dynamic_pointer_cast<IfNode>(stmt))
+    {
+        auto cond = dynamic_pointer_cast<BinaryExpressionNode>(ifStmt->getCondition());
+        if (!cond || ifStmt->getElseBranch())
+            return false;
+        string op = cond->getOperator();
+        auto then_stmts = bodyStatements(ifStmt->getThenBranch());
+        string array_name;
+
+        if (op == "==")
+        {
+            // Linear search: if (A[i] == key) { ...; break; }
+            shared_ptr<ExpressionNode> key;
+            if (isSubscriptByVar(cond->getLeft(), var, array_name))
+                key = cond->getRight();
+            else if (isSubscriptByVar(cond->getRight(), var, array_name))
+                key = cond->getLeft();
+            else
+                return false;
+            if (then_stmts.empty() || !dynamic_pointer_cast<BreakNode>(then_stmts.back()))
+                return false;
+            for (size_t k = 0; k + 1 < then_stmts.size(); ++k)
+            {
+                if (containsLoopControl(then_stmts[k]))
+                    return false;
+            }
+            set<string> key_names;
+            collectIdentifiers(key, key_names);
+            if (!isSideEffectFree(key) || key_names.count(var) || key_names.count(array_name))
+                return false;
 
-            // Break the loop since we've handled the final 'else'.
-            current_else_branch = nullptr;
+            // list.index() scans at C speed and raises ValueError when nothing matches.
+            code = "try:\n";
+            auto pointer = m_pointers.find(array_name);
+            if (pointer != m_pointers.end() && (pointer->second.kind == PointerInfo::Kind::Walker || pointer->second.kind == PointerInfo::Kind::Pair))
+            {
+                // Searched in the list the pointer walks; the index found is relative to the pointer again.
+                string from = lo_py == "0" ? array_name : addOffset(array_name, "+", lo_py);
+                string to = addOffset(array_name, "+", hi_py);
+                code += indent(var + " = " + pointer->second.buffer + ".index(" + transpileExpression(key) + ", " + from + ", " + to +
+                                   ") - " + array_name + "\n",
+                               1);
+            }
+            else
+            {
+                code += indent(var + " = " + array_name + ".index(" + transpileExpression(key) + ", " + lo_py + ", " + hi_py + ")\n", 1);
+            }
+            code += "except ValueError:\n";
+            code += indent(var_epilogue.empty() ? "pass\n" : var_epilogue, 1);
+            if (then_stmts.size() > 1)
+            {
+                code += "else:\n";
+                for (size_t k = 0; k + 1 < then_stmts.size(); ++k)
+                {
+                    code += transpileStatement(then_stmts[k], 1);
+                }
+            }
+            idiom = "index() search in " + array_name;
+        }
+        else if (op == "<" || op == "<=" || op == ">" || op == ">=")
+        {
+            // Min/max reduction: if (A[i] < m) m = A[i];  (any operand order / comparison)
+            if (then_stmts.size() != 1)
+                return false;
+            auto exprStmt = dynamic_pointer_cast<ExpressionStatementNode>(then_stmts[0]);
+            auto assign = exprStmt ? dynamic_pointer_cast<AssignmentNode>(exprStmt->getExpression()) : nullptr;
+            auto target = assign ? dynamic_pointer_cast<IdentifierNode>(assign->getLValue()) : nullptr;
+            if (!target || !isSubscriptByVar(assign->getRValue(), var, array_name))
+                return false;
+            string m = target->getName();
+            string cmp_array;
+            bool element_on_left;
+            if (isSubscriptByVar(cond->getLeft(), var, cmp_array) && isIdentifierNamed(cond->getRight(), m))
+                element_on_left = true;
+            else if (isIdentifierNamed(cond->getLeft(), m) && isSubscriptByVar(cond->getRight(), var, cmp_array))
+                element_on_left = false;
+            else
+                return false;
+            if (cmp_array != array_name || m == var || m == array_name)
+                return false;
+            // min()/max() pick the same element as the C comparison only when no conversion happens on assignment.
+            auto m_type = m_declared_types.find(m);
+            string elem_type = elementTypeOf(array_name);
+            if (m_type == m_declared_types.end() || m_type->second != elem_type || (elem_type != "int" && elem_type != "float"))
+                return false;
+            bool element_smaller = (op == "<" || op == "<=") == element_on_left;
+            string fn = element_smaller ? "min" : "max";
+            written.insert(m);
+            code = m + " = _b." + fn + "(" + m + ", _b." + fn + "(" + sliceOf(array_name) + ", default=" + m + "))\n" + var_epilogue;
+            idiom = fn + "() reduction over " + array_name;
+        }
+        else
+        {
+            return false;
         }
     }
+    else
+    {
+        return false;
+    }
 
-    return code;
+    for (const auto &name : written)
+    {
+        auto pointer = m_pointers.find(name);
+        if (bound_names.count(name) || m_boxed.count(name) || (pointer != m_pointers.end() && bound_names.count(pointer->second.buffer)))
+            return false;
+    }
+
+    if (code.find("_b.") != string::npos)
+        m_runtime_helpers.insert("_b");
+    m_loop_rewrites.push_back({line, loop_kind, idiom});
+    out_code = indent(code, indent_level);
+    return true;
 }
 
 string Transpiler::transpileWhileStatement(shared_ptr<WhileNode> stmt, int base_indent_level)
 {
+    // A counted while loop (`while (i < n) { <stmt>; i = i + 1; }`) may be a loop idiom.
+    if (auto cond = dynamic_pointer_cast<BinaryExpressionNode>(stmt->getCondition()))
+    {
+        auto counter = dynamic_pointer_cast<IdentifierNode>(cond->getLeft());
+        auto stmts = bodyStatements(stmt->getBody());
+        if (counter && (cond->getOperator() == "<" || cond->getOperator() == "<=") &&
+            stmts.size() == 2 && isUnitIncrementOf(stmts[1], counter->getName()))
+        {
+            CountedLoop counted;
+            counted.var = counter->getName();
+            counted.hi = cond->getRight();
+            counted.inclusive = (cond->getOperator() == "<=");
+            counted.var_live_after = true;
+            counted.body_stmt = stmts[0];
+            string idiom_code;
+            if (transpileLoopIdiom(counted, stmt->line, "while", base_indent_level, idiom_code))
+            {
+                return idiom_code;
+            }
+        }
+    }
+
     string condition = transpileExpression(stmt->getCondition());
     string while_header = indent("while " + condition + ":\n", base_indent_level);
-    string body_code = transpileStatement(stmt->getBody(), base_indent_level + 1);
+    string body_code = transpileLoopBody(stmt->getBody(), base_indent_level + 1, stmt->line);
+
+    // Lint: `while (i < n) { ...; i = i + 1; }` is a counted loop written out by hand.
+    auto cond = dynamic_pointer_cast<BinaryExpressionNode>(stmt->getCondition());
+    auto counter = cond ? dynamic_pointer_cast<IdentifierNode>(cond->getLeft()) : nullptr;
+    auto stmts = bodyStatements(stmt->getBody());
+    if (m_options.lint && counter && (cond->getOperator() == "<" || cond->getOperator() == "<=") && !stmts.empty() &&
+        isUnitIncrementOf(stmts.back(), counter->getName()))
+    {
+        int overhead = lintCost(cond) + lintCost(stmts.back()) + 1;
+        lint(stmt->line, "while-not-range", "while loop counts '" + counter->getName() + "' up by one; as a for-loop over range() "
+                                            "the test and the step would be one FOR_ITER",
+             max(0, overhead - 2));
+    }
+    lintLoop(stmt, stmt->getCondition(), nullptr, stmt->getBody());
     return while_header + body_code;
 }
 string Transpiler::transpileForStatement(shared_ptr<ForNode> forNode, int current_indent_level)
@@ -571,6 +1539,7 @@ string Transpiler::transpileForStatement(shared_ptr<ForNode> forNode, int curren
     string code;
     string loopVar;
     string startValue = "0"; // Default if no explicit start
+    shared_ptr<ExpressionNode> startExpr; // AST of startValue, when there is one
     auto initializer = forNode->getInitializer();
     string init_code_for_while_fallback; // Code for initializer if using while loop
 
@@ -581,6 +1550,7 @@ string Transpiler::transpileForStatement(shared_ptr<ForNode> forNode, int curren
         if (auto initExpr = varDecl->getInitializer())
         {
             startValue = transpileExpression(initExpr);
+            startExpr = initExpr;
         }
         init_code_for_while_fallback = transpileVariableDeclaration(varDecl); // For while loop
     }
@@ -593,6 +1563,7 @@ string Transpiler::transpileForStatement(shared_ptr<ForNode> forNode, int curren
             {
                 loopVar = identLVal->getName();
                 startValue = transpileExpression(assignNode->getRValue());
+                startExpr = assignNode->getRValue();
             }
             else
             {
@@ -614,6 +1585,7 @@ string Transpiler::transpileForStatement(shared_ptr<ForNode> forNode, int curren
 
     // Handle Condition
     string stopValue;                 // Only for range optimization
+    shared_ptr<ExpressionNode> stopExpr; // AST of stopValue
     bool inclusive_for_range = false; // Only for range optimization
     auto condition_expr_node = forNode->getCondition();
     string condition_py_expr_for_while = "True"; // Default for while if no C condition
@@ -633,6 +1605,7 @@ string Transpiler::transpileForStatement(shared_ptr<ForNode> forNode, int curren
                         if (op == "<" || op == "<=")
                         {
                             stopValue = transpileExpression(binaryCond->getRight());
+                            stopExpr = binaryCond->getRight();
                             inclusive_for_range = (op == "<=");
                         } // else: not a simple < or <=, stopValue remains empty for no range optimization
                     } // else: loopVar not on left, stopValue remains empty
@@ -641,8 +1614,29 @@ string Transpiler::transpileForStatement(shared_ptr<ForNode> forNode, int curren
         }
     }
 
-    // Handle Increment
-    int step_for_range = 1; // Default step for range
+    // A walking pointer as loop variable counts offsets: range over the offsets of start and stop.
+    auto loopPointer = m_pointers.find(loopVar);
+    if (!loopVar.empty() && loopPointer != m_pointers.end())
+    {
+        string start_buffer, start_offset, stop_buffer, stop_offset;
+        if (loopPointer->second.kind == PointerInfo::Kind::Walker && startExpr && stopExpr &&
+            pointerParts(startExpr, start_buffer, start_offset) && pointerParts(stopExpr, stop_buffer, stop_offset))
+        {
+            startValue = start_offset;
+            stopValue = stop_offset;
+        }
+        else
+        {
+            stopValue.clear();
+        }
+        startExpr = nullptr; // The loop idiom recognizer works on integer counters only
+    }
+    // range() would rebind a boxed counter to a plain int.
+    if (m_boxed.count(loopVar))
+        stopValue.clear();
+
+    // Handle Increment
+    int step_for_range = 1; // Default step for range
     bool simple_increment_for_range = false;
     auto increment_expr_node = forNode->getIncrement();
     string increment_py_expr_for_while;
@@ -716,6 +1710,45 @@ string Transpiler::transpileForStatement(shared_ptr<ForNode> forNode, int curren
     // Decide whether to use range() or fallback to while
     bool use_range_optimization = !loopVar.empty() && !startValue.empty() && !stopValue.empty() && simple_increment_for_range && (step_for_range != 0);
 
+    // A unit-step counted loop whose body is a single statement may be a loop idiom.
+    if (use_range_optimization && step_for_range == 1 && startExpr && stopExpr)
+    {
+        auto stmts = bodyStatements(forNode->getBody());
+        if (stmts.size() == 1)
+        {
+            CountedLoop counted;
+            counted.var = loopVar;
+            counted.lo = startExpr;
+            counted.hi = stopExpr;
+            counted.inclusive = inclusive_for_range;
+            // A variable declared in the for-initializer goes out of scope with the loop.
+            counted.var_live_after = !dynamic_pointer_cast<VariableDeclarationNode>(initializer);
+            counted.body_stmt = stmts[0];
+            string idiom_code;
+            if (transpileLoopIdiom(counted, forNode->line, "for", current_indent_level, idiom_code))
+            {
+                return idiom_code;
+            }
+        }
+    }
+
+    // Independent iterations that call pure functions may run on a process pool (--parallel).
+    string parallel_code;
+    if (use_range_optimization && startExpr && stopExpr &&
+        transpileParallelLoop(forNode, loopVar, startExpr, stopExpr, inclusive_for_range, step_for_range,
+                              current_indent_level, parallel_code))
+    {
+        return parallel_code;
+    }
+
+    // A short loop with a constant trip count is fully unrolled.
+    string unrolled_code;
+    if (use_range_optimization && transpileUnrolledLoop(forNode, loopVar, startExpr, stopExpr, inclusive_for_range,
+                                                        step_for_range, current_indent_level, unrolled_code))
+    {
+        return unrolled_code;
+    }
+
     if (use_range_optimization)
     {
         string effective_stopValue_for_range = stopValue;
@@ -735,11 +1768,8 @@ string Transpiler::transpileForStatement(shared_ptr<ForNode> forNode, int curren
 
         code += indent(loopVar + " = " + startValue + "\n", current_indent_level); // Ensure loop var is initialized if not by decl
         code += indent("for " + loopVar + " in range(" + startValue + ", " + effective_stopValue_for_range + step_str_for_range + "):\n", current_indent_level);
-        auto body = forNode->getBody();
-        if (body)
-            code += transpileStatement(body, current_indent_level + 1);
-        else
-            code += indent("pass\n", current_indent_level + 1);
+        code += transpileLoopBody(forNode->getBody(), current_indent_level + 1, forNode->line);
+        lintLoop(forNode, nullptr, nullptr, forNode->getBody()); // range() evaluates the bound once
     }
     else
     {
@@ -758,21 +1788,38 @@ string Transpiler::transpileForStatement(shared_ptr<ForNode> forNode, int curren
         // else: Initializer might have been complex and not translatable to a simple Python var init here.
 
         code += indent("while " + condition_py_expr_for_while + ":\n", current_indent_level);
-        string bodyCode;
-        if (auto body = forNode->getBody())
-        {
-            bodyCode += transpileStatement(body, current_indent_level + 1);
-        }
-        else
-        {
-            bodyCode += indent("pass\n", current_indent_level + 1);
-        }
+        string bodyCode = transpileLoopBody(forNode->getBody(), current_indent_level + 1, forNode->line);
 
         if (!increment_py_expr_for_while.empty())
         { // Append transpiled increment expression
             bodyCode += indent(increment_py_expr_for_while + "\n", current_indent_level + 1);
         }
         code += bodyCode;
+
+        // Lint: a counter loop that misses range() by only one of its condition (a comparison of
+        // the counter, just not `var < bound` / `var <= bound`) and its increment (var = var +/- step,
+        // just not with a literal step).
+        bool range_condition = !stopValue.empty();
+        bool range_step = simple_increment_for_range && step_for_range != 0;
+        auto comparison = dynamic_pointer_cast<BinaryExpressionNode>(condition_expr_node);
+        bool near_condition = comparison && set<string>{"<", "<=", ">", ">=", "!="}.count(comparison->getOperator()) &&
+                              (isIdentifierNamed(comparison->getLeft(), loopVar) || isIdentifierNamed(comparison->getRight(), loopVar));
+        auto step_assign = dynamic_pointer_cast<AssignmentNode>(increment_expr_node);
+        auto step_value = step_assign ? dynamic_pointer_cast<BinaryExpressionNode>(step_assign->getRValue()) : nullptr;
+        bool near_step = step_value && isIdentifierNamed(step_assign->getLValue(), loopVar) &&
+                         isIdentifierNamed(step_value->getLeft(), loopVar) &&
+                         (step_value->getOperator() == "+" || step_value->getOperator() == "-");
+        if (m_options.lint && !loopVar.empty() && ((range_step && !range_condition && near_condition) || (range_condition && !range_step && near_step)))
+        {
+            string reason = range_condition ? "its increment '" + increment_py_expr_for_while + "' is not a constant step"
+                                            : "its condition '" + condition_py_expr_for_while + "' is not '" + loopVar +
+                                                  " < bound' or '" + loopVar + " <= bound'";
+            int overhead = lintCost(condition_expr_node) + lintCost(increment_expr_node) + 1; // test, step, jump back
+            lint(forNode->line, "while-not-range", "for-loop over '" + loopVar + "' is emitted as a while loop because " + reason +
+                                                       "; range() would do the test and the step in one FOR_ITER",
+                 max(0, overhead - 2));
+        }
+        lintLoop(forNode, condition_expr_node, increment_expr_node, forNode->getBody());
     }
     return code;
 }
@@ -799,31 +1846,476 @@ string Transpiler::transpileFunctionDeclaration(shared_ptr<FunctionDeclarationNo
 
     string code = indent(header.str(), base_indent);
 
+    // Parameters and locals are only in scope for this function; restore the outer names afterwards.
+    unordered_map<string, string> outer_types = m_declared_types;
+    unordered_map<string, vector<long long>> outer_dims = m_array_dims;
+    declareParameters(funcDecl);
+    for (const auto &param : params)
+    {
+        if (param.isArray || isPointerType(param.type))
+            m_array_params.insert(param.name);
+    }
+    analyzePointers(funcDecl);
+    // Pointer parameters that move get their incoming list in a local and start at offset 0, or at
+    // the offset passed along with the list (see planPointerArguments).
+    auto offset_params = m_offset_params.find(funcDecl->getName());
+    for (size_t i = 0; i < params.size(); ++i)
+    {
+        const auto &param = params[i];
+        bool pair = offset_params != m_offset_params.end() && offset_params->second.count(i);
+        auto it = m_pointers.find(param.name);
+        if (it != m_pointers.end() && it->second.from_param)
+        {
+            code += indent(it->second.buffer + ", " + param.name + " = " + param.name + (pair ? "" : ", 0") + "\n", base_indent + 1);
+        }
+        else if (pair)
+        {
+            *m_diagnostics << "Transpiler Error: Pointer parameter '" << param.name << "' of " << funcDecl->getName()
+                           << "() is passed a pointer into a list, but its uses could not be lowered to an index." << endl;
+        }
+        if (m_boxed.count(param.name))
+            code += indent(param.name + " = [" + param.name + "]\n", base_indent + 1);
+    }
+
+    // Profile: count calls, or treat a function that was never called as cold.
+    if (isProfiling())
+        code += profileCounter("\"call\", \"" + funcDecl->getName() + "\"", base_indent + 1);
+    m_cold = m_options.profile.loaded && m_options.profile.callCount(funcDecl->getName()) == 0;
+
+    // --instrument: the body goes inside a timed try block.
+    m_function_name = funcDecl->getName();
+    int body_indent = base_indent + (m_options.instrument ? 2 : 1);
+    string body_code;
     auto bodyNode = funcDecl->getBody();
     if (bodyNode && !bodyNode->getStatements().empty())
     {
-        code += transpileStatement(bodyNode, base_indent + 1);
+        body_code = transpileStatement(bodyNode, body_indent);
     }
     else
     {
-        code += indent("pass\n", base_indent + 1);
+        body_code = indent("pass\n", body_indent);
     }
+    if (m_options.instrument)
+        body_code = instrumentConstruct(body_code, funcDecl->line, "function " + funcDecl->getName(), base_indent + 1);
+    code += body_code;
+    m_function_name.clear();
+    m_cold = false;
+    m_declared_types = outer_types;
+    m_array_dims = outer_dims;
+    m_pointers.clear();
+    m_boxed.clear();
+    m_array_params.clear();
     return code;
 }
 
+// Declares the parameters of funcDecl in m_declared_types, for sizeof and the loop rewrites.
+void Transpiler::declareParameters(shared_ptr<FunctionDeclarationNode> funcDecl)
+{
+    for (const auto &param : funcDecl->getParameters())
+    {
+        string dims;
+        for (int d = 0; d < (param.isArray ? max(1, param.dimensions) : 0); ++d)
+            dims += "[]";
+        m_declared_types[param.name] = param.type + dims;
+        m_array_dims.erase(param.name); // sizeof an array parameter is the size of a pointer
+    }
+}
+
+// --- Small-function inlining ---
+// A CPython call costs far more than evaluating a small expression, so calls to tiny helpers
+// (getters, max, clamp, ...) are expanded at their call sites. Only pure callees whose body reduces
+// to one conditional expression qualify; the hottest call sites (deepest loop nesting) are expanded
+// first until the options' code growth allowance is used up.
+
+static int countNodes(const shared_ptr<ASTNode> &node)
+{
+    if (!node)
+        return 0;
+    int count = 1;
+    forEachChild(node, [&](const shared_ptr<ASTNode> &child)
+                 { count += countNodes(child); });
+    return count;
+}
+
+// True if the whole Python expression is wrapped in one pair of parentheses.
+static bool isParenthesized(const string &py_expr)
+{
+    if (py_expr.size() < 2 || py_expr.front() != '(' || py_expr.back() != ')')
+        return false;
+    int depth = 0;
+    for (size_t i = 0; i < py_expr.size(); ++i)
+    {
+        depth += py_expr[i] == '(' ? 1 : (py_expr[i] == ')' ? -1 : 0);
+        if (depth == 0 && i + 1 < py_expr.size())
+            return false;
+    }
+    return true;
+}
+
+// The single statement inside `{ stmt }`, or stmt itself.
+static shared_ptr<StatementNode> singleStatement(shared_ptr<StatementNode> stmt)
+{
+    auto block = dynamic_pointer_cast<BlockNode>(stmt);
+    if (!block)
+        return stmt;
+    return block->getStatements().size() == 1 ? singleStatement(block->getStatements()[0]) : nullptr;
+}
+
+static shared_ptr<ExpressionNode> returnedValue(shared_ptr<StatementNode> stmt)
+{
+    auto ret = dynamic_pointer_cast<ReturnNode>(singleStatement(stmt));
+    return ret ? ret->getReturnValue() : nullptr;
+}
+
+// Builds the candidate description of funcDecl, or returns false if its body is not return-only.
+static bool buildInlineCandidate(shared_ptr<FunctionDeclarationNode> funcDecl, InlineCandidate &candidate)
+{
+    auto body = funcDecl->getBody();
+    if (!body || body->getStatements().empty())
+        return false;
+    for (const auto &param : funcDecl->getParameters())
+    {
+        if (isPointerType(param.type))
+            return false; // Pointer parameters depend on the caller's pointer lowering
+    }
+
+    candidate.decl = funcDecl;
+    const auto &stmts = body->getStatements();
+    for (size_t i = 0; i < stmts.size(); ++i)
+    {
+        bool last = i + 1 == stmts.size();
+        auto decl = dynamic_pointer_cast<VariableDeclarationNode>(stmts[i]);
+        auto ifStmt = dynamic_pointer_cast<IfNode>(stmts[i]);
+        if (decl && decl->getInitializer() && !isPointerType(decl->getDeclaredType()) && candidate.guarded_returns.empty())
+        {
+            candidate.locals.push_back({decl->getName(), decl->getInitializer()});
+        }
+        else if (ifStmt && returnedValue(ifStmt->getThenBranch()))
+        {
+            candidate.guarded_returns.push_back({ifStmt->getCondition(), returnedValue(ifStmt->getThenBranch())});
+            if (ifStmt->getElseBranch())
+            {
+                candidate.final_return = returnedValue(ifStmt->getElseBranch());
+                if (!candidate.final_return || !last)
+                    return false;
+            }
+        }
+        else if (dynamic_pointer_cast<ReturnNode>(stmts[i]) && returnedValue(stmts[i]) && last)
+        {
+            candidate.final_return = returnedValue(stmts[i]);
+        }
+        else
+        {
+            return false;
+        }
+    }
+    if (!candidate.final_return)
+        return false;
+
+    vector<shared_ptr<ExpressionNode>> exprs = {candidate.final_return};
+    for (const auto &local : candidate.locals)
+        exprs.push_back(local.second);
+    for (const auto &guarded : candidate.guarded_returns)
+    {
+        exprs.push_back(guarded.first);
+        exprs.push_back(guarded.second);
+    }
+    set<string> bound;
+    for (const auto &param : funcDecl->getParameters())
+        bound.insert(param.name);
+    for (const auto &local : candidate.locals)
+        bound.insert(local.first);
+    for (const auto &expr : exprs)
+    {
+        candidate.size += countNodes(expr);
+        set<string> names;
+        collectIdentifiers(expr, names);
+        for (const auto &name : names)
+        {
+            if (!bound.count(name))
+                candidate.globals.insert(name);
+        }
+    }
+    return true;
+}
+
+// Pure: no assignments, ++/--, pointer operators, or calls other than to the given pure functions.
+static bool isPureExpression(const shared_ptr<ASTNode> &node, const string &self, const unordered_map<string, InlineCandidate> &pure)
+{
+    if (!node)
+        return true;
+    if (dynamic_pointer_cast<AssignmentNode>(node))
+        return false;
+    if (auto unary = dynamic_pointer_cast<UnaryExpressionNode>(node))
+    {
+        const string &op = unary->getOperator();
+        if (op == "++" || op == "--" || op == "*" || op == "&")
+            return false;
+    }
+    if (auto call = dynamic_pointer_cast<FunctionCallNode>(node))
+    {
+        if (call->getFunctionName() == self || !pure.count(call->getFunctionName()))
+            return false;
+    }
+    bool pure_children = true;
+    forEachChild(node, [&](const shared_ptr<ASTNode> &child)
+                 { pure_children = pure_children && isPureExpression(child, self, pure); });
+    return pure_children;
+}
+
+void Transpiler::planInlining(shared_ptr<ProgramNode> program)
+{
+    m_inline_candidates.clear();
+    m_inline_sites.clear();
+    if (m_options.inline_budget <= 0 || isProfiling())
+        return; // An instrumented build keeps every call, so the calls can be counted
+    const ProfileData &profile = m_options.profile;
+
+    for (const auto &stmt : program->getStatements())
+    {
+        auto funcDecl = dynamic_pointer_cast<FunctionDeclarationNode>(stmt);
+        InlineCandidate candidate;
+        // Hot callees (by profile) may be twice the size.
+        int budget = m_options.inline_budget;
+        if (funcDecl && profile.loaded && profile.callCount(funcDecl->getName()) >= m_options.profile_hot)
+            budget *= 2;
+        // A parameter passed as a (list, offset) pair needs the callee's prologue
+        if (funcDecl && !m_offset_params.count(funcDecl->getName()) && buildInlineCandidate(funcDecl, candidate) &&
+            candidate.size <= budget)
+            m_inline_candidates[funcDecl->getName()] = candidate;
+    }
+    // Drop impure candidates until the set is closed (a callee may call other pure candidates).
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (auto it = m_inline_candidates.begin(); it != m_inline_candidates.end();)
+        {
+            const InlineCandidate &c = it->second;
+            bool pure = isPureExpression(c.final_return, it->first, m_inline_candidates);
+            for (const auto &local : c.locals)
+                pure = pure && isPureExpression(local.second, it->first, m_inline_candidates);
+            for (const auto &guarded : c.guarded_returns)
+                pure = pure && isPureExpression(guarded.first, it->first, m_inline_candidates) &&
+                       isPureExpression(guarded.second, it->first, m_inline_candidates);
+            if (!pure)
+            {
+                it = m_inline_candidates.erase(it);
+                changed = true;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+    if (m_inline_candidates.empty())
+        return;
+
+    // Collect call sites with their loop depth. A call is only expandable where none of the
+    // callee's global names is shadowed by a local of the calling function. With a profile,
+    // 'heat' is how often the site ran: the iterations of its innermost loop, or the calls of
+    // its function outside loops.
+    struct Site
+    {
+        const ASTNode *call;
+        int depth;
+        int cost;
+        long long heat;
+    };
+    vector<Site> sites;
+    for (const auto &stmt : program->getStatements())
+    {
+        auto funcDecl = dynamic_pointer_cast<FunctionDeclarationNode>(stmt);
+        string caller = funcDecl ? funcDecl->getName() : "";
+        set<string> locals;
+        if (funcDecl)
+        {
+            for (const auto &param : funcDecl->getParameters())
+                locals.insert(param.name);
+            function<void(const shared_ptr<ASTNode> &)> collectLocals = [&](const shared_ptr<ASTNode> &node)
+            {
+                if (auto decl = dynamic_pointer_cast<DeclarationNode>(node))
+                    locals.insert(decl->getName());
+                forEachChild(node, collectLocals);
+            };
+            collectLocals(funcDecl->getBody());
+        }
+
+        function<void(const shared_ptr<ASTNode> &, int, long long)> visit = [&](const shared_ptr<ASTNode> &node, int depth, long long heat)
+        {
+            if (!node)
+                return;
+            auto call = dynamic_pointer_cast<FunctionCallNode>(node);
+            auto it = call ? m_inline_candidates.find(call->getFunctionName()) : m_inline_candidates.end();
+            if (it != m_inline_candidates.end() && it->first != caller &&
+                call->getArguments().size() == it->second.decl->getParameters().size())
+            {
+                bool shadowed = false;
+                for (const auto &name : it->second.globals)
+                    shadowed = shadowed || locals.count(name);
+                if (!shadowed)
+                    sites.push_back({node.get(), depth, it->second.size, heat});
+            }
+            bool loop = dynamic_pointer_cast<ForNode>(node) || dynamic_pointer_cast<WhileNode>(node);
+            long long inner_heat = loop ? profile.loopIterations(node->line) : heat;
+            forEachChild(node, [&](const shared_ptr<ASTNode> &child)
+                         { visit(child, depth + (loop ? 1 : 0), inner_heat); });
+        };
+        visit(stmt, 0, funcDecl ? profile.callCount(caller) : 0);
+    }
+
+    // Hottest sites first: by profile if there is one, otherwise by loop nesting.
+    stable_sort(sites.begin(), sites.end(), [&profile](const Site &a, const Site &b)
+                { return profile.loaded ? a.heat > b.heat : a.depth > b.depth; });
+    int allowance = max(m_options.inline_budget, countNodes(program) * m_options.inline_growth / 100);
+    for (const auto &site : sites)
+    {
+        bool hot = profile.loaded && site.heat >= m_options.profile_hot;
+        if (profile.loaded && site.heat == 0)
+            continue; // Never ran: leave the call as it is
+        if (site.cost > allowance && !hot)
+            continue;
+        allowance -= min(allowance, site.cost); // Hot sites are expanded even beyond the growth allowance
+        m_inline_sites.insert(site.call);
+    }
+}
+
+// Emits the callee's body as one expression, with parameters bound to the call's arguments.
+// Arguments that are not trivial and are used more than once (or have side effects) are
+// evaluated once into an _inlN_ temporary; everything else is substituted directly.
+bool Transpiler::transpileInlinedCall(shared_ptr<FunctionCallNode> call, string &out_code)
+{
+    if (m_inline_depth > 0 || m_cold || !m_inline_sites.count(call.get()))
+        return false;
+    const InlineCandidate &candidate = m_inline_candidates.at(call->getFunctionName());
+    const auto args = call->getArguments();
+    for (const auto &arg : args)
+    {
+        if (isPointerExpression(arg))
+            return false; // Passed as a list and an offset, see transpileFunctionCallNode
+    }
+
+    unordered_map<string, int> uses;
+    function<void(const shared_ptr<ASTNode> &)> countUses = [&](const shared_ptr<ASTNode> &node)
+    {
+        if (auto ident = dynamic_pointer_cast<IdentifierNode>(node))
+            uses[ident->getName()]++;
+        forEachChild(node, countUses);
+    };
+    countUses(candidate.final_return);
+    for (const auto &local : candidate.locals)
+        countUses(local.second);
+    for (const auto &guarded : candidate.guarded_returns)
+    {
+        countUses(guarded.first);
+        countUses(guarded.second);
+    }
+
+    int site = ++m_inline_counter;
+    vector<string> temps;
+    auto bind = [&](unordered_map<string, string> &bindings, const string &name, shared_ptr<ExpressionNode> value, const string &py_value)
+    {
+        bool trivial = dynamic_pointer_cast<IdentifierNode>(value) || dynamic_pointer_cast<NumberNode>(value) ||
+                       dynamic_pointer_cast<CharLiteralNode>(value) || dynamic_pointer_cast<BooleanNode>(value);
+        if (trivial)
+            bindings[name] = py_value;
+        else if (uses[name] <= 1 && isSideEffectFree(value))
+            bindings[name] = isParenthesized(py_value) ? py_value : "(" + py_value + ")";
+        else
+        {
+            string temp = "_inl" + to_string(site) + "_" + name;
+            temps.push_back("(" + temp + " := " + py_value + ")");
+            bindings[name] = temp;
+        }
+    };
+
+    // Arguments are transpiled in the caller's context ...
+    unordered_map<string, string> bindings;
+    const auto &params = candidate.decl->getParameters();
+    for (size_t i = 0; i < params.size(); ++i)
+        bind(bindings, params[i].name, args[i], transpileExpression(args[i]));
+
+    // ... the body in the callee's: no pointers, only its own bindings, and its own declarations
+    // (sizeof a is the size of the parameter a, not of the caller's array). Globals the callee uses
+    // are not shadowed at an expanded call site (see planInlining).
+    unordered_map<string, string> caller_types = m_declared_types;
+    unordered_map<string, vector<long long>> caller_dims = m_array_dims;
+    declareParameters(candidate.decl);
+    for (const auto &stmt : candidate.decl->getBody()->getStatements())
+    {
+        if (auto decl = dynamic_pointer_cast<VariableDeclarationNode>(stmt))
+        {
+            m_declared_types[decl->getName()] = decl->getDeclaredType();
+            m_array_dims.erase(decl->getName());
+        }
+    }
+    m_inline_depth++;
+    unordered_map<string, PointerInfo> caller_pointers;
+    set<string> caller_boxed;
+    vector<unordered_map<string, shared_ptr<ExpressionNode>>> caller_macro_arguments;
+    caller_pointers.swap(m_pointers);
+    caller_boxed.swap(m_boxed);
+    caller_macro_arguments.swap(m_macro_arguments);
+    m_inline_bindings.swap(bindings);
+    for (const auto &local : candidate.locals)
+        bind(m_inline_bindings, local.first, local.second, transpileExpression(local.second));
+    string body = transpileExpression(candidate.final_return);
+    for (auto it = candidate.guarded_returns.rbegin(); it != candidate.guarded_returns.rend(); ++it)
+        body = transpileExpression(it->second) + " if " + transpileExpression(it->first) + " else " + body;
+    m_inline_bindings.swap(bindings);
+    caller_pointers.swap(m_pointers);
+    caller_boxed.swap(m_boxed);
+    caller_macro_arguments.swap(m_macro_arguments);
+    m_inline_depth--;
+    m_declared_types.swap(caller_types);
+    m_array_dims.swap(caller_dims);
+
+    string temps_code;
+    for (const auto &temp : temps)
+        temps_code += temp + ", ";
+    out_code = temps.empty() ? "(" + body + ")" : "(" + temps_code + body + ")[-1]";
+    m_inlined_calls[call->getFunctionName()]++;
+    return true;
+}
+
 string Transpiler::transpileAssignmentNode(shared_ptr<AssignmentNode> assign)
 {
+    auto target = dynamic_pointer_cast<IdentifierNode>(assign->getLValue());
+    if (target && m_pointers.count(target->getName()))
+    {
+        return transpilePointerAssignment(target->getName(), assign->getRValue());
+    }
     string lvalue_py = transpileExpression(assign->getLValue()); // Assumes getLValue() exists
     string rvalue_py = transpileExpression(assign->getRValue()); // Assumes getRValue() exists
     return lvalue_py + " = " + rvalue_py;
 }
 
-string Transpiler::transpileIdentifierNode(shared_ptr<IdentifierNode> expr) { return expr->getName(); }
+string Transpiler::transpileIdentifierNode(shared_ptr<IdentifierNode> expr)
+{
+    string code;
+    if (withMacroArgument(expr->getName(), [&](const shared_ptr<ExpressionNode> &argument)
+                          { code = transpileExpression(argument); }))
+        return code;
+    if (transpileMacroExpansion(expr->getName(), false, {}, code))
+        return code;
+    if (!m_inline_bindings.empty())
+    {
+        auto it = m_inline_bindings.find(expr->getName());
+        if (it != m_inline_bindings.end())
+            return it->second;
+    }
+    if (m_boxed.count(expr->getName()))
+        return expr->getName() + "[0]";
+    return expr->getName();
+}
 string Transpiler::transpileNumberNode(shared_ptr<NumberNode> expr) { return expr->getValue(); }
 string Transpiler::transpileStringLiteralNode(shared_ptr<StringLiteralNode> expr)
 { /* ... same (with Python escaping) ... */
     string py_val = expr->getValue();
     stringstream ss;
+    if (m_options.char_as_int)
+        ss << "b"; // A NUL terminated bytes object: indexing yields ints, like C chars
     ss << "\"";
     for (char c : py_val)
     {
@@ -844,11 +2336,16 @@ string Transpiler::transpileStringLiteralNode(shared_ptr<StringLiteralNode> expr
         case '\t':
             ss << "\\t";
             break;
+        case '\0':
+            ss << "\\x00"; // Not "\\0": a following digit would extend it to an octal escape
+            break;
         default:
             ss << c;
             break;
         }
     }
+    if (m_options.char_as_int)
+        ss << "\\x00";
     ss << "\"";
     return ss.str();
 }
@@ -858,6 +2355,8 @@ string Transpiler::transpileCharLiteralNode(shared_ptr<CharLiteralNode> expr)
     if (val.length() != 1)
         return "'#ERR_CHAR'";
     char c = val[0];
+    if (m_options.char_as_int)
+        return to_string((int)(unsigned char)c);
     stringstream ss;
     ss << "'";
     switch (c)
@@ -877,6 +2376,9 @@ string Transpiler::transpileCharLiteralNode(shared_ptr<CharLiteralNode> expr)
     case '\t':
         ss << "\\t";
         break;
+    case '\0':
+        ss << "\\x00";
+        break;
     default:
         ss << c;
         break;
@@ -887,11 +2389,45 @@ string Transpiler::transpileCharLiteralNode(shared_ptr<CharLiteralNode> expr)
 string Transpiler::transpileBooleanNode(shared_ptr<BooleanNode> expr) { return expr->getValue() ? "True" : "False"; }
 string Transpiler::transpileFunctionCallNode(shared_ptr<FunctionCallNode> expr)
 { /* ... same ... */
+    if (expr->getFunctionName() == "malloc" || expr->getFunctionName() == "calloc")
+    {
+        return transpileAllocation(expr, "");
+    }
+    string inlined;
+    if (transpileInlinedCall(expr, inlined) || transpileMacroExpansion(expr->getFunctionName(), true, expr->getArguments(), inlined))
+        return inlined;
     string result = expr->getFunctionName() + "(";
     const auto &args = expr->getArguments();
+    auto offset_params = m_offset_params.find(expr->getFunctionName());
     for (size_t i = 0; i < args.size(); ++i)
     {
-        result += transpileExpression(args[i]);
+        // A parameter that may be passed a pointer into a list gets the list and the offset
+        // (planPointerArguments); every other pointer argument is a whole list, offset 0.
+        bool pair = offset_params != m_offset_params.end() && offset_params->second.count(i);
+        bool moved = false;
+        string buffer, offset;
+        if (isPointerValue(args[i], moved) && pointerParts(args[i], buffer, offset))
+        {
+            if (pair)
+            {
+                result += "(" + buffer + ", " + offset + ")";
+            }
+            else if (offset == "0")
+            {
+                result += buffer;
+            }
+            else
+            {
+                // Only a function the program does not define can get here; it would index from 0.
+                *m_diagnostics << "Transpiler Error: Pointer argument " << i + 1 << " of " << expr->getFunctionName() << "() points at '"
+                               << buffer << "' + " << offset << ", but only functions the program defines can be passed one." << endl;
+                result += unsupportedValue("pointer argument of " + expr->getFunctionName() + "()");
+            }
+        }
+        else
+        {
+            result += pair ? "(" + transpileExpression(args[i]) + ", 0)" : transpileExpression(args[i]);
+        }
         if (i < args.size() - 1)
             result += ", ";
     }
@@ -900,9 +2436,42 @@ string Transpiler::transpileFunctionCallNode(shared_ptr<FunctionCallNode> expr)
 }
 string Transpiler::transpileBinaryExpression(shared_ptr<BinaryExpressionNode> expr)
 { /* ... same (with && || mapping) ... */
+    // Pointer comparison/difference: both sides walk the same list, so compare offsets.
+    const string &c_op = expr->getOperator();
+    if ((c_op == "<" || c_op == "<=" || c_op == ">" || c_op == ">=" || c_op == "==" || c_op == "!=" || c_op == "-") &&
+        (isPointerExpression(expr->getLeft()) || (c_op != "-" && isPointerExpression(expr->getRight()))))
+    {
+        string left_buffer, left_offset, right_buffer, right_offset;
+        if (pointerParts(expr->getLeft(), left_buffer, left_offset) && pointerParts(expr->getRight(), right_buffer, right_offset))
+        {
+            if (c_op == "-" && right_offset == "0")
+                return left_offset;
+            return "(" + left_offset + " " + c_op + " " + right_offset + ")";
+        }
+    }
     string left = transpileExpression(expr->getLeft());
     string right = transpileExpression(expr->getRight());
     string op = expr->getOperator();
+
+    // Constant folding, mostly for index arithmetic of unrolled loops (i * 4 + j with i = 2).
+    long long a, b;
+    bool left_constant = parseIntegerLiteral(left, a);
+    bool right_constant = parseIntegerLiteral(right, b);
+    if (left_constant && right_constant && (op == "+" || op == "-" || op == "*"))
+        return to_string(op == "+" ? a + b : (op == "-" ? a - b : a * b));
+    // Integer division of constants folds with C semantics (truncation), e.g. sizeof a / sizeof a[0].
+    if (left_constant && right_constant && (op == "/" || op == "%") && b != 0)
+        return to_string(op == "/" ? a / b : a % b);
+    if (left_constant && right_constant && (op == "<" || op == "<=" || op == ">" || op == ">=" || op == "==" || op == "!="))
+    {
+        bool holds = op == "<" ? a < b : op == "<=" ? a <= b : op == ">" ? a > b : op == ">=" ? a >= b : op == "==" ? a == b : a != b;
+        return holds ? "True" : "False";
+    }
+    if ((op == "+" && left_constant && a == 0) || (op == "*" && left_constant && a == 1))
+        return right;
+    if (((op == "+" || op == "-") && right_constant && b == 0) || (op == "*" && right_constant && b == 1))
+        return left;
+
     if (op == "&&")
         op = "and";
     else if (op == "||")
@@ -923,6 +2492,42 @@ string Transpiler::transpileBinaryExpression(shared_ptr<BinaryExpressionNode> ex
 string Transpiler::transpileUnaryExpression(shared_ptr<UnaryExpressionNode> expr)
 {
     string op = expr->getOperator();
+
+    if (op == "*")
+    {
+        auto target = stripCasts(expr->getOperand());
+        // *p++ / *++p on a walking pointer: advance the offset inline with an assignment expression.
+        auto step = dynamic_pointer_cast<UnaryExpressionNode>(target);
+        auto stepped = step ? dynamic_pointer_cast<IdentifierNode>(step->getOperand()) : nullptr;
+        if (stepped && (step->getOperator() == "++" || step->getOperator() == "--"))
+        {
+            auto it = m_pointers.find(stepped->getName());
+            if (it != m_pointers.end() && (it->second.kind == PointerInfo::Kind::Walker || it->second.kind == PointerInfo::Kind::Pair))
+            {
+                const string &name = stepped->getName();
+                string sign = step->getOperator() == "++" ? "+" : "-";
+                string index = "(" + name + " := " + name + " " + sign + " 1)";
+                if (step->isPostfix())
+                    index += step->getOperator() == "++" ? " - 1" : " + 1";
+                return it->second.buffer + "[" + index + "]";
+            }
+        }
+        if (auto ident = dynamic_pointer_cast<IdentifierNode>(target))
+        {
+            auto it = m_pointers.find(ident->getName());
+            if (it != m_pointers.end() && it->second.kind == PointerInfo::Kind::ScalarAlias)
+                return it->second.buffer;
+        }
+        string buffer, offset;
+        if (pointerParts(target, buffer, offset))
+            return buffer + "[" + offset + "]";
+        return transpileExpression(target) + "[0]";
+    }
+
+    auto scalar = dynamic_pointer_cast<IdentifierNode>(expr->getOperand());
+    if (op == "&" && scalar && m_boxed.count(scalar->getName()))
+        return scalar->getName(); // The box is the address
+
     string operand = transpileExpression(expr->getOperand());
 
     // --- NEW LOGIC FOR ++ and -- ---
@@ -954,6 +2559,215 @@ string Transpiler::transpileUnaryExpression(shared_ptr<UnaryExpressionNode> expr
     return op + operand;
 }
 
+string Transpiler::transpileCastNode(shared_ptr<CastNode> expr)
+{
+    const string &type = expr->getTargetType();
+    string operand = transpileExpression(expr->getOperand());
+    if (type == "int")
+        return "int(" + operand + ")";
+    if (type == "float" || type == "double")
+        return "float(" + operand + ")";
+    if (type == "bool")
+        return "bool(" + operand + ")";
+    return operand; // Pointer casts and casts to char/void do not change the Python value
+}
+
+string Transpiler::transpileSizeofNode(shared_ptr<SizeofNode> expr)
+{
+    long long size;
+    if (sizeofValue(expr, size))
+        return to_string(size);
+    // A variable length array (int v[n]): the length of its list, times the constant size of an element.
+    string type;
+    vector<long long> dims;
+    if (expr->getOperand() && staticType(expr->getOperand(), type, dims) && !dims.empty() && dims[0] == 0)
+    {
+        long long element = m_options.abi.sizeOf(type);
+        for (size_t d = 1; d < dims.size(); ++d)
+            element *= dims[d];
+        if (element > 0)
+        {
+            m_runtime_helpers.insert("_b");
+            return "(_b.len(" + transpileExpression(expr->getOperand()) + ") * " + to_string(element) + ")";
+        }
+    }
+    string what = "sizeof(" + (expr->getOperand() ? string("expression") : expr->getTargetType()) + ")";
+    *m_diagnostics << "Transpiler Warning: cannot determine " << what << " at transpile time" << endl;
+    return unsupportedValue(what);
+}
+
+// A placeholder for a value that could not be transpiled: it fails when evaluated, not when the module
+// is compiled. Single quotes, so that it may stand inside the f"..." of a print (before Python 3.12, an
+// f-string expression cannot reuse the string's own quote).
+string Transpiler::unsupportedValue(const string &what)
+{
+    m_runtime_helpers.insert("_unsupported");
+    return "_unsupported('" + what + "')";
+}
+
+// Size in bytes under the target ABI (--abi): sizeof(type), or sizeof of the static type of an
+// expression (the operand is not evaluated, as in C).
+bool Transpiler::sizeofValue(shared_ptr<SizeofNode> expr, long long &size) const
+{
+    string type = expr->getTargetType();
+    vector<long long> dims;
+    if (expr->getOperand() && !staticType(expr->getOperand(), type, dims))
+        return false;
+    size = m_options.abi.sizeOf(type);
+    for (long long dim : dims)
+        size *= dim;
+    return size > 0;
+}
+
+// C type of an expression, where it follows from declarations: scalar type, plus the dimensions
+// when it is an array (int a[4][8] -> "int", {4, 8}; a dimension only known at run time is 0, so
+// sizeof does not fold). Array parameters are pointers.
+bool Transpiler::staticType(shared_ptr<ExpressionNode> expr, string &type, vector<long long> &dims) const
+{
+    dims.clear();
+    auto arithmetic = [](const string &a, const string &b)
+    {
+        if (a == "double" || b == "double")
+            return string("double");
+        if (a == "float" || b == "float")
+            return string("float");
+        if (a == "long" || b == "long")
+            return string("long");
+        return string("int");
+    };
+    if (auto ident = dynamic_pointer_cast<IdentifierNode>(expr))
+    {
+        bool typed = false;
+        if (withMacroArgument(ident->getName(), [&](const shared_ptr<ExpressionNode> &argument)
+                              { typed = staticType(argument, type, dims); }))
+            return typed;
+        auto expansion = m_macro_expansions.find(ident->getName());
+        if (expansion != m_macro_expansions.end() && !expansion->second.function_like && !m_expanding_macros.count(ident->getName()))
+        {
+            m_expanding_macros.insert(ident->getName());
+            typed = staticType(expansion->second.body, type, dims);
+            m_expanding_macros.erase(ident->getName());
+            return typed;
+        }
+        auto declared = m_declared_types.find(ident->getName());
+        if (declared == m_declared_types.end())
+        {
+            if (!m_integer_macros.count(ident->getName()))
+                return false;
+            type = "int";
+            return true;
+        }
+        type = declared->second;
+        string element = elementTypeOf(ident->getName());
+        if (element.empty())
+            return true;
+        element = element.substr(0, element.find('['));
+        auto known = m_array_dims.find(ident->getName());
+        if (known == m_array_dims.end())
+        {
+            type = element + "*"; // Array parameter: only a pointer in C too
+            return true;
+        }
+        type = element;
+        dims = known->second;
+        return true;
+    }
+    if (dynamic_pointer_cast<ArraySubscriptNode>(expr) ||
+        (dynamic_pointer_cast<UnaryExpressionNode>(expr) && dynamic_pointer_cast<UnaryExpressionNode>(expr)->getOperator() == "*"))
+    {
+        auto sub = dynamic_pointer_cast<ArraySubscriptNode>(expr);
+        auto base = sub ? sub->getArrayExpression() : dynamic_pointer_cast<UnaryExpressionNode>(expr)->getOperand();
+        if (!staticType(base, type, dims))
+            return false;
+        if (!dims.empty())
+            dims.erase(dims.begin());
+        else if (isPointerType(type))
+            type.pop_back();
+        else
+            return false;
+        return true;
+    }
+    if (auto unary = dynamic_pointer_cast<UnaryExpressionNode>(expr))
+    {
+        const string &op = unary->getOperator();
+        if (!staticType(unary->getOperand(), type, dims))
+            return false;
+        if (op == "&")
+            type += "*";
+        else if (op == "!")
+            type = "int";
+        else if (op == "-" && !dims.empty())
+            return false;
+        else if (op == "-")
+            type = arithmetic(type, "int");
+        else if (!dims.empty())
+            return false; // ++/-- on an array
+        dims.clear();
+        return true;
+    }
+    if (auto num = dynamic_pointer_cast<NumberNode>(expr))
+    {
+        const string &text = num->getValue();
+        bool hex = text.size() > 1 && (text[1] == 'x' || text[1] == 'X');
+        long long value;
+        if (!hex && text.find_first_of(".eE") != string::npos)
+            type = "double";
+        else if (text.find_first_of("lL") != string::npos || (parseIntegerLiteral(text, value) && value > INT_MAX))
+            type = "long";
+        else
+            type = "int";
+        return true;
+    }
+    if (dynamic_pointer_cast<CharLiteralNode>(expr) || dynamic_pointer_cast<BooleanNode>(expr))
+    {
+        type = "int"; // 'a' is an int in C
+        return true;
+    }
+    if (auto str = dynamic_pointer_cast<StringLiteralNode>(expr))
+    {
+        type = "char";
+        dims.push_back((long long)str->getValue().size() + 1);
+        return true;
+    }
+    if (auto cast = dynamic_pointer_cast<CastNode>(expr))
+    {
+        type = cast->getTargetType();
+        return true;
+    }
+    if (dynamic_pointer_cast<SizeofNode>(expr))
+    {
+        type = "size_t";
+        return true;
+    }
+    if (auto assign = dynamic_pointer_cast<AssignmentNode>(expr))
+    {
+        return staticType(assign->getLValue(), type, dims);
+    }
+    if (auto binary = dynamic_pointer_cast<BinaryExpressionNode>(expr))
+    {
+        const string &op = binary->getOperator();
+        if (op == "<" || op == ">" || op == "<=" || op == ">=" || op == "==" || op == "!=" || op == "&&" || op == "||")
+        {
+            type = "int";
+            return true;
+        }
+        string left, right;
+        vector<long long> left_dims, right_dims;
+        if (!staticType(binary->getLeft(), left, left_dims) || !staticType(binary->getRight(), right, right_dims))
+            return false;
+        bool left_pointer = !left_dims.empty() || isPointerType(left);
+        bool right_pointer = !right_dims.empty() || isPointerType(right);
+        if (left_pointer && right_pointer)
+            type = "ptrdiff_t";
+        else if (left_pointer || right_pointer)
+            type = (left_pointer ? left : right) + "*"; // Decayed array or pointer; only its size matters
+        else
+            type = arithmetic(left, right);
+        return true;
+    }
+    return false;
+}
+
 // Transpiles ArrayDeclarationNode
 // Returns the Python code line WITHOUT indent, but WITH a newline.
 // e.g., "my_array = [None] * 10\n"
@@ -961,12 +2775,49 @@ string Transpiler::transpileArrayDeclaration(shared_ptr<ArrayDeclarationNode> de
 {
     string name = decl->getName();
     string size_py_expr = transpileExpression(decl->getSizeExpression());
+    m_declared_types[name] = decl->getDeclaredType() + "[]";
+    // Dimensions, for sizeof: 0 where the size is only known at run time (a variable length array)
+    vector<long long> dims(1);
+    if (!integerConstant(decl->getSizeExpression(), dims[0]))
+        dims[0] = 0;
+    for (const auto &inner : decl->getInnerSizeExpressions())
+    {
+        dims.emplace_back();
+        if (!integerConstant(inner, dims.back()))
+            dims.back() = 0;
+    }
+    m_array_dims[name] = dims;
 
     // In Python, C's `int arr[10];` is often represented as `arr = [None] * 10` or `arr = [0] * 10`.
     // Let's use [None] for generality, or you could use 0 if you check type.
     // Python needs parentheses around the size_py_expr if it could be complex (e.g. `var + 5`)
     // to ensure correct precedence with `*`.
     string py_decl = name + " = [None] * (" + size_py_expr + ")";
+    if (m_options.char_as_int && decl->getDeclaredType() == "char")
+        py_decl = name + " = bytearray(" + size_py_expr + ")"; // Zero filled, so already NUL terminated
+
+    // T a[N][M]...: one independent list per row (not [[None] * M] * N, which would share a single row).
+    const auto &inner_sizes = decl->getInnerSizeExpressions();
+    if (!inner_sizes.empty())
+    {
+        string element = "[None] * (" + transpileExpression(inner_sizes.back()) + ")";
+        if (m_options.char_as_int && decl->getDeclaredType() == "char")
+            element = "bytearray(" + transpileExpression(inner_sizes.back()) + ")";
+        for (size_t d = inner_sizes.size() - 1; d > 0; --d)
+            element = "[" + element + " for _ in range(" + transpileExpression(inner_sizes[d - 1]) + ")]";
+        py_decl = name + " = [" + element + " for _ in range(" + size_py_expr + ")]";
+        for (size_t d = 0; d < inner_sizes.size(); ++d)
+            m_declared_types[name] += "[]";
+    }
+
+    if (m_options.lint && py_decl.find("[None]") != string::npos)
+    {
+        lint(decl->line, "list-of-none",
+             "'" + name + "' is a list of None: every element is a boxed Python object, and the list is only usable once each element is stored" +
+                 (m_loop_depth > 0 ? "; it is rebuilt on every iteration" : "") +
+                 " (numeric data fits array('i')/array('d'), or build the values with a comprehension)",
+             m_loop_depth > 0 ? lintCost(decl) : 0);
+    }
 
     // TODO: If supporting C initializers `int arr[3] = {1,2,3};`, they would be transpiled here.
     // e.g., `py_decl = name + " = [" + comma_separated_transpiled_initializers + "]";`
@@ -978,12 +2829,2070 @@ string Transpiler::transpileArrayDeclaration(shared_ptr<ArrayDeclarationNode> de
 // Returns Python expression string, e.g., "my_array[i]"
 string Transpiler::transpileArraySubscriptNode(shared_ptr<ArraySubscriptNode> expr)
 {
+    string buffer, offset;
+    if (isPointerExpression(expr->getArrayExpression()) && pointerParts(expr->getArrayExpression(), buffer, offset))
+    {
+        return buffer + "[" + addOffset(offset, "+", transpileExpression(expr->getIndexExpression())) + "]";
+    }
     string array_py_expr = transpileExpression(expr->getArrayExpression());
     string index_py_expr = transpileExpression(expr->getIndexExpression());
 
     return array_py_expr + "[" + index_py_expr + "]";
 }
 
+// --- Pointer lowering ---
+// A C pointer is modeled as a (buffer, offset) pair. analyzePointers() looks at every assignment
+// to each pointer of a function and, when a pointer only ever walks one list, drops the buffer part
+// so that `*p`, `p[k]` and `p++` become plain index arithmetic on that list.
+
+void Transpiler::analyzePointers(shared_ptr<FunctionDeclarationNode> funcDecl)
+{
+    m_pointers.clear();
+    m_boxed.clear();
+
+    struct PointerFacts
+    {
+        vector<shared_ptr<ExpressionNode>> assigned; // Every value stored into the pointer
+        bool is_param = false;
+        bool walked = false;  // p++, p--, p = p + k, ...
+        bool escapes = false; // The pointer value itself is used: passed, returned, stored, compared, indexed
+    };
+    unordered_map<string, PointerFacts> facts;
+    set<string> scalars; // Scalar parameters and locals: the variables whose address may be boxed
+    set<string> arrays;
+    for (const auto &entry : m_declared_types)
+    {
+        if (entry.second.size() > 2 && entry.second.substr(entry.second.size() - 2) == "[]")
+            arrays.insert(entry.first);
+    }
+    const auto &params = funcDecl->getParameters();
+    auto offset_params = m_offset_params.find(funcDecl->getName());
+    for (size_t i = 0; i < params.size(); ++i)
+    {
+        const auto &param = params[i];
+        if (offset_params != m_offset_params.end() && offset_params->second.count(i))
+        {
+            // Receives a (list, offset) pair: walks that list from the offset on
+            facts[param.name].is_param = true;
+            facts[param.name].walked = true;
+        }
+        else if (param.isArray)
+            arrays.insert(param.name);
+        else if (isPointerType(param.type))
+            facts[param.name].is_param = true;
+        else
+            scalars.insert(param.name);
+    }
+
+    // Pass 1: pointer and array declarations of the body
+    function<void(const shared_ptr<ASTNode> &)> collectDecls = [&](const shared_ptr<ASTNode> &node)
+    {
+        if (auto arrayDecl = dynamic_pointer_cast<ArrayDeclarationNode>(node))
+        {
+            arrays.insert(arrayDecl->getName());
+        }
+        else if (auto decl = dynamic_pointer_cast<VariableDeclarationNode>(node))
+        {
+            if (isPointerType(decl->getDeclaredType()))
+            {
+                auto &f = facts[decl->getName()];
+                if (decl->getInitializer())
+                    f.assigned.push_back(decl->getInitializer());
+            }
+            else
+            {
+                scalars.insert(decl->getName());
+            }
+        }
+        forEachChild(node, collectDecls);
+    };
+    collectDecls(funcDecl->getBody());
+
+    // A scalar whose address is used other than as a scanf target or as the value stored into a
+    // pointer (e.g. swap(&x, &y), c ? &x : &y) lives in a one-element list, so that the address can
+    // be passed around: x is x[0], &x is x.
+    auto addressedScalar = [&](const shared_ptr<ExpressionNode> &expr) -> string
+    {
+        auto unary = dynamic_pointer_cast<UnaryExpressionNode>(stripCasts(expr));
+        auto ident = unary && unary->getOperator() == "&" ? dynamic_pointer_cast<IdentifierNode>(unary->getOperand()) : nullptr;
+        return ident && scalars.count(ident->getName()) ? ident->getName() : "";
+    };
+    function<void(const shared_ptr<ASTNode> &)> collectAddresses = [&](const shared_ptr<ASTNode> &node)
+    {
+        if (auto scanfStmt = dynamic_pointer_cast<ScanfNode>(node))
+        {
+            for (const auto &arg : scanfStmt->getArguments())
+            {
+                if (addressedScalar(arg).empty())
+                    collectAddresses(arg);
+            }
+            return;
+        }
+        auto decl = dynamic_pointer_cast<VariableDeclarationNode>(node);
+        if (decl && facts.count(decl->getName()) && decl->getInitializer() && !addressedScalar(decl->getInitializer()).empty())
+            return;
+        auto assign = dynamic_pointer_cast<AssignmentNode>(node);
+        auto target = assign ? dynamic_pointer_cast<IdentifierNode>(assign->getLValue()) : nullptr;
+        if (target && facts.count(target->getName()) && !addressedScalar(assign->getRValue()).empty())
+            return;
+        if (auto expr = dynamic_pointer_cast<ExpressionNode>(node))
+        {
+            string name = addressedScalar(expr);
+            if (!name.empty())
+            {
+                m_boxed.insert(name);
+                return;
+            }
+        }
+        forEachChild(node, collectAddresses);
+    };
+    collectAddresses(funcDecl->getBody());
+    if (facts.empty())
+        return;
+
+    // Pass 2: assignments and increments
+    function<void(const shared_ptr<ASTNode> &)> collectUses = [&](const shared_ptr<ASTNode> &node)
+    {
+        if (auto assign = dynamic_pointer_cast<AssignmentNode>(node))
+        {
+            auto target = dynamic_pointer_cast<IdentifierNode>(assign->getLValue());
+            if (target && facts.count(target->getName()))
+                facts[target->getName()].assigned.push_back(assign->getRValue());
+        }
+        else if (auto unary = dynamic_pointer_cast<UnaryExpressionNode>(node))
+        {
+            auto target = dynamic_pointer_cast<IdentifierNode>(unary->getOperand());
+            if ((unary->getOperator() == "++" || unary->getOperator() == "--") && target && facts.count(target->getName()))
+                facts[target->getName()].walked = true;
+        }
+        forEachChild(node, collectUses);
+    };
+    collectUses(funcDecl->getBody());
+
+    // Pass 3: uses of the pointer value other than *p, stores into p and p++ / p--
+    function<void(const shared_ptr<ASTNode> &)> collectEscapes = [&](const shared_ptr<ASTNode> &node)
+    {
+        if (auto ident = dynamic_pointer_cast<IdentifierNode>(node))
+        {
+            if (facts.count(ident->getName()))
+                facts[ident->getName()].escapes = true;
+            return;
+        }
+        if (auto unary = dynamic_pointer_cast<UnaryExpressionNode>(node))
+        {
+            const string &op = unary->getOperator();
+            auto operand = op == "*" ? stripCasts(unary->getOperand()) : unary->getOperand();
+            if ((op == "*" || op == "++" || op == "--") && dynamic_pointer_cast<IdentifierNode>(operand))
+                return;
+        }
+        if (auto assign = dynamic_pointer_cast<AssignmentNode>(node))
+        {
+            auto target = dynamic_pointer_cast<IdentifierNode>(assign->getLValue());
+            if (target && facts.count(target->getName()))
+            {
+                collectEscapes(assign->getRValue());
+                return;
+            }
+        }
+        forEachChild(node, collectEscapes);
+    };
+    collectEscapes(funcDecl->getBody());
+
+    // Where does a stored value point? Returns an array name, "*q" (same place as pointer q),
+    // "#self" (p moved relative to itself), "#fresh" (new allocation), "&x" (scalar) or "?".
+    function<string(shared_ptr<ExpressionNode>, const string &, bool &)> rootOf =
+        [&](shared_ptr<ExpressionNode> expr, const string &self, bool &zero_offset) -> string
+    {
+        expr = stripCasts(expr);
+        zero_offset = true;
+        if (isAllocationCall(expr))
+            return "#fresh";
+        if (m_options.char_as_int && dynamic_pointer_cast<StringLiteralNode>(expr))
+            return "#fresh";
+        if (auto ident = dynamic_pointer_cast<IdentifierNode>(expr))
+        {
+            const string &name = ident->getName();
+            if (name == self)
+                return "#self";
+            if (facts.count(name))
+                return "*" + name;
+            if (arrays.count(name))
+                return name;
+            return "?";
+        }
+        if (auto binary = dynamic_pointer_cast<BinaryExpressionNode>(expr))
+        {
+            if (binary->getOperator() != "+" && binary->getOperator() != "-")
+                return "?";
+            bool ignored;
+            string left = rootOf(binary->getLeft(), self, ignored);
+            string right = binary->getOperator() == "+" ? rootOf(binary->getRight(), self, ignored) : "?";
+            string root = left != "?" ? left : right;
+            zero_offset = isZeroLiteral(left != "?" ? binary->getRight() : binary->getLeft());
+            return root;
+        }
+        if (auto unary = dynamic_pointer_cast<UnaryExpressionNode>(expr))
+        {
+            if (unary->getOperator() == "&")
+            {
+                if (auto sub = dynamic_pointer_cast<ArraySubscriptNode>(unary->getOperand()))
+                {
+                    bool ignored;
+                    string root = rootOf(sub->getArrayExpression(), self, ignored);
+                    zero_offset = isZeroLiteral(sub->getIndexExpression()) && root.rfind("*", 0) != 0;
+                    return root;
+                }
+                if (auto ident = dynamic_pointer_cast<IdentifierNode>(unary->getOperand()))
+                    return m_boxed.count(ident->getName()) ? ident->getName() : "&" + ident->getName();
+            }
+            if ((unary->getOperator() == "++" || unary->getOperator() == "--") &&
+                dynamic_pointer_cast<IdentifierNode>(unary->getOperand()))
+            {
+                bool ignored;
+                zero_offset = false;
+                return rootOf(unary->getOperand(), self, ignored);
+            }
+        }
+        return "?";
+    };
+
+    // Classification depends on the classes of the pointers a value is copied from,
+    // so iterate a few times until it settles. A scalar whose address ends up in a pointer that
+    // cannot simply alias it (the pointer escapes or is stored more than once) is boxed after all,
+    // and the pointers are classified again with that scalar as a one-element list.
+    for (bool settled = false; !settled;)
+    {
+        m_pointers.clear();
+        for (int round = 0; round < 4; ++round)
+        {
+            for (auto &entry : facts)
+            {
+                const string &name = entry.first;
+                const PointerFacts &f = entry.second;
+                bool walked = f.walked;
+                set<string> roots;
+                if (f.is_param)
+                    roots.insert("#param");
+                for (const auto &value : f.assigned)
+                {
+                    bool zero_offset = true;
+                    string root = rootOf(value, name, zero_offset);
+                    if (root == "#self")
+                    {
+                        walked = true;
+                        continue;
+                    }
+                    if (root[0] == '*')
+                    {
+                        auto other = m_pointers.find(root.substr(1));
+                        if (other == m_pointers.end())
+                            root = "?";
+                        else if (other->second.kind == PointerInfo::Kind::Buffer)
+                            root = root.substr(1);
+                        else if (other->second.kind == PointerInfo::Kind::Walker)
+                        {
+                            root = other->second.buffer;
+                            zero_offset = false;
+                        }
+                        else
+                            root = "?";
+                    }
+                    if (!zero_offset)
+                        walked = true;
+                    roots.insert(root);
+                }
+
+                PointerInfo info;
+                size_t stores = f.assigned.size() + (f.is_param ? 1 : 0);
+                if (roots.empty() || roots.count("?"))
+                {
+                    info.kind = PointerInfo::Kind::Opaque;
+                }
+                else if (roots.begin()->rfind("&", 0) == 0 || roots.rbegin()->rfind("&", 0) == 0)
+                {
+                    if (roots.size() == 1 && stores == 1 && !walked && !f.escapes)
+                    {
+                        info.kind = PointerInfo::Kind::ScalarAlias;
+                        info.buffer = roots.begin()->substr(1);
+                    }
+                }
+                else if (!walked && stores == 1)
+                {
+                    info.kind = PointerInfo::Kind::Buffer;
+                    info.buffer = name;
+                }
+                else if (roots.size() == 1 && roots.count("#fresh") == 0 && roots.count("#param") == 0)
+                {
+                    info.kind = PointerInfo::Kind::Walker;
+                    info.buffer = *roots.begin();
+                }
+                else if (roots.size() == 1)
+                {
+                    // Walks its own allocation or the list it was passed: that list gets its own local.
+                    info.kind = PointerInfo::Kind::Walker;
+                    info.buffer = name + "__buf";
+                    info.from_param = f.is_param;
+                }
+                else
+                {
+                    info.kind = PointerInfo::Kind::Pair;
+                    info.buffer = name + "__buf";
+                    info.from_param = f.is_param;
+                }
+                m_pointers[name] = info;
+            }
+        }
+        settled = true;
+        for (const auto &entry : facts)
+        {
+            if (m_pointers[entry.first].kind == PointerInfo::Kind::ScalarAlias)
+                continue;
+            for (const auto &value : entry.second.assigned)
+            {
+                string scalar = addressedScalar(value);
+                if (!scalar.empty() && m_boxed.insert(scalar).second)
+                    settled = false;
+            }
+        }
+    }
+
+    for (const auto &entry : m_pointers)
+    {
+        if (entry.second.kind == PointerInfo::Kind::Opaque)
+        {
+            *m_diagnostics << "Transpiler Warning: Pointer '" << entry.first << "' in function '" << funcDecl->getName()
+                 << "' could not be lowered to an index; it is transpiled as a plain variable." << endl;
+        }
+    }
+}
+
+// True if the expression is a pointer value derived from one of the function's pointer variables.
+bool Transpiler::isPointerExpression(shared_ptr<ExpressionNode> expr) const
+{
+    expr = stripCasts(expr);
+    if (auto ident = dynamic_pointer_cast<IdentifierNode>(expr))
+    {
+        auto it = m_pointers.find(ident->getName());
+        return it != m_pointers.end() && it->second.kind != PointerInfo::Kind::Opaque &&
+               it->second.kind != PointerInfo::Kind::ScalarAlias;
+    }
+    if (auto binary = dynamic_pointer_cast<BinaryExpressionNode>(expr))
+    {
+        if (binary->getOperator() == "+")
+            return isPointerExpression(binary->getLeft()) || isPointerExpression(binary->getRight());
+        if (binary->getOperator() == "-")
+            return isPointerExpression(binary->getLeft()) && !isPointerExpression(binary->getRight());
+    }
+    return false;
+}
+
+// True if the expression is a pointer value pointerParts can split: a lowered pointer, an array,
+// &a[k], &x of a boxed scalar, or one of those plus or minus an integer. Sets 'moved' when it may
+// point past the start of its list.
+bool Transpiler::isPointerValue(shared_ptr<ExpressionNode> expr, bool &moved) const
+{
+    expr = stripCasts(expr);
+    moved = false;
+    if (auto ident = dynamic_pointer_cast<IdentifierNode>(expr))
+    {
+        auto it = m_pointers.find(ident->getName());
+        if (it == m_pointers.end())
+            return !elementTypeOf(ident->getName()).empty();
+        moved = it->second.kind == PointerInfo::Kind::Walker || it->second.kind == PointerInfo::Kind::Pair;
+        return it->second.kind != PointerInfo::Kind::Opaque && it->second.kind != PointerInfo::Kind::ScalarAlias;
+    }
+    if (auto binary = dynamic_pointer_cast<BinaryExpressionNode>(expr))
+    {
+        const string &op = binary->getOperator();
+        bool ignored;
+        if ((op == "+" || op == "-") && isPointerValue(binary->getLeft(), moved) && !isPointerValue(binary->getRight(), ignored))
+        {
+            moved = moved || !isZeroLiteral(binary->getRight());
+            return true;
+        }
+        if (op == "+" && isPointerValue(binary->getRight(), moved) && !isPointerValue(binary->getLeft(), ignored))
+        {
+            moved = moved || !isZeroLiteral(binary->getLeft());
+            return true;
+        }
+        moved = false;
+        return false;
+    }
+    auto unary = dynamic_pointer_cast<UnaryExpressionNode>(expr);
+    if (!unary || unary->getOperator() != "&")
+        return false;
+    if (auto scalar = dynamic_pointer_cast<IdentifierNode>(unary->getOperand()))
+        return m_boxed.count(scalar->getName()) > 0;
+    auto sub = dynamic_pointer_cast<ArraySubscriptNode>(unary->getOperand());
+    if (!sub || !isPointerValue(sub->getArrayExpression(), moved))
+        return false;
+    moved = moved || !isZeroLiteral(sub->getIndexExpression());
+    return true;
+}
+
+// A pointer argument that may point past the start of its list (buf + 4, &a[k], a pointer that was
+// walked) is passed as a (list, offset) pair, and the callee walks the list from that offset: the
+// callee's writes land in the caller's list. Decided for the whole program before any function is
+// transpiled, since such a parameter is itself a moved pointer when the callee passes it on, and
+// every call of the function then passes that parameter as a pair. Arguments for functions the
+// program does not define are not planned (transpileFunctionCallNode refuses moved ones).
+void Transpiler::planPointerArguments(shared_ptr<ProgramNode> program)
+{
+    m_defined_functions.clear();
+    m_offset_params.clear();
+    for (const auto &stmt : program->getStatements())
+    {
+        auto funcDecl = dynamic_pointer_cast<FunctionDeclarationNode>(stmt);
+        if (funcDecl && funcDecl->getBody())
+            m_defined_functions[funcDecl->getName()] = funcDecl;
+    }
+
+    // Declarations as the statements will declare them, as far as pointers and arrays go.
+    auto declare = [this](const shared_ptr<ASTNode> &node)
+    {
+        auto decl = dynamic_pointer_cast<VariableDeclarationNode>(node);
+        if (!decl)
+            return;
+        m_declared_types[decl->getName()] = decl->getDeclaredType();
+        if (auto arrayDecl = dynamic_pointer_cast<ArrayDeclarationNode>(node))
+        {
+            for (size_t d = 0; d <= arrayDecl->getInnerSizeExpressions().size(); ++d)
+                m_declared_types[decl->getName()] += "[]";
+        }
+    };
+    unordered_map<string, string> outer_types = m_declared_types;
+    unordered_map<string, vector<long long>> outer_dims = m_array_dims;
+    ostringstream ignored; // analyzePointers' warnings come when the functions are transpiled
+    ostream *diagnostics = m_diagnostics;
+    m_diagnostics = &ignored;
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+        m_declared_types = outer_types;
+        for (const auto &stmt : program->getStatements())
+        {
+            auto funcDecl = dynamic_pointer_cast<FunctionDeclarationNode>(stmt);
+            if (!funcDecl)
+            {
+                declare(stmt);
+                continue;
+            }
+            if (!funcDecl->getBody())
+                continue;
+            unordered_map<string, string> global_types = m_declared_types;
+            declareParameters(funcDecl);
+            function<void(const shared_ptr<ASTNode> &)> declareLocals = [&](const shared_ptr<ASTNode> &node)
+            {
+                declare(node);
+                forEachChild(node, declareLocals);
+            };
+            declareLocals(funcDecl->getBody());
+            analyzePointers(funcDecl);
+            function<void(const shared_ptr<ASTNode> &)> visitCalls = [&](const shared_ptr<ASTNode> &node)
+            {
+                auto call = dynamic_pointer_cast<FunctionCallNode>(node);
+                auto callee = call ? m_defined_functions.find(call->getFunctionName()) : m_defined_functions.end();
+                if (callee != m_defined_functions.end())
+                {
+                    const auto &args = call->getArguments();
+                    for (size_t i = 0; i < args.size() && i < callee->second->getParameters().size(); ++i)
+                    {
+                        bool moved;
+                        if (isPointerValue(args[i], moved) && moved && m_offset_params[callee->first].insert(i).second)
+                            changed = true;
+                    }
+                }
+                forEachChild(node, visitCalls);
+            };
+            visitCalls(funcDecl->getBody());
+            m_declared_types = global_types;
+        }
+    }
+    m_diagnostics = diagnostics;
+    m_declared_types = outer_types;
+    m_array_dims = outer_dims;
+    m_pointers.clear();
+    m_boxed.clear();
+}
+
+// Splits a pointer-valued expression into the Python list it indexes and the offset into it.
+bool Transpiler::pointerParts(shared_ptr<ExpressionNode> expr, string &buffer, string &offset)
+{
+    expr = stripCasts(expr);
+    if (auto ident = dynamic_pointer_cast<IdentifierNode>(expr))
+    {
+        const string &name = ident->getName();
+        auto it = m_pointers.find(name);
+        if (it != m_pointers.end())
+        {
+            switch (it->second.kind)
+            {
+            case PointerInfo::Kind::Buffer:
+                buffer = name;
+                offset = "0";
+                return true;
+            case PointerInfo::Kind::Walker:
+            case PointerInfo::Kind::Pair:
+                buffer = it->second.buffer;
+                offset = name;
+                return true;
+            default:
+                return false;
+            }
+        }
+        if (!elementTypeOf(name).empty())
+        {
+            buffer = name;
+            offset = "0";
+            return true;
+        }
+        return false;
+    }
+    if (auto binary = dynamic_pointer_cast<BinaryExpressionNode>(expr))
+    {
+        const string &op = binary->getOperator();
+        if ((op == "+" || op == "-") && !isPointerExpression(binary->getRight()) &&
+            pointerParts(binary->getLeft(), buffer, offset))
+        {
+            offset = addOffset(offset, op, transpileExpression(binary->getRight()));
+            return true;
+        }
+        if (op == "+" && !isPointerExpression(binary->getLeft()) && pointerParts(binary->getRight(), buffer, offset))
+        {
+            offset = addOffset(offset, "+", transpileExpression(binary->getLeft()));
+            return true;
+        }
+        return false;
+    }
+    if (auto unary = dynamic_pointer_cast<UnaryExpressionNode>(expr))
+    {
+        auto scalar = dynamic_pointer_cast<IdentifierNode>(unary->getOperand());
+        if (unary->getOperator() == "&" && scalar && m_boxed.count(scalar->getName()))
+        {
+            buffer = scalar->getName();
+            offset = "0";
+            return true;
+        }
+        auto sub = dynamic_pointer_cast<ArraySubscriptNode>(unary->getOperand());
+        if (unary->getOperator() == "&" && sub && pointerParts(sub->getArrayExpression(), buffer, offset))
+        {
+            offset = addOffset(offset, "+", transpileExpression(sub->getIndexExpression()));
+            return true;
+        }
+    }
+    return false;
+}
+
+// `name = rhs` for a pointer variable, following its representation.
+string Transpiler::transpilePointerAssignment(const string &name, shared_ptr<ExpressionNode> rhs)
+{
+    auto it = m_pointers.find(name);
+    if (it == m_pointers.end() || it->second.kind == PointerInfo::Kind::Opaque)
+        return name + " = " + transpileExpression(rhs);
+    const PointerInfo &info = it->second;
+    if (info.kind == PointerInfo::Kind::ScalarAlias)
+        return ""; // Every *name is rewritten to the aliased variable
+
+    string allocation;
+    if (isAllocationCall(rhs))
+        allocation = transpileAllocation(dynamic_pointer_cast<FunctionCallNode>(stripCasts(rhs)), m_declared_types[name]);
+    else if (m_options.char_as_int && dynamic_pointer_cast<StringLiteralNode>(stripCasts(rhs)))
+        allocation = transpileExpression(stripCasts(rhs)); // The bytes literal is the buffer
+    string buffer = "None";
+    string offset = "0";
+    if (allocation.empty() && !pointerParts(rhs, buffer, offset))
+        return name + " = " + transpileExpression(rhs);
+
+    switch (info.kind)
+    {
+    case PointerInfo::Kind::Buffer:
+        return name + " = " + (allocation.empty() ? buffer : allocation);
+    case PointerInfo::Kind::Walker:
+        if (!allocation.empty())
+            return info.buffer + ", " + name + " = " + allocation + ", 0";
+        return name + " = " + offset;
+    default: // Pair
+        return info.buffer + ", " + name + " = " + (allocation.empty() ? buffer : allocation) + ", " + offset;
+    }
+}
+
+// malloc(n * sizeof(T)) / calloc(n, sizeof(T)) -> a preallocated list of n zero values of type T.
+string Transpiler::transpileAllocation(shared_ptr<FunctionCallNode> call, const string &pointer_type)
+{
+    auto args = call->getArguments();
+    string element_type = isPointerType(pointer_type) ? pointer_type.substr(0, pointer_type.size() - 1) : "";
+    shared_ptr<ExpressionNode> count;
+    auto takeSizeof = [&](shared_ptr<ExpressionNode> expr)
+    {
+        auto size = dynamic_pointer_cast<SizeofNode>(expr);
+        string type;
+        vector<long long> dims;
+        if (size && !size->getOperand())
+            element_type = size->getTargetType();
+        else if (size && staticType(size->getOperand(), type, dims) && dims.empty())
+            element_type = type; // malloc(n * sizeof *p)
+        return size != nullptr;
+    };
+
+    if (call->getFunctionName() == "calloc" && args.size() == 2)
+    {
+        count = args[0];
+        takeSizeof(args[1]);
+    }
+    else if (call->getFunctionName() == "malloc" && args.size() == 1)
+    {
+        auto product = dynamic_pointer_cast<BinaryExpressionNode>(args[0]);
+        if (takeSizeof(args[0]))
+            count = make_shared<NumberNode>("1");
+        else if (product && product->getOperator() == "*" && takeSizeof(product->getRight()))
+            count = product->getLeft();
+        else if (product && product->getOperator() == "*" && takeSizeof(product->getLeft()))
+            count = product->getRight();
+        else
+        {
+            // No sizeof: the size is in bytes, so only char buffers get the exact element count.
+            count = args[0];
+            if (element_type != "char")
+                *m_diagnostics << "Transpiler Warning: " << call->getFunctionName() << " size is not of the form n * sizeof(T); "
+                     << "allocating one element per byte." << endl;
+        }
+    }
+    else
+    {
+        return "#UNSUPPORTED_ALLOCATION";
+    }
+
+    string zero = "None";
+    if (element_type == "int" || element_type == "long" || element_type == "short")
+        zero = "0";
+    else if (element_type == "float" || element_type == "double")
+        zero = "0.0";
+    else if (element_type == "char" && m_options.char_as_int)
+        return "bytearray(" + transpileExpression(count) + ")";
+    else if (element_type == "char")
+        zero = "'\\0'";
+    else if (element_type == "bool")
+        zero = "False";
+    return "[" + zero + "] * (" + transpileExpression(count) + ")";
+}
+
+// --- Transpile-time partial evaluation ---
+// Lookup tables that a function fills with loops over constants (factorials, sieves, CRC tables)
+// are computed once by the transpiler: a run of statements that starts with an array declaration
+// and only uses constants is executed by the Evaluator, and the arrays (and any scalars the run
+// leaves behind) are emitted as literals. Anything the Evaluator cannot prove (run-time input,
+// calls, I/O, undefined behavior, an exhausted step budget) ends the run.
+
+// Shortest decimal text that reads back as the same double, in Python syntax.
+static string pythonFloatLiteral(double value)
+{
+    char buffer[32];
+    for (int precision = 1; precision <= 17; ++precision)
+    {
+        snprintf(buffer, sizeof(buffer), "%.*g", precision, value);
+        if (strtod(buffer, nullptr) == value)
+            break;
+    }
+    string text = buffer;
+    if (text.find_first_of(".e") == string::npos)
+        text += ".0";
+    return text;
+}
+
+string Transpiler::transpileEvaluatedValue(const EvalValue &value, const string &type)
+{
+    if (!value.known)
+        return m_options.char_as_int && type == "char" ? "0" : "None";
+    if (value.is_float)
+        return pythonFloatLiteral(value.f);
+    if (type == "bool")
+        return value.i ? "True" : "False";
+    if (type == "char")
+        return transpileCharLiteralNode(make_shared<CharLiteralNode>(string(1, (char)value.i)));
+    return to_string(value.i);
+}
+
+void Transpiler::defineEvaluatorConstants(Evaluator &evaluator) const
+{
+    for (const auto &macro : m_integer_macros)
+    {
+        long long value;
+        if (parseIntegerLiteral(macro.second, value))
+            evaluator.defineConstant(macro.first, value);
+    }
+}
+
+// `name = <literal>` for a variable the Evaluator computed (nothing for a scalar it left unknown).
+string Transpiler::transpileEvaluatedVariable(const string &name, const EvalVariable &variable, int indent_level)
+{
+    if (variable.dims.empty())
+    {
+        if (!m_declared_types.count(name))
+            m_declared_types[name] = variable.type;
+        if (m_boxed.count(name))
+            return indent(name + " = [" + transpileEvaluatedValue(variable.cells[0], variable.type) + "]\n", indent_level);
+        if (variable.cells[0].known)
+            return indent(name + " = " + transpileEvaluatedValue(variable.cells[0], variable.type) + "\n", indent_level);
+        return "";
+    }
+    m_declared_types[name] = variable.type;
+    for (size_t d = 0; d < variable.dims.size(); ++d)
+        m_declared_types[name] += "[]";
+    m_array_dims[name] = variable.dims;
+
+    // Innermost rows first: one line per value run (wrapped), then nested lists around them.
+    bool bytes = m_options.char_as_int && variable.type == "char";
+    long long row = variable.dims.back();
+    vector<string> rows;
+    for (size_t start = 0; start < variable.cells.size(); start += row)
+    {
+        vector<string> items;
+        for (long long k = 0; k < row; ++k)
+            items.push_back(transpileEvaluatedValue(variable.cells[start + k], variable.type));
+        string text, line;
+        for (size_t k = 0; k < items.size(); ++k)
+        {
+            string item = items[k] + (k + 1 < items.size() ? "," : "");
+            if (!line.empty() && line.size() + item.size() + 1 > 96)
+            {
+                text += line + "\n";
+                line.clear();
+            }
+            line += (line.empty() ? "" : " ") + item;
+        }
+        text += line;
+        bool wrapped = text.find('\n') != string::npos;
+        text = wrapped ? "[\n" + indent(text + "\n", 1) + "]" : "[" + text + "]";
+        rows.push_back(bytes ? "bytearray(" + text + ")" : text);
+    }
+    for (size_t d = variable.dims.size() - 1; d > 0; --d)
+    {
+        vector<string> outer;
+        long long count = variable.dims[d - 1];
+        for (size_t start = 0; start < rows.size(); start += count)
+        {
+            string text;
+            for (long long k = 0; k < count; ++k)
+                text += indent(rows[start + k] + ",\n", 1);
+            outer.push_back("[\n" + text + "]");
+        }
+        rows = outer;
+    }
+    return indent(name + " = " + rows[0] + "\n", indent_level);
+}
+
+// Number of statements from stmts[first] on that were replaced by literals in out_code (0: none).
+size_t Transpiler::transpilePrecomputed(const vector<shared_ptr<StatementNode>> &stmts, size_t first, int indent_level, string &out_code)
+{
+    if (m_options.eval_budget <= 0 || m_cold || isProfiling() || !m_inline_bindings.empty() ||
+        !dynamic_pointer_cast<ArrayDeclarationNode>(stmts[first]))
+        return 0;
+
+    Evaluator evaluator(m_options.eval_budget);
+    defineEvaluatorConstants(evaluator);
+    // Local scalars declared before the run may be assigned by it (e.g. a shared loop counter).
+    for (const auto &entry : m_declared_types)
+    {
+        if (!m_global_names.count(entry.first) && !m_pointers.count(entry.first) && !m_boxed.count(entry.first) &&
+            entry.second.find_first_of("[*") == string::npos)
+            evaluator.allowOuterScalar(entry.first, entry.second);
+    }
+
+    // Extend the run one statement at a time; it ends with its last loop.
+    Evaluator trial = evaluator;
+    size_t end = first;
+    shared_ptr<StatementNode> first_loop;
+    for (size_t k = first; k < stmts.size(); ++k)
+    {
+        try
+        {
+            trial.execute(stmts[k]);
+        }
+        catch (const EvaluationAborted &)
+        {
+            break;
+        }
+        if (dynamic_pointer_cast<ForNode>(stmts[k]) || dynamic_pointer_cast<WhileNode>(stmts[k]))
+        {
+            evaluator = trial;
+            end = k + 1;
+            first_loop = first_loop ? first_loop : stmts[k];
+        }
+    }
+    if (!first_loop)
+        return 0;
+    long long elements = 0;
+    for (const auto &name : evaluator.getVariableOrder())
+        elements += evaluator.getVariable(name).cells.size();
+    if (elements > m_options.eval_max_elements)
+        return 0;
+
+    string code;
+    string arrays;
+    for (const auto &name : evaluator.getVariableOrder())
+    {
+        const EvalVariable &variable = evaluator.getVariable(name);
+        code += transpileEvaluatedVariable(name, variable, indent_level);
+        if (!variable.dims.empty())
+            arrays += (arrays.empty() ? "" : ", ") + name;
+    }
+    m_loop_rewrites.push_back({first_loop->line, dynamic_pointer_cast<ForNode>(first_loop) ? "for" : "while",
+                               "values computed at transpile time (" + arrays + ", " + to_string(evaluator.getStepsUsed()) + " steps)"});
+    out_code = code;
+    return end - first;
+}
+
+static bool sameValue(const EvalValue &a, const EvalValue &b)
+{
+    return a.known == b.known && a.is_float == b.is_float && (a.is_float ? a.f == b.f : a.i == b.i);
+}
+
+// Global tables that main fills before it does anything else, by calling an init function without
+// parameters (int sq[N]; void init() { for (...) sq[i] = i * i; }) or with loops at the top of its
+// body, are computed the same way. The Evaluator runs the global declarations, then the leading
+// statements of main, with the body of each init() call in place of the call; the run ends with its
+// last loop or init call. Globals the run changed are emitted as literals where they are declared,
+// and its statements are dropped from main. Since nothing runs before main, the literals hold
+// exactly what the globals hold once the dropped statements ran. The init functions stay, for other
+// callers. A local declaration without initializer (int n;) does not end the run, any other
+// statement the Evaluator refuses (calls, pointers, I/O, locals of main) does.
+void Transpiler::planGlobalTables(shared_ptr<ProgramNode> program)
+{
+    m_precomputed_globals.clear();
+    m_precomputed_statements.clear();
+    auto mainDecl = m_defined_functions.find("main");
+    if (m_options.eval_budget <= 0 || isProfiling() || mainDecl == m_defined_functions.end())
+        return;
+
+    // Globals the Evaluator cannot declare (pointers, initializer lists) stay unknown to it.
+    Evaluator evaluator(m_options.eval_budget);
+    defineEvaluatorConstants(evaluator);
+    for (const auto &stmt : program->getStatements())
+    {
+        if (!dynamic_pointer_cast<VariableDeclarationNode>(stmt))
+            continue;
+        Evaluator trial = evaluator;
+        try
+        {
+            trial.execute(stmt);
+        }
+        catch (const EvaluationAborted &)
+        {
+            continue;
+        }
+        evaluator = trial;
+    }
+    const Evaluator declared = evaluator;
+    size_t globals = evaluator.getVariableOrder().size();
+
+    auto firstLoopIn = [](const shared_ptr<ASTNode> &root)
+    {
+        shared_ptr<StatementNode> loop;
+        function<void(const shared_ptr<ASTNode> &)> visit = [&](const shared_ptr<ASTNode> &node)
+        {
+            if (!loop && (dynamic_pointer_cast<ForNode>(node) || dynamic_pointer_cast<WhileNode>(node)))
+                loop = dynamic_pointer_cast<StatementNode>(node);
+            if (!loop)
+                forEachChild(node, visit);
+        };
+        visit(root);
+        return loop;
+    };
+
+    const auto &stmts = mainDecl->second->getBody()->getStatements();
+    Evaluator trial = evaluator;
+    vector<const StatementNode *> executed, run;
+    shared_ptr<StatementNode> first_loop, trial_loop;
+    for (const auto &stmt : stmts)
+    {
+        auto local = dynamic_pointer_cast<VariableDeclarationNode>(stmt);
+        if (local && !dynamic_pointer_cast<ArrayDeclarationNode>(stmt) && !local->getInitializer() &&
+            !m_global_names.count(local->getName()))
+            continue;
+        auto exprStmt = dynamic_pointer_cast<ExpressionStatementNode>(stmt);
+        auto call = exprStmt ? dynamic_pointer_cast<FunctionCallNode>(exprStmt->getExpression()) : nullptr;
+        auto callee = call ? m_defined_functions.find(call->getFunctionName()) : m_defined_functions.end();
+        shared_ptr<StatementNode> loop;
+        try
+        {
+            if (callee != m_defined_functions.end())
+            {
+                if (!call->getArguments().empty() || !callee->second->getParameters().empty())
+                    break;
+                trial.execute(callee->second->getBody());
+                loop = firstLoopIn(callee->second->getBody());
+            }
+            else
+            {
+                trial.execute(stmt);
+                if (dynamic_pointer_cast<ForNode>(stmt) || dynamic_pointer_cast<WhileNode>(stmt))
+                    loop = stmt;
+            }
+        }
+        catch (const EvaluationAborted &)
+        {
+            break;
+        }
+        if (trial.getVariableOrder().size() != globals)
+            break; // It declared a local of main
+        executed.push_back(stmt.get());
+        trial_loop = trial_loop ? trial_loop : loop;
+        if (loop)
+        {
+            evaluator = trial;
+            run = executed;
+            first_loop = trial_loop;
+        }
+    }
+    if (!first_loop)
+        return;
+
+    long long elements = 0;
+    string tables;
+    unordered_map<string, EvalVariable> changed;
+    for (const auto &name : evaluator.getVariableOrder())
+    {
+        const EvalVariable &before = declared.getVariable(name);
+        const EvalVariable &after = evaluator.getVariable(name);
+        if (equal(before.cells.begin(), before.cells.end(), after.cells.begin(), sameValue))
+            continue;
+        changed[name] = after;
+        elements += after.cells.size();
+        if (!after.dims.empty())
+            tables += (tables.empty() ? "" : ", ") + name;
+    }
+    if (elements > m_options.eval_max_elements)
+        return;
+    m_precomputed_globals = changed;
+    m_precomputed_statements.insert(run.begin(), run.end());
+    m_loop_rewrites.push_back({first_loop->line, dynamic_pointer_cast<ForNode>(first_loop) ? "for" : "while",
+                               "values computed at transpile time (" + (tables.empty() ? string("globals") : tables) + ", " +
+                                   to_string(evaluator.getStepsUsed()) + " steps)"});
+}
+
+// --- Common subexpression elimination ---
+// Inside loop bodies, a subscript or arithmetic expression that a run of simple statements computes
+// several times is evaluated once into a _cseN local. Expressions are matched by a structural key;
+// a store to any name (or array element) that an expression reads ends its reuse window. Row
+// references of multi-dimensional arrays (grid[i] in grid[i][j]) that cannot change inside a loop
+// are computed once before the loop into a _rowN local.
+
+// Structural key of a side-effect free expression; "" if the expression is not a CSE candidate.
+static string expressionKey(const shared_ptr<ExpressionNode> &expr)
+{
+    if (auto ident = dynamic_pointer_cast<IdentifierNode>(expr))
+        return ident->getName();
+    if (auto num = dynamic_pointer_cast<NumberNode>(expr))
+        return "#" + num->getValue();
+    if (auto ch = dynamic_pointer_cast<CharLiteralNode>(expr))
+        return "'" + ch->getValue() + "'";
+    if (auto boolean = dynamic_pointer_cast<BooleanNode>(expr))
+        return boolean->getValue() ? "#true" : "#false";
+    if (auto sub = dynamic_pointer_cast<ArraySubscriptNode>(expr))
+    {
+        string array = expressionKey(sub->getArrayExpression());
+        string index = expressionKey(sub->getIndexExpression());
+        return array.empty() || index.empty() ? "" : array + "[" + index + "]";
+    }
+    if (auto binary = dynamic_pointer_cast<BinaryExpressionNode>(expr))
+    {
+        string left = expressionKey(binary->getLeft());
+        string right = expressionKey(binary->getRight());
+        return left.empty() || right.empty() ? "" : "(" + left + " " + binary->getOperator() + " " + right + ")";
+    }
+    if (auto unary = dynamic_pointer_cast<UnaryExpressionNode>(expr))
+    {
+        const string &op = unary->getOperator();
+        string operand = expressionKey(unary->getOperand());
+        if (op == "++" || op == "--" || op == "*" || op == "&" || operand.empty())
+            return ""; // Stores, and pointer reads whose target the write sets do not track
+        return "(" + op + operand + ")";
+    }
+    if (auto cast = dynamic_pointer_cast<CastNode>(expr))
+    {
+        string operand = expressionKey(cast->getOperand());
+        return operand.empty() ? "" : "((" + cast->getTargetType() + ")" + operand + ")";
+    }
+    return "";
+}
+
+// Rough CPython cost of evaluating the expression, in bytecode-sized units.
+static int evaluationCost(const shared_ptr<ASTNode> &node)
+{
+    int cost = dynamic_pointer_cast<ArraySubscriptNode>(node) ? 3 : 1;
+    for (const auto &child : node->getChildren())
+        cost += evaluationCost(child);
+    return cost;
+}
+
+// "grid" and 2 for grid[i][j]; "" if the subscript chain does not start at a name.
+static string subscriptBase(shared_ptr<ExpressionNode> expr, int &depth)
+{
+    depth = 0;
+    while (auto sub = dynamic_pointer_cast<ArraySubscriptNode>(expr))
+    {
+        depth++;
+        expr = sub->getArrayExpression();
+    }
+    auto ident = dynamic_pointer_cast<IdentifierNode>(expr);
+    return ident ? ident->getName() : "";
+}
+
+// Names an expression reads, and the subscript chains (array, depth) it loads through.
+struct ReadSet
+{
+    set<string> names;
+    vector<pair<string, int>> subscripts;
+};
+
+static void collectReads(const shared_ptr<ASTNode> &node, ReadSet &reads)
+{
+    if (auto ident = dynamic_pointer_cast<IdentifierNode>(node))
+        reads.names.insert(ident->getName());
+    if (auto sub = dynamic_pointer_cast<ArraySubscriptNode>(node))
+    {
+        int depth;
+        string base = subscriptBase(sub, depth);
+        reads.subscripts.push_back({base, depth});
+    }
+    forEachChild(node, [&](const shared_ptr<ASTNode> &child)
+                 { collectReads(child, reads); });
+}
+
+// What a statement (or a whole loop) may store to. 'calls' is set by calls to functions
+// that are not known to be pure; they may write globals and any array passed to them.
+struct WriteSet
+{
+    set<string> names;
+    vector<pair<string, int>> elements; // Stores through a subscript chain: (array, depth)
+    bool calls = false;
+    bool unknown = false; // Stores through pointers or other lvalues that are not tracked
+};
+
+static void noteStore(const shared_ptr<ExpressionNode> &lvalue, WriteSet &writes)
+{
+    if (auto ident = dynamic_pointer_cast<IdentifierNode>(lvalue))
+    {
+        writes.names.insert(ident->getName());
+        return;
+    }
+    int depth;
+    string base = subscriptBase(lvalue, depth);
+    if (depth > 0 && !base.empty())
+        writes.elements.push_back({base, depth});
+    else
+        writes.unknown = true;
+}
+
+static void collectWrites(const shared_ptr<ASTNode> &node, WriteSet &writes, const unordered_map<string, InlineCandidate> &pure_functions)
+{
+    if (auto assign = dynamic_pointer_cast<AssignmentNode>(node))
+    {
+        noteStore(assign->getLValue(), writes);
+    }
+    else if (auto unary = dynamic_pointer_cast<UnaryExpressionNode>(node))
+    {
+        if (unary->getOperator() == "++" || unary->getOperator() == "--")
+            noteStore(unary->getOperand(), writes);
+    }
+    else if (auto decl = dynamic_pointer_cast<DeclarationNode>(node))
+    {
+        writes.names.insert(decl->getName());
+    }
+    else if (auto call = dynamic_pointer_cast<FunctionCallNode>(node))
+    {
+        if (!pure_functions.count(call->getFunctionName()))
+            writes.calls = true;
+    }
+    else if (auto scanfStmt = dynamic_pointer_cast<ScanfNode>(node))
+    {
+        for (const auto &arg : scanfStmt->getArguments())
+        {
+            auto address = dynamic_pointer_cast<UnaryExpressionNode>(arg);
+            if (address && address->getOperator() == "&")
+                noteStore(address->getOperand(), writes);
+            else if (auto ident = dynamic_pointer_cast<IdentifierNode>(arg))
+                writes.elements.push_back({ident->getName(), 1}); // scanf("%s", buf)
+            else
+                writes.unknown = true;
+        }
+    }
+    forEachChild(node, [&](const shared_ptr<ASTNode> &child)
+                 { collectWrites(child, writes, pure_functions); });
+}
+
+// True if a value computed from 'reads' may be stale after 'writes'.
+// An element store of depth d may alias any load of depth >= d (array parameters and
+// pointers can share lists), but leaves shallower row references intact.
+static bool isKilledBy(const ReadSet &reads, const WriteSet &writes, bool pointers_in_scope)
+{
+    if (writes.unknown)
+        return true;
+    for (const auto &name : writes.names)
+    {
+        if (reads.names.count(name))
+            return true;
+    }
+    for (const auto &element : writes.elements)
+    {
+        for (const auto &load : reads.subscripts)
+        {
+            if (load.second >= element.second || pointers_in_scope)
+                return true;
+        }
+    }
+    return false;
+}
+
+// Loads a simple statement evaluates unconditionally, in order: candidate subscripts and arithmetic.
+// Expressions already held in a local ('bound') are skipped. Returns false for statements
+// that are not part of a straight-line region.
+static bool collectStatementLoads(const shared_ptr<StatementNode> &stmt, const unordered_map<const ASTNode *, string> &bound,
+                                  vector<shared_ptr<ExpressionNode>> &loads)
+{
+    function<void(const shared_ptr<ExpressionNode> &)> visit = [&](const shared_ptr<ExpressionNode> &expr)
+    {
+        if (!expr || dynamic_pointer_cast<FunctionCallNode>(expr) || bound.count(expr.get()))
+            return; // Inlined callees may evaluate their arguments lazily
+        auto binary = dynamic_pointer_cast<BinaryExpressionNode>(expr);
+        if (binary && (binary->getOperator() == "&&" || binary->getOperator() == "||"))
+        {
+            visit(binary->getLeft()); // The right operand is only evaluated sometimes
+            return;
+        }
+        static const set<string> arithmetic = {"+", "-", "*", "/", "%", "<<", ">>", "&", "|", "^"};
+        if ((dynamic_pointer_cast<ArraySubscriptNode>(expr) || (binary && arithmetic.count(binary->getOperator()))) &&
+            !expressionKey(expr).empty())
+        {
+            loads.push_back(expr);
+        }
+        for (const auto &child : expr->getChildren())
+            visit(dynamic_pointer_cast<ExpressionNode>(child));
+    };
+
+    if (dynamic_pointer_cast<ArrayDeclarationNode>(stmt))
+        return false;
+    if (auto decl = dynamic_pointer_cast<VariableDeclarationNode>(stmt))
+    {
+        if (isPointerType(decl->getDeclaredType()))
+            return false;
+        visit(decl->getInitializer());
+        return true;
+    }
+    if (auto printfStmt = dynamic_pointer_cast<PrintfNode>(stmt))
+    {
+        for (const auto &arg : printfStmt->getArguments())
+            visit(arg);
+        return true;
+    }
+    auto exprStmt = dynamic_pointer_cast<ExpressionStatementNode>(stmt);
+    if (!exprStmt)
+        return false;
+    if (auto assign = dynamic_pointer_cast<AssignmentNode>(exprStmt->getExpression()))
+    {
+        visit(assign->getRValue());
+        if (auto target = dynamic_pointer_cast<ArraySubscriptNode>(assign->getLValue()))
+        {
+            visit(target->getArrayExpression()); // The row of grid[i][j] = v is a load
+            visit(target->getIndexExpression());
+        }
+        return true;
+    }
+    visit(exprStmt->getExpression());
+    return true;
+}
+
+string Transpiler::transpileStatementList(const vector<shared_ptr<StatementNode>> &stmts, int indent_level)
+{
+    string code;
+    if (m_loop_depth == 0)
+    {
+        for (size_t k = 0; k < stmts.size(); ++k)
+        {
+            if (m_precomputed_statements.count(stmts[k].get()))
+                continue; // Its effect is in the literals of the globals (see planGlobalTables)
+            string precomputed_code;
+            size_t replaced = transpilePrecomputed(stmts, k, indent_level, precomputed_code);
+            if (replaced > 0)
+            {
+                code += precomputed_code;
+                k += replaced - 1;
+                continue;
+            }
+            code += transpileStatement(stmts[k], indent_level);
+        }
+        return code;
+    }
+
+    bool pointers_in_scope = false;
+    for (const auto &entry : m_pointers)
+        pointers_in_scope = pointers_in_scope || entry.second.kind != PointerInfo::Kind::Opaque;
+
+    // 1. Group equal loads of each straight-line run, splitting groups at stores that affect them.
+    struct Group
+    {
+        vector<shared_ptr<ExpressionNode>> occurrences;
+        vector<size_t> stmt_index;
+        ReadSet reads;
+    };
+    vector<Group> finished;
+    unordered_map<string, Group> open;
+    auto closeGroups = [&](const function<bool(const Group &)> &should_close)
+    {
+        for (auto it = open.begin(); it != open.end();)
+        {
+            if (should_close(it->second))
+            {
+                if (it->second.occurrences.size() > 1)
+                    finished.push_back(it->second);
+                it = open.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    };
+    for (size_t k = 0; k < stmts.size(); ++k)
+    {
+        vector<shared_ptr<ExpressionNode>> loads;
+        WriteSet writes;
+        collectWrites(stmts[k], writes, m_inline_candidates);
+        if (!collectStatementLoads(stmts[k], m_cse_bindings, loads) || writes.calls)
+        {
+            closeGroups([](const Group &)
+                        { return true; });
+            continue;
+        }
+        for (const auto &load : loads)
+        {
+            Group &group = open[expressionKey(load)];
+            if (group.occurrences.empty())
+                collectReads(load, group.reads);
+            group.occurrences.push_back(load);
+            group.stmt_index.push_back(k);
+        }
+        closeGroups([&](const Group &group)
+                    { return isKilledBy(group.reads, writes, pointers_in_scope); });
+    }
+    closeGroups([](const Group &)
+                { return true; });
+
+    // 2. Keep the profitable groups, largest expressions first. Loads inside a replaced
+    //    (non-first) occurrence of a larger expression are no longer evaluated at all.
+    stable_sort(finished.begin(), finished.end(), [](const Group &a, const Group &b)
+                { return countNodes(a.occurrences[0]) > countNodes(b.occurrences[0]); });
+    set<const ASTNode *> dead;
+    function<void(const shared_ptr<ASTNode> &)> markDead = [&](const shared_ptr<ASTNode> &node)
+    {
+        forEachChild(node, [&](const shared_ptr<ASTNode> &child)
+                     {
+                         dead.insert(child.get());
+                         markDead(child); });
+    };
+    // Per statement: temporaries to assign before it, smallest expression first.
+    map<size_t, vector<pair<string, const Group *>>> before;
+    vector<Group> selected;
+    selected.reserve(finished.size());
+    for (const auto &group : finished)
+    {
+        Group live;
+        live.reads = group.reads;
+        for (size_t i = 0; i < group.occurrences.size(); ++i)
+        {
+            if (!dead.count(group.occurrences[i].get()))
+            {
+                live.occurrences.push_back(group.occurrences[i]);
+                live.stmt_index.push_back(group.stmt_index[i]);
+            }
+        }
+        int n = (int)live.occurrences.size();
+        if (n < 2 || (n - 1) * evaluationCost(live.occurrences[0]) <= n + 1) // Saved work vs. one store and n loads
+            continue;
+        for (int i = 1; i < n; ++i)
+            markDead(live.occurrences[i]);
+        selected.push_back(live);
+    }
+    for (auto it = selected.rbegin(); it != selected.rend(); ++it)
+        before[it->stmt_index[0]].push_back({"_cse" + to_string(++m_cse_counter), &*it});
+
+    // 3. Emit: each temporary is assigned right before the statement of its first occurrence.
+    vector<const ASTNode *> bound;
+    for (size_t k = 0; k < stmts.size(); ++k)
+    {
+        for (const auto &temp : before[k])
+        {
+            code += indent(temp.first + " = " + transpileExpression(temp.second->occurrences[0]) + "\n", indent_level);
+            for (const auto &occurrence : temp.second->occurrences)
+            {
+                m_cse_bindings[occurrence.get()] = temp.first;
+                bound.push_back(occurrence.get());
+            }
+        }
+        code += transpileStatement(stmts[k], indent_level);
+    }
+    for (const auto *node : bound)
+        m_cse_bindings.erase(node);
+    return code;
+}
+
+// A loop body; a lone statement is treated as a one-statement list so CSE applies to it too.
+// With --profile-gen, profile_line (the loop's C line) gets an iteration counter.
+string Transpiler::transpileLoopBody(shared_ptr<StatementNode> body, int indent_level, int profile_line)
+{
+    string counter = isProfiling() && profile_line > 0 ? profileCounter("\"loop\", " + to_string(profile_line), indent_level) : "";
+    if (!body)
+        return counter + indent("pass\n", indent_level);
+    if (dynamic_pointer_cast<BlockNode>(body))
+        return counter + transpileStatement(body, indent_level);
+    string code = transpileStatementList({body}, indent_level);
+    return counter + (code.empty() ? indent("pass\n", indent_level) : code);
+}
+
+// Transpiles a for/while loop, first hoisting the multi-dimensional row references that
+// the loop cannot change. Rows are only hoisted from statements the loop body always
+// executes (not from if branches or the right operand of && and ||).
+string Transpiler::transpileLoop(shared_ptr<StatementNode> loop, int indent_level)
+{
+    string hoisted_code;
+    vector<const ASTNode *> bound;
+    bool has_multidim = false;
+    for (const auto &entry : m_declared_types)
+        has_multidim = has_multidim || entry.second.find("[][]") != string::npos;
+
+    // --instrument puts the loop (and its hoisted rows) inside a try block one level deeper.
+    int outer_indent_level = indent_level;
+    if (m_options.instrument)
+        indent_level++;
+
+    if (has_multidim)
+    {
+        WriteSet writes;
+        collectWrites(loop, writes, m_inline_candidates);
+        vector<shared_ptr<ExpressionNode>> rows;
+        function<void(const shared_ptr<ASTNode> &)> visit = [&](const shared_ptr<ASTNode> &node)
+        {
+            if (!node || dynamic_pointer_cast<IfNode>(node) || dynamic_pointer_cast<FunctionCallNode>(node))
+                return;
+            auto binary = dynamic_pointer_cast<BinaryExpressionNode>(node);
+            if (binary && (binary->getOperator() == "&&" || binary->getOperator() == "||"))
+            {
+                visit(binary->getLeft());
+                return;
+            }
+            if (auto sub = dynamic_pointer_cast<ArraySubscriptNode>(node))
+            {
+                auto row = dynamic_pointer_cast<ArraySubscriptNode>(sub->getArrayExpression());
+                if (row && !expressionKey(row).empty() && !m_cse_bindings.count(row.get()))
+                    rows.push_back(row);
+            }
+            forEachChild(node, visit);
+        };
+        if (auto forNode = dynamic_pointer_cast<ForNode>(loop))
+            visit(forNode->getBody());
+        else if (auto whileNode = dynamic_pointer_cast<WhileNode>(loop))
+            visit(whileNode->getBody());
+
+        // Shallower rows first, so grid[i] is bound before grid[i][j] of a 3-D array is computed.
+        stable_sort(rows.begin(), rows.end(), [](const shared_ptr<ExpressionNode> &a, const shared_ptr<ExpressionNode> &b)
+                    { return countNodes(a) < countNodes(b); });
+        unordered_map<string, string> temps;
+        for (const auto &row : rows)
+        {
+            int depth;
+            string base = subscriptBase(row, depth);
+            auto type = m_declared_types.find(base);
+            if (type == m_declared_types.end() || count(type->second.begin(), type->second.end(), '[') <= depth)
+                continue; // Not a row of a declared multi-dimensional array
+            ReadSet reads;
+            collectReads(row, reads);
+            bool reads_global = false;
+            for (const auto &name : reads.names)
+                reads_global = reads_global || m_global_names.count(name);
+            if (isKilledBy(reads, writes, false) || (writes.calls && reads_global))
+                continue;
+            string key = expressionKey(row);
+            if (!temps.count(key))
+            {
+                temps[key] = "_row" + to_string(++m_cse_counter);
+                hoisted_code += indent(temps[key] + " = " + transpileExpression(row) + "\n", indent_level);
+            }
+            m_cse_bindings[row.get()] = temps[key];
+            bound.push_back(row.get());
+        }
+    }
+
+    // Profile: count how often the loop is reached, or classify it as cold/hot from the counts.
+    string entry_code;
+    bool outer_cold = m_cold;
+    bool outer_hot = m_hot_loop;
+    if (isProfiling())
+        entry_code = profileCounter("\"entry\", " + to_string(loop->line), indent_level);
+    else if (m_options.profile.loaded)
+    {
+        m_cold = m_cold || m_options.profile.loopEntries(loop->line) == 0;
+        m_hot_loop = m_options.profile.loopIterations(loop->line) >= m_options.profile_hot;
+    }
+
+    m_loop_depth++;
+    string loop_code;
+    if (auto forNode = dynamic_pointer_cast<ForNode>(loop))
+        loop_code = transpileForStatement(forNode, indent_level);
+    else
+        loop_code = transpileWhileStatement(dynamic_pointer_cast<WhileNode>(loop), indent_level);
+    m_loop_depth--;
+    m_cold = outer_cold;
+    m_hot_loop = outer_hot;
+    for (const auto *node : bound)
+        m_cse_bindings.erase(node);
+    if (m_options.instrument)
+    {
+        string what = (dynamic_pointer_cast<ForNode>(loop) ? "for-loop" : "while-loop") +
+                      (m_function_name.empty() ? "" : " in " + m_function_name);
+        return instrumentConstruct(entry_code + hoisted_code + loop_code, loop->line, what, outer_indent_level);
+    }
+    return entry_code + hoisted_code + loop_code;
+}
+
+// --- Full unrolling of short counted loops ---
+// A for-loop with a small constant trip count pays more for range() iterator setup and the
+// per-iteration loop overhead than for its body. Such loops are emitted as straight-line copies
+// of the body with the loop variable replaced by its literal value, which also lets constant
+// folding simplify index arithmetic like i * 4 + j.
+
+// Integer value of a literal or of an object-like macro defined as an integer literal.
+bool Transpiler::integerConstant(shared_ptr<ExpressionNode> expr, long long &value) const
+{
+    string text;
+    if (auto num = dynamic_pointer_cast<NumberNode>(expr))
+        text = num->getValue();
+    else if (auto ident = dynamic_pointer_cast<IdentifierNode>(expr))
+    {
+        auto it = m_integer_macros.find(ident->getName());
+        if (it == m_integer_macros.end())
+            return false;
+        text = it->second;
+    }
+    else if (auto size = dynamic_pointer_cast<SizeofNode>(expr))
+        return sizeofValue(size, value);
+    else if (auto binary = dynamic_pointer_cast<BinaryExpressionNode>(expr))
+    {
+        // Arithmetic on constants, with C's truncating division (sizeof a / sizeof a[0], N * 2).
+        long long a, b;
+        const string &op = binary->getOperator();
+        if (!integerConstant(binary->getLeft(), a) || !integerConstant(binary->getRight(), b))
+            return false;
+        if (op == "+" || op == "-" || op == "*")
+            value = op == "+" ? a + b : (op == "-" ? a - b : a * b);
+        else if ((op == "/" || op == "%") && b != 0)
+            value = op == "/" ? a / b : a % b;
+        else
+            return false;
+        return true;
+    }
+    return parseIntegerLiteral(text, value);
+}
+
+bool Transpiler::transpileUnrolledLoop(shared_ptr<ForNode> forNode, const string &loop_var, shared_ptr<ExpressionNode> start,
+                                       shared_ptr<ExpressionNode> stop, bool inclusive, int step, int indent_level, string &out_code)
+{
+    long long first, bound;
+    if (m_options.unroll_max_trips <= 0 || step <= 0 || !start || !stop || m_cold || isProfiling() ||
+        !integerConstant(start, first) || !integerConstant(stop, bound))
+        return false;
+    long long end = inclusive ? bound + 1 : bound;
+    long long trips = end > first ? (end - first + step - 1) / step : 0;
+    auto body = forNode->getBody();
+    int scale = m_hot_loop ? 2 : 1; // Hot loops (by profile) may grow twice as much
+    if (trips > scale * m_options.unroll_max_trips || countNodes(body) > scale * m_options.unroll_max_body ||
+        containsLoopControl(body))
+        return false;
+    WriteSet writes;
+    collectWrites(body, writes, m_inline_candidates);
+    if (writes.names.count(loop_var) || writes.unknown || m_pointers.count(loop_var))
+        return false;
+
+    string code;
+    auto outer_binding = m_inline_bindings.find(loop_var);
+    string saved_binding = outer_binding != m_inline_bindings.end() ? outer_binding->second : "";
+    for (long long k = 0; k < trips; ++k)
+    {
+        m_inline_bindings[loop_var] = to_string(first + k * step);
+        code += body ? transpileStatement(body, indent_level) : "";
+    }
+    if (saved_binding.empty())
+        m_inline_bindings.erase(loop_var);
+    else
+        m_inline_bindings[loop_var] = saved_binding;
+
+    // A counter declared outside the loop is still visible afterwards, holding the first value that failed the test.
+    if (!dynamic_pointer_cast<VariableDeclarationNode>(forNode->getInitializer()))
+        code += indent(loop_var + " = " + to_string(first + trips * step) + "\n", indent_level);
+    m_loop_rewrites.push_back({forNode->line, "for", "fully unrolled (" + to_string(trips) + " iterations)"});
+    out_code = code;
+    return true;
+}
+
+// --- Parallel-for lowering (--parallel) ---
+// A counted loop whose iterations are independent and call pure functions is run on a process
+// pool: the loop body becomes a module-level kernel _pforN(i, captured values...) that _pmap
+// evaluates in chunks, and the results are written back in iteration order. Two loop shapes
+// are handled: A[i] = expr (a map) and s = s + expr on ints (a reduction, order-independent).
+// Loops whose estimated work is too small stay serial; at run time the pool is only used when
+// the trip count reaches the threshold derived from the same estimate.
+
+// Purity summaries of all functions of the program. A function is pure when it does no I/O,
+// stores only to its own locals, reads no global that any function assigns, and calls only
+// pure functions (or function-like macros). Its weight estimates the work of one call.
+void Transpiler::summarizePurity(shared_ptr<ProgramNode> program)
+{
+    m_pure_functions.clear();
+    if (!m_options.parallel)
+        return;
+
+    unordered_map<string, shared_ptr<FunctionDeclarationNode>> functions;
+    for (const auto &stmt : program->getStatements())
+    {
+        if (auto funcDecl = dynamic_pointer_cast<FunctionDeclarationNode>(stmt))
+        {
+            if (funcDecl->getBody())
+                functions[funcDecl->getName()] = funcDecl;
+        }
+    }
+
+    // Globals stored to anywhere in a function body are mutable: workers may not see their current value.
+    set<string> mutable_globals;
+    for (const auto &entry : functions)
+    {
+        WriteSet writes;
+        collectWrites(entry.second->getBody(), writes, {});
+        for (const auto &name : writes.names)
+        {
+            if (m_global_names.count(name))
+                mutable_globals.insert(name);
+        }
+        for (const auto &element : writes.elements)
+        {
+            if (m_global_names.count(element.first))
+                mutable_globals.insert(element.first);
+        }
+    }
+
+    unordered_map<string, int> candidates; // name -> weight
+    unordered_map<string, set<string>> callees;
+    for (const auto &entry : functions)
+    {
+        auto funcDecl = entry.second;
+        set<string> locals;
+        for (const auto &param : funcDecl->getParameters())
+        {
+            if (!param.isArray && !isPointerType(param.type))
+                locals.insert(param.name);
+        }
+        bool pure = true;
+        bool has_loop = false;
+        function<void(const shared_ptr<ASTNode> &)> visit = [&](const shared_ptr<ASTNode> &node)
+        {
+            if (!pure || !node)
+                return;
+            if (dynamic_pointer_cast<PrintfNode>(node) || dynamic_pointer_cast<ScanfNode>(node))
+                pure = false;
+            else if (auto decl = dynamic_pointer_cast<DeclarationNode>(node))
+                locals.insert(decl->getName());
+            else if (auto ident = dynamic_pointer_cast<IdentifierNode>(node))
+                pure = pure && !mutable_globals.count(ident->getName());
+            else if (auto call = dynamic_pointer_cast<FunctionCallNode>(node))
+                callees[entry.first].insert(call->getFunctionName());
+            else if (dynamic_pointer_cast<ForNode>(node) || dynamic_pointer_cast<WhileNode>(node))
+                has_loop = true;
+            forEachChild(node, visit);
+        };
+        visit(funcDecl->getBody());
+
+        // Stores must target locals (scalars, or arrays declared in the function).
+        WriteSet writes;
+        collectWrites(funcDecl->getBody(), writes, {});
+        for (const auto &name : writes.names)
+            pure = pure && locals.count(name);
+        for (const auto &element : writes.elements)
+            pure = pure && locals.count(element.first);
+        pure = pure && !writes.unknown;
+        if (pure)
+        {
+            bool recursive = callees[entry.first].count(entry.first) > 0;
+            candidates[entry.first] = countNodes(funcDecl->getBody()) * (has_loop ? 16 : 1) * (recursive ? 64 : 1);
+        }
+    }
+
+    // Drop candidates that call anything impure, until nothing changes.
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (auto it = candidates.begin(); it != candidates.end();)
+        {
+            bool calls_impure = false;
+            for (const auto &callee : callees[it->first])
+                calls_impure = calls_impure || (!candidates.count(callee) && !m_macro_functions.count(callee));
+            if (calls_impure)
+            {
+                it = candidates.erase(it);
+                changed = true;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+    m_pure_functions = candidates;
+}
+
+// Estimated work of evaluating expr once; -1 if it is not pure.
+int Transpiler::estimateWork(const shared_ptr<ASTNode> &expr) const
+{
+    if (!expr)
+        return 0;
+    int work = 1;
+    if (dynamic_pointer_cast<AssignmentNode>(expr))
+        return -1;
+    if (auto unary = dynamic_pointer_cast<UnaryExpressionNode>(expr))
+    {
+        const string &op = unary->getOperator();
+        if (op == "++" || op == "--" || op == "*" || op == "&")
+            return -1;
+    }
+    if (auto call = dynamic_pointer_cast<FunctionCallNode>(expr))
+    {
+        auto it = m_pure_functions.find(call->getFunctionName());
+        if (it == m_pure_functions.end() && !m_macro_functions.count(call->getFunctionName()))
+            return -1;
+        work += it != m_pure_functions.end() ? it->second : 1;
+    }
+    for (const auto &child : expr->getChildren())
+    {
+        int child_work = estimateWork(child);
+        if (child_work < 0)
+            return -1;
+        work += child_work;
+    }
+    return work;
+}
+
+bool Transpiler::transpileParallelLoop(shared_ptr<ForNode> forNode, const string &loop_var, shared_ptr<ExpressionNode> start,
+                                       shared_ptr<ExpressionNode> stop, bool inclusive, int step, int indent_level, string &out_code)
+{
+    auto stmts = bodyStatements(forNode->getBody());
+    auto exprStmt = stmts.size() == 1 ? dynamic_pointer_cast<ExpressionStatementNode>(stmts[0]) : nullptr;
+    auto assign = exprStmt ? dynamic_pointer_cast<AssignmentNode>(exprStmt->getExpression()) : nullptr;
+    if (!m_options.parallel || m_cold || isProfiling() || step != 1 || !start || !stop || !assign || m_pointers.count(loop_var) ||
+        !isSideEffectFree(start) || !isSideEffectFree(stop))
+        return false;
+
+    // Shape: A[i] = expr (map) or s = s + expr (reduction)
+    string target_array, accumulator;
+    shared_ptr<ExpressionNode> value;
+    if (isSubscriptByVar(assign->getLValue(), loop_var, target_array))
+    {
+        value = assign->getRValue();
+    }
+    else if (auto target = dynamic_pointer_cast<IdentifierNode>(assign->getLValue()))
+    {
+        // s = s + a + b parses as (s + a) + b: walk down the left operands to s, collecting a, b.
+        vector<shared_ptr<ExpressionNode>> terms;
+        auto sum = dynamic_pointer_cast<BinaryExpressionNode>(assign->getRValue());
+        while (sum && sum->getOperator() == "+" && !isIdentifierNamed(sum->getLeft(), target->getName()))
+        {
+            terms.insert(terms.begin(), sum->getRight());
+            sum = dynamic_pointer_cast<BinaryExpressionNode>(sum->getLeft());
+        }
+        if (!sum || sum->getOperator() != "+")
+            return false;
+        auto type = m_declared_types.find(target->getName());
+        if (type == m_declared_types.end() || type->second != "int")
+            return false; // Reordering float additions would change the rounding
+        accumulator = target->getName();
+        value = sum->getRight();
+        for (const auto &term : terms)
+        {
+            auto partial = make_shared<BinaryExpressionNode>("+");
+            partial->addChild(value);
+            partial->addChild(term);
+            value = partial;
+        }
+    }
+    else
+    {
+        return false;
+    }
+
+    // Only loops that call into pure functions carry enough work per iteration to pay for the pool.
+    int work = estimateWork(value);
+    bool calls_function = false;
+    function<void(const shared_ptr<ASTNode> &)> findCall = [&](const shared_ptr<ASTNode> &node)
+    {
+        if (auto call = dynamic_pointer_cast<FunctionCallNode>(node))
+            calls_function = calls_function || m_pure_functions.count(call->getFunctionName()) > 0;
+        forEachChild(node, findCall);
+    };
+    findCall(value);
+    if (work < 0 || !calls_function)
+        return false;
+
+    // Dependences: the only store is A[i]; A may only be read at [i]; the accumulator not at all.
+    set<string> names;
+    collectIdentifiers(value, names);
+    if (names.count(accumulator) || m_boxed.count(accumulator) || m_pointers.count(target_array))
+        return false;
+    for (const auto &name : names)
+    {
+        if (m_pointers.count(name) || m_boxed.count(name))
+            return false;
+    }
+    bool valid = true;
+    bool target_local = !target_array.empty() && !m_global_names.count(target_array) && !m_array_params.count(target_array);
+    function<void(const shared_ptr<ASTNode> &)> checkReads = [&](const shared_ptr<ASTNode> &node)
+    {
+        if (auto sub = dynamic_pointer_cast<ArraySubscriptNode>(node))
+        {
+            int depth;
+            string base = subscriptBase(sub, depth);
+            string ignored;
+            if (base.empty())
+                valid = false;
+            else if (base == target_array && !isSubscriptByVar(sub, loop_var, ignored))
+                valid = false; // Another iteration's element
+            else if (base != target_array && !target_array.empty() && !target_local &&
+                     (m_global_names.count(base) || m_array_params.count(base)))
+                valid = false; // Two non-local arrays may be the same list
+        }
+        forEachChild(node, checkReads);
+    };
+    checkReads(value);
+    if (!valid)
+        return false;
+
+    // Trip count threshold: enough iterations to amortize shipping work to the pool.
+    long long min_trips = max(2LL, (long long)m_options.parallel_min_work / work);
+    long long first, bound;
+    bool constant_trips = integerConstant(start, first) && integerConstant(stop, bound);
+    if (constant_trips && (inclusive ? bound + 1 : bound) - first < min_trips)
+        return false;
+
+    // Kernel: module level, so the worker processes can unpickle it by name.
+    string kernel = "_pfor" + to_string(++m_parallel_counter);
+    vector<string> captures;
+    for (const auto &name : names)
+    {
+        if (name != loop_var && !m_integer_macros.count(name))
+            captures.push_back(name);
+    }
+    string params = loop_var;
+    string args;
+    for (const auto &name : captures)
+    {
+        params += ", " + name;
+        args += ", " + transpileExpression(make_shared<IdentifierNode>(name));
+    }
+    // The kernel sees only its parameters: no outer bindings of the counter, no hoisted _rowN/_cseN locals.
+    auto saved_bindings = m_inline_bindings;
+    auto saved_cse = m_cse_bindings;
+    m_inline_bindings.erase(loop_var);
+    m_cse_bindings.clear();
+    m_parallel_kernels += "def " + kernel + "(" + params + "):\n" + indent("return " + transpileExpression(value) + "\n", 1) + "\n";
+    m_inline_bindings = saved_bindings;
+    m_cse_bindings = saved_cse;
+    m_runtime_helpers.insert("_b"); // Used by _pmap too
+    m_runtime_helpers.insert("_pmap");
+
+    string lo = transpileExpression(start);
+    string hi = constant_trips && inclusive ? to_string(bound + 1) : transpileExpression(stop);
+    if (inclusive && !constant_trips)
+        hi = addOffset(hi, "+", "1");
+    string parallel_code = accumulator.empty()
+                               ? target_array + "[" + lo + ":" + hi + "] = _pmap(" + kernel + ", " + lo + ", " + hi + args + ")\n"
+                               : accumulator + " = " + accumulator + " + _b.sum(_pmap(" + kernel + ", " + lo + ", " + hi + args + "))\n";
+
+    // With a constant trip count the threshold was checked above; otherwise it is checked at run time.
+    string code;
+    if (constant_trips)
+    {
+        code = indent(parallel_code, indent_level);
+    }
+    else
+    {
+        code = indent("if " + (lo == "0" ? hi : hi + " - " + lo) + " >= " + to_string(min_trips) + ":\n", indent_level);
+        code += indent(parallel_code, indent_level + 1);
+        code += indent("else:\n", indent_level);
+        code += indent("for " + loop_var + " in range(" + lo + ", " + hi + "):\n", indent_level + 1);
+        code += transpileLoopBody(forNode->getBody(), indent_level + 2);
+    }
+    if (!dynamic_pointer_cast<VariableDeclarationNode>(forNode->getInitializer()))
+        code += indent(loop_var + " = " + (constant_trips ? hi : "_b.max(" + lo + ", " + hi + ")") + "\n", indent_level);
+    m_loop_rewrites.push_back({forNode->line, "for", "parallel " + string(accumulator.empty() ? "map" : "sum") +
+                                                          " on a process pool (" + kernel + ")"});
+    out_code = code;
+    return true;
+}
+
+// --- Profile-guided transpilation ---
+// --profile-gen emits counters (in a Counter named _prof, written to the profile file at exit)
+// for function calls, loop entries and iterations and if-chain arms, keyed by C line. Optimizations
+// that remove loops or calls are off in that build so everything stays countable.
+// --profile-use reads the counts back: if-chains test their most frequent arm first, hot call sites
+// and loops may grow more through inlining and unrolling, and code that never ran is left as is.
+
+string Transpiler::profileCounter(const string &key, int indent_level)
+{
+    m_runtime_helpers.insert("_prof");
+    return indent("_prof[" + key + "] += 1\n", indent_level);
+}
+
+// Order in which an if-chain tests its conditions. By profile count, most frequent first, when
+// the conditions are mutually exclusive, so that testing one before another cannot change which
+// arm runs: `E == constant` tests of one side-effect free expression E against distinct constants.
+// Otherwise (and without a profile) source order.
+vector<size_t> Transpiler::profiledArmOrder(int line, const vector<shared_ptr<ExpressionNode>> &conditions)
+{
+    vector<size_t> order;
+    for (size_t arm = 0; arm < conditions.size(); ++arm)
+        order.push_back(arm);
+    if (!m_options.profile.loaded || conditions.size() < 2)
+        return order;
+
+    auto constantValue = [this](shared_ptr<ExpressionNode> expr, long long &value)
+    {
+        auto ch = dynamic_pointer_cast<CharLiteralNode>(expr);
+        if (ch && ch->getValue().size() == 1)
+        {
+            value = (unsigned char)ch->getValue()[0];
+            return true;
+        }
+        return integerConstant(expr, value);
+    };
+    string subject;
+    set<long long> constants;
+    for (const auto &condition : conditions)
+    {
+        auto test = dynamic_pointer_cast<BinaryExpressionNode>(condition);
+        if (!test || test->getOperator() != "==")
+            return order;
+        long long value;
+        shared_ptr<ExpressionNode> tested;
+        if (constantValue(test->getRight(), value))
+            tested = test->getLeft();
+        else if (constantValue(test->getLeft(), value))
+            tested = test->getRight();
+        else
+            return order;
+        string key = expressionKey(tested);
+        if (key.empty() || !isSideEffectFree(tested) || (!subject.empty() && key != subject) || !constants.insert(value).second)
+            return order;
+        subject = key;
+    }
+
+    const ProfileData &profile = m_options.profile;
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+                { return profile.branchCount(line, (int)a) > profile.branchCount(line, (int)b); });
+    if (order[0] != 0 || !is_sorted(order.begin(), order.end()))
+    {
+        string arms;
+        for (size_t arm : order)
+            arms += (arms.empty() ? "" : ", ") + to_string(arm);
+        m_profile_notes.push_back({line, "if-chain reordered by profile (arm order " + arms + ")"});
+    }
+    return order;
+}
+
+// --- Run-time instrumentation (--instrument) ---
+// Each C function and loop is timed with perf_counter_ns through _inst_enter/_inst_exit, which
+// keep a stack so time spent in callees and inner loops is charged to them: the exit report
+// (on stderr, sorted by self time) shows where a slow translated program spends its time, by C
+// line. Without the flag nothing of this is emitted.
+
+// Wraps already transpiled code (indented one level deeper than indent_level) in a timed try/finally.
+string Transpiler::instrumentConstruct(const string &code, int line, const string &what, int indent_level)
+{
+    m_runtime_helpers.insert("_inst");
+    string timer = "_t" + to_string(++m_instrument_counter);
+    string key = "(" + to_string(line) + ", \"" + what + "\")";
+    return indent(timer + " = _inst_enter()\n", indent_level) +
+           indent("try:\n", indent_level) + code +
+           indent("finally:\n", indent_level) +
+           indent("_inst_exit(" + key + ", " + timer + ")\n", indent_level + 1);
+}
+
+// --- Performance lint (--lint) ---
+// Loops are checked when they are emitted as Python for/while loops (not when they became an
+// idiom, were unrolled, precomputed or parallelized), so the warnings describe the code that
+// actually runs. Each finding carries an estimated per-iteration cost from a simple model:
+// one unit per AST node evaluated (a subscript counts 3, like the CSE cost model), plus
+// LINT_CALL_COST per Python call and, for a call to a program function, one unit per node of
+// its body. A global read counts 2: LOAD_GLOBAL is a dictionary lookup, LOAD_FAST an array index.
+
+static const int LINT_CALL_COST = 4;
+static const int LINT_GLOBAL_READ_COST = 2;
+
+void Transpiler::prepareLint(shared_ptr<ProgramNode> program)
+{
+    m_function_sizes.clear();
+    m_function_locals.clear();
+    if (!m_options.lint)
+        return;
+    for (const auto &stmt : program->getStatements())
+    {
+        auto funcDecl = dynamic_pointer_cast<FunctionDeclarationNode>(stmt);
+        if (!funcDecl || !funcDecl->getBody())
+            continue;
+        m_function_sizes[funcDecl->getName()] = countNodes(funcDecl->getBody());
+
+        // Python makes every name the function declares or assigns a local (no global statements are emitted).
+        set<string> &locals = m_function_locals[funcDecl->getName()];
+        for (const auto &param : funcDecl->getParameters())
+            locals.insert(param.name);
+        function<void(const shared_ptr<ASTNode> &)> visit = [&](const shared_ptr<ASTNode> &node)
+        {
+            if (!node)
+                return;
+            if (auto decl = dynamic_pointer_cast<DeclarationNode>(node))
+                locals.insert(decl->getName());
+            else if (auto assign = dynamic_pointer_cast<AssignmentNode>(node))
+            {
+                if (auto target = dynamic_pointer_cast<IdentifierNode>(assign->getLValue()))
+                    locals.insert(target->getName());
+            }
+            else if (auto unary = dynamic_pointer_cast<UnaryExpressionNode>(node))
+            {
+                auto target = dynamic_pointer_cast<IdentifierNode>(unary->getOperand());
+                if (target && (unary->getOperator() == "++" || unary->getOperator() == "--"))
+                    locals.insert(target->getName());
+            }
+            forEachChild(node, visit);
+        };
+        visit(funcDecl->getBody());
+    }
+}
+
+void Transpiler::lint(int line, const string &rule, const string &message, int cost)
+{
+    if (m_lint_keys.insert(to_string(line) + "|" + rule + "|" + message).second)
+        m_lint_warnings.push_back({line, rule, message, cost});
+}
+
+int Transpiler::lintCost(const shared_ptr<ASTNode> &node) const
+{
+    if (!node)
+        return 0;
+    int cost = dynamic_pointer_cast<ArraySubscriptNode>(node) ? 3 : 1;
+    if (auto call = dynamic_pointer_cast<FunctionCallNode>(node))
+    {
+        auto callee = m_function_sizes.find(call->getFunctionName());
+        cost += LINT_CALL_COST + (callee != m_function_sizes.end() ? callee->second : 0);
+    }
+    else if (dynamic_pointer_cast<PrintfNode>(node) || dynamic_pointer_cast<ScanfNode>(node))
+    {
+        cost += LINT_CALL_COST;
+    }
+    forEachChild(node, [&](const shared_ptr<ASTNode> &child)
+                 { cost += lintCost(child); });
+    return cost;
+}
+
+// Checks what one iteration of an emitted loop executes: 'condition' and 'increment' are the parts
+// evaluated on every iteration (nullptr when range() took them over). Nested loops are checked
+// when they are emitted themselves.
+void Transpiler::lintLoop(shared_ptr<StatementNode> loop, shared_ptr<ExpressionNode> condition, shared_ptr<ExpressionNode> increment,
+                          shared_ptr<StatementNode> body)
+{
+    if (!m_options.lint)
+        return;
+
+    // Calls in the loop condition run once per iteration.
+    function<void(const shared_ptr<ASTNode> &)> findCalls = [&](const shared_ptr<ASTNode> &node)
+    {
+        if (!node)
+            return;
+        auto call = dynamic_pointer_cast<FunctionCallNode>(node);
+        if (call && !m_inline_sites.count(call.get()))
+        {
+            lint(loop->line, "call-in-loop-condition",
+                 "'" + call->getFunctionName() + "()' in the loop condition is called on every iteration; "
+                                                 "if its result cannot change inside the loop, compute it once before",
+                 lintCost(call));
+        }
+        forEachChild(node, findCalls);
+    };
+    findCalls(condition);
+
+    // Without char-as-int a C char is a one-character str, so char + char concatenates strings.
+    auto isText = [this](const shared_ptr<ExpressionNode> &expr)
+    {
+        if (dynamic_pointer_cast<StringLiteralNode>(expr) || dynamic_pointer_cast<CharLiteralNode>(expr))
+            return true;
+        int depth;
+        string base = subscriptBase(expr, depth);
+        auto type = m_declared_types.find(base);
+        return type != m_declared_types.end() && type->second.rfind("char", 0) == 0 &&
+               (int)count(type->second.begin(), type->second.end(), '[') == depth && type->second.find('*') == string::npos;
+    };
+
+    auto locals = m_function_locals.find(m_function_name);
+    map<string, int> global_reads;
+    int statement_line = loop->line;
+    function<void(const shared_ptr<ASTNode> &)> visit = [&](const shared_ptr<ASTNode> &node)
+    {
+        if (!node || dynamic_pointer_cast<ForNode>(node) || dynamic_pointer_cast<WhileNode>(node))
+            return;
+        int outer_line = statement_line;
+        if (auto stmt = dynamic_pointer_cast<StatementNode>(node))
+            statement_line = stmt->line > 0 ? stmt->line : statement_line;
+
+        if (dynamic_pointer_cast<PrintfNode>(node))
+        {
+            lint(statement_line, "io-in-loop", "printf in a loop makes one print() call per iteration; "
+                                               "collect the pieces in a list and write them once with ''.join()",
+                 lintCost(node));
+        }
+        else if (dynamic_pointer_cast<ScanfNode>(node))
+        {
+            lint(statement_line, "io-in-loop", "scanf in a loop makes one input() call per iteration; "
+                                               "read all input once (sys.stdin.read().split()) and index into it",
+                 lintCost(node));
+        }
+        else if (auto ident = dynamic_pointer_cast<IdentifierNode>(node))
+        {
+            const string &name = ident->getName();
+            bool module_level = m_global_names.count(name) || m_integer_macros.count(name);
+            bool local = locals != m_function_locals.end() && locals->second.count(name);
+            if (!m_function_name.empty() && module_level && !local && !m_inline_bindings.count(name))
+                global_reads[name]++;
+        }
+        else if (auto binary = dynamic_pointer_cast<BinaryExpressionNode>(node))
+        {
+            if (!m_options.char_as_int && binary->getOperator() == "+" && isText(binary->getLeft()) && isText(binary->getRight()))
+            {
+                lint(statement_line, "string-concat-in-loop",
+                     "'+' on chars concatenates Python strings, building a new string on every iteration "
+                     "(--char-as-int keeps chars as integers)",
+                     lintCost(binary));
+            }
+        }
+        forEachChild(node, visit);
+        statement_line = outer_line;
+    };
+    visit(condition);
+    visit(increment);
+    visit(body);
+
+    for (const auto &read : global_reads)
+    {
+        lint(loop->line, "global-in-loop",
+             "global '" + read.first + "' is read " + to_string(read.second) + " time(s) per iteration with LOAD_GLOBAL "
+                                                                                "(a dictionary lookup); copy it to a local before the loop",
+             LINT_GLOBAL_READ_COST * read.second);
+    }
+}
+
 // --- MODIFY transpileStatement ---
 string Transpiler::transpileStatement(shared_ptr<StatementNode> stmt, int base_indent_level)
 {
@@ -992,6 +4901,19 @@ string Transpiler::transpileStatement(shared_ptr<StatementNode> stmt, int base_i
         return "";
     }
 
+    // Source map: transpile the statement, then tag its first line with the C line.
+    if (m_options.source_map && stmt->line > 0 && m_tagging_statement != stmt.get())
+    {
+        const StatementNode *outer = m_tagging_statement;
+        m_tagging_statement = stmt.get();
+        string code = transpileStatement(stmt, base_indent_level);
+        m_tagging_statement = outer;
+        size_t first = code.find_first_not_of(" ");
+        if (first != string::npos)
+            code.insert(first, SOURCE_TAG_START + to_string(stmt->line) + SOURCE_TAG_END);
+        return code;
+    }
+
     // ---- SECTION 1: Structural/Block statements ----
     if (auto funcDecl = dynamic_pointer_cast<FunctionDeclarationNode>(stmt))
     {
@@ -1001,13 +4923,9 @@ string Transpiler::transpileStatement(shared_ptr<StatementNode> stmt, int base_i
     {
         return transpileIfStatement(ifStmt, base_indent_level);
     }
-    else if (auto forStmt = dynamic_pointer_cast<ForNode>(stmt))
+    else if (dynamic_pointer_cast<ForNode>(stmt) || dynamic_pointer_cast<WhileNode>(stmt))
     {
-        return transpileForStatement(forStmt, base_indent_level);
-    }
-    else if (auto whileStmt = dynamic_pointer_cast<WhileNode>(stmt))
-    {
-        return transpileWhileStatement(whileStmt, base_indent_level);
+        return transpileLoop(stmt, base_indent_level);
     }
     else if (auto blockStmt = dynamic_pointer_cast<BlockNode>(stmt))
     {
@@ -1082,6 +5000,12 @@ string Transpiler::transpileExpression(shared_ptr<ExpressionNode> expr)
 {
     if (!expr)
         return "";
+    if (!m_cse_bindings.empty())
+    {
+        auto it = m_cse_bindings.find(expr.get());
+        if (it != m_cse_bindings.end())
+            return it->second;
+    }
     if (auto binary = dynamic_pointer_cast<BinaryExpressionNode>(expr))
         return transpileBinaryExpression(binary);
     if (auto unary = dynamic_pointer_cast<UnaryExpressionNode>(expr))
@@ -1102,7 +5026,11 @@ string Transpiler::transpileExpression(shared_ptr<ExpressionNode> expr)
         return transpileFunctionCallNode(funcCall);                   // <<<< MAKE SURE THIS IS PRESENT AND ACTIVE
     if (auto assign = dynamic_pointer_cast<AssignmentNode>(expr))     // Check this is also present for assignments within expressions
         return transpileAssignmentNode(assign);
+    if (auto cast = dynamic_pointer_cast<CastNode>(expr))
+        return transpileCastNode(cast);
+    if (auto size = dynamic_pointer_cast<SizeofNode>(expr))
+        return transpileSizeofNode(size);
 
-    cerr << "Transpiler Error: Unsupported expression type: " << (expr->type_name.empty() ? "Unknown" : expr->type_name) << endl;
+    *m_diagnostics << "Transpiler Error: Unsupported expression type: " << (expr->type_name.empty() ? "Unknown" : expr->type_name) << endl;
     return "#UNSUPPORTED_EXPR_" + expr->type_name;
 }
\ No newline at end of file
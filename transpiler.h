@@ -2,13 +2,204 @@
 
 #include "Parser.h" // Includes all AST Node definition
 #include "Lexer.h"
+#include "Evaluator.h"
+#include "Profile.h"
+#include "Abi.h"
+#include "Stats.h"
+#include <unordered_map>
+#include <set>
+#include <list>
+#include <map>
+#include <mutex>
+#include <iostream>
 using namespace std;
 
+// Code generation choices, set from the command line in main.cpp.
+struct TranspilerOptions
+{
+    // Represent C char values as ints and char arrays as bytearrays; text is only
+    // converted to/from str at printf/scanf, so character arithmetic stays integer arithmetic.
+    bool char_as_int = false;
+    // Largest callee (in AST nodes) that is expanded at its call sites; 0 disables inlining.
+    int inline_budget = 24;
+    // Total code growth allowed from inlining, in percent of the program's AST node count.
+    int inline_growth = 30;
+    // Loops with at most this many iterations (and a constant trip count) are fully unrolled; 0 disables.
+    int unroll_max_trips = 4;
+    // Largest loop body, in AST nodes, that is unrolled.
+    int unroll_max_body = 32;
+    // Run provably independent loops that call pure functions on a process pool.
+    bool parallel = false;
+    // Estimated work units a parallel loop must reach (trip count x work per iteration) to use the pool.
+    int parallel_min_work = 100000;
+    // Steps the transpile-time evaluator may spend on one table-filling run of statements; 0 disables it.
+    long long eval_budget = 1000000;
+    // Largest table (in elements, all arrays of a run) that is emitted as a literal.
+    long long eval_max_elements = 4096;
+    // --profile-gen: emit instrumented code that writes execution counts to this file at exit ("" = off).
+    string profile_gen_path;
+    // --profile-use: counts of an instrumented run, used to order if-chains, pick call sites to
+    // inline and loops to unroll, and to keep code that never ran unoptimized (profile.loaded = on).
+    ProfileData profile;
+    // Call sites and loops executed at least this often count as hot.
+    long long profile_hot = 1000;
+    // Time every function and loop (perf_counter_ns, keyed by C line) and print a report sorted by self time at exit.
+    bool instrument = false;
+    // Record the C line of every generated Python line (see getSourceLines and SourceMap.h).
+    bool source_map = false;
+    // Collect performance lint warnings about slow patterns in the emitted Python (see getLintWarnings).
+    bool lint = false;
+    // Type sizes sizeof is evaluated with (--abi).
+    TargetAbi abi;
+};
+
+// Applies one command-line option that sets a TranspilerOptions field (--char-as-int,
+// --inline-budget=N, ..., --abi=NAME). Returns false if arg is not such an option; throws
+// invalid_argument/out_of_range if its value is malformed. --profile-use (which reads a file) is
+// left to the caller.
+bool parseTranspilerOption(const string &arg, TranspilerOptions &options);
+
+// Python expressions of macro bodies, shared by the transpilations of a --serve process that use the
+// same options (the translation depends only on the body, the parameters and the options).
+// Holds at most 'capacity' translations, dropping the least recently used. Safe to use from several threads.
+class MacroTranslationCache
+{
+public:
+    explicit MacroTranslationCache(size_t capacity = 4096) : m_capacity(capacity) {}
+
+    // The Python expression and the messages its translation wrote, if 'key' was stored before.
+    bool find(const string &key, string &python, string &messages)
+    {
+        lock_guard<mutex> guard(m_lock);
+        auto it = m_entries.find(key);
+        if (it == m_entries.end())
+            return false;
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        python = it->second->python;
+        messages = it->second->messages;
+        m_hits++;
+        return true;
+    }
+    void store(const string &key, const string &python, const string &messages)
+    {
+        lock_guard<mutex> guard(m_lock);
+        if (m_entries.count(key))
+            return;
+        m_lru.push_front({key, python, messages});
+        m_entries[key] = m_lru.begin();
+        if (m_lru.size() > m_capacity)
+        {
+            m_entries.erase(m_lru.back().key);
+            m_lru.pop_back();
+        }
+    }
+    long long hits()
+    {
+        lock_guard<mutex> guard(m_lock);
+        return m_hits;
+    }
+
+private:
+    struct Entry
+    {
+        string key;
+        string python;
+        string messages;
+    };
+
+    mutex m_lock;
+    size_t m_capacity;
+    list<Entry> m_lru; // Most recently used first
+    unordered_map<string, list<Entry>::iterator> m_entries;
+    long long m_hits = 0;
+};
+
+// A loop that visits var = lo, lo + 1, ..., hi - 1 (hi exclusive once 'inclusive' is applied).
+// Built by the for/while transpilers and handed to the loop idiom recognizer.
+struct CountedLoop
+{
+    string var;
+    shared_ptr<ExpressionNode> lo;      // nullptr: the loop starts from var's current value (while loops)
+    shared_ptr<ExpressionNode> hi;      // Bound from the condition (var < hi or var <= hi)
+    bool inclusive = false;             // true for var <= hi
+    bool var_live_after = false;        // var is visible after the loop, so its final value must be kept
+    shared_ptr<StatementNode> body_stmt; // The single statement executed per iteration (increment removed)
+};
+
+// One entry of the loop idiom report: which C loop was replaced by which Python builtin.
+struct LoopRewrite
+{
+    int line;
+    string loop_kind; // "for" or "while"
+    string idiom;     // e.g. "sum() reduction over arr"
+};
+
+// One finding of the performance lint: a pattern in the generated Python that is known to be slow.
+struct LintWarning
+{
+    int line;       // C line of the construct
+    string rule;    // e.g. "global-in-loop", "while-not-range"
+    string message;
+    int cost;       // Estimated bytecode units the pattern costs per loop iteration (0: not in a loop)
+};
+
+// How a C pointer variable is represented in the generated Python (decided per function by analyzePointers).
+// Pointers are (buffer, offset) pairs; whenever possible the buffer is known statically and only
+// the integer offset survives as a Python variable.
+struct PointerInfo
+{
+    enum class Kind
+    {
+        Buffer,      // Never moved, offset 0: the variable simply names the list (arrays, malloc results)
+        Walker,      // Only ever walks one known list: the variable holds the integer offset into 'buffer'
+        Pair,        // May switch lists: offset in the variable, current list in <name>__buf
+        ScalarAlias, // Points at a single scalar variable: *p is rewritten to that variable
+        Opaque       // Not understood: transpiled as a plain Python variable
+    };
+    Kind kind = Kind::Opaque;
+    string buffer; // Walker: list being indexed; ScalarAlias: the aliased variable
+    bool from_param = false; // Walker/Pair parameter: the incoming list (or list and offset) is copied to <name>__buf on entry
+};
+
+// A macro whose body has a sizeof that can only be evaluated where the macro is used: its uses are
+// replaced by the body, with the parameters standing for the arguments of each use.
+struct MacroExpansion
+{
+    bool function_like = false;
+    vector<string> parameters;
+    shared_ptr<ExpressionNode> body;
+};
+
+// A function whose body is only `T v = e;` declarations followed by `if (c) return a;` ... `return e;`.
+// Such a function is a single Python conditional expression, so calls to it can be expanded in place.
+struct InlineCandidate
+{
+    shared_ptr<FunctionDeclarationNode> decl;
+    vector<pair<string, shared_ptr<ExpressionNode>>> locals;                           // In declaration order
+    vector<pair<shared_ptr<ExpressionNode>, shared_ptr<ExpressionNode>>> guarded_returns; // (condition, value)
+    shared_ptr<ExpressionNode> final_return;
+    int size = 0;       // AST nodes in all of the expressions above
+    set<string> globals; // Names the body reads that are neither parameters nor locals
+};
+
 class Transpiler
 {
 public:
-    Transpiler();
+    explicit Transpiler(const TranspilerOptions &options = TranspilerOptions());
     string transpile(shared_ptr<ProgramNode> program, const vector<MacroDefinition> &macros);
+    const vector<LoopRewrite> &getLoopRewrites() const { return m_loop_rewrites; }
+    const map<string, int> &getInlinedCalls() const { return m_inlined_calls; } // Callee name -> expanded call sites
+    const vector<pair<int, string>> &getProfileNotes() const { return m_profile_notes; } // (C line, decision)
+    const vector<int> &getSourceLines() const { return m_source_lines; } // With source_map: C line per Python line (0: none)
+    const vector<LintWarning> &getLintWarnings() const { return m_lint_warnings; } // With lint: in order of emission
+    // Where warnings and errors go (default cerr); also used for the lexer/parser of macro bodies.
+    void setDiagnostics(ostream &out) { m_diagnostics = &out; }
+    // Reuse macro translations of earlier transpilations with the same options (nullptr: off).
+    void setMacroCache(MacroTranslationCache *cache) { m_macro_cache = cache; }
+    // --stats: each pass adds its time to 'stats' as "pass:<name>" (nullptr: not measured).
+    void setStats(TranspileStats *stats) { m_stats = stats; }
+    // "Transpiler Info" lines about loop rewrites, profile decisions and inlined calls.
+    void writeInfoMessages(ostream &out) const;
 
 private:
     // Program
@@ -43,6 +234,9 @@ private:
     string transpileBinaryExpression(shared_ptr<BinaryExpressionNode> expr);
     string transpileUnaryExpression(shared_ptr<UnaryExpressionNode> expr);
     string transpileFunctionCallNode(shared_ptr<FunctionCallNode> expr);
+    string transpileCastNode(shared_ptr<CastNode> expr);
+    string transpileSizeofNode(shared_ptr<SizeofNode> expr);
+    string unsupportedValue(const string &what); // _unsupported('what'), see runtimeHelperDefinitions
     string transpileStringLiteralNode(shared_ptr<StringLiteralNode> expr);
     string transpileCharLiteralNode(shared_ptr<CharLiteralNode> expr);
     string transpileNumberNode(shared_ptr<NumberNode> expr);
@@ -51,7 +245,125 @@ private:
 
     // Helper
     string indent(const string &code, int level, bool add_final_newline_if_missing = false);
+    TranspilerOptions m_options;
+    ostream *m_diagnostics = &cerr;
+    MacroTranslationCache *m_macro_cache = nullptr;
+    unordered_map<string, long long> m_enumerators; // Of the program being transpiled, for macro bodies
+    string m_enumerator_key;                         // The same, as text for the macro cache key
+    TranspileStats *m_stats = nullptr;
+    set<string> m_runtime_helpers; // Names of runtime helper functions the generated code needs
+    string transpileRuntimeHelpers() const;
+    string transpileCharBufferArgument(shared_ptr<ExpressionNode> expr, string &offset);
     int m_current_indent_level; // To manage global indentation if needed (can be tricky)
                                 // Simpler approach: pass indent level around. I'll use passed level.
     string transpileMacroBodyToPythonExpression(const string &c_macro_body_source, const vector<string> &macro_params);
+    string translateMacroBody(const string &c_macro_body_source, const vector<string> &macro_params);
+    shared_ptr<ExpressionNode> parseMacroBody(const string &c_macro_body_source, const vector<string> &macro_params, string &python);
+    bool transpileMacroExpansion(const string &name, bool called, const vector<shared_ptr<ExpressionNode>> &args, string &out_code);
+    bool withMacroArgument(const string &name, const function<void(const shared_ptr<ExpressionNode> &)> &use) const;
+    unordered_map<string, MacroExpansion> m_macro_expansions;
+    // Arguments of the macro expansions being transpiled, innermost last (parameter -> argument)
+    mutable vector<unordered_map<string, shared_ptr<ExpressionNode>>> m_macro_arguments;
+    mutable set<string> m_expanding_macros;
+
+    // Partial evaluation: table-filling code over constants is run at transpile time (see Evaluator)
+    size_t transpilePrecomputed(const vector<shared_ptr<StatementNode>> &stmts, size_t first, int indent_level, string &out_code);
+    void planGlobalTables(shared_ptr<ProgramNode> program);
+    void defineEvaluatorConstants(Evaluator &evaluator) const;
+    string transpileEvaluatedVariable(const string &name, const EvalVariable &variable, int indent_level);
+    string transpileEvaluatedValue(const EvalValue &value, const string &type);
+    unordered_map<string, EvalVariable> m_precomputed_globals; // Globals emitted as literals (see planGlobalTables)
+    set<const StatementNode *> m_precomputed_statements; // Statements of main those literals replace
+
+    // Loop idiom recognizer (sum/min/max reductions, linear search, fill, copy)
+    bool transpileLoopIdiom(const CountedLoop &loop, int line, const string &loop_kind, int indent_level, string &out_code);
+    string elementTypeOf(const string &array_name) const;
+    unordered_map<string, string> m_declared_types; // C types of names in scope ("int", "int[]", "int*", ...)
+    unordered_map<string, vector<long long>> m_array_dims; // Constant dimensions of the arrays in m_declared_types
+
+    // sizeof, evaluated at transpile time under m_options.abi
+    bool sizeofValue(shared_ptr<SizeofNode> expr, long long &size) const;
+    bool staticType(shared_ptr<ExpressionNode> expr, string &type, vector<long long> &dims) const;
+
+    // Pointer lowering (pointer walks become index arithmetic on a known list)
+    void analyzePointers(shared_ptr<FunctionDeclarationNode> funcDecl);
+    bool pointerParts(shared_ptr<ExpressionNode> expr, string &buffer, string &offset);
+    bool isPointerExpression(shared_ptr<ExpressionNode> expr) const;
+    bool isPointerValue(shared_ptr<ExpressionNode> expr, bool &moved) const;
+    void planPointerArguments(shared_ptr<ProgramNode> program);
+    string transpilePointerAssignment(const string &name, shared_ptr<ExpressionNode> rhs);
+    string transpileAllocation(shared_ptr<FunctionCallNode> call, const string &pointer_type);
+    unordered_map<string, PointerInfo> m_pointers; // Pointer variables of the function being transpiled
+    set<string> m_boxed; // Its scalars whose address escapes: one-element lists (x is x[0], &x is x)
+    unordered_map<string, shared_ptr<FunctionDeclarationNode>> m_defined_functions; // Functions of the program, by name
+    unordered_map<string, set<size_t>> m_offset_params; // Function -> indexes of the pointer parameters passed (list, offset)
+    vector<LoopRewrite> m_loop_rewrites;
+
+    // Small-function inlining (pure, non-recursive callees expanded as expressions at chosen call sites)
+    void planInlining(shared_ptr<ProgramNode> program);
+    void declareParameters(shared_ptr<FunctionDeclarationNode> funcDecl);
+    bool transpileInlinedCall(shared_ptr<FunctionCallNode> call, string &out_code);
+    unordered_map<string, InlineCandidate> m_inline_candidates;
+    set<const ASTNode *> m_inline_sites;               // Call nodes chosen for expansion
+    unordered_map<string, string> m_inline_bindings;   // Name -> Python expression substituted for it (inlined callee
+                                                       // parameters/locals, unrolled loop counters)
+    int m_inline_depth = 0;                            // Expansions are not nested
+    int m_inline_counter = 0;                          // Numbers the _inlN_ temporaries
+    map<string, int> m_inlined_calls;
+
+    // Common subexpression elimination in loop bodies, and hoisting of invariant multi-dimensional rows
+    string transpileStatementList(const vector<shared_ptr<StatementNode>> &stmts, int indent_level);
+    string transpileLoopBody(shared_ptr<StatementNode> body, int indent_level, int profile_line = 0);
+    string transpileLoop(shared_ptr<StatementNode> loop, int indent_level);
+    unordered_map<const ASTNode *, string> m_cse_bindings; // Expression node -> local that already holds its value
+    int m_cse_counter = 0;                                 // Numbers the _cseN/_rowN locals
+    int m_loop_depth = 0;
+    set<string> m_global_names; // Variables declared at file scope
+
+    // Full unrolling of counted loops with a small constant trip count
+    bool transpileUnrolledLoop(shared_ptr<ForNode> forNode, const string &loop_var, shared_ptr<ExpressionNode> start,
+                               shared_ptr<ExpressionNode> stop, bool inclusive, int step, int indent_level, string &out_code);
+    bool integerConstant(shared_ptr<ExpressionNode> expr, long long &value) const;
+    unordered_map<string, string> m_integer_macros; // Object-like macros whose body is an integer literal
+
+    // Parallel-for lowering: independent map/sum loops become module-level kernels run by _pmap
+    void summarizePurity(shared_ptr<ProgramNode> program);
+    int estimateWork(const shared_ptr<ASTNode> &expr) const;
+    bool transpileParallelLoop(shared_ptr<ForNode> forNode, const string &loop_var, shared_ptr<ExpressionNode> start,
+                               shared_ptr<ExpressionNode> stop, bool inclusive, int step, int indent_level, string &out_code);
+    unordered_map<string, int> m_pure_functions; // Pure function -> estimated work of one call
+    set<string> m_macro_functions;               // Function-like macros (expressions of their arguments)
+    set<string> m_array_params;                  // Array and pointer parameters of the function being transpiled
+    string m_parallel_kernels;                   // _pforN definitions, emitted at module level
+    int m_parallel_counter = 0;
+
+    // Profile-guided transpilation (--profile-gen / --profile-use)
+    bool isProfiling() const { return !m_options.profile_gen_path.empty(); }
+    string profileCounter(const string &key, int indent_level);
+    vector<size_t> profiledArmOrder(int line, const vector<shared_ptr<ExpressionNode>> &conditions);
+    bool m_cold = false;     // Transpiling code the profile says never ran: no code-growing optimizations
+    bool m_hot_loop = false; // The loop being transpiled ran at least profile_hot iterations
+    vector<pair<int, string>> m_profile_notes;
+
+    // Run-time instrumentation (--instrument): try/finally timers around functions and loops
+    string instrumentConstruct(const string &code, int line, const string &what, int indent_level);
+    string m_function_name; // C function being transpiled ("" at file scope)
+    int m_instrument_counter = 0;
+
+    // Source map: statements tag their first line with their C line while transpiling; transpile()
+    // strips the tags into m_source_lines
+    string stripSourceTags(const string &tagged_code);
+    const StatementNode *m_tagging_statement = nullptr;
+    vector<int> m_source_lines;
+
+    // Performance lint (--lint): loops are checked as they are emitted as Python for/while loops
+    void prepareLint(shared_ptr<ProgramNode> program);
+    void lint(int line, const string &rule, const string &message, int cost);
+    void lintLoop(shared_ptr<StatementNode> loop, shared_ptr<ExpressionNode> condition, shared_ptr<ExpressionNode> increment,
+                  shared_ptr<StatementNode> body);
+    int lintCost(const shared_ptr<ASTNode> &node) const;
+    unordered_map<string, int> m_function_sizes;           // Program function -> AST nodes of its body
+    unordered_map<string, set<string>> m_function_locals; // Program function -> parameters, locals and assigned names
+    vector<LintWarning> m_lint_warnings;
+    set<string> m_lint_keys; // Findings already reported (a construct may be transpiled more than once)
 };
\ No newline at end of file